@@ -109,6 +109,14 @@ bytes OverlayDB::lookupAux(h256 const& _h) const
 	return asBytes(v);
 }
 
+OverlayDB OverlayDB::share() const
+{
+	OverlayDB ret;
+	ret.m_db = m_db;
+	ret.m_nodeCache = m_nodeCache;
+	return ret;
+}
+
 void OverlayDB::rollback()
 {
 #if DEV_GUARDED_DB
@@ -121,7 +129,13 @@ std::string OverlayDB::lookup(h256 const& _h) const
 {
 	std::string ret = MemoryDB::lookup(_h);
 	if (ret.empty() && m_db)
+	{
+		if (m_nodeCache && m_nodeCache->get(_h, ret))
+			return ret;
 		m_db->Get(m_readOptions, ldb::Slice((char const*)_h.data(), 32), &ret);
+		if (m_nodeCache && !ret.empty())
+			m_nodeCache->store(_h, ret);
+	}
 	return ret;
 }
 
@@ -159,6 +173,8 @@ bool OverlayDB::deepkill(h256 const& _h)
 {
 	
 	kill(_h);
+	if (m_nodeCache)
+		m_nodeCache->erase(_h);
 
 	
 	ldb::Status s = m_db->Delete(m_writeOptions, ldb::Slice((char const*)_h.data(), 32));
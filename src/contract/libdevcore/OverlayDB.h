@@ -26,6 +26,7 @@
 #include <libdevcore/Common.h>
 #include <libdevcore/Log.h>
 #include <libdevcore/MemoryDB.h>
+#include <libdevcore/TrieNodeCache.h>
 
 namespace dev
 {
@@ -37,6 +38,12 @@ public:
 	~OverlayDB();
 
 	ldb::DB* db() const { return m_db.get(); }
+	/// A new overlay without pending changes on top of the same database.
+	OverlayDB share() const;
+
+	/// Nodes read from the database are kept in _cache, copies and shares use the same cache.
+	void setNodeCache(TrieNodeCache* _cache) { m_nodeCache = _cache; }
+	TrieNodeCache* nodeCache() const { return m_nodeCache; }
 
 	void commit();
 	void rollback();
@@ -52,6 +59,7 @@ private:
 	using MemoryDB::clear;
 
 	std::shared_ptr<ldb::DB> m_db;
+	TrieNodeCache* m_nodeCache = nullptr;
 
 	ldb::ReadOptions m_readOptions;
 	ldb::WriteOptions m_writeOptions;
@@ -0,0 +1,91 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http:
+*/
+/** @file TrieNodeCache.cpp
+ * @date 2018
+ */
+
+#include "TrieNodeCache.h"
+using namespace std;
+using namespace dev;
+
+bool TrieNodeCache::get(h256 const& _h, string& _out)
+{
+	Guard l(x_cache);
+	if (!m_maxMemory)
+		return false;
+	auto it = m_cache.find(_h);
+	if (it == m_cache.end())
+	{
+		++m_misses;
+		return false;
+	}
+	++m_hits;
+	m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+	_out = it->second.node;
+	return true;
+}
+
+void TrieNodeCache::store(h256 const& _h, string const& _node)
+{
+	size_t memory = memoryUsage(_node);
+	Guard l(x_cache);
+	if (memory > m_maxMemory || m_cache.count(_h))
+		return;
+	m_lru.push_front(_h);
+	m_cache[_h] = Entry{_node, m_lru.begin()};
+	m_memoryUsage += memory;
+	evict();
+}
+
+void TrieNodeCache::erase(h256 const& _h)
+{
+	Guard l(x_cache);
+	auto it = m_cache.find(_h);
+	if (it == m_cache.end())
+		return;
+	m_memoryUsage -= memoryUsage(it->second.node);
+	m_lru.erase(it->second.lru);
+	m_cache.erase(it);
+}
+
+void TrieNodeCache::setMaxMemory(size_t _bytes)
+{
+	Guard l(x_cache);
+	m_maxMemory = _bytes;
+	evict();
+}
+
+void TrieNodeCache::clear()
+{
+	Guard l(x_cache);
+	m_cache.clear();
+	m_lru.clear();
+	m_memoryUsage = 0;
+	m_hits = 0;
+	m_misses = 0;
+}
+
+void TrieNodeCache::evict()
+{
+	while (m_memoryUsage > m_maxMemory && !m_lru.empty())
+	{
+		auto it = m_cache.find(m_lru.back());
+		m_memoryUsage -= memoryUsage(it->second.node);
+		m_cache.erase(it);
+		m_lru.pop_back();
+	}
+}
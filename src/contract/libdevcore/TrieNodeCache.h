@@ -0,0 +1,79 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http:
+*/
+/** @file TrieNodeCache.h
+ * @date 2018
+ */
+
+#pragma once
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include "FixedHash.h"
+#include "Guards.h"
+
+namespace dev
+{
+
+/**
+ * @brief Thread-safe cache of trie nodes read from the database, keyed by node hash.
+ * A node is the preimage of its key, so an entry never goes stale and one cache can be shared
+ * by every trie on the same database. Entries are evicted least recently used first once the
+ * memory budget is exceeded.
+ */
+class TrieNodeCache
+{
+public:
+	/// Copies the node into _out and returns true when it is cached.
+	bool get(h256 const& _h, std::string& _out);
+	void store(h256 const& _h, std::string const& _node);
+	void erase(h256 const& _h);
+
+	void setMaxMemory(size_t _bytes);
+	size_t maxMemory() const { Guard l(x_cache); return m_maxMemory; }
+	bool enabled() const { return maxMemory() > 0; }
+	void clear();
+
+	uint64_t hits() const { Guard l(x_cache); return m_hits; }
+	uint64_t misses() const { Guard l(x_cache); return m_misses; }
+	size_t size() const { Guard l(x_cache); return m_cache.size(); }
+	size_t memoryUsage() const { Guard l(x_cache); return m_memoryUsage; }
+
+	static TrieNodeCache& instance() { static TrieNodeCache cache; return cache; }
+
+	static const size_t c_defaultMaxMemory = 64 * 1024 * 1024;
+
+private:
+	struct Entry
+	{
+		std::string node;
+		std::list<h256>::iterator lru;
+	};
+
+	static size_t memoryUsage(std::string const& _node) { return sizeof(Entry) + sizeof(h256) * 2 + _node.size(); }
+	void evict();
+
+	mutable Mutex x_cache;
+	std::unordered_map<h256, Entry> m_cache;
+	std::list<h256> m_lru;
+	size_t m_maxMemory = c_defaultMaxMemory;
+	size_t m_memoryUsage = 0;
+	uint64_t m_hits = 0;
+	uint64_t m_misses = 0;
+};
+
+}
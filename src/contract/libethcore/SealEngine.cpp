@@ -60,6 +60,8 @@ SealEngineFace* SealEngineRegistrar::create(ChainOperationParams const& _params)
 
 EVMSchedule const& SealEngineBase::evmSchedule(EnvInfo const& _envInfo) const
 {
+	if (EVMSchedule const* pinned = pinnedEVMSchedule())
+		return *pinned;
     
 	if (u256(0) == chainParams().u256Param("EIP158ForkBlock") && 
 		u256(0) == chainParams().u256Param("EIP150ForkBlock") &&
@@ -73,7 +73,7 @@ public:
 	virtual void cancelGeneration() {}
 
 	ChainOperationParams const& chainParams() const { return m_params; }
-	void setChainParams(ChainOperationParams const& _params) { m_params = _params; }
+	void setChainParams(ChainOperationParams const& _params) { m_params = _params; m_pinnedSchedule = nullptr; }
 	SealEngineFace* withChainParams(ChainOperationParams const& _params) { setChainParams(_params); return this; }
 	virtual EVMSchedule const& evmSchedule(EnvInfo const&) const = 0;
 
@@ -89,6 +89,10 @@ public:
 
 	EVMSchedule& getTesraSchedule() const { return tesraSchedule; }
 
+	/// Fixes the schedule returned by evmSchedule() for an engine that only ever serves one block.
+	void pinEVMSchedule(EVMSchedule const* _schedule) const { m_pinnedSchedule = _schedule; }
+	EVMSchedule const* pinnedEVMSchedule() const { return m_pinnedSchedule; }
+
 	
 	
 	
@@ -104,6 +108,7 @@ private:
 	std::unordered_map<std::string, bytes> m_options;
 
 	mutable EVMSchedule tesraSchedule; 
+	mutable EVMSchedule const* m_pinnedSchedule = nullptr;
 
 	ChainOperationParams m_params;
 };
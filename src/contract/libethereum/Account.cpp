@@ -30,9 +30,9 @@ using namespace dev::eth;
 
 void Account::setNewCode(bytes&& _code)
 {
-	m_codeCache = std::move(_code);
+	m_codeCache = std::make_shared<bytes const>(std::move(_code));
 	m_hasNewCode = true;
-	m_codeHash = sha3(m_codeCache);
+	m_codeHash = sha3(*m_codeCache);
 }
 
 namespace js = json_spirit;
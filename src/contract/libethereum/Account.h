@@ -26,6 +26,7 @@
 #include <libdevcore/TrieDB.h>
 #include <libdevcore/SHA3.h>
 #include <libethcore/Common.h>
+#include <libevm/CodeCache.h>
 
 namespace dev
 {
@@ -146,14 +147,15 @@ public:
 	void setNewCode(bytes&& _code);
 
 	
-	void resetCode() { m_codeCache.clear(); m_hasNewCode = false; m_codeHash = EmptySHA3; }
+	void resetCode() { m_codeCache.reset(); m_hasNewCode = false; m_codeHash = EmptySHA3; }
 
 	
 	
-	void noteCode(bytesConstRef _code) { assert(sha3(_code) == m_codeHash); m_codeCache = _code.toBytes(); }
+	void noteCode(SharedCode const& _code) { assert(sha3(*_code) == m_codeHash); m_codeCache = _code; }
 
 	
-	bytes const& code() const { return m_codeCache; }
+	bytes const& code() const { return m_codeCache ? *m_codeCache : NullBytes; }
+	SharedCode const& sharedCode() const { return m_codeCache ? m_codeCache : CodeCache::empty(); }
 
 private:
 	
@@ -191,7 +193,7 @@ private:
 
 	
 	
-	bytes m_codeCache;
+	SharedCode m_codeCache;
 
 	
 	static const h256 c_contractConceptionCodeHash;
@@ -43,8 +43,8 @@ class ExtVM: public ExtVMFace
 {
 public:
 	
-	ExtVM(State& _s, EnvInfo const& _envInfo, SealEngineFace const& _sealEngine, Address _myAddress, Address _caller, Address _origin, u256 _value, u256 _gasPrice, bytesConstRef _data, bytesConstRef _code, h256 const& _codeHash, unsigned _depth = 0):
-		ExtVMFace(_envInfo, _myAddress, _caller, _origin, _value, _gasPrice, _data, _code.toBytes(), _codeHash, _depth), m_s(_s), m_sealEngine(_sealEngine)
+	ExtVM(State& _s, EnvInfo const& _envInfo, SealEngineFace const& _sealEngine, Address _myAddress, Address _caller, Address _origin, u256 _value, u256 _gasPrice, bytesConstRef _data, SharedCode _code, h256 const& _codeHash, unsigned _depth = 0):
+		ExtVMFace(_envInfo, _myAddress, _caller, _origin, _value, _gasPrice, _data, std::move(_code), _codeHash, _depth), m_s(_s), m_sealEngine(_sealEngine)
 	{
 		
 		
@@ -88,6 +88,8 @@ public:
 	
 	virtual EVMSchedule const& evmSchedule() const override final { return m_sealEngine.evmSchedule(envInfo()); }
 
+	virtual EnvInfo const& blockInfo() override final { m_s.noteBlockInfo(); return envInfo(); }
+
 	State const& state() const { return m_s; }
 
 private:
@@ -33,7 +33,6 @@
 #include <libethcore/Exceptions.h>
 #include <libevm/VMFactory.h>
 #include "BlockChain.h"
-#include "CodeSizeCache.h"
 #include "Defaults.h"
 #include "ExtVM.h"
 #include "Executive.h"
@@ -67,8 +66,10 @@ State::State(State const& _s):
 	m_cache(_s.m_cache),
 	m_unchangedCacheEntries(_s.m_unchangedCacheEntries),
 	m_nonExistingAccountsCache(_s.m_nonExistingAccountsCache),
+	m_killedAccounts(_s.m_killedAccounts),
 	m_touched(_s.m_touched),
-	m_accountStartNonce(_s.m_accountStartNonce)
+	m_accountStartNonce(_s.m_accountStartNonce),
+	m_snapshot(_s.m_snapshot)
 {}
 
 OverlayDB State::openDB(std::string const& _basePath, h256 const& _genesisHash, WithExisting _we)
@@ -150,7 +151,9 @@ State& State::operator=(State const& _s)
 	m_cache = _s.m_cache;
 	m_unchangedCacheEntries = _s.m_unchangedCacheEntries;
 	m_nonExistingAccountsCache = _s.m_nonExistingAccountsCache;
+	m_killedAccounts = _s.m_killedAccounts;
 	m_touched = _s.m_touched;
+	m_snapshot = _s.m_snapshot;
 	m_accountStartNonce = _s.m_accountStartNonce;
 	return *this;
 }
@@ -162,15 +165,18 @@ Account const* State::account(Address const& _a) const
 
 Account* State::account(Address const& _addr)
 {
+	if (m_accessObserver)
+		m_accessObserver->onAccount(_addr);
+
 	auto it = m_cache.find(_addr);
 	if (it != m_cache.end())
 		return &it->second;
 
-	if (m_nonExistingAccountsCache.count(_addr))
+	if (m_nonExistingAccountsCache.count(_addr) || m_killedAccounts.count(_addr))
 		return nullptr;
 
 	
-	string stateBack = m_state.at(_addr);
+	string stateBack = snapshotValid() ? m_snapshot->account(sha3(_addr)) : m_state.at(_addr);
 	if (stateBack.empty())
 	{
 		m_nonExistingAccountsCache.insert(_addr);
@@ -211,12 +217,91 @@ void State::commit(CommitBehaviour _commitBehaviour)
 {
 	if (_commitBehaviour == CommitBehaviour::RemoveEmptyAccounts)
 		removeEmptyAccounts();
+	for (auto const& a: m_killedAccounts)
+		if (!m_cache.count(a))
+			m_cache[a].kill();
+	m_killedAccounts.clear();
 	m_touched += dev::eth::commit(m_cache, m_state);
 	m_changeLog.clear();
+	m_settledAccounts.clear();
 	m_cache.clear();
 	m_unchangedCacheEntries.clear();
 }
 
+void State::commitSnapshot(CommitBehaviour _commitBehaviour)
+{
+	if (!m_snapshot)
+	{
+		commit(_commitBehaviour);
+		return;
+	}
+
+	bool follows = snapshotValid();
+	vector<Address> changed;
+	if (follows)
+	{
+		if (_commitBehaviour == CommitBehaviour::RemoveEmptyAccounts)
+			removeEmptyAccounts();
+		for (auto const& a: m_killedAccounts)
+			if (!m_cache.count(a))
+			{
+				changed.push_back(a);
+				m_snapshot->clearStorage(sha3(a));
+			}
+		for (auto const& i: m_cache)
+			if (i.second.isDirty())
+			{
+				h256 addressHash = sha3(i.first);
+				changed.push_back(i.first);
+				if (i.second.baseRoot() == EmptyTrie)
+					m_snapshot->clearStorage(addressHash);
+				for (auto const& j: i.second.storageOverlay())
+					m_snapshot->putStorage(addressHash, sha3(h256(j.first)), j.second ? asString(rlp(j.second)) : string());
+			}
+	}
+
+	commit(_commitBehaviour);
+
+	if (follows)
+	{
+		for (Address const& a: changed)
+			m_snapshot->putAccount(sha3(a), m_state.at(a));
+		m_snapshot->setRoot(m_state.root());
+	}
+	else
+		m_snapshot->rebuild(m_db, m_state.root());
+}
+
+void State::settle()
+{
+	for (auto it = m_cache.begin(); it != m_cache.end();)
+		if (!it->second.isAlive())
+		{
+			bool killed = m_killedAccounts.insert(it->first).second;
+			if (m_keepChanges)
+			{
+				m_changeLog.emplace_back(Change::Settle, it->first, m_settledAccounts.size());
+				m_changeLog.back().key = killed ? 1 : 0;
+				m_settledAccounts.push_back(std::move(it->second));
+			}
+			it = m_cache.erase(it);
+		}
+		else
+			++it;
+	if (!m_keepChanges)
+		m_changeLog.clear();
+}
+
+void State::setKeepChanges(bool _keep)
+{
+	m_keepChanges = _keep;
+	if (!_keep)
+	{
+		m_changeLog.clear();
+		m_settledAccounts.clear();
+	}
+}
+
 unordered_map<Address, u256> State::addresses() const
 {
 #if ETH_FATDB
@@ -233,11 +318,33 @@ unordered_map<Address, u256> State::addresses() const
 #endif
 }
 
+vector<pair<Address, u256>> State::addresses(h256 const& _from, size_t _max, h256& o_next) const
+{
+	vector<pair<Address, u256>> ret;
+	o_next = h256();
+	GenericTrieDB<OverlayDB> state(const_cast<OverlayDB*>(&m_db), m_state.root(), Verification::Skip);
+	for (auto it = state.lower_bound(_from.ref()); it != state.end(); ++it)
+	{
+		auto entry = *it;
+		h256 hashed(entry.first, h256::AlignLeft);
+		if (ret.size() >= _max)
+		{
+			o_next = hashed;
+			break;
+		}
+		bytes address = m_db.lookupAux(hashed);
+		if (address.size() == Address::size)
+			ret.push_back(make_pair(Address(address), RLP(entry.second)[1].toInt<u256>()));
+	}
+	return ret;
+}
+
 void State::setRoot(h256 const& _r)
 {
 	m_cache.clear();
 	m_unchangedCacheEntries.clear();
 	m_nonExistingAccountsCache.clear();
+	m_killedAccounts.clear();
 
 	m_state.setRoot(_r);
 }
@@ -352,6 +459,9 @@ u256 State::getNonce(Address const& _addr) const
 
 u256 State::storage(Address const& _id, u256 const& _key) const
 {
+	if (m_accessObserver)
+		m_accessObserver->onStorage(_id, _key);
+
 	if (Account const* a = account(_id))
 	{
 		auto mit = a->storageOverlay().find(_key);
@@ -359,8 +469,14 @@ u256 State::storage(Address const& _id, u256 const& _key) const
 			return mit->second;
 
 		
-		SecureTrieDB<h256, OverlayDB> memdb(const_cast<OverlayDB*>(&m_db), a->baseRoot());			
-		string payload = memdb.at(_key);
+		string payload;
+		if (!snapshotValid())
+		{
+			SecureTrieDB<h256, OverlayDB> memdb(const_cast<OverlayDB*>(&m_db), a->baseRoot());			
+			payload = memdb.at(_key);
+		}
+		else if (a->baseRoot() != EmptyTrie)
+			payload = m_snapshot->storage(sha3(_id), sha3(h256(_key)));
 		u256 ret = payload.size() ? RLP(payload).toInt<u256>() : 0;
 		a->setStorageCache(_key, ret);
 		return ret;
@@ -420,21 +536,37 @@ h256 State::storageRoot(Address const& _id) const
 	return EmptyTrie;
 }
 
+bool State::hasUncommittedChanges(Address const& _address) const
+{
+	auto it = m_cache.find(_address);
+	if (it != m_cache.end())
+		return it->second.isDirty();
+	return m_killedAccounts.count(_address) != 0;
+}
+
 bytes const& State::code(Address const& _addr) const
+{
+	return *sharedCode(_addr);
+}
+
+SharedCode const& State::sharedCode(Address const& _addr) const
 {
 	Account const* a = account(_addr);
 	if (!a || a->codeHash() == EmptySHA3)
-		return NullBytes;
+		return CodeCache::empty();
 
 	if (a->code().empty())
 	{
 		
 		Account* mutableAccount = const_cast<Account*>(a);
-		mutableAccount->noteCode(m_db.lookup(a->codeHash()));
-		CodeSizeCache::instance().store(a->codeHash(), a->code().size());
+		CodeCache& codeCache = CodeCache::instance();
+		SharedCode code = codeCache.get(a->codeHash());
+		if (!code)
+			code = codeCache.store(a->codeHash(), std::make_shared<bytes const>(asBytes(m_db.lookup(a->codeHash()))));
+		mutableAccount->noteCode(code);
 	}
 
-	return a->code();
+	return a->sharedCode();
 }
 
 void State::setNewCode(Address const& _address, bytes&& _code)
@@ -455,18 +587,12 @@ size_t State::codeSize(Address const& _a) const
 {
 	if (Account const* a = account(_a))
 	{
-		if (a->hasNewCode())
+		if (a->hasNewCode() || a->codeHash() == EmptySHA3 || !a->code().empty())
 			return a->code().size();
-		auto& codeSizeCache = CodeSizeCache::instance();
-		h256 codeHash = a->codeHash();
-		if (codeSizeCache.contains(codeHash))
-			return codeSizeCache.get(codeHash);
-		else
-		{
-			size_t size = code(_a).size();
-			codeSizeCache.store(codeHash, size);
+		size_t size;
+		if (CodeCache::instance().size(a->codeHash(), size))
 			return size;
-		}
+		return code(_a).size();
 	}
 	else
 		return 0;
@@ -507,6 +633,12 @@ void State::rollback(size_t _savepoint)
 			account.untouch();
 			m_unchangedCacheEntries.emplace_back(change.address);
 			break;
+		case Change::Settle:
+			account = std::move(m_settledAccounts.back());
+			m_settledAccounts.pop_back();
+			if (change.key)
+				m_killedAccounts.erase(change.address);
+			break;
 		}
 		m_changeLog.pop_back();
 	}
@@ -532,6 +664,7 @@ std::pair<ExecutionResult, TransactionReceipt> State::execute(EnvInfo const& _en
 	if (!e.execute())
 		e.go(onOp);
 	e.finalize();
+	VMFactory::releaseFrames();
 
 	if (_p == Permanence::Reverted)
 		m_cache.clear();
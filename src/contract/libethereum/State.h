@@ -29,13 +29,14 @@
 #include <libdevcore/OverlayDB.h>
 #include <libethcore/Exceptions.h>
 #include <libethcore/BlockHeader.h>
-#include <libethereum/CodeSizeCache.h>
+#include <libevm/CodeCache.h>
 #include <libethereum/GenericMiner.h>
 #include <libevm/ExtVMFace.h>
 #include "Account.h"
 #include "Transaction.h"
 #include "TransactionReceipt.h"
 #include "GasPricer.h"
+#include "StateSnapshot.h"
 
 namespace dev
 {
@@ -123,7 +124,11 @@ struct Change
 		NewCode,
 
 		
-		Touch
+		Touch,
+
+		/// Account dropped from the cache by settle() while State::setKeepChanges() is on. value
+		/// indexes the saved account, key is 1 when settle() also marked it as killed.
+		Settle
 	};
 
 	Kind kind;        
@@ -144,6 +149,18 @@ struct Change
 
 }
 
+/// Told about every account and storage slot a State reads. Used to build the read sets of
+/// speculatively executed transactions; a State without an observer pays only a null check.
+class StateAccessObserver
+{
+public:
+	virtual ~StateAccessObserver() {}
+	virtual void onAccount(Address const& _address) = 0;
+	virtual void onStorage(Address const& _address, u256 const& _key) = 0;
+	/// A transaction read a block header field, its outcome may differ in another block.
+	virtual void onBlockInfo() {}
+};
+
 
 /**
  * Model of an Ethereum state, essentially a facade for the trie.
@@ -203,6 +220,11 @@ public:
 	
 	std::unordered_map<Address, u256> addresses() const;
 
+	/// Up to @a _max accounts of the committed account trie with their balance, in the order of
+	/// their hashed address and starting at @a _from. @a o_next is set to the hashed address
+	/// to continue from, or to h256() when the end of the trie was reached.
+	std::vector<std::pair<Address, u256>> addresses(h256 const& _from, size_t _max, h256& o_next) const;
+
 	
 	
 	std::pair<ExecutionResult, TransactionReceipt> execute(EnvInfo const& _envInfo, SealEngineFace const& _sealEngine, Transaction const& _t, Permanence _p = Permanence::Committed, OnOpFunc const& _onOp = OnOpFunc());
@@ -242,6 +264,10 @@ public:
 	
 	h256 storageRoot(Address const& _contract) const;
 
+	/// Whether @a _address has changes the trie does not hold yet, so storageRoot() and rootHash()
+	/// do not reflect them.
+	bool hasUncommittedChanges(Address const& _address) const;
+
 	
 	
 	u256 storage(Address const& _contract, u256 const& _memory) const;
@@ -269,6 +295,9 @@ public:
 	
 	bytes const& code(Address const& _addr) const;
 
+	/// Same as code() but shares the bytecode instead of referencing the account cache.
+	SharedCode const& sharedCode(Address const& _addr) const;
+
 	
 	
 	h256 codeHash(Address const& _contract) const;
@@ -303,6 +332,25 @@ public:
 	
 	size_t savepoint() const;
 
+	void setAccessObserver(StateAccessObserver* _observer) { m_accessObserver = _observer; }
+	void noteBlockInfo() const { if (m_accessObserver) m_accessObserver->onBlockInfo(); }
+
+	/// Ends a transaction without writing the trie: dirty accounts stay in the cache and accounts
+	/// killed by the transaction read as non-existent until the next commit() removes them.
+	void settle();
+
+	/// While on, settle() keeps the change log and saves the accounts it drops, so a savepoint
+	/// taken before a transaction can still be rolled back after it. commit() ends the log.
+	void setKeepChanges(bool _keep);
+
+	/// Serves account and storage reads from _snapshot whenever it is at the root of this state.
+	void setSnapshot(std::shared_ptr<StateSnapshot> const& _snapshot) { m_snapshot = _snapshot; }
+	std::shared_ptr<StateSnapshot> const& snapshot() const { return m_snapshot; }
+
+	/// commit() that also moves the snapshot to the new root, from the committed accounts when it
+	/// was at the old root and by a rebuild from the trie otherwise. Call StateSnapshot::flush() after.
+	void commitSnapshot(CommitBehaviour _commitBehaviour);
+
 	
 	void rollback(size_t _savepoint);
 
@@ -331,12 +379,22 @@ protected:
 	mutable std::unordered_map<Address, Account> m_cache;	
 	mutable std::vector<Address> m_unchangedCacheEntries;	
 	mutable std::set<Address> m_nonExistingAccountsCache;	
+	AddressHash m_killedAccounts;				///< Accounts killed since the last commit(), see settle().
 	AddressHash m_touched;						
 
 	u256 m_accountStartNonce;
 
 	friend std::ostream& operator<<(std::ostream& _out, State const& _s);
 	std::vector<detail::Change> m_changeLog;
+	std::vector<Account> m_settledAccounts;		///< Accounts dropped by settle(), see detail::Change::Settle.
+	bool m_keepChanges = false;
+
+	StateAccessObserver* m_accessObserver = nullptr;
+
+	std::shared_ptr<StateSnapshot> m_snapshot;
+
+private:
+	bool snapshotValid() const { return m_snapshot && m_snapshot->root() == m_state.root(); }
 };
 
 std::ostream& operator<<(std::ostream& _out, State const& _s);
@@ -376,7 +434,7 @@ AddressHash commit(AccountMap const& _cache, SecureTrieDB<Address, DB>& _state)
 				{
 					h256 ch = i.second.codeHash();
 					
-					CodeSizeCache::instance().store(ch, i.second.code().size());
+					CodeCache::instance().store(ch, i.second.sharedCode());
 					_state.db()->insert(ch, &i.second.code());
 					s << ch;
 				}
@@ -0,0 +1,360 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http:
+*/
+/** @file StateSnapshot.cpp
+ * @date 2018
+ */
+
+#include "StateSnapshot.h"
+#include <boost/filesystem.hpp>
+#include <libdevcore/Log.h>
+#include <libdevcore/RLP.h>
+#include <libdevcore/TrieDB.h>
+#include <libethcore/Exceptions.h>
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+char const c_accountPrefix = 'a';
+char const c_storagePrefix = 's';
+char const c_undoPrefix = 'u';
+char const c_rootKey[] = "r";
+char const c_undoRootsKey[] = "U";
+size_t const c_rebuildBatchSize = 10000;
+
+string accountKey(h256 const& _addressHash)
+{
+	string ret(1, c_accountPrefix);
+	ret.append((char const*)_addressHash.data(), h256::size);
+	return ret;
+}
+
+string storageKey(h256 const& _addressHash, h256 const* _keyHash = nullptr)
+{
+	string ret(1, c_storagePrefix);
+	ret.append((char const*)_addressHash.data(), h256::size);
+	if (_keyHash)
+		ret.append((char const*)_keyHash->data(), h256::size);
+	return ret;
+}
+
+string undoKey(h256 const& _root)
+{
+	string ret(1, c_undoPrefix);
+	ret.append((char const*)_root.data(), h256::size);
+	return ret;
+}
+
+void putOrDelete(ldb::WriteBatch& _batch, string const& _key, string const& _payload)
+{
+	if (_payload.empty())
+		_batch.Delete(ldb::Slice(_key));
+	else
+		_batch.Put(ldb::Slice(_key), ldb::Slice(_payload));
+}
+
+}
+
+StateSnapshot::StateSnapshot(ldb::DB* _db): m_db(_db)
+{
+	string root = get(c_rootKey);
+	if (root.size() == h256::size)
+		m_root = h256(root, h256::FromBinary);
+	m_flushedRoot = m_root;
+	string undo = get(c_undoRootsKey);
+	if (!undo.empty())
+		for (h256 const& r: RLP(undo).toVector<h256>())
+			m_undo.push_back(r);
+}
+
+shared_ptr<StateSnapshot> StateSnapshot::open(string const& _path)
+{
+	boost::filesystem::create_directories(_path);
+
+	ldb::Options o;
+	o.max_open_files = 256;
+	o.create_if_missing = true;
+	ldb::DB* db = nullptr;
+	ldb::Status status = ldb::DB::Open(o, _path, &db);
+	if (!status.ok() || !db)
+	{
+		cwarn << status.ToString();
+		BOOST_THROW_EXCEPTION(DatabaseAlreadyOpen());
+	}
+	return make_shared<StateSnapshot>(db);
+}
+
+string StateSnapshot::get(string const& _key) const
+{
+	string ret;
+	m_db->Get(ldb::ReadOptions(), ldb::Slice(_key), &ret);
+	return ret;
+}
+
+string StateSnapshot::account(h256 const& _addressHash) const
+{
+	ReadGuard l(x_this);
+	auto it = m_accounts.find(_addressHash);
+	if (it != m_accounts.end())
+		return it->second;
+	return get(accountKey(_addressHash));
+}
+
+string StateSnapshot::storage(h256 const& _addressHash, h256 const& _keyHash) const
+{
+	ReadGuard l(x_this);
+	auto it = m_storage.find(make_pair(_addressHash, _keyHash));
+	if (it != m_storage.end())
+		return it->second;
+	if (m_cleared.count(_addressHash))
+		return string();
+	return get(storageKey(_addressHash, &_keyHash));
+}
+
+void StateSnapshot::putAccount(h256 const& _addressHash, string const& _payload)
+{
+	WriteGuard l(x_this);
+	m_accounts[_addressHash] = _payload;
+}
+
+void StateSnapshot::putStorage(h256 const& _addressHash, h256 const& _keyHash, string const& _payload)
+{
+	WriteGuard l(x_this);
+	m_storage[make_pair(_addressHash, _keyHash)] = _payload;
+}
+
+void StateSnapshot::clearStorage(h256 const& _addressHash)
+{
+	WriteGuard l(x_this);
+	auto begin = m_storage.lower_bound(make_pair(_addressHash, h256()));
+	auto end = begin;
+	while (end != m_storage.end() && end->first.first == _addressHash)
+		++end;
+	m_storage.erase(begin, end);
+	m_cleared.insert(_addressHash);
+}
+
+void StateSnapshot::setRoot(h256 const& _root)
+{
+	WriteGuard l(x_this);
+	m_root = _root;
+}
+
+void StateSnapshot::write(ldb::WriteBatch& _batch)
+{
+	ldb::WriteOptions o;
+	o.sync = false;
+	ldb::Status status = m_db->Write(o, &_batch);
+	if (!status.ok())
+		cwarn << "Error writing state snapshot: " << status.ToString();
+	_batch.Clear();
+}
+
+void StateSnapshot::putUndoRoots(ldb::WriteBatch& _batch) const
+{
+	RLPStream s;
+	s.appendVector(vector<h256>(m_undo.begin(), m_undo.end()));
+	bytes const& out = s.out();
+	_batch.Put(ldb::Slice(c_undoRootsKey), ldb::Slice((char const*)out.data(), out.size()));
+}
+
+void StateSnapshot::flush()
+{
+	WriteGuard l(x_this);
+	ldb::WriteBatch batch;
+
+	// The undo record holds what the batch overwrites: every slot of a cleared account, then the
+	// previous payload of each other slot and account that changes
+	vector<pair<pair<h256, h256>, string>> undoStorage;
+	if (!m_cleared.empty())
+	{
+		unique_ptr<ldb::Iterator> it(m_db->NewIterator(ldb::ReadOptions()));
+		for (h256 const& a: m_cleared)
+		{
+			string prefix = storageKey(a);
+			for (it->Seek(ldb::Slice(prefix)); it->Valid() && it->key().starts_with(ldb::Slice(prefix)); it->Next())
+			{
+				h256 keyHash(bytesConstRef((byte const*)it->key().data() + prefix.size(), h256::size));
+				undoStorage.push_back(make_pair(make_pair(a, keyHash), it->value().ToString()));
+				batch.Delete(it->key());
+			}
+		}
+	}
+	for (auto const& i: m_storage)
+	{
+		string key = storageKey(i.first.first, &i.first.second);
+		if (!m_cleared.count(i.first.first))
+			undoStorage.push_back(make_pair(i.first, get(key)));
+		putOrDelete(batch, key, i.second);
+	}
+	RLPStream undoAccounts(m_accounts.size());
+	for (auto const& i: m_accounts)
+	{
+		string key = accountKey(i.first);
+		undoAccounts.appendList(2) << i.first << get(key);
+		putOrDelete(batch, key, i.second);
+	}
+
+	if (m_flushedRoot && m_flushedRoot != m_root)
+	{
+		RLPStream undo(4);
+		undo << m_flushedRoot;
+		undo.appendRaw(undoAccounts.out());
+		undo.appendList(undoStorage.size());
+		for (auto const& i: undoStorage)
+			undo.appendList(3) << i.first.first << i.first.second << i.second;
+		undo.appendVector(vector<h256>(m_cleared.begin(), m_cleared.end()));
+		bytes const& out = undo.out();
+		batch.Put(ldb::Slice(undoKey(m_root)), ldb::Slice((char const*)out.data(), out.size()));
+
+		m_undo.push_back(m_root);
+		while (m_undo.size() > c_undoDepth)
+		{
+			batch.Delete(ldb::Slice(undoKey(m_undo.front())));
+			m_undo.pop_front();
+		}
+		putUndoRoots(batch);
+	}
+	batch.Put(ldb::Slice(c_rootKey), ldb::Slice((char const*)m_root.data(), h256::size));
+	write(batch);
+
+	m_flushedRoot = m_root;
+	m_accounts.clear();
+	m_storage.clear();
+	m_cleared.clear();
+}
+
+void StateSnapshot::discard()
+{
+	WriteGuard l(x_this);
+	m_root = m_flushedRoot;
+	m_accounts.clear();
+	m_storage.clear();
+	m_cleared.clear();
+}
+
+bool StateSnapshot::revert(h256 const& _root)
+{
+	WriteGuard l(x_this);
+	m_root = m_flushedRoot;
+	m_accounts.clear();
+	m_storage.clear();
+	m_cleared.clear();
+
+	// Only touch the table when the records lead all the way to _root
+	vector<string> records;
+	h256 root = m_root;
+	for (auto it = m_undo.rbegin(); root != _root; ++it)
+	{
+		if (it == m_undo.rend() || *it != root)
+			return false;
+		records.push_back(get(undoKey(root)));
+		if (records.back().empty())
+			return false;
+		root = RLP(records.back())[0].toHash<h256>();
+	}
+
+	for (string const& record: records)
+	{
+		RLP undo(record);
+		ldb::WriteBatch batch;
+		// A new iterator for each record, one made earlier would not see the records applied since
+		unique_ptr<ldb::Iterator> it(m_db->NewIterator(ldb::ReadOptions()));
+		for (h256 const& a: undo[3].toVector<h256>())
+		{
+			string prefix = storageKey(a);
+			for (it->Seek(ldb::Slice(prefix)); it->Valid() && it->key().starts_with(ldb::Slice(prefix)); it->Next())
+				batch.Delete(it->key());
+		}
+		for (auto const& i: undo[2])
+		{
+			h256 keyHash = i[1].toHash<h256>();
+			putOrDelete(batch, storageKey(i[0].toHash<h256>(), &keyHash), i[2].toString());
+		}
+		for (auto const& i: undo[1])
+			putOrDelete(batch, accountKey(i[0].toHash<h256>()), i[1].toString());
+
+		batch.Delete(ldb::Slice(undoKey(m_root)));
+		m_undo.pop_back();
+		putUndoRoots(batch);
+		m_root = undo[0].toHash<h256>();
+		batch.Put(ldb::Slice(c_rootKey), ldb::Slice((char const*)m_root.data(), h256::size));
+		write(batch);
+	}
+	m_flushedRoot = m_root;
+	return true;
+}
+
+void StateSnapshot::rebuild(OverlayDB const& _db, h256 const& _root)
+{
+	WriteGuard l(x_this);
+	m_root = h256();
+	m_flushedRoot = h256();
+	m_undo.clear();
+	m_accounts.clear();
+	m_storage.clear();
+	m_cleared.clear();
+
+	ldb::WriteBatch batch;
+	{
+		unique_ptr<ldb::Iterator> it(m_db->NewIterator(ldb::ReadOptions()));
+		for (it->SeekToFirst(); it->Valid(); it->Next())
+			batch.Delete(it->key());
+	}
+	write(batch);
+
+	size_t accounts = 0;
+	size_t slots = 0;
+	size_t pending = 0;
+	OverlayDB* db = const_cast<OverlayDB*>(&_db);
+	GenericTrieDB<OverlayDB> state(db, _root, Verification::Skip);
+	for (auto it = state.begin(); it != state.end(); ++it)
+	{
+		auto entry = *it;
+		h256 addressHash(entry.first, h256::AlignLeft);
+		batch.Put(ldb::Slice(accountKey(addressHash)), ldb::Slice((char const*)entry.second.data(), entry.second.size()));
+		++accounts;
+		++pending;
+
+		h256 storageRoot = RLP(entry.second)[2].toHash<h256>();
+		if (storageRoot != EmptyTrie)
+		{
+			GenericTrieDB<OverlayDB> storage(db, storageRoot, Verification::Skip);
+			for (auto jt = storage.begin(); jt != storage.end(); ++jt)
+			{
+				auto slot = *jt;
+				h256 keyHash(slot.first, h256::AlignLeft);
+				batch.Put(ldb::Slice(storageKey(addressHash, &keyHash)), ldb::Slice((char const*)slot.second.data(), slot.second.size()));
+				++slots;
+				++pending;
+			}
+		}
+		if (pending >= c_rebuildBatchSize)
+		{
+			write(batch);
+			pending = 0;
+		}
+	}
+	m_root = _root;
+	m_flushedRoot = _root;
+	batch.Put(ldb::Slice(c_rootKey), ldb::Slice((char const*)m_root.data(), h256::size));
+	write(batch);
+
+	cnote << "Rebuilt state snapshot at" << _root << ":" << accounts << "accounts," << slots << "slots";
+}
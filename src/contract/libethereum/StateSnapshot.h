@@ -0,0 +1,99 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http:
+*/
+/** @file StateSnapshot.h
+ * @date 2018
+ */
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <libdevcore/db.h>
+#include <libdevcore/Guards.h>
+#include <libdevcore/OverlayDB.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief Flat copy of the account trie and of every storage trie at one state root.
+ * Entries are keyed by the hashed address and hashed slot the secure tries use and hold the
+ * same payload the trie would return, so a read is one lookup instead of a walk from the root.
+ * The tries stay the source of truth: a State only reads the snapshot while its root equals
+ * root(). Updates are staged in memory and written in one batch by flush(), or dropped by
+ * discard(). Each flush keeps the previous payloads of what it changed, so revert() can take
+ * the snapshot back over the last c_undoDepth flushes without a rebuild.
+ */
+class StateSnapshot
+{
+public:
+	explicit StateSnapshot(ldb::DB* _db);
+
+	static std::shared_ptr<StateSnapshot> open(std::string const& _path);
+
+	h256 root() const { ReadGuard l(x_this); return m_root; }
+
+	/// Trie payload of the account at sha3(address), empty when it does not exist.
+	std::string account(h256 const& _addressHash) const;
+	/// Trie payload of the slot at sha3(key) of the account at sha3(address), empty when unset.
+	std::string storage(h256 const& _addressHash, h256 const& _keyHash) const;
+
+	/// Stages a change; an empty payload removes the entry.
+	void putAccount(h256 const& _addressHash, std::string const& _payload);
+	void putStorage(h256 const& _addressHash, h256 const& _keyHash, std::string const& _payload);
+	/// Stages the removal of all slots of an account, slots put afterwards are kept.
+	void clearStorage(h256 const& _addressHash);
+	void setRoot(h256 const& _root);
+
+	/// Writes the staged changes, the new root and their undo record in one batch.
+	void flush();
+	/// Drops the staged changes and goes back to the root of the last flush.
+	void discard();
+	/// Undoes flushes until the snapshot is at _root. Does nothing and returns false when the kept
+	/// undo records do not lead there.
+	bool revert(h256 const& _root);
+
+	/// Replaces the whole content with the tries found under _root in _db.
+	void rebuild(OverlayDB const& _db, h256 const& _root);
+
+	static const size_t c_undoDepth = 100;
+
+private:
+	std::string get(std::string const& _key) const;
+	void write(ldb::WriteBatch& _batch);
+	void putUndoRoots(ldb::WriteBatch& _batch) const;
+
+	std::shared_ptr<ldb::DB> m_db;
+	h256 m_root;
+	h256 m_flushedRoot;
+	/// Roots that have an undo record, oldest first. The record of each one leads to the one before.
+	std::deque<h256> m_undo;
+
+	std::unordered_map<h256, std::string> m_accounts;
+	std::map<std::pair<h256, h256>, std::string> m_storage;
+	std::set<h256> m_cleared;
+
+	mutable SharedMutex x_this;
+};
+
+}
+}
@@ -0,0 +1,94 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http:
+*/
+/** @file CodeAnalysis.cpp
+ * @date 2018
+ */
+
+#include "CodeAnalysis.h"
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+size_t CodeAnalysis::memoryUsage() const
+{
+	return sizeof(CodeAnalysis) + codeSpace.capacity() + (jumpDests.capacity() + beginSubs.capacity()) * sizeof(uint64_t) +
+		program.capacity() * sizeof(ThreadedOp) + constants.capacity() * sizeof(Word256) + chains.capacity() +
+		entries.capacity() * sizeof(uint32_t);
+}
+
+CodeAnalysisPtr CodeAnalysisCache::get(h256 const& _codeHash, size_t _codeSize, bool _needProgram)
+{
+	Guard l(x_cache);
+	auto it = m_cache.find(_codeHash);
+	if (it == m_cache.end() || it->second.analysis->codeSize != _codeSize || (_needProgram && it->second.analysis->program.empty()))
+	{
+		++m_misses;
+		return CodeAnalysisPtr();
+	}
+	++m_hits;
+	m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+	return it->second.analysis;
+}
+
+void CodeAnalysisCache::store(h256 const& _codeHash, CodeAnalysisPtr const& _analysis)
+{
+	size_t memory = _analysis->memoryUsage();
+	Guard l(x_cache);
+	if (memory > m_maxMemory)
+		return;
+	auto it = m_cache.find(_codeHash);
+	if (it != m_cache.end())
+	{
+		if (!it->second.analysis->program.empty() || _analysis->program.empty())
+			return;
+		m_memoryUsage -= it->second.memory;
+		m_lru.erase(it->second.lru);
+		m_cache.erase(it);
+	}
+	m_lru.push_front(_codeHash);
+	m_cache[_codeHash] = Entry{_analysis, memory, m_lru.begin()};
+	m_memoryUsage += memory;
+	evict();
+}
+
+void CodeAnalysisCache::setMaxMemory(size_t _bytes)
+{
+	Guard l(x_cache);
+	m_maxMemory = _bytes;
+	evict();
+}
+
+void CodeAnalysisCache::clear()
+{
+	Guard l(x_cache);
+	m_cache.clear();
+	m_lru.clear();
+	m_memoryUsage = 0;
+	m_hits = 0;
+	m_misses = 0;
+}
+
+void CodeAnalysisCache::evict()
+{
+	while (m_memoryUsage > m_maxMemory && !m_lru.empty())
+	{
+		auto it = m_cache.find(m_lru.back());
+		m_memoryUsage -= it->second.memory;
+		m_cache.erase(it);
+		m_lru.pop_back();
+	}
+}
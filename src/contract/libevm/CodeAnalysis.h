@@ -0,0 +1,119 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http:
+*/
+/** @file CodeAnalysis.h
+ * @date 2018
+ */
+
+#pragma once
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <libdevcore/Common.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+#include "Word256.h"
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief One pre-decoded instruction of the threaded interpreter. Immediates are expanded
+ * into CodeAnalysis::constants and jump targets are resolved to program indices.
+ */
+struct ThreadedOp
+{
+	void const* label = nullptr;
+	uint64_t pc = 0;
+	uint32_t arg = 0;
+	uint32_t target = 0;
+	uint16_t handler = 0;
+	byte op = 0;
+	byte next = 0;
+};
+
+/**
+ * @brief Result of VM::optimize() for one piece of code: the padded and rewritten
+ * code, the sorted JUMPDEST table, the constant pool used by PUSHC and, for the
+ * threaded interpreter, the pre-decoded program.
+ * Immutable once published, so it can be shared by concurrently running VMs.
+ */
+struct CodeAnalysis
+{
+	bytes codeSpace;
+	size_t codeSize = 0;
+	std::vector<uint64_t> jumpDests;
+	std::vector<uint64_t> beginSubs;
+	Word256 pool[256];
+
+	std::vector<ThreadedOp> program;
+	std::vector<Word256> constants;
+	std::vector<byte> chains;
+	std::vector<uint32_t> entries;
+
+	size_t memoryUsage() const;
+};
+
+using CodeAnalysisPtr = std::shared_ptr<CodeAnalysis const>;
+
+/**
+ * @brief Thread-safe cache of code analysis results keyed by code hash.
+ * Entries are evicted least recently used first once the memory budget is exceeded.
+ */
+class CodeAnalysisCache
+{
+public:
+	CodeAnalysisPtr get(h256 const& _codeHash, size_t _codeSize, bool _needProgram = false);
+	void store(h256 const& _codeHash, CodeAnalysisPtr const& _analysis);
+
+	void setMaxMemory(size_t _bytes);
+	size_t maxMemory() const { Guard l(x_cache); return m_maxMemory; }
+	bool enabled() const { return maxMemory() > 0; }
+	void clear();
+
+	uint64_t hits() const { Guard l(x_cache); return m_hits; }
+	uint64_t misses() const { Guard l(x_cache); return m_misses; }
+	size_t size() const { Guard l(x_cache); return m_cache.size(); }
+	size_t memoryUsage() const { Guard l(x_cache); return m_memoryUsage; }
+
+	static CodeAnalysisCache& instance() { static CodeAnalysisCache cache; return cache; }
+
+	static const size_t c_defaultMaxMemory = 32 * 1024 * 1024;
+
+private:
+	struct Entry
+	{
+		CodeAnalysisPtr analysis;
+		size_t memory;
+		std::list<h256>::iterator lru;
+	};
+
+	void evict();
+
+	mutable Mutex x_cache;
+	std::unordered_map<h256, Entry> m_cache;
+	std::list<h256> m_lru;
+	size_t m_maxMemory = c_defaultMaxMemory;
+	size_t m_memoryUsage = 0;
+	uint64_t m_hits = 0;
+	uint64_t m_misses = 0;
+};
+
+}
+}
@@ -0,0 +1,160 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http:
+*/
+/** @file CodeCache.cpp
+ * @date 2018
+ */
+
+#include "CodeCache.h"
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+SharedCode const& CodeCache::empty()
+{
+	static SharedCode const s_empty = make_shared<bytes const>();
+	return s_empty;
+}
+
+CodeCache::Entry* CodeCache::find(Shard& _shard, h256 const& _codeHash)
+{
+	if (!m_maxMemory)
+		return nullptr;
+	auto it = _shard.cache.find(_codeHash);
+	if (it == _shard.cache.end())
+	{
+		++_shard.misses;
+		return nullptr;
+	}
+	++_shard.hits;
+	_shard.lru.splice(_shard.lru.begin(), _shard.lru, it->second.lru);
+	return &it->second;
+}
+
+SharedCode CodeCache::get(h256 const& _codeHash)
+{
+	Shard& s = shard(_codeHash);
+	Guard l(s.x_shard);
+	Entry* e = find(s, _codeHash);
+	return e ? e->code : SharedCode();
+}
+
+bool CodeCache::size(h256 const& _codeHash, size_t& _size)
+{
+	Shard& s = shard(_codeHash);
+	Guard l(s.x_shard);
+	Entry* e = find(s, _codeHash);
+	if (!e)
+		return false;
+	_size = e->code->size();
+	return true;
+}
+
+SharedCode CodeCache::store(h256 const& _codeHash, SharedCode const& _code)
+{
+	size_t maxMemory = m_maxMemory / c_shards;
+	size_t memory = memoryUsage(*_code);
+	Shard& s = shard(_codeHash);
+	Guard l(s.x_shard);
+	auto it = s.cache.find(_codeHash);
+	if (it != s.cache.end())
+		return it->second.code;
+	if (memory > maxMemory)
+		return _code;
+	s.lru.push_front(_codeHash);
+	s.cache[_codeHash] = Entry{_code, s.lru.begin()};
+	s.memoryUsage += memory;
+	evict(s, maxMemory);
+	return _code;
+}
+
+void CodeCache::setMaxMemory(size_t _bytes)
+{
+	m_maxMemory = _bytes;
+	for (Shard& s: m_shards)
+	{
+		Guard l(s.x_shard);
+		evict(s, _bytes / c_shards);
+	}
+}
+
+void CodeCache::clear()
+{
+	for (Shard& s: m_shards)
+	{
+		Guard l(s.x_shard);
+		s.cache.clear();
+		s.lru.clear();
+		s.memoryUsage = 0;
+		s.hits = 0;
+		s.misses = 0;
+	}
+}
+
+uint64_t CodeCache::hits() const
+{
+	uint64_t ret = 0;
+	for (Shard const& s: m_shards)
+	{
+		Guard l(s.x_shard);
+		ret += s.hits;
+	}
+	return ret;
+}
+
+uint64_t CodeCache::misses() const
+{
+	uint64_t ret = 0;
+	for (Shard const& s: m_shards)
+	{
+		Guard l(s.x_shard);
+		ret += s.misses;
+	}
+	return ret;
+}
+
+size_t CodeCache::size() const
+{
+	size_t ret = 0;
+	for (Shard const& s: m_shards)
+	{
+		Guard l(s.x_shard);
+		ret += s.cache.size();
+	}
+	return ret;
+}
+
+size_t CodeCache::memoryUsage() const
+{
+	size_t ret = 0;
+	for (Shard const& s: m_shards)
+	{
+		Guard l(s.x_shard);
+		ret += s.memoryUsage;
+	}
+	return ret;
+}
+
+void CodeCache::evict(Shard& _shard, size_t _maxMemory)
+{
+	while (_shard.memoryUsage > _maxMemory && !_shard.lru.empty())
+	{
+		auto it = _shard.cache.find(_shard.lru.back());
+		_shard.memoryUsage -= memoryUsage(*it->second.code);
+		_shard.cache.erase(it);
+		_shard.lru.pop_back();
+	}
+}
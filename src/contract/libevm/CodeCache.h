@@ -0,0 +1,100 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http:
+*/
+/** @file CodeCache.h
+ * @date 2018
+ */
+
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <libdevcore/Common.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/// Immutable contract bytecode, shared by the accounts, VMs and caches that use it.
+using SharedCode = std::shared_ptr<bytes const>;
+
+/**
+ * @brief Thread-safe cache of contract bytecode and code size keyed by code hash.
+ * Code is the preimage of its hash, so an entry never goes stale and one cache is shared by
+ * every State. The cache is split in shards by the first byte of the hash, each with its own
+ * lock, least recently used list and share of the memory budget, so concurrent executions of
+ * different contracts do not contend on one mutex.
+ */
+class CodeCache
+{
+public:
+	/// Returns the cached code or null.
+	SharedCode get(h256 const& _codeHash);
+	/// Sets _size and returns true when the code is cached.
+	bool size(h256 const& _codeHash, size_t& _size);
+	/// Inserts the code unless already cached and returns the cached copy.
+	SharedCode store(h256 const& _codeHash, SharedCode const& _code);
+
+	void setMaxMemory(size_t _bytes);
+	size_t maxMemory() const { return m_maxMemory; }
+	bool enabled() const { return maxMemory() > 0; }
+	void clear();
+
+	uint64_t hits() const;
+	uint64_t misses() const;
+	size_t size() const;
+	size_t memoryUsage() const;
+
+	static CodeCache& instance() { static CodeCache cache; return cache; }
+	/// Shared empty code, for accounts without code.
+	static SharedCode const& empty();
+
+	static const size_t c_defaultMaxMemory = 32 * 1024 * 1024;
+	static const unsigned c_shards = 16;
+
+private:
+	struct Entry
+	{
+		SharedCode code;
+		std::list<h256>::iterator lru;
+	};
+
+	struct Shard
+	{
+		mutable Mutex x_shard;
+		std::unordered_map<h256, Entry> cache;
+		std::list<h256> lru;
+		size_t memoryUsage = 0;
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+	};
+
+	static size_t memoryUsage(bytes const& _code) { return sizeof(Entry) + sizeof(h256) * 2 + _code.size(); }
+	Shard& shard(h256 const& _codeHash) { return m_shards[_codeHash[0] % c_shards]; }
+	Entry* find(Shard& _shard, h256 const& _codeHash);
+	void evict(Shard& _shard, size_t _maxMemory);
+
+	Shard m_shards[c_shards];
+	std::atomic<size_t> m_maxMemory{c_defaultMaxMemory};
+};
+
+}
+}
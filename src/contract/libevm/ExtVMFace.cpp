@@ -24,7 +24,7 @@
 using namespace dev;
 using namespace dev::eth;
 
-ExtVMFace::ExtVMFace(EnvInfo const& _envInfo, Address _myAddress, Address _caller, Address _origin, u256 _value, u256 _gasPrice, bytesConstRef _data, bytes _code, h256 const& _codeHash, unsigned _depth):
+ExtVMFace::ExtVMFace(EnvInfo const& _envInfo, Address _myAddress, Address _caller, Address _origin, u256 _value, u256 _gasPrice, bytesConstRef _data, SharedCode _code, h256 const& _codeHash, unsigned _depth):
 	m_envInfo(_envInfo),
 	myAddress(_myAddress),
 	caller(_caller),
@@ -32,7 +32,8 @@ ExtVMFace::ExtVMFace(EnvInfo const& _envInfo, Address _myAddress, Address _calle
 	value(_value),
 	gasPrice(_gasPrice),
 	data(_data),
-	code(std::move(_code)),
+	sharedCode(std::move(_code)),
+	code(*sharedCode),
 	codeHash(_codeHash),
 	depth(_depth)
 {}
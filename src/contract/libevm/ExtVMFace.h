@@ -32,6 +32,7 @@
 #include <libethcore/Common.h>
 #include <libethcore/BlockHeader.h>
 #include <libethcore/ChainOperationParams.h>
+#include "CodeCache.h"
 
 namespace dev
 {
@@ -269,7 +270,7 @@ public:
 	ExtVMFace() = default;
 
 	
-	ExtVMFace(EnvInfo const& _envInfo, Address _myAddress, Address _caller, Address _origin, u256 _value, u256 _gasPrice, bytesConstRef _data, bytes _code, h256 const& _codeHash, unsigned _depth);
+	ExtVMFace(EnvInfo const& _envInfo, Address _myAddress, Address _caller, Address _origin, u256 _value, u256 _gasPrice, bytesConstRef _data, SharedCode _code, h256 const& _codeHash, unsigned _depth);
 
 	virtual ~ExtVMFace() = default;
 
@@ -307,7 +308,10 @@ public:
 	virtual void log(h256s&& _topics, bytesConstRef _data) { sub.logs.push_back(LogEntry(myAddress, std::move(_topics), _data.toBytes())); }
 
 	
-	h256 blockHash(u256 _number) { return _number < envInfo().number() && _number >= (std::max<u256>(256, envInfo().number()) - 256) ? envInfo().lastHashes()[(unsigned)(envInfo().number() - 1 - _number)] : h256(); }
+	h256 blockHash(u256 _number) { EnvInfo const& env = blockInfo(); return _number < env.number() && _number >= (std::max<u256>(256, env.number()) - 256) ? env.lastHashes()[(unsigned)(env.number() - 1 - _number)] : h256(); }
+
+	/// The block header fields as read by the block information opcodes.
+	virtual EnvInfo const& blockInfo() { return m_envInfo; }
 
 	
 	EnvInfo const& envInfo() const { return m_envInfo; }
@@ -326,7 +330,8 @@ public:
 	u256 value;					
 	u256 gasPrice;				
 	bytesConstRef data;			
-	bytes code;					
+	SharedCode sharedCode;		
+	bytes const& code;					
 	h256 codeHash;				
 	SubState sub;				
 	unsigned depth = 0;			
@@ -28,19 +28,12 @@ using namespace dev;
 using namespace dev::eth;
 
 
-uint64_t VM::memNeed(u256 _offset, u256 _size)
+uint64_t VM::memNeed(Word256 const& _offset, Word256 const& _size)
 {
-	return toInt63(_size ? u512(_offset) + _size : u512(0));
-}
-
-template <class S> S divWorkaround(S const& _a, S const& _b)
-{
-	return (S)(s512(_a) / s512(_b));
-}
-
-template <class S> S modWorkaround(S const& _a, S const& _b)
-{
-	return (S)(s512(_a) % s512(_b));
+	if (_size.isZero())
+		return 0;
+	uint64_t offset = toInt63(_offset);
+	return toInt63(Word256(offset + toInt63(_size)));
 }
 
 
@@ -58,14 +51,14 @@ uint64_t VM::decodeJumpDest(const byte* const _code, uint64_t& _pc)
 	return dest;
 }
 
-uint64_t VM::decodeJumpvDest(const byte* const _code, uint64_t& _pc, u256*& _sp)
+uint64_t VM::decodeJumpvDest(const byte* const _code, uint64_t& _pc, Word256*& _sp)
 {
 	
 	
 	
 	
 	
-	uint64_t i = uint64_t(*_sp--);  
+	uint64_t i = (_sp--)->low64();  
 	uint64_t pc = _pc;
 	byte n = _code[++pc];           
 	if (i >= n) i = n - 1;          
@@ -83,33 +76,20 @@ uint64_t VM::decodeJumpvDest(const byte* const _code, uint64_t& _pc, u256*& _sp)
 
 void VM::onOperation()
 {
+	if (m_trace)
+		m_trace->step(m_traceExecution, m_PC, byte(m_OP), m_io_gas, 1 + m_SP - m_stack, m_mem.size());
 	if (m_onOp)
 		(m_onOp)(++m_nSteps, m_PC, m_OP,
 			m_newMemSize > m_mem.size() ? (m_newMemSize - m_mem.size()) / 32 : uint64_t(0),
 			m_runGas, m_io_gas, this, m_ext);
 }
 
-void VM::checkStack(unsigned _removed, unsigned _added)
-{
-	int const size = 1 + m_SP - m_stack;
-	int const usedSize = size - _removed;
-	if (usedSize < 0 || usedSize + _added > 1024)
-		throwBadStack(size, _removed, _added);
-}
-
 uint64_t VM::gasForMem(u512 _size)
 {
 	u512 s = _size / 32;
 	return toInt63((u512)m_schedule->memoryGas * s + s * s / m_schedule->quadCoeffDiv);
 }
 
-void VM::updateIOGas()
-{
-	if (m_io_gas < m_runGas)
-		throwOutOfGas();
-	m_io_gas -= m_runGas;
-}
-
 void VM::updateGas()
 {
 	if (m_newMemSize > m_mem.size())
@@ -124,13 +104,17 @@ void VM::updateMem()
 	m_newMemSize = (m_newMemSize + 31) / 32 * 32;
 	updateGas();
 	if (m_newMemSize > m_mem.size())
+	{
+		if (m_newMemSize > m_mem.capacity())
+			m_mem.reserve(std::max<uint64_t>(m_mem.capacity() * 2, (m_newMemSize + c_memPageSize - 1) / c_memPageSize * c_memPageSize));
 		m_mem.resize(m_newMemSize);
+	}
 }
 
 void VM::logGasMem()
 {
 	unsigned n = (unsigned)m_OP - (unsigned)Instruction::LOG0;
-	m_runGas = toInt63(m_schedule->logGas + m_schedule->logTopicGas * n + u512(m_schedule->logDataGas) * *(m_SP - 1));
+	m_runGas = toInt63(m_schedule->logGas + m_schedule->logTopicGas * n + u512(m_schedule->logDataGas) * w2u(*(m_SP - 1)));
 	m_newMemSize = memNeed(*m_SP, *(m_SP - 1));
 	updateMem();
 }
@@ -161,6 +145,39 @@ void VM::fetchInstruction()
 
 
 
+void VM::reset()
+{
+	io_gas = 0;
+	m_io_gas = 0;
+	m_ext = 0;
+	m_onOp = OnOpFunc();
+	m_trace = nullptr;
+	m_traceExecution = 0;
+	m_profile = nullptr;
+	m_caseInit = false;
+	m_bounce = 0;
+	m_onFail = 0;
+	m_interpret = 0;
+	m_nSteps = 0;
+	m_schedule = nullptr;
+	m_output = owning_bytes_ref();
+	if (m_mem.capacity() > c_maxPooledMemory)
+		bytes().swap(m_mem);
+	else
+		m_mem.clear();
+	m_analysis.reset();
+	m_code = nullptr;
+	m_PC = 0;
+	m_SP = m_stack - 1;
+#if EVM_JUMPS_AND_SUBS
+	m_RP = m_return - 1;
+	m_frameSize.clear();
+#endif
+	m_runGas = 0;
+	m_newMemSize = 0;
+	m_copyMemSize = 0;
+}
+
 owning_bytes_ref VM::exec(u256& _io_gas, ExtVMFace& _ext, OnOpFunc const& _onOp)
 {
 	io_gas = &_io_gas;
@@ -169,6 +186,17 @@ owning_bytes_ref VM::exec(u256& _io_gas, ExtVMFace& _ext, OnOpFunc const& _onOp)
 	m_schedule = &m_ext->evmSchedule();
 	m_onOp = _onOp;
 	m_onFail = &VM::onOperation;
+	m_trace = VMTracer::instance().enabled() ? &VMTracer::instance().local() : nullptr;
+	if (m_trace)
+		m_traceExecution = m_trace->enter(m_ext->myAddress, m_ext->depth, m_io_gas);
+	m_profile = VMProfiler::instance().enabled() ? VMProfiler::instance().local() : nullptr;
+	if (m_profile)
+		m_profileFrame.enter(*m_profile, m_ext->myAddress, m_io_gas);
+	// Only the switch interpreter reports each instruction
+	if (m_profile)
+		m_interpret = &VM::interpretCases<true>;
+	else
+		m_interpret = m_threaded && !_onOp && !m_trace ? &VM::interpretThreaded : &VM::interpretCases<false>;
 	
 	try
 	{
@@ -182,16 +210,29 @@ owning_bytes_ref VM::exec(u256& _io_gas, ExtVMFace& _ext, OnOpFunc const& _onOp)
 	catch (...)
 	{
 		*io_gas = m_io_gas;
+		if (m_trace)
+			m_trace->exit(m_traceExecution, m_io_gas, true);
+		if (m_profile)
+			m_profileFrame.exit(m_io_gas);
 		throw;
 	}
 
 	*io_gas = m_io_gas;
+	if (m_trace)
+		m_trace->exit(m_traceExecution, m_io_gas, false);
+	if (m_profile)
+		m_profileFrame.exit(m_io_gas);
 	return std::move(m_output);
 }
 
 
 
 
+// interpretCases<false> leaves the profiler out of every instruction
+#undef PROFILE_OP
+#define PROFILE_OP() (Profiled ? profileOperation() : void())
+
+template <bool Profiled>
 void VM::interpretCases()
 {
 	INIT_CASES
@@ -227,9 +268,9 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			size_t b = (size_t)*m_SP--;
-			size_t s = (size_t)*m_SP--;
-			m_output = owning_bytes_ref{std::move(m_mem), b, s};
+			size_t b = (m_SP--)->low64();
+			size_t s = (m_SP--)->low64();
+			m_output = s ? owning_bytes_ref{bytes(m_mem.begin() + b, m_mem.begin() + b + s), 0, s} : owning_bytes_ref();
 			m_bounce = 0;
 		}
 		BREAK
@@ -273,7 +314,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*m_SP = (u256)*(h256 const*)(m_mem.data() + (unsigned)*m_SP);
+			*m_SP = Word256::fromBigEndian(m_mem.data() + (unsigned)m_SP->low64());
 		}
 		NEXT
 
@@ -284,7 +325,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*(h256*)&m_mem[(unsigned)*m_SP] = (h256)*(m_SP - 1);
+			(m_SP - 1)->toBigEndian(&m_mem[(unsigned)m_SP->low64()]);
 			m_SP -= 2;
 		}
 		NEXT
@@ -296,22 +337,22 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			m_mem[(unsigned)*m_SP] = (byte)(*(m_SP - 1) & 0xff);
+			m_mem[(unsigned)m_SP->low64()] = (byte)(m_SP - 1)->low64();
 			m_SP -= 2;
 		}
 		NEXT
 
 		CASE(SHA3)
 		{
-			m_runGas = toInt63(m_schedule->sha3Gas + (u512(*(m_SP - 1)) + 31) / 32 * m_schedule->sha3WordGas);
+			m_runGas = toInt63(m_schedule->sha3Gas + (u512(w2u(*(m_SP - 1))) + 31) / 32 * m_schedule->sha3WordGas);
 			m_newMemSize = memNeed(*m_SP, *(m_SP - 1));
 			updateMem();
 			ON_OP();
 			updateIOGas();
 
-			uint64_t inOff = (uint64_t)*m_SP--;
-			uint64_t inSize = (uint64_t)*m_SP--;
-			*++m_SP = (u256)sha3(bytesConstRef(m_mem.data() + inOff, inSize));
+			uint64_t inOff = (m_SP--)->low64();
+			uint64_t inSize = (m_SP--)->low64();
+			*++m_SP = h2w(sha3(bytesConstRef(m_mem.data() + inOff, inSize)));
 		}
 		NEXT
 
@@ -322,9 +363,9 @@ void VM::interpretCases()
 
                         eExtendDataType  _type;
                         Address _owner = asAddress(*m_SP--);
-                        u256   _need = u256(*m_SP--);
-                        h256   _bytes = h256(*m_SP--);
-                        u256   _height = u256(*m_SP--);
+                        u256   _need = w2u(*m_SP--);
+                        h256   _bytes = w2h(*m_SP--);
+                        u256   _height = w2u(*m_SP--);
                         vector<uint8_t> _value;
                         bool ret;
                         u256 result = u256(0);
@@ -336,7 +377,7 @@ void VM::interpretCases()
                                 }
                         }
 
-                        *++m_SP = result << 8 * (32 - _value.size());
+                        *++m_SP = u2w(result << 8 * (32 - _value.size()));
                 }
                 NEXT
 
@@ -346,7 +387,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			m_ext->log({}, bytesConstRef(m_mem.data() + (uint64_t)*m_SP, (uint64_t)*(m_SP - 1)));
+			m_ext->log({}, bytesConstRef(m_mem.data() + m_SP->low64(), (m_SP - 1)->low64()));
 			m_SP -= 2;
 		}
 		NEXT
@@ -357,7 +398,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			m_ext->log({*(m_SP - 2)}, bytesConstRef(m_mem.data() + (uint64_t)*m_SP, (uint64_t)*(m_SP - 1)));
+			m_ext->log({w2h(*(m_SP - 2))}, bytesConstRef(m_mem.data() + m_SP->low64(), (m_SP - 1)->low64()));
 			m_SP -= 3;
 		}
 		NEXT
@@ -368,7 +409,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			m_ext->log({*(m_SP - 2), *(m_SP-3)}, bytesConstRef(m_mem.data() + (uint64_t)*m_SP, (uint64_t)*(m_SP - 1)));
+			m_ext->log({w2h(*(m_SP - 2)), w2h(*(m_SP-3))}, bytesConstRef(m_mem.data() + m_SP->low64(), (m_SP - 1)->low64()));
 			m_SP -= 4;
 		}
 		NEXT
@@ -379,7 +420,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			m_ext->log({*(m_SP - 2), *(m_SP-3), *(m_SP-4)}, bytesConstRef(m_mem.data() + (uint64_t)*m_SP, (uint64_t)*(m_SP - 1)));
+			m_ext->log({w2h(*(m_SP - 2)), w2h(*(m_SP-3)), w2h(*(m_SP-4))}, bytesConstRef(m_mem.data() + m_SP->low64(), (m_SP - 1)->low64()));
 			m_SP -= 5;
 		}
 		NEXT
@@ -390,20 +431,20 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			m_ext->log({*(m_SP - 2), *(m_SP-3), *(m_SP-4), *(m_SP-5)}, bytesConstRef(m_mem.data() + (uint64_t)*m_SP, (uint64_t)*(m_SP - 1)));
+			m_ext->log({w2h(*(m_SP - 2)), w2h(*(m_SP-3)), w2h(*(m_SP-4)), w2h(*(m_SP-5))}, bytesConstRef(m_mem.data() + m_SP->low64(), (m_SP - 1)->low64()));
 			m_SP -= 6;
 		}
 		NEXT	
 
 		CASE(EXP)
 		{
-			u256 expon = *(m_SP - 1);
-			m_runGas = toInt63(m_schedule->expGas + m_schedule->expByteGas * (32 - (h256(expon).firstBitSet() / 8)));
+			Word256 expon = *(m_SP - 1);
+			m_runGas = toInt63(m_schedule->expGas + m_schedule->expByteGas * expon.byteLength());
 			ON_OP();
 			updateIOGas();
 
-			u256 base = *m_SP--;
-			*m_SP = exp256(base, expon);
+			Word256 base = *m_SP--;
+			*m_SP = exp(base, expon);
 		}
 		NEXT
 
@@ -452,7 +493,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*(m_SP - 1) = *(m_SP - 1) ? divWorkaround(*m_SP, *(m_SP - 1)) : 0;
+			*(m_SP - 1) = div(*m_SP, *(m_SP - 1));
 			--m_SP;
 		}
 		NEXT
@@ -462,7 +503,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*(m_SP - 1) = *(m_SP - 1) ? s2u(divWorkaround(u2s(*m_SP), u2s(*(m_SP - 1)))) : 0;
+			*(m_SP - 1) = sdiv(*m_SP, *(m_SP - 1));
 			--m_SP;
 		}
 		NEXT
@@ -472,7 +513,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*(m_SP - 1) = *(m_SP - 1) ? modWorkaround(*m_SP, *(m_SP - 1)) : 0;
+			*(m_SP - 1) = mod(*m_SP, *(m_SP - 1));
 			--m_SP;
 		}
 		NEXT
@@ -482,7 +523,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*(m_SP - 1) = *(m_SP - 1) ? s2u(modWorkaround(u2s(*m_SP), u2s(*(m_SP - 1)))) : 0;
+			*(m_SP - 1) = smod(*m_SP, *(m_SP - 1));
 			--m_SP;
 		}
 		NEXT
@@ -521,7 +562,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*(m_SP - 1) = u2s(*m_SP) < u2s(*(m_SP - 1)) ? 1 : 0;
+			*(m_SP - 1) = slt(*m_SP, *(m_SP - 1)) ? 1 : 0;
 			--m_SP;
 		}
 		NEXT
@@ -531,7 +572,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*(m_SP - 1) = u2s(*m_SP) > u2s(*(m_SP - 1)) ? 1 : 0;
+			*(m_SP - 1) = sgt(*m_SP, *(m_SP - 1)) ? 1 : 0;
 			--m_SP;
 		}
 		NEXT
@@ -551,7 +592,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*m_SP = *m_SP ? 0 : 1;
+			*m_SP = m_SP->isZero() ? 1 : 0;
 		}
 		NEXT
 
@@ -590,7 +631,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*(m_SP - 1) = *m_SP < 32 ? (*(m_SP - 1) >> (unsigned)(8 * (31 - *m_SP))) & 0xff : 0;
+			*(m_SP - 1) = byteAt(*m_SP, *(m_SP - 1));
 			--m_SP;
 		}
 		NEXT
@@ -600,7 +641,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*(m_SP - 2) = *(m_SP - 2) ? u256((u512(*m_SP) + u512(*(m_SP - 1))) % *(m_SP - 2)) : 0;
+			*(m_SP - 2) = addmod(*m_SP, *(m_SP - 1), *(m_SP - 2));
 			m_SP -= 2;
 		}
 		NEXT
@@ -610,7 +651,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*(m_SP - 2) = *(m_SP - 2) ? u256((u512(*m_SP) * u512(*(m_SP - 1))) % *(m_SP - 2)) : 0;
+			*(m_SP - 2) = mulmod(*m_SP, *(m_SP - 1), *(m_SP - 2));
 			m_SP -= 2;
 		}
 		NEXT
@@ -620,16 +661,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			if (*m_SP < 31)
-			{
-				unsigned testBit = static_cast<unsigned>(*m_SP) * 8 + 7;
-				u256& number = *(m_SP - 1);
-				u256 mask = ((u256(1) << testBit) - 1);
-				if (boost::multiprecision::bit_test(number, testBit))
-					number |= ~mask;
-				else
-					number &= mask;
-			}
+			*(m_SP - 1) = signExtend(*m_SP, *(m_SP - 1));
 			--m_SP;
 		}
 		NEXT
@@ -639,7 +671,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*++m_SP = fromAddress(m_ext->myAddress);
+			*++m_SP = wordFromAddress(m_ext->myAddress);
 		}
 		NEXT
 
@@ -648,7 +680,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*++m_SP = fromAddress(m_ext->origin);
+			*++m_SP = wordFromAddress(m_ext->origin);
 		}
 		NEXT
 
@@ -658,7 +690,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*m_SP = m_ext->balance(asAddress(*m_SP));
+			*m_SP = u2w(m_ext->balance(asAddress(*m_SP)));
 		}
 		NEXT
 
@@ -668,7 +700,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*++m_SP = fromAddress(m_ext->caller);
+			*++m_SP = wordFromAddress(m_ext->caller);
 		}
 		NEXT
 
@@ -677,7 +709,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*++m_SP = m_ext->value;
+			*++m_SP = u2w(m_ext->value);
 		}
 		NEXT
 
@@ -687,16 +719,16 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			if (u512(*m_SP) + 31 < m_ext->data.size())
-				*m_SP = (u256)*(h256 const*)(m_ext->data.data() + (size_t)*m_SP);
-			else if (*m_SP >= m_ext->data.size())
-				*m_SP = u256(0);
+			if (*m_SP >= m_ext->data.size())
+				*m_SP = 0;
+			else if (m_SP->low64() + 32 <= m_ext->data.size())
+				*m_SP = Word256::fromBigEndian(m_ext->data.data() + m_SP->low64());
 			else
 			{
 				h256 r;
-				for (uint64_t i = (uint64_t)*m_SP, e = (uint64_t)*m_SP + (uint64_t)32, j = 0; i < e; ++i, ++j)
+				for (uint64_t i = m_SP->low64(), e = m_SP->low64() + (uint64_t)32, j = 0; i < e; ++i, ++j)
 					r[j] = i < m_ext->data.size() ? m_ext->data[i] : 0;
-				*m_SP = (u256)r;
+				*m_SP = h2w(r);
 			}
 		}
 		NEXT
@@ -775,7 +807,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*++m_SP = m_ext->gasPrice;
+			*++m_SP = u2w(m_ext->gasPrice);
 		}
 		NEXT
 
@@ -784,7 +816,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*m_SP = (u256)m_ext->blockHash(*m_SP);
+			*m_SP = h2w(m_ext->blockHash(w2u(*m_SP)));
 		}
 		NEXT
 
@@ -793,7 +825,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*++m_SP = (u160)m_ext->envInfo().author();
+			*++m_SP = wordFromAddress(m_ext->blockInfo().author());
 		}
 		NEXT
 
@@ -802,7 +834,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*++m_SP = m_ext->envInfo().timestamp();
+			*++m_SP = u2w(m_ext->blockInfo().timestamp());
 		}
 		NEXT
 
@@ -811,7 +843,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*++m_SP = m_ext->envInfo().number();
+			*++m_SP = u2w(m_ext->blockInfo().number());
 		}
 		NEXT
 
@@ -820,7 +852,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*++m_SP = m_ext->envInfo().difficulty();
+			*++m_SP = u2w(m_ext->blockInfo().difficulty());
 		}
 		NEXT
 
@@ -829,7 +861,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*++m_SP = m_ext->envInfo().gasLimit();
+			*++m_SP = m_ext->blockInfo().gasLimit();
 		}
 		NEXT
 
@@ -849,7 +881,7 @@ void VM::interpretCases()
 			updateIOGas();
 
 			++m_PC;
-			*++m_SP = m_pool[m_code[m_PC]];
+			*++m_SP = m_analysis->pool[m_code[m_PC]];
 			++m_PC;
 			m_PC += m_code[m_PC];
 #else
@@ -903,12 +935,8 @@ void VM::interpretCases()
 			updateIOGas();
 
 			int numBytes = (int)m_OP - (int)Instruction::PUSH1 + 1;
-			*++m_SP = 0;
-			
-			
-			
-			for (++m_PC; numBytes--; ++m_PC)
-				*m_SP = (*m_SP << 8) | m_code[m_PC];
+			*++m_SP = Word256::fromBigEndian(m_code + m_PC + 1, numBytes);
+			m_PC += numBytes + 1;
 		}
 		CONTINUE
 
@@ -926,7 +954,7 @@ void VM::interpretCases()
 		{
 			ON_OP();
 			updateIOGas();
-			if (*(m_SP - 1))
+			if (!(m_SP - 1)->isZero())
 				m_PC = verifyJumpDest(*m_SP);
 			else
 				++m_PC;
@@ -947,7 +975,7 @@ void VM::interpretCases()
 		{
 			ON_OP();
 			updateIOGas();
-			if (*m_SP)
+			if (!m_SP->isZero())
 				m_PC = decodeJumpDest(m_code, m_PC);
 			else
 				++m_PC;
@@ -1012,7 +1040,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			m_PC = uint64_t(*m_SP);
+			m_PC = m_SP->low64();
 			--m_SP;
 #else
 			throwBadInstruction();
@@ -1026,8 +1054,8 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			if (*(m_SP - 1))
-				m_PC = uint64_t(*m_SP);
+			if (!(m_SP - 1)->isZero())
+				m_PC = m_SP->low64();
 			else
 				++m_PC;
 			m_SP -= 2;
@@ -1089,7 +1117,7 @@ void VM::interpretCases()
 			updateIOGas();
 
 			unsigned n = (unsigned)m_OP - (unsigned)Instruction::SWAP1 + 2;
-			u256 d = *m_SP;
+			Word256 d = *m_SP;
 			*m_SP = m_stack[(1 + m_SP - m_stack) - n];
 			m_stack[(1 + m_SP - m_stack) - n] = d;
 		}
@@ -1102,15 +1130,16 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 
-			*m_SP = m_ext->store(*m_SP);
+			*m_SP = u2w(m_ext->store(w2u(*m_SP)));
 		}
 		NEXT
 
 		CASE(SSTORE)
 		{
-			if (!m_ext->store(*m_SP) && *(m_SP - 1))
+			u256 const key = w2u(*m_SP);
+			if (!m_ext->store(key) && !(m_SP - 1)->isZero())
 				m_runGas = toInt63(m_schedule->sstoreSetGas);
-			else if (m_ext->store(*m_SP) && !*(m_SP - 1))
+			else if (m_ext->store(key) && (m_SP - 1)->isZero())
 			{
 				m_runGas = toInt63(m_schedule->sstoreResetGas);
 				m_ext->sub.refunds += m_schedule->sstoreRefundGas;
@@ -1120,7 +1149,7 @@ void VM::interpretCases()
 			ON_OP();
 			updateIOGas();
 	
-			m_ext->setStore(*m_SP, *(m_SP - 1));
+			m_ext->setStore(key, w2u(*(m_SP - 1)));
 			m_SP -= 2;
 		}
 		NEXT
@@ -28,6 +28,10 @@
 #include <libdevcore/SHA3.h>
 #include <libethcore/BlockHeader.h>
 #include "VMFace.h"
+#include "CodeAnalysis.h"
+#include "VMProfile.h"
+#include "VMTrace.h"
+#include "Word256.h"
 
 namespace dev
 {
@@ -46,6 +50,16 @@ inline u256 fromAddress(Address _a)
 	return (u160)_a;
 }
 
+inline Address asAddress(Word256 const& _item)
+{
+	return right160(w2h(_item));
+}
+
+inline Word256 wordFromAddress(Address const& _a)
+{
+	return Word256::fromBigEndian(_a.data(), 20);
+}
+
 
 struct InstructionMetric
 {
@@ -60,16 +74,24 @@ struct InstructionMetric
 class VM: public VMFace
 {
 public:
+	VM() = default;
+	explicit VM(bool _threaded): m_threaded(_threaded) {}
+
 	virtual owning_bytes_ref exec(u256& io_gas, ExtVMFace& _ext, OnOpFunc const& _onOp) override final;
 
 #if EVM_JUMPS_AND_SUBS
 	
 	void validate(ExtVMFace& _ext);
-	void validateSubroutine(uint64_t _PC, uint64_t* _RP, u256* _SP);
+	void validateSubroutine(uint64_t _PC, uint64_t* _RP, Word256* _SP);
 #endif
 
 	bytes const& memory() const { return m_mem; }
-	u256s stack() const { assert(m_stack <= m_SP + 1); return u256s(m_stack, m_SP + 1); };
+	bool threaded() const { return m_threaded; }
+
+	/// Brings the VM back to its freshly constructed state so a frame pool can hand it to the next
+	/// call, keeping the memory buffer unless it grew past c_maxPooledMemory.
+	void reset();
+	u256s stack() const { assert(m_stack <= m_SP + 1); u256s ret; for (Word256 const* p = m_stack; p <= m_SP; ++p) ret.push_back(w2u(*p)); return ret; };
 
 private:
 
@@ -77,17 +99,29 @@ private:
 	uint64_t m_io_gas = 0;
 	ExtVMFace* m_ext = 0;
 	OnOpFunc m_onOp;
+	/// Buffer of the calling thread while -record-log-opcodes traces, null otherwise.
+	VMTraceBuffer* m_trace = nullptr;
+	uint32_t m_traceExecution = 0;
+	/// State of the calling thread while -vmprofile profiles the frame, null otherwise.
+	VMProfileThread* m_profile = nullptr;
+	VMProfileFrame m_profileFrame;
+
+	/// Memory grows by whole pages, a buffer larger than c_maxPooledMemory is freed on reset().
+	static const uint64_t c_memPageSize = 4096;
+	static const uint64_t c_maxPooledMemory = 1024 * 1024;
 
 	static std::array<InstructionMetric, 256> c_metrics;
 	static void initMetrics();
-	static u256 exp256(u256 _base, u256 _exponent);
-	void copyCode(int);
+	void copyCode(CodeAnalysis& _analysis, int);
 	const void* const* c_jumpTable = 0;
 	bool m_caseInit = false;
 	
 	typedef void (VM::*MemFnPtr)();
 	MemFnPtr m_bounce = 0;
 	MemFnPtr m_onFail = 0;
+	MemFnPtr m_interpret = 0;
+	bool m_threaded = false;
+	static void const* const* c_threadedLabels;
 	uint64_t m_nSteps = 0;
 	EVMSchedule const* m_schedule = nullptr;
 
@@ -98,12 +132,12 @@ private:
 	bytes m_mem;
 
 	
-	bytes m_codeSpace;
-	byte* m_code = nullptr;
+	CodeAnalysisPtr m_analysis;
+	byte const* m_code = nullptr;
 
 	
-	u256 m_stackSpace[1025];
-	u256* m_stack = m_stackSpace + 1;
+	Word256 m_stackSpace[1025];
+	Word256* m_stack = m_stackSpace + 1;
 	ptrdiff_t stackSize() { return m_SP - m_stack; }
 	
 #if EVM_JUMPS_AND_SUBS
@@ -116,12 +150,9 @@ private:
 #endif
 
 	
-	u256 m_pool[256];
-
-	
 	Instruction m_OP;                   
 	uint64_t    m_PC = 0;               
-	u256*       m_SP = m_stack - 1;     
+	Word256*    m_SP = m_stack - 1;     
 #if EVM_JUMPS_AND_SUBS
 	uint64_t*   m_RP = m_return - 1;    
 #endif
@@ -134,17 +165,20 @@ private:
 	
 	void initEntry();
 	void optimize();
+	void analyse(CodeAnalysis& _analysis);
 
 	
-	void interpretCases();
+	template <bool Profiled> void interpretCases();
+	void interpretThreaded();
+	void translate(CodeAnalysis& _analysis);
 
 	
 	void caseCreate();
 	bool caseCallSetup(CallParameters*, bytesRef& o_output);
 	void caseCall();
 
-	void copyDataToMemory(bytesConstRef _data, u256*& m_SP);
-	uint64_t memNeed(u256 _offset, u256 _size);
+	void copyDataToMemory(bytesConstRef _data, Word256*& m_SP);
+	uint64_t memNeed(Word256 const& _offset, Word256 const& _size);
 
 	void throwOutOfGas();
 	void throwBadInstruction();
@@ -153,23 +187,33 @@ private:
 
 	void reportStackUse();
 
-	std::vector<uint64_t> m_beginSubs;
-	std::vector<uint64_t> m_jumpDests;
-	int64_t verifyJumpDest(u256 const& _dest, bool _throw = true);
+	int64_t verifyJumpDest(Word256 const& _dest, bool _throw = true);
 
 	int poolConstant(const u256&);
 
 	void onOperation();
-	void checkStack(unsigned _n, unsigned _d);
+	void profileOperation() { m_profileFrame.operation(byte(m_OP)); }
+	void checkStack(unsigned _removed, unsigned _added)
+	{
+		int const size = 1 + m_SP - m_stack;
+		int const usedSize = size - _removed;
+		if (usedSize < 0 || usedSize + _added > 1024)
+			throwBadStack(size, _removed, _added);
+	}
 	uint64_t gasForMem(u512 _size);
-	void updateIOGas();
+	void updateIOGas()
+	{
+		if (m_io_gas < m_runGas)
+			throwOutOfGas();
+		m_io_gas -= m_runGas;
+	}
 	void updateGas();
 	void updateMem();
 	void logGasMem();
 	void fetchInstruction();
 	
 	uint64_t decodeJumpDest(const byte* const _code, uint64_t& _pc);
-	uint64_t decodeJumpvDest(const byte* const _code, uint64_t& _pc, u256*& _sp);
+	uint64_t decodeJumpvDest(const byte* const _code, uint64_t& _pc, Word256*& _sp);
 
 	template<class T> uint64_t toInt63(T v)
 	{
@@ -179,6 +223,12 @@ private:
 		uint64_t w = uint64_t(v);
 		return w;
 	}
+	uint64_t toInt63(Word256 const& v)
+	{
+		if (!v.fitsUint64() || v.low64() > 0x7FFFFFFFFFFFFFFF)
+			throwOutOfGas();
+		return v.low64();
+	}
 	};
 
 }
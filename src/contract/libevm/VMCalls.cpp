@@ -25,14 +25,14 @@ using namespace dev::eth;
 
 
 
-void VM::copyDataToMemory(bytesConstRef _data, u256*& _sp)
+void VM::copyDataToMemory(bytesConstRef _data, Word256*& _sp)
 {
-	auto offset = static_cast<size_t>(*_sp--);
-	s512 bigIndex = *_sp--;
-	auto index = static_cast<size_t>(bigIndex);
-	auto size = static_cast<size_t>(*_sp--);
+	auto offset = static_cast<size_t>((_sp--)->low64());
+	Word256 bigIndex = *_sp--;
+	auto index = static_cast<size_t>(bigIndex.low64());
+	auto size = static_cast<size_t>((_sp--)->low64());
 
-	size_t sizeToBeCopied = bigIndex + size > _data.size() ? _data.size() < bigIndex ? 0 : _data.size() - index : size;
+	size_t sizeToBeCopied = bigIndex >= _data.size() ? 0 : std::min(size, _data.size() - index);
 
 	if (sizeToBeCopied > 0)
 		std::memcpy(m_mem.data() + offset, _data.data() + index, sizeToBeCopied);
@@ -74,7 +74,7 @@ void VM::throwBadStack(unsigned _size, unsigned _removed, unsigned _added)
 	}
 }
 
-int64_t VM::verifyJumpDest(u256 const& _dest, bool _throw)
+int64_t VM::verifyJumpDest(Word256 const& _dest, bool _throw)
 {
 	
 	
@@ -82,8 +82,8 @@ int64_t VM::verifyJumpDest(u256 const& _dest, bool _throw)
 
 		
 		
-		uint64_t pc = uint64_t(_dest);
-		if (std::binary_search(m_jumpDests.begin(), m_jumpDests.end(), pc))
+		uint64_t pc = _dest.low64();
+		if (std::binary_search(m_analysis->jumpDests.begin(), m_analysis->jumpDests.end(), pc))
 			return pc;
 	}
 	if (_throw)
@@ -98,16 +98,16 @@ int64_t VM::verifyJumpDest(u256 const& _dest, bool _throw)
 
 void VM::caseCreate()
 {
-	m_bounce = &VM::interpretCases;
+	m_bounce = m_interpret;
 	m_newMemSize = memNeed(*(m_SP - 1), *(m_SP - 2));
 	m_runGas = toInt63(m_schedule->createGas);
 	updateMem();
 	ON_OP();
 	updateIOGas();
 
-	auto const& endowment = *m_SP--;
-	uint64_t initOff = (uint64_t)*m_SP--;
-	uint64_t initSize = (uint64_t)*m_SP--;
+	u256 const endowment = w2u(*m_SP--);
+	uint64_t initOff = (m_SP--)->low64();
+	uint64_t initSize = (m_SP--)->low64();
 
 	if (endowment) BOOST_THROW_EXCEPTION(CreateWithValue());
 
@@ -118,7 +118,7 @@ void VM::caseCreate()
 		if (!m_schedule->staticCallDepthLimit())
 			createGas -= createGas / 64;
 		u256 gas = createGas;
-		*++m_SP = (u160)m_ext->create(endowment, gas, bytesConstRef(m_mem.data() + initOff, initSize), m_onOp);
+		*++m_SP = wordFromAddress(m_ext->create(endowment, gas, bytesConstRef(m_mem.data() + initOff, initSize), m_onOp));
 		*io_gas -= (createGas - gas);
 		m_io_gas = uint64_t(*io_gas);
 	}
@@ -129,7 +129,7 @@ void VM::caseCreate()
 
 void VM::caseCall()
 {
-	m_bounce = &VM::interpretCases;
+	m_bounce = m_interpret;
 	unique_ptr<CallParameters> callParams(new CallParameters());
 	bytesRef output;
 	if (caseCallSetup(callParams.get(), output))
@@ -160,10 +160,10 @@ bool VM::caseCallSetup(CallParameters *callParams, bytesRef& o_output)
 		m_runGas += toInt63(m_schedule->callValueTransferGas);
 
 	size_t sizesOffset = m_OP == Instruction::DELEGATECALL ? 3 : 4;
-	u256 inputOffset = m_stack[(1 + m_SP - m_stack) - sizesOffset];
-	u256 inputSize = m_stack[(1 + m_SP - m_stack) - sizesOffset - 1];
-	u256 outputOffset = m_stack[(1 + m_SP - m_stack) - sizesOffset - 2];
-	u256 outputSize = m_stack[(1 + m_SP - m_stack) - sizesOffset - 3];
+	Word256 const& inputOffset = m_stack[(1 + m_SP - m_stack) - sizesOffset];
+	Word256 const& inputSize = m_stack[(1 + m_SP - m_stack) - sizesOffset - 1];
+	Word256 const& outputOffset = m_stack[(1 + m_SP - m_stack) - sizesOffset - 2];
+	Word256 const& outputSize = m_stack[(1 + m_SP - m_stack) - sizesOffset - 3];
 	uint64_t inputMemNeed = memNeed(inputOffset, inputSize);
 	uint64_t outputMemNeed = memNeed(outputOffset, outputSize);
 
@@ -174,12 +174,12 @@ bool VM::caseCallSetup(CallParameters *callParams, bytesRef& o_output)
 	
 	if (m_schedule->staticCallDepthLimit())
 		
-		callParams->gas = *m_SP;
+		callParams->gas = w2u(*m_SP);
 	else
 	{
 		
 		u256 maxAllowedCallGas = m_io_gas - m_io_gas / 64;
-		callParams->gas = std::min(*m_SP, maxAllowedCallGas);
+		callParams->gas = std::min(w2u(*m_SP), maxAllowedCallGas);
 	}
 
 	m_runGas = toInt63(callParams->gas);
@@ -200,14 +200,14 @@ bool VM::caseCallSetup(CallParameters *callParams, bytesRef& o_output)
 	}
 	else
 	{
-		callParams->apparentValue = callParams->valueTransfer = *m_SP;
+		callParams->apparentValue = callParams->valueTransfer = w2u(*m_SP);
 		--m_SP;
 	}
 
-	uint64_t inOff = (uint64_t)*m_SP--;
-	uint64_t inSize = (uint64_t)*m_SP--;
-	uint64_t outOff = (uint64_t)*m_SP--;
-	uint64_t outSize = (uint64_t)*m_SP--;
+	uint64_t inOff = (m_SP--)->low64();
+	uint64_t inSize = (m_SP--)->low64();
+	uint64_t outOff = (m_SP--)->low64();
+	uint64_t outSize = (m_SP--)->low64();
 
 	if (m_ext->balance(m_ext->myAddress) >= callParams->valueTransfer && m_ext->depth < 1024)
 	{
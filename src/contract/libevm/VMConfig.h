@@ -75,10 +75,10 @@ namespace eth
 	#undef ON_OP
 	#if EVM_TRACE > 1
 		#define ON_OP() \
-			(onOperation(), \
+			(PROFILE_OP(), onOperation(), \
 			(cerr <<"### "<< m_nSteps <<" @"<< m_PC <<" "<< instructionInfo(m_OP).name <<endl))
 	#else
-		#define ON_OP() onOperation()
+		#define ON_OP() do { PROFILE_OP(); onOperation(); } while (0)
 	#endif
 	
 	#define TRACE_STR(level, str) \
@@ -105,9 +105,12 @@ namespace eth
 	#define TRACE_OP(level, pc, op)
 	#define TRACE_PRE_OPT(level, pc, op)
 	#define TRACE_POST_OPT(level, pc, op)
-	#define ON_OP() onOperation()
+	#define ON_OP() do { PROFILE_OP(); onOperation(); } while (0)
 #endif
 
+// Outside of interpretCases<Profiled> the frame checks whether it profiles
+#define PROFILE_OP() (m_profile ? profileOperation() : void())
+
 
 #if 0
 	#define THROW_EXCEPTION(X) \
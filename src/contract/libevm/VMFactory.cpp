@@ -16,6 +16,7 @@
 */
 
 #include "VMFactory.h"
+#include <boost/thread/tss.hpp>
 #include <libdevcore/Assertions.h>
 #include "VM.h"
 
@@ -31,6 +32,54 @@ namespace eth
 namespace
 {
 	auto g_kind = VMKind::Interpreter;
+
+	/// Frames kept per interpreter kind once a transaction is done.
+	size_t const c_keptFrames = 16;
+
+	/// Interpreter frames released by finished calls on one thread, indexed by VM::threaded().
+	struct FramePool
+	{
+		std::vector<std::unique_ptr<VM>> frames[2];
+	};
+
+	boost::thread_specific_ptr<FramePool> t_framePool;
+
+	FramePool& framePool()
+	{
+		if (!t_framePool.get())
+			t_framePool.reset(new FramePool);
+		return *t_framePool;
+	}
+
+	VMPtr pooledVM(bool _threaded)
+	{
+		std::vector<std::unique_ptr<VM>>& frames = framePool().frames[_threaded];
+		if (frames.empty())
+			return VMPtr(new VM(_threaded), VMRelease(true));
+		VMPtr ret(frames.back().release(), VMRelease(true));
+		frames.pop_back();
+		return ret;
+	}
+}
+
+void VMRelease::operator()(VMFace* _vm) const
+{
+	if (!m_pooled)
+	{
+		delete _vm;
+		return;
+	}
+	std::unique_ptr<VM> vm(static_cast<VM*>(_vm));
+	vm->reset();
+	framePool().frames[vm->threaded()].push_back(std::move(vm));
+}
+
+void VMFactory::releaseFrames()
+{
+	FramePool& pool = framePool();
+	for (auto& frames: pool.frames)
+		if (frames.size() > c_keptFrames)
+			frames.resize(c_keptFrames);
 }
 
 void VMFactory::setKind(VMKind _kind)
@@ -38,27 +87,29 @@ void VMFactory::setKind(VMKind _kind)
 	g_kind = _kind;
 }
 
-std::unique_ptr<VMFace> VMFactory::create()
+VMPtr VMFactory::create()
 {
 	return create(g_kind);
 }
 
-std::unique_ptr<VMFace> VMFactory::create(VMKind _kind)
+VMPtr VMFactory::create(VMKind _kind)
 {
 #if ETH_EVMJIT
 	switch (_kind)
 	{
 	default:
 	case VMKind::Interpreter:
-		return std::unique_ptr<VMFace>(new VM);
+		return pooledVM(false);
+	case VMKind::Threaded:
+		return pooledVM(true);
 	case VMKind::JIT:
-		return std::unique_ptr<VMFace>(new JitVM);
+		return VMPtr(new JitVM);
 	case VMKind::Smart:
-		return std::unique_ptr<VMFace>(new SmartVM);
+		return VMPtr(new SmartVM);
 	}
 #else
-	asserts(_kind == VMKind::Interpreter && "JIT disabled in build configuration");
-	return std::unique_ptr<VMFace>(new VM);
+	asserts((_kind == VMKind::Interpreter || _kind == VMKind::Threaded) && "JIT disabled in build configuration");
+	return pooledVM(_kind == VMKind::Threaded);
 #endif
 }
 
@@ -27,19 +27,38 @@ enum class VMKind
 {
 	Interpreter,
 	JIT,
-	Smart
+	Smart,
+	Threaded
 };
 
+/// Deleter of the VMs made by VMFactory: interpreter frames go back to the pool of the
+/// thread that released them instead of being freed.
+class VMRelease
+{
+public:
+	explicit VMRelease(bool _pooled = false): m_pooled(_pooled) {}
+	void operator()(VMFace* _vm) const;
+
+private:
+	bool m_pooled;
+};
+
+using VMPtr = std::unique_ptr<VMFace, VMRelease>;
+
 class VMFactory
 {
 public:
 	VMFactory() = delete;
 
 	
-	static std::unique_ptr<VMFace> create();
+	static VMPtr create();
 
 	
-	static std::unique_ptr<VMFace> create(VMKind _kind);
+	static VMPtr create(VMKind _kind);
+
+	/// Trims the calling thread's pool of interpreter frames, called at the end of each transaction
+	/// so a deep call chain does not keep its frames and memory buffers alive afterwards.
+	static void releaseFrames();
 
 	
 	static void setKind(VMKind _kind);
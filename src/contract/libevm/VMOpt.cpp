@@ -49,30 +49,52 @@ void VM::initMetrics()
 	done = true;
 }
 
-void VM::copyCode(int _extraBytes)
+void VM::copyCode(CodeAnalysis& _analysis, int _extraBytes)
 {
 	
 	
 	
 	auto extendedSize = m_ext->code.size() + _extraBytes;
-	m_codeSpace.reserve(extendedSize);
-	m_codeSpace = m_ext->code;
-	m_codeSpace.resize(extendedSize);
-	m_code = m_codeSpace.data();
+	_analysis.codeSpace.reserve(extendedSize);
+	_analysis.codeSpace = m_ext->code;
+	_analysis.codeSpace.resize(extendedSize);
+	_analysis.codeSize = m_ext->code.size();
 }
 
 void VM::optimize()
 {
-	copyCode(33);
+	CodeAnalysisCache& cache = CodeAnalysisCache::instance();
+	bool threaded = m_interpret == &VM::interpretThreaded;
+	bool cacheable = cache.enabled() && m_ext->codeHash && !m_ext->code.empty();
+	if (cacheable)
+		m_analysis = cache.get(m_ext->codeHash, m_ext->code.size(), threaded);
 
-	size_t const nBytes = m_ext->code.size();
+	if (!m_analysis)
+	{
+		auto analysis = std::make_shared<CodeAnalysis>();
+		m_analysis = analysis;
+		analyse(*analysis);
+		if (threaded)
+			translate(*analysis);
+		if (cacheable)
+			cache.store(m_ext->codeHash, m_analysis);
+	}
+	m_code = m_analysis->codeSpace.data();
+}
+
+void VM::analyse(CodeAnalysis& _analysis)
+{
+	copyCode(_analysis, 33);
+
+	byte* code = _analysis.codeSpace.data();
+	size_t const nBytes = _analysis.codeSize;
 
 	
 	
 	TRACE_STR(1, "Build JUMPDEST table")
 	for (size_t pc = 0; pc < nBytes; ++pc)
 	{
-		Instruction op = Instruction(m_code[pc]);
+		Instruction op = Instruction(code[pc]);
 		TRACE_OP(2, pc, op);
 				
 		
@@ -83,12 +105,12 @@ void VM::optimize()
 		)
 		{
 			TRACE_OP(1, pc, op);
-			m_code[pc] = (byte)Instruction::BAD;
+			code[pc] = (byte)Instruction::BAD;
 		}
 
 		if (op == Instruction::JUMPDEST)
 		{
-			m_jumpDests.push_back(pc);
+			_analysis.jumpDests.push_back(pc);
 		}
 		else if (
 			(byte)Instruction::PUSH1 <= (byte)op &&
@@ -109,11 +131,11 @@ void VM::optimize()
 		else if (op == Instruction::JUMPV || op == Instruction::JUMPSUBV)
 		{
 			++pc;
-			pc += 4 * m_code[pc];  
+			pc += 4 * code[pc];  
 		}
 		else if (op == Instruction::BEGINSUB)
 		{
-			m_beginSubs.push_back(pc);
+			_analysis.beginSubs.push_back(pc);
 		}
 		else if (op == Instruction::BEGINDATA)
 		{
@@ -134,10 +156,10 @@ void VM::optimize()
 			const uint32_t FNV_PRIME2 = 16777619;
 			uint32_t hash = FNV_PRIME1;
 			
-			u256 (&table)[256];
+			Word256 (&table)[256];
 			bool empty[256];
 			
-			hash256(u256 (&table)[256]) : table(table)
+			hash256(Word256 (&table)[256]) : table(table)
 			{
 				for (int i = 0; i < 256; ++i)
 				{
@@ -155,7 +177,7 @@ void VM::optimize()
 			byte getHash() { return ((hash >> 8) ^ hash) & 0xff; }
 		
 			
-			bool insertVal(byte hash, u256& val)
+			bool insertVal(byte hash, Word256& val)
 			{
 				if (empty[hash])
 				{
@@ -165,7 +187,7 @@ void VM::optimize()
 				}
 				return table[hash] == val;
 			}
-		} constantPool(m_pool);
+		} constantPool(_analysis.pool);
 		#define CONST_POOL_HASH_INIT() constantPool.hashInit()
 		#define CONST_POOL_HASH_BYTE(b) constantPool.hashByte(b)
 		#define CONST_POOL_GET_HASH() constantPool.getHash()
@@ -180,8 +202,8 @@ void VM::optimize()
 	TRACE_STR(1, "Do first pass optimizations")
 	for (size_t pc = 0; pc < nBytes; ++pc)
 	{
-		u256 val = 0;
-		Instruction op = Instruction(m_code[pc]);
+		Word256 val = 0;
+		Instruction op = Instruction(code[pc]);
 
 		if ((byte)Instruction::PUSH1 <= (byte)op && (byte)op <= (byte)Instruction::PUSH32)
 		{
@@ -190,10 +212,10 @@ void VM::optimize()
 
 			
 			CONST_POOL_HASH_INIT();
-			val = m_code[pc+1];
+			val = code[pc+1];
 			for (uint64_t i = pc+2, n = nPush; --n; ++i) {
-				val = (val << 8) | m_code[i];
-				CONST_POOL_HASH_BYTE(m_code[i]);
+				val = (val << 8) | code[i];
+				CONST_POOL_HASH_BYTE(code[i]);
 			}
 
 		#ifdef EVM_USE_CONSTANT_POOL
@@ -205,10 +227,10 @@ void VM::optimize()
 				byte hash = CONST_POOL_GET_HASH();
 				if (CONST_POOL_INSERT_VAL(hash, val))
 				{
-					m_code[pc] = (byte)Instruction::PUSHC;
-					m_code[pc+1] = hash;
-					m_code[pc+2] = nPush - 1;
-					TRACE_VAL(1, "constant pooled", val);
+					code[pc] = (byte)Instruction::PUSHC;
+					code[pc+1] = hash;
+					code[pc+2] = nPush - 1;
+					TRACE_VAL(1, "constant pooled", w2u(val));
 				}
 				TRACE_POST_OPT(1, pc, op);
 			}
@@ -220,14 +242,14 @@ void VM::optimize()
 			
 			
 			size_t i = pc + nPush + 1;
-			op = Instruction(m_code[i]);
+			op = Instruction(code[i]);
 			if (op == Instruction::JUMP)
 			{
 				TRACE_STR(1, "Replace const JUMPC")
 				TRACE_PRE_OPT(1, i, op);
 				
 				if (0 <= verifyJumpDest(val, false))
-					m_code[i] = byte(op = Instruction::JUMPC);
+					code[i] = byte(op = Instruction::JUMPC);
 				
 				TRACE_POST_OPT(1, i, op);
 			}
@@ -237,7 +259,7 @@ void VM::optimize()
 				TRACE_PRE_OPT(1, i, op);
 				
 				if (0 <= verifyJumpDest(val, false))
-					m_code[i] = byte(op = Instruction::JUMPCI);
+					code[i] = byte(op = Instruction::JUMPCI);
 				
 				TRACE_POST_OPT(1, ii, op);
 			}
@@ -257,29 +279,8 @@ void VM::optimize()
 
 void VM::initEntry()
 {
-	m_bounce = &VM::interpretCases; 	
-	interpretCases(); 
+	m_bounce = m_interpret; 	
+	(this->*m_interpret)(); 
 	initMetrics();
 	optimize();
 }
-
-
-
-
-
-
-
-
-u256 VM::exp256(u256 _base, u256 _exponent)
-{
-	using boost::multiprecision::limb_type;
-	u256 result = 1;
-	while (_exponent)
-	{
-		if (static_cast<limb_type>(_exponent) & 1)	
-			result *= _base;
-		_base *= _base;
-		_exponent >>= 1;
-	}
-	return result;
-}
@@ -0,0 +1,172 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http:
+*/
+/** @file VMProfile.cpp
+ * @date 2018
+ */
+
+#include "VMProfile.h"
+#include <boost/thread/tss.hpp>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+	boost::thread_specific_ptr<VMProfileThread> t_thread;
+	boost::thread_specific_ptr<VMProfile*> t_scope;
+}
+
+void VMProfileData::add(VMProfileData const& _other)
+{
+	for (size_t i = 0; i < opcodes.size(); ++i)
+	{
+		opcodes[i].count += _other.opcodes[i].count;
+		opcodes[i].cycles += _other.opcodes[i].cycles;
+	}
+	for (auto const& i: _other.contracts)
+	{
+		VMContractStats& stats = contracts[i.first];
+		stats.calls += i.second.calls;
+		stats.gas += i.second.gas;
+		stats.nanos += i.second.nanos;
+		stats.sloads += i.second.sloads;
+		stats.sstores += i.second.sstores;
+	}
+}
+
+void VMProfileData::clear()
+{
+	opcodes.fill(VMOpcodeStats());
+	contracts.clear();
+}
+
+VMProfileScope::VMProfileScope(VMProfile* _profile)
+{
+	if (!t_scope.get())
+		t_scope.reset(new VMProfile*(nullptr));
+	m_previous = *t_scope;
+	*t_scope = _profile;
+}
+
+VMProfileScope::~VMProfileScope()
+{
+	*t_scope = m_previous;
+}
+
+VMProfile* VMProfileScope::current()
+{
+	return t_scope.get() ? *t_scope : nullptr;
+}
+
+void VMProfileFrame::enter(VMProfileThread& _thread, h160 const& _address, uint64_t _gas)
+{
+	m_thread = &_thread;
+	m_thread->depth++;
+	m_address = _address;
+	m_gas = _gas;
+	m_nestedCycles = m_thread->nestedCycles;
+	m_nestedNanos = m_thread->nestedNanos;
+	m_nestedGas = m_thread->nestedGas;
+	m_sloads = 0;
+	m_sstores = 0;
+	m_running = false;
+	m_startNanos = nanos();
+	m_startCycles = cycles();
+}
+
+void VMProfileFrame::exit(uint64_t _gas)
+{
+	uint64_t now = cycles();
+	endOperation(now);
+	uint64_t elapsed = nanos() - m_startNanos;
+	uint64_t used = m_gas > _gas ? m_gas - _gas : 0;
+
+	VMContractStats& stats = m_thread->data.contracts[m_address];
+	uint64_t nestedNanos = m_thread->nestedNanos - m_nestedNanos;
+	uint64_t nestedGas = m_thread->nestedGas - m_nestedGas;
+	stats.calls++;
+	stats.nanos += elapsed > nestedNanos ? elapsed - nestedNanos : 0;
+	stats.gas += used > nestedGas ? used - nestedGas : 0;
+	stats.sloads += m_sloads;
+	stats.sstores += m_sstores;
+
+	// The caller sees this frame as a whole, the frames it called are part of it
+	m_thread->nestedCycles = m_nestedCycles + (now - m_startCycles);
+	m_thread->nestedNanos = m_nestedNanos + elapsed;
+	m_thread->nestedGas = m_nestedGas + used;
+
+	if (--m_thread->depth == 0)
+	{
+		if (VMProfile* profile = VMProfileScope::current())
+			profile->add(m_thread->data);
+		m_thread->data.clear();
+		m_thread->nestedCycles = 0;
+		m_thread->nestedNanos = 0;
+		m_thread->nestedGas = 0;
+	}
+	m_thread = nullptr;
+	m_running = false;
+}
+
+VMProfileThread* VMProfiler::local() const
+{
+	if (!enabled() || !VMProfileScope::current())
+		return nullptr;
+	if (!t_thread.get())
+		t_thread.reset(new VMProfileThread());
+	return t_thread.get();
+}
+
+void VMProfiler::addBlock(unsigned _height, h256 const& _hash, VMProfileData const& _data)
+{
+	VMBlockProfile block;
+	block.height = _height;
+	block.hash = _hash;
+	block.data = _data;
+
+	Guard l(x_blocks);
+	m_total.add(_data);
+	m_totalBlocks++;
+	m_blocks.push_back(std::move(block));
+	while (m_blocks.size() > c_maxBlocks)
+		m_blocks.pop_front();
+}
+
+VMProfileData VMProfiler::total(uint64_t& o_blocks) const
+{
+	Guard l(x_blocks);
+	o_blocks = m_totalBlocks;
+	return m_total;
+}
+
+vector<VMBlockProfile> VMProfiler::recent(size_t _count) const
+{
+	Guard l(x_blocks);
+	vector<VMBlockProfile> ret;
+	for (auto it = m_blocks.rbegin(); it != m_blocks.rend() && ret.size() < _count; ++it)
+		ret.push_back(*it);
+	return ret;
+}
+
+void VMProfiler::reset()
+{
+	Guard l(x_blocks);
+	m_blocks.clear();
+	m_total.clear();
+	m_totalBlocks = 0;
+}
@@ -0,0 +1,222 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http:
+*/
+/** @file VMProfile.h
+ * @date 2018
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <libdevcore/Common.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+#include <libevmcore/Instruction.h>
+
+namespace dev
+{
+namespace eth
+{
+
+struct VMOpcodeStats
+{
+	uint64_t count = 0;
+	/// Time spent in the instruction, nested frames excluded.
+	uint64_t cycles = 0;
+};
+
+/// Totals of the frames that ran the code of one address, nested frames excluded.
+struct VMContractStats
+{
+	uint64_t calls = 0;
+	uint64_t gas = 0;
+	uint64_t nanos = 0;
+	uint64_t sloads = 0;
+	uint64_t sstores = 0;
+};
+
+struct VMProfileData
+{
+	std::array<VMOpcodeStats, 256> opcodes;
+	std::unordered_map<h160, VMContractStats> contracts;
+
+	void add(VMProfileData const& _other);
+	void clear();
+	bool empty() const { return contracts.empty(); }
+};
+
+/// Profile of one connected block.
+struct VMBlockProfile
+{
+	unsigned height = 0;
+	h256 hash;
+	VMProfileData data;
+};
+
+/// What the frames of one thread collected since its outermost frame started.
+struct VMProfileThread
+{
+	VMProfileData data;
+	unsigned depth = 0;
+	/// Inclusive totals of the frames that returned to the running one, taken out of its own.
+	uint64_t nestedCycles = 0;
+	uint64_t nestedNanos = 0;
+	uint64_t nestedGas = 0;
+};
+
+/// Collects the frames executed while a VMProfileScope with it is open, on any thread.
+class VMProfile
+{
+public:
+	void add(VMProfileData const& _data) { Guard l(x_data); m_data.add(_data); }
+	VMProfileData data() const { Guard l(x_data); return m_data; }
+
+private:
+	mutable Mutex x_data;
+	VMProfileData m_data;
+};
+
+/// Sends what the VM frames of the calling thread collect to a VMProfile until it is destroyed.
+class VMProfileScope
+{
+public:
+	explicit VMProfileScope(VMProfile* _profile);
+	~VMProfileScope();
+
+	/// The profile of the innermost scope open on the calling thread, null when there is none.
+	static VMProfile* current();
+
+private:
+	VMProfileScope(VMProfileScope const&) = delete;
+	VMProfileScope& operator=(VMProfileScope const&) = delete;
+
+	VMProfile* m_previous;
+};
+
+/**
+ * @brief Profiling state of one VM frame.
+ * Each instruction is timed from its ON_OP() to the next one, minus the time spent in the frames it
+ * called. The time and gas of the frame are added to the totals of its address when it exits.
+ */
+class VMProfileFrame
+{
+public:
+	void enter(VMProfileThread& _thread, h160 const& _address, uint64_t _gas);
+
+	/// Ends the instruction that ran so far and starts timing _op.
+	void operation(byte _op)
+	{
+		uint64_t now = cycles();
+		endOperation(now);
+		m_thread->data.opcodes[_op].count++;
+		if (_op == byte(Instruction::SLOAD))
+			m_sloads++;
+		else if (_op == byte(Instruction::SSTORE))
+			m_sstores++;
+		m_op = _op;
+		m_running = true;
+		m_opStart = now;
+		m_opNested = m_thread->nestedCycles;
+	}
+
+	/// Adds the frame to the totals of its address. The outermost frame of a thread hands what the
+	/// thread collected to the current VMProfileScope.
+	void exit(uint64_t _gas);
+
+	/// Time stamp counter where the CPU has one, nanoseconds otherwise.
+	static uint64_t cycles()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return nanos();
+#endif
+	}
+
+	static uint64_t nanos()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+private:
+	void endOperation(uint64_t _now)
+	{
+		if (m_running)
+			m_thread->data.opcodes[m_op].cycles += _now - m_opStart - (m_thread->nestedCycles - m_opNested);
+	}
+
+	VMProfileThread* m_thread = nullptr;
+	h160 m_address;
+	uint64_t m_gas = 0;
+	uint64_t m_startCycles = 0;
+	uint64_t m_startNanos = 0;
+	uint64_t m_nestedCycles = 0;
+	uint64_t m_nestedNanos = 0;
+	uint64_t m_nestedGas = 0;
+	uint64_t m_sloads = 0;
+	uint64_t m_sstores = 0;
+	uint64_t m_opStart = 0;
+	uint64_t m_opNested = 0;
+	byte m_op = 0;
+	bool m_running = false;
+};
+
+/**
+ * @brief Opt-in opcode and contract profiler of the interpreter, aggregated per connected block.
+ * Frames only profile while enabled and a VMProfileScope is open on their thread, they run the
+ * interpretCases<true> variant then. The variant for unprofiled frames has no profiling code.
+ */
+class VMProfiler
+{
+public:
+	bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+	void setEnabled(bool _enabled) { m_enabled = _enabled; }
+
+	/// The state of the calling thread when its frames profile, null otherwise.
+	VMProfileThread* local() const;
+
+	void addBlock(unsigned _height, h256 const& _hash, VMProfileData const& _data);
+
+	/// Totals since the last reset and the number of blocks they cover.
+	VMProfileData total(uint64_t& o_blocks) const;
+	/// The last _count blocks, latest first.
+	std::vector<VMBlockProfile> recent(size_t _count) const;
+
+	void reset();
+
+	static VMProfiler& instance() { static VMProfiler profiler; return profiler; }
+
+	static const size_t c_maxBlocks = 100;
+
+private:
+	std::atomic<bool> m_enabled{false};
+
+	mutable Mutex x_blocks;
+	std::deque<VMBlockProfile> m_blocks;
+	VMProfileData m_total;
+	uint64_t m_totalBlocks = 0;
+};
+
+}
+}
@@ -0,0 +1,1011 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http:
+*/
+/** @file VMThreaded.cpp
+ * Threaded-code interpreter. The code image produced by optimize() is translated once
+ * into a program of ThreadedOp which is then run with direct handler dispatch.
+ * Gas and stack accounting follow interpretCases() instruction by instruction.
+ * @date 2018
+ */
+
+#include <libethereum/ExtVM.h>
+#include <tesrastate.h>
+#include "VMConfig.h"
+#include "VM.h"
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+#define THREADED_HANDLERS(X) \
+	X(STOP) X(ADD) X(MUL) X(SUB) X(DIV) X(SDIV) X(MOD) X(SMOD) X(ADDMOD) X(MULMOD) X(EXP) X(SIGNEXTEND) \
+	X(LT) X(GT) X(SLT) X(SGT) X(EQ) X(ISZERO) X(AND) X(OR) X(XOR) X(NOT) X(BYTE) \
+	X(SHA3) X(TESRAINFO) \
+	X(ADDRESS) X(BALANCE) X(ORIGIN) X(CALLER) X(CALLVALUE) X(CALLDATALOAD) X(CALLDATASIZE) X(CALLDATACOPY) \
+	X(CODESIZE) X(CODECOPY) X(GASPRICE) X(EXTCODESIZE) X(EXTCODECOPY) \
+	X(BLOCKHASH) X(COINBASE) X(TIMESTAMP) X(NUMBER) X(DIFFICULTY) X(GASLIMIT) \
+	X(POP) X(MLOAD) X(MSTORE) X(MSTORE8) X(SLOAD) X(SSTORE) X(JUMP) X(JUMPI) X(PC) X(MSIZE) X(GAS) X(JUMPDEST) \
+	X(PUSH) X(DUP) X(SWAP) X(LOG) X(JUMPC) X(JUMPCI) \
+	X(CREATE) X(CALL) X(RETURN) X(SUICIDE) \
+	X(PUSH_JUMPC) X(PUSH_JUMPCI) X(STACK_CHAIN) X(INVALID)
+
+namespace
+{
+
+enum class ThreadedHandler: uint16_t
+{
+#define THREADED_ENUM(name) name,
+	THREADED_HANDLERS(THREADED_ENUM)
+#undef THREADED_ENUM
+};
+
+ThreadedHandler handlerFor(Instruction _op)
+{
+	if (Instruction::PUSH1 <= _op && _op <= Instruction::PUSH32)
+		return ThreadedHandler::PUSH;
+	if (Instruction::DUP1 <= _op && _op <= Instruction::DUP16)
+		return ThreadedHandler::DUP;
+	if (Instruction::SWAP1 <= _op && _op <= Instruction::SWAP16)
+		return ThreadedHandler::SWAP;
+	if (Instruction::LOG0 <= _op && _op <= Instruction::LOG4)
+		return ThreadedHandler::LOG;
+
+	switch (_op)
+	{
+#define THREADED_MAP(name) case Instruction::name: return ThreadedHandler::name;
+	THREADED_MAP(STOP) THREADED_MAP(ADD) THREADED_MAP(MUL) THREADED_MAP(SUB) THREADED_MAP(DIV) THREADED_MAP(SDIV)
+	THREADED_MAP(MOD) THREADED_MAP(SMOD) THREADED_MAP(ADDMOD) THREADED_MAP(MULMOD) THREADED_MAP(EXP) THREADED_MAP(SIGNEXTEND)
+	THREADED_MAP(LT) THREADED_MAP(GT) THREADED_MAP(SLT) THREADED_MAP(SGT) THREADED_MAP(EQ) THREADED_MAP(ISZERO)
+	THREADED_MAP(AND) THREADED_MAP(OR) THREADED_MAP(XOR) THREADED_MAP(NOT) THREADED_MAP(BYTE)
+	THREADED_MAP(SHA3) THREADED_MAP(TESRAINFO)
+	THREADED_MAP(ADDRESS) THREADED_MAP(BALANCE) THREADED_MAP(ORIGIN) THREADED_MAP(CALLER) THREADED_MAP(CALLVALUE)
+	THREADED_MAP(CALLDATALOAD) THREADED_MAP(CALLDATASIZE) THREADED_MAP(CALLDATACOPY) THREADED_MAP(CODESIZE)
+	THREADED_MAP(CODECOPY) THREADED_MAP(GASPRICE) THREADED_MAP(EXTCODESIZE) THREADED_MAP(EXTCODECOPY)
+	THREADED_MAP(BLOCKHASH) THREADED_MAP(COINBASE) THREADED_MAP(TIMESTAMP) THREADED_MAP(NUMBER)
+	THREADED_MAP(DIFFICULTY) THREADED_MAP(GASLIMIT)
+	THREADED_MAP(POP) THREADED_MAP(MLOAD) THREADED_MAP(MSTORE) THREADED_MAP(MSTORE8) THREADED_MAP(SLOAD)
+	THREADED_MAP(SSTORE) THREADED_MAP(JUMP) THREADED_MAP(JUMPI) THREADED_MAP(PC) THREADED_MAP(MSIZE)
+	THREADED_MAP(GAS) THREADED_MAP(JUMPDEST) THREADED_MAP(JUMPC) THREADED_MAP(JUMPCI)
+	THREADED_MAP(CREATE) THREADED_MAP(RETURN) THREADED_MAP(SUICIDE)
+#undef THREADED_MAP
+	case Instruction::PUSHC:
+		return ThreadedHandler::PUSH;
+	case Instruction::CALL:
+	case Instruction::CALLCODE:
+	case Instruction::DELEGATECALL:
+		return ThreadedHandler::CALL;
+	default:
+		return ThreadedHandler::INVALID;
+	}
+}
+
+bool isStackOp(byte _op)
+{
+	return _op == (byte)Instruction::POP ||
+		((byte)Instruction::DUP1 <= _op && _op <= (byte)Instruction::SWAP16);
+}
+
+}
+
+void const* const* VM::c_threadedLabels = nullptr;
+
+void VM::translate(CodeAnalysis& _analysis)
+{
+	byte const* code = _analysis.codeSpace.data();
+	size_t const nBytes = _analysis.codeSize;
+
+	auto emit = [&](ThreadedHandler _handler, uint64_t _pc, byte _op) -> ThreadedOp&
+	{
+		ThreadedOp op;
+		op.handler = (uint16_t)_handler;
+		op.label = c_threadedLabels ? c_threadedLabels[op.handler] : nullptr;
+		op.pc = _pc;
+		op.op = _op;
+		_analysis.entries[_pc] = _analysis.program.size();
+		_analysis.program.push_back(op);
+		return _analysis.program.back();
+	};
+
+	_analysis.entries.assign(nBytes + 34, uint32_t(-1));
+	_analysis.program.reserve(nBytes + 1);
+
+	uint64_t pc = 0;
+	while (pc < nBytes)
+	{
+		byte op = code[pc];
+		ThreadedHandler handler = handlerFor(Instruction(op));
+
+		if (handler == ThreadedHandler::PUSH)
+		{
+			Word256 val;
+			uint64_t next;
+			if (op == (byte)Instruction::PUSHC)
+			{
+				val = _analysis.pool[code[pc + 1]];
+				next = pc + 2 + code[pc + 2];
+			}
+			else
+			{
+				int n = op - (byte)Instruction::PUSH1 + 1;
+				val = Word256::fromBigEndian(code + pc + 1, n);
+				next = pc + 1 + n;
+			}
+
+			byte jump = code[next];
+			if (jump == (byte)Instruction::JUMPC || jump == (byte)Instruction::JUMPCI)
+			{
+				ThreadedOp& fused = emit(jump == (byte)Instruction::JUMPC ? ThreadedHandler::PUSH_JUMPC : ThreadedHandler::PUSH_JUMPCI, pc, op);
+				fused.next = jump;
+				fused.target = uint32_t(val.low64());
+				++next;
+			}
+			else
+				emit(handler, pc, op);
+			_analysis.program.back().arg = _analysis.constants.size();
+			_analysis.constants.push_back(val);
+			pc = next;
+		}
+		else if (isStackOp(op) && isStackOp(code[pc + 1]))
+		{
+			ThreadedOp& chain = emit(ThreadedHandler::STACK_CHAIN, pc, op);
+			chain.arg = _analysis.chains.size();
+			for (; pc < nBytes && isStackOp(code[pc]); ++pc)
+				_analysis.chains.push_back(code[pc]);
+			chain.target = _analysis.chains.size() - chain.arg;
+		}
+		else
+		{
+			emit(handler, pc, op);
+			++pc;
+		}
+	}
+	emit(ThreadedHandler::STOP, pc, (byte)Instruction::STOP);
+
+	for (ThreadedOp& op: _analysis.program)
+		if (op.handler == (uint16_t)ThreadedHandler::PUSH_JUMPC || op.handler == (uint16_t)ThreadedHandler::PUSH_JUMPCI)
+			op.target = _analysis.entries[op.target];
+}
+
+#define THREADED_FETCH(_op) \
+	{ \
+		m_OP = Instruction(_op); \
+		InstructionMetric const& metric = c_metrics[_op]; \
+		checkStack(metric.args, metric.ret); \
+		m_runGas = toInt63(m_schedule->tierStepGas[static_cast<unsigned>(metric.gasPriceTier)]); \
+		m_newMemSize = m_mem.size(); \
+		m_copyMemSize = 0; \
+	}
+
+#if defined(__GNUC__)
+	#define THREADED_CASE(name) name:
+	#define THREADED_DISPATCH goto *op->label;
+	#define THREADED_BEGIN THREADED_DISPATCH {
+	#define THREADED_END }
+#else
+	#define THREADED_CASE(name) case ThreadedHandler::name:
+	#define THREADED_DISPATCH continue;
+	#define THREADED_BEGIN for (;;) switch (ThreadedHandler(op->handler)) {
+	#define THREADED_END }
+#endif
+#define THREADED_NEXT ++op; THREADED_DISPATCH
+#define THREADED_JUMP(_dest) op = program + entries[_dest]; THREADED_DISPATCH
+
+void VM::interpretThreaded()
+{
+#if defined(__GNUC__)
+	static void const* const labels[] =
+	{
+#define THREADED_LABEL(name) &&name,
+		THREADED_HANDLERS(THREADED_LABEL)
+#undef THREADED_LABEL
+	};
+	if (!m_caseInit)
+	{
+		c_threadedLabels = labels;
+		m_caseInit = true;
+		return;
+	}
+#else
+	if (!m_caseInit)
+	{
+		m_caseInit = true;
+		return;
+	}
+#endif
+
+	ThreadedOp const* const program = m_analysis->program.data();
+	uint32_t const* const entries = m_analysis->entries.data();
+	Word256 const* const constants = m_analysis->constants.data();
+	ThreadedOp const* op = program + entries[m_PC];
+
+	THREADED_BEGIN
+
+	THREADED_CASE(CREATE)
+	{
+		THREADED_FETCH(op->op);
+		m_PC = op->pc;
+		m_bounce = &VM::caseCreate;
+	}
+	return;
+
+	THREADED_CASE(CALL)
+	{
+		THREADED_FETCH(op->op);
+		if (m_OP == Instruction::DELEGATECALL && !m_schedule->haveDelegateCall)
+			throwBadInstruction();
+		m_PC = op->pc;
+		m_bounce = &VM::caseCall;
+	}
+	return;
+
+	THREADED_CASE(RETURN)
+	{
+		THREADED_FETCH(op->op);
+		m_newMemSize = memNeed(*m_SP, *(m_SP - 1));
+		updateMem();
+		updateIOGas();
+
+		size_t b = (m_SP--)->low64();
+		size_t s = (m_SP--)->low64();
+		m_output = s ? owning_bytes_ref{bytes(m_mem.begin() + b, m_mem.begin() + b + s), 0, s} : owning_bytes_ref();
+		m_bounce = 0;
+	}
+	return;
+
+	THREADED_CASE(SUICIDE)
+	{
+		THREADED_FETCH(op->op);
+		m_runGas = toInt63(m_schedule->suicideGas);
+		Address dest = asAddress(*m_SP);
+
+		if (m_ext->balance(m_ext->myAddress) > 0 || m_schedule->zeroValueTransferChargesNewAccountGas())
+			if (m_schedule->suicideChargesNewAccountGas() && !m_ext->exists(dest))
+				m_runGas += m_schedule->callNewAccountGas;
+
+		updateIOGas();
+		m_ext->suicide(dest);
+		m_bounce = 0;
+	}
+	return;
+
+	THREADED_CASE(STOP)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+		m_bounce = 0;
+	}
+	return;
+
+	THREADED_CASE(MLOAD)
+	{
+		THREADED_FETCH(op->op);
+		m_newMemSize = toInt63(*m_SP) + 32;
+		updateMem();
+		updateIOGas();
+
+		*m_SP = Word256::fromBigEndian(m_mem.data() + (unsigned)m_SP->low64());
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(MSTORE)
+	{
+		THREADED_FETCH(op->op);
+		m_newMemSize = toInt63(*m_SP) + 32;
+		updateMem();
+		updateIOGas();
+
+		(m_SP - 1)->toBigEndian(&m_mem[(unsigned)m_SP->low64()]);
+		m_SP -= 2;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(MSTORE8)
+	{
+		THREADED_FETCH(op->op);
+		m_newMemSize = toInt63(*m_SP) + 1;
+		updateMem();
+		updateIOGas();
+
+		m_mem[(unsigned)m_SP->low64()] = (byte)(m_SP - 1)->low64();
+		m_SP -= 2;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(SHA3)
+	{
+		THREADED_FETCH(op->op);
+		m_runGas = toInt63(m_schedule->sha3Gas + (u512(w2u(*(m_SP - 1))) + 31) / 32 * m_schedule->sha3WordGas);
+		m_newMemSize = memNeed(*m_SP, *(m_SP - 1));
+		updateMem();
+		updateIOGas();
+
+		uint64_t inOff = (m_SP--)->low64();
+		uint64_t inSize = (m_SP--)->low64();
+		*++m_SP = h2w(sha3(bytesConstRef(m_mem.data() + inOff, inSize)));
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(TESRAINFO)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		eExtendDataType _type;
+		Address _owner = asAddress(*m_SP--);
+		u256 _need = w2u(*m_SP--);
+		h256 _bytes = w2h(*m_SP--);
+		u256 _height = w2u(*m_SP--);
+		vector<uint8_t> _value;
+		u256 result = u256(0);
+
+		bool ret = getData((uint32_t)_height, (char*)_bytes.data(), _type, _value, _owner);
+		if (ret && (_value.size() > 0) && (_type == (uint8_t)_need))
+			for (const auto& _v: _value)
+				result = (result << 8) | _v;
+
+		*++m_SP = u2w(result << 8 * (32 - _value.size()));
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(LOG)
+	{
+		THREADED_FETCH(op->op);
+		logGasMem();
+		updateIOGas();
+
+		unsigned n = (unsigned)m_OP - (unsigned)Instruction::LOG0;
+		h256s topics;
+		for (unsigned i = 0; i < n; ++i)
+			topics.push_back(w2h(*(m_SP - 2 - i)));
+		m_ext->log(std::move(topics), bytesConstRef(m_mem.data() + m_SP->low64(), (m_SP - 1)->low64()));
+		m_SP -= 2 + n;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(EXP)
+	{
+		THREADED_FETCH(op->op);
+		Word256 expon = *(m_SP - 1);
+		m_runGas = toInt63(m_schedule->expGas + m_schedule->expByteGas * expon.byteLength());
+		updateIOGas();
+
+		Word256 base = *m_SP--;
+		*m_SP = exp(base, expon);
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(ADD)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 1) += *m_SP;
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(MUL)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 1) *= *m_SP;
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(SUB)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 1) = *m_SP - *(m_SP - 1);
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(DIV)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 1) = div(*m_SP, *(m_SP - 1));
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(SDIV)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 1) = sdiv(*m_SP, *(m_SP - 1));
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(MOD)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 1) = mod(*m_SP, *(m_SP - 1));
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(SMOD)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 1) = smod(*m_SP, *(m_SP - 1));
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(NOT)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*m_SP = ~*m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(LT)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 1) = *m_SP < *(m_SP - 1) ? 1 : 0;
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(GT)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 1) = *m_SP > *(m_SP - 1) ? 1 : 0;
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(SLT)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 1) = slt(*m_SP, *(m_SP - 1)) ? 1 : 0;
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(SGT)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 1) = sgt(*m_SP, *(m_SP - 1)) ? 1 : 0;
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(EQ)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 1) = *m_SP == *(m_SP - 1) ? 1 : 0;
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(ISZERO)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*m_SP = m_SP->isZero() ? 1 : 0;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(AND)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 1) = *m_SP & *(m_SP - 1);
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(OR)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 1) = *m_SP | *(m_SP - 1);
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(XOR)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 1) = *m_SP ^ *(m_SP - 1);
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(BYTE)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 1) = byteAt(*m_SP, *(m_SP - 1));
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(ADDMOD)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 2) = addmod(*m_SP, *(m_SP - 1), *(m_SP - 2));
+		m_SP -= 2;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(MULMOD)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 2) = mulmod(*m_SP, *(m_SP - 1), *(m_SP - 2));
+		m_SP -= 2;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(SIGNEXTEND)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*(m_SP - 1) = signExtend(*m_SP, *(m_SP - 1));
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(ADDRESS)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*++m_SP = wordFromAddress(m_ext->myAddress);
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(ORIGIN)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*++m_SP = wordFromAddress(m_ext->origin);
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(BALANCE)
+	{
+		THREADED_FETCH(op->op);
+		m_runGas = toInt63(m_schedule->balanceGas);
+		updateIOGas();
+
+		*m_SP = u2w(m_ext->balance(asAddress(*m_SP)));
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(CALLER)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*++m_SP = wordFromAddress(m_ext->caller);
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(CALLVALUE)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*++m_SP = u2w(m_ext->value);
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(CALLDATALOAD)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		if (*m_SP >= m_ext->data.size())
+			*m_SP = 0;
+		else if (m_SP->low64() + 32 <= m_ext->data.size())
+			*m_SP = Word256::fromBigEndian(m_ext->data.data() + m_SP->low64());
+		else
+		{
+			h256 r;
+			for (uint64_t i = m_SP->low64(), e = m_SP->low64() + (uint64_t)32, j = 0; i < e; ++i, ++j)
+				r[j] = i < m_ext->data.size() ? m_ext->data[i] : 0;
+			*m_SP = h2w(r);
+		}
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(CALLDATASIZE)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*++m_SP = m_ext->data.size();
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(CODESIZE)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*++m_SP = m_ext->code.size();
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(EXTCODESIZE)
+	{
+		THREADED_FETCH(op->op);
+		m_runGas = toInt63(m_schedule->extcodesizeGas);
+		updateIOGas();
+
+		*m_SP = m_ext->codeSizeAt(asAddress(*m_SP));
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(CALLDATACOPY)
+	{
+		THREADED_FETCH(op->op);
+		m_copyMemSize = toInt63(*(m_SP - 2));
+		m_newMemSize = memNeed(*m_SP, *(m_SP - 2));
+		updateMem();
+		updateIOGas();
+
+		copyDataToMemory(m_ext->data, m_SP);
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(CODECOPY)
+	{
+		THREADED_FETCH(op->op);
+		m_copyMemSize = toInt63(*(m_SP - 2));
+		m_newMemSize = memNeed(*m_SP, *(m_SP - 2));
+		updateMem();
+		updateIOGas();
+
+		copyDataToMemory(&m_ext->code, m_SP);
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(EXTCODECOPY)
+	{
+		THREADED_FETCH(op->op);
+		m_runGas = toInt63(m_schedule->extcodecopyGas);
+		m_copyMemSize = toInt63(*(m_SP - 3));
+		m_newMemSize = memNeed(*(m_SP - 1), *(m_SP - 3));
+		updateMem();
+		updateIOGas();
+
+		Address a = asAddress(*m_SP);
+		--m_SP;
+		copyDataToMemory(&m_ext->codeAt(a), m_SP);
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(GASPRICE)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*++m_SP = u2w(m_ext->gasPrice);
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(BLOCKHASH)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*m_SP = h2w(m_ext->blockHash(w2u(*m_SP)));
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(COINBASE)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*++m_SP = wordFromAddress(m_ext->blockInfo().author());
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(TIMESTAMP)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*++m_SP = u2w(m_ext->blockInfo().timestamp());
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(NUMBER)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*++m_SP = u2w(m_ext->blockInfo().number());
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(DIFFICULTY)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*++m_SP = u2w(m_ext->blockInfo().difficulty());
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(GASLIMIT)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*++m_SP = m_ext->blockInfo().gasLimit();
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(POP)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		--m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(PUSH)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*++m_SP = constants[op->arg];
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(DUP)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		unsigned n = 1 + (unsigned)m_OP - (unsigned)Instruction::DUP1;
+		*(m_SP + 1) = m_stack[(1 + m_SP - m_stack) - n];
+		++m_SP;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(SWAP)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		unsigned n = (unsigned)m_OP - (unsigned)Instruction::SWAP1 + 2;
+		Word256 d = *m_SP;
+		*m_SP = m_stack[(1 + m_SP - m_stack) - n];
+		m_stack[(1 + m_SP - m_stack) - n] = d;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(STACK_CHAIN)
+	{
+		for (byte const *it = m_analysis->chains.data() + op->arg, *end = it + op->target; it != end; ++it)
+		{
+			THREADED_FETCH(*it);
+			updateIOGas();
+
+			if (m_OP == Instruction::POP)
+				--m_SP;
+			else if (m_OP <= Instruction::DUP16)
+			{
+				unsigned n = 1 + (unsigned)m_OP - (unsigned)Instruction::DUP1;
+				*(m_SP + 1) = m_stack[(1 + m_SP - m_stack) - n];
+				++m_SP;
+			}
+			else
+			{
+				unsigned n = (unsigned)m_OP - (unsigned)Instruction::SWAP1 + 2;
+				Word256 d = *m_SP;
+				*m_SP = m_stack[(1 + m_SP - m_stack) - n];
+				m_stack[(1 + m_SP - m_stack) - n] = d;
+			}
+		}
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(JUMP)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		uint64_t dest = verifyJumpDest(*m_SP);
+		--m_SP;
+		THREADED_JUMP(dest)
+	}
+
+	THREADED_CASE(JUMPI)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+		if (!(m_SP - 1)->isZero())
+		{
+			uint64_t dest = verifyJumpDest(*m_SP);
+			m_SP -= 2;
+			THREADED_JUMP(dest)
+		}
+		m_SP -= 2;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(JUMPC)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		uint64_t dest = m_SP->low64();
+		--m_SP;
+		THREADED_JUMP(dest)
+	}
+
+	THREADED_CASE(JUMPCI)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+		if (!(m_SP - 1)->isZero())
+		{
+			uint64_t dest = m_SP->low64();
+			m_SP -= 2;
+			THREADED_JUMP(dest)
+		}
+		m_SP -= 2;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(PUSH_JUMPC)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+		*++m_SP = constants[op->arg];
+
+		THREADED_FETCH(op->next);
+		updateIOGas();
+		--m_SP;
+		op = program + op->target;
+	}
+	THREADED_DISPATCH
+
+	THREADED_CASE(PUSH_JUMPCI)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+		*++m_SP = constants[op->arg];
+
+		THREADED_FETCH(op->next);
+		updateIOGas();
+		bool jump = *(m_SP - 1) != 0;
+		m_SP -= 2;
+		if (jump)
+		{
+			op = program + op->target;
+			THREADED_DISPATCH
+		}
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(PC)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*++m_SP = op->pc;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(MSIZE)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*++m_SP = m_mem.size();
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(GAS)
+	{
+		THREADED_FETCH(op->op);
+		updateIOGas();
+
+		*++m_SP = m_io_gas;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(JUMPDEST)
+	{
+		THREADED_FETCH(op->op);
+		m_runGas = 1;
+		updateIOGas();
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(SLOAD)
+	{
+		THREADED_FETCH(op->op);
+		m_runGas = toInt63(m_schedule->sloadGas);
+		updateIOGas();
+
+		*m_SP = u2w(m_ext->store(w2u(*m_SP)));
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(SSTORE)
+	{
+		THREADED_FETCH(op->op);
+		u256 const key = w2u(*m_SP);
+		if (!m_ext->store(key) && !(m_SP - 1)->isZero())
+			m_runGas = toInt63(m_schedule->sstoreSetGas);
+		else if (m_ext->store(key) && (m_SP - 1)->isZero())
+		{
+			m_runGas = toInt63(m_schedule->sstoreResetGas);
+			m_ext->sub.refunds += m_schedule->sstoreRefundGas;
+		}
+		else
+			m_runGas = toInt63(m_schedule->sstoreResetGas);
+		updateIOGas();
+
+		m_ext->setStore(key, w2u(*(m_SP - 1)));
+		m_SP -= 2;
+	}
+	THREADED_NEXT
+
+	THREADED_CASE(INVALID)
+	{
+		THREADED_FETCH(op->op);
+		throwBadInstruction();
+	}
+	THREADED_NEXT
+
+	THREADED_END
+}
@@ -0,0 +1,217 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http:
+*/
+/** @file VMTrace.cpp
+ * @date 2018
+ */
+
+#include "VMTrace.h"
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <boost/thread/tss.hpp>
+#include <libdevcore/Log.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+	boost::thread_specific_ptr<shared_ptr<VMTraceBuffer>> t_buffer;
+}
+
+void VMTraceBuffer::setData(VMTraceRecord& o_record, byte const* _data, size_t _size)
+{
+	memset(&o_record, 0, sizeof(o_record));
+	memcpy(&o_record, _data, min(_size, VMTraceRecord::c_dataSize));
+	o_record.kind = VMTraceRecord::Data;
+}
+
+uint32_t VMTraceBuffer::enter(h160 const& _address, unsigned _depth, uint64_t _gas)
+{
+	uint32_t execution = ++m_executions;
+	VMTraceRecord r[2];
+	r[0] = VMTraceRecord{_gas, _depth, 0, execution, 0, 0, VMTraceRecord::Enter};
+	setData(r[1], _address.data(), h160::size);
+	push(r, 2);
+	return execution;
+}
+
+void VMTraceBuffer::exit(uint32_t _execution, uint64_t _gas, bool _threw)
+{
+	VMTraceRecord r{_gas, 0, 0, _execution, 0, uint8_t(_threw ? 1 : 0), VMTraceRecord::Exit};
+	push(&r, 1);
+}
+
+void VMTraceBuffer::transaction(h256 const& _hash, uint32_t _nOut, uint64_t _gas)
+{
+	VMTraceRecord r[3];
+	r[0] = VMTraceRecord{_gas, _nOut, 0, m_executions, 0, 0, VMTraceRecord::Transaction};
+	setData(r[1], _hash.data(), VMTraceRecord::c_dataSize);
+	setData(r[2], _hash.data() + VMTraceRecord::c_dataSize, h256::size - VMTraceRecord::c_dataSize);
+	push(r, 3);
+}
+
+void VMTraceBuffer::drain(vector<VMTraceRecord>& o_records, uint64_t& o_dropped)
+{
+	uint64_t tail = m_tail.load(memory_order_relaxed);
+	uint64_t head = m_head.load(memory_order_acquire);
+	for (uint64_t i = tail; i < head; ++i)
+		o_records.push_back(m_records[i & (c_capacity - 1)]);
+	m_tail.store(head, memory_order_release);
+	o_dropped = m_dropped.exchange(0, memory_order_relaxed);
+}
+
+VMTraceBuffer& VMTracer::local()
+{
+	if (!t_buffer.get())
+	{
+		Guard l(x_buffers);
+		shared_ptr<VMTraceBuffer> buffer = make_shared<VMTraceBuffer>(++m_threads);
+		m_buffers.push_back(buffer);
+		t_buffer.reset(new shared_ptr<VMTraceBuffer>(buffer));
+	}
+	return **t_buffer;
+}
+
+bool VMTracer::start(string const& _path, uint64_t _maxSize)
+{
+	stop();
+	{
+		Guard l(x_file);
+		m_path = _path;
+		m_maxSize = _maxSize;
+		if (!openFile())
+			return false;
+	}
+	m_stop = false;
+	m_enabled = true;
+	m_thread.reset(new boost::thread([this]() { run(); }));
+	return true;
+}
+
+void VMTracer::stop()
+{
+	if (!m_thread)
+		return;
+	m_enabled = false;
+	m_stop = true;
+	m_thread->join();
+	m_thread.reset();
+	flush();
+
+	Guard l(x_file);
+	if (m_file)
+		fclose(m_file);
+	m_file = nullptr;
+}
+
+void VMTracer::run()
+{
+	while (!m_stop)
+	{
+		boost::this_thread::sleep_for(boost::chrono::milliseconds(c_flushInterval));
+		flush();
+	}
+}
+
+void VMTracer::flush()
+{
+	Guard lf(x_flush);
+
+	// A buffer only the list holds belongs to a thread that ended, it is dropped once drained
+	vector<shared_ptr<VMTraceBuffer>> buffers;
+	vector<shared_ptr<VMTraceBuffer>> finished;
+	{
+		Guard l(x_buffers);
+		for (auto const& buffer: m_buffers)
+			if (buffer.use_count() == 1)
+				finished.push_back(buffer);
+		buffers = m_buffers;
+	}
+
+	vector<VMTraceRecord> records;
+	for (auto const& buffer: buffers)
+	{
+		records.clear();
+		records.push_back(VMTraceRecord{0, 0, 0, buffer->thread(), 0, 0, VMTraceRecord::Chunk});
+		uint64_t dropped = 0;
+		buffer->drain(records, dropped);
+		if (dropped)
+		{
+			records.insert(records.begin() + 1, VMTraceRecord{dropped, 0, 0, buffer->thread(), 0, 0, VMTraceRecord::Dropped});
+			m_dropped += dropped;
+		}
+		if (records.size() > 1)
+		{
+			records[0].pc = uint32_t(records.size() - 1);
+			write(records.data(), records.size());
+		}
+	}
+
+	{
+		Guard l(x_file);
+		if (m_file)
+			fflush(m_file);
+	}
+
+	Guard l(x_buffers);
+	for (auto const& buffer: finished)
+		m_buffers.erase(find(m_buffers.begin(), m_buffers.end(), buffer));
+}
+
+bool VMTracer::openFile()
+{
+	if (m_file)
+		fclose(m_file);
+	m_file = nullptr;
+
+	boost::system::error_code ec;
+	if (m_maxSize && boost::filesystem::exists(m_path, ec) && boost::filesystem::file_size(m_path, ec) >= m_maxSize)
+		boost::filesystem::rename(m_path, m_path + ".old", ec);
+
+	m_file = fopen(m_path.c_str(), "ab");
+	if (!m_file)
+	{
+		cwarn << "Cannot open VM trace file" << m_path;
+		return false;
+	}
+	fseek(m_file, 0, SEEK_END);
+	m_fileSize = ftell(m_file);
+	if (m_fileSize == 0)
+	{
+		VMTraceHeader header;
+		memcpy(header.magic, VMTraceHeader::magicBytes(), sizeof(header.magic));
+		header.version = VMTraceHeader::c_version;
+		header.recordSize = sizeof(VMTraceRecord);
+		header.reserved = 0;
+		fwrite(&header, sizeof(header), 1, m_file);
+		m_fileSize = sizeof(header);
+	}
+	return true;
+}
+
+void VMTracer::write(VMTraceRecord const* _records, size_t _n)
+{
+	Guard l(x_file);
+	if (m_maxSize && m_fileSize >= m_maxSize && !openFile())
+		return;
+	if (!m_file)
+		return;
+	size_t n = fwrite(_records, sizeof(VMTraceRecord), _n, m_file);
+	m_fileSize += n * sizeof(VMTraceRecord);
+	m_written += n;
+}
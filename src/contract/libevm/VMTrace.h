@@ -0,0 +1,192 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http:
+*/
+/** @file VMTrace.h
+ * @date 2018
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/thread.hpp>
+#include <libdevcore/Common.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief One slot of a binary VM trace file.
+ * A trace file is a VMTraceHeader followed by an array of slots of the same size, so it can be
+ * mapped and a range of records found by offset. The slots a thread recorded follow a Chunk slot.
+ */
+struct VMTraceRecord
+{
+	enum Kind: uint8_t
+	{
+		Step = 0,			///< An instruction about to run: gas left, stack depth and memory size.
+		Enter = 1,			///< A frame starts with gas, its call depth in pc; a Data slot with the code address follows.
+		Exit = 2,			///< A frame ends with gas left, op is 1 when it threw.
+		Transaction = 3,	///< A transaction starts with gas, its output index in pc; two Data slots with its hash follow.
+		Data = 4,			///< Payload of the slot before it, in the first c_dataSize bytes.
+		Chunk = 5,			///< The next pc slots were recorded by the thread numbered execution.
+		Dropped = 6			///< The thread dropped gas records since its last chunk, its buffer was full.
+	};
+
+	uint64_t gas;
+	uint32_t pc;
+	uint32_t memory;
+	/// Frame the record belongs to, numbered per thread.
+	uint32_t execution;
+	uint16_t stack;
+	uint8_t op;
+	uint8_t kind;
+
+	static const size_t c_dataSize = 20;
+};
+
+static_assert(sizeof(VMTraceRecord) == 24, "VM trace records are written as is");
+
+struct VMTraceHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t recordSize;
+	uint64_t reserved;
+
+	static const uint32_t c_version = 1;
+	static char const* magicBytes() { return "EVMTRACE"; }
+};
+
+static_assert(sizeof(VMTraceHeader) == sizeof(VMTraceRecord), "the header takes the first slot");
+
+/**
+ * @brief Lock-free single producer, single consumer ring of trace records of one thread.
+ * The VM thread pushes and never waits: records that do not fit are counted and dropped. The
+ * writer thread drains the ring.
+ */
+class VMTraceBuffer
+{
+public:
+	explicit VMTraceBuffer(uint32_t _thread): m_records(new VMTraceRecord[c_capacity]), m_thread(_thread) {}
+
+	/// Pushes _n records, all or none of them.
+	void push(VMTraceRecord const* _records, size_t _n)
+	{
+		uint64_t head = m_head.load(std::memory_order_relaxed);
+		if (head + _n - m_tail.load(std::memory_order_acquire) > c_capacity)
+		{
+			m_dropped.fetch_add(_n, std::memory_order_relaxed);
+			return;
+		}
+		for (size_t i = 0; i < _n; ++i)
+			m_records[(head + i) & (c_capacity - 1)] = _records[i];
+		m_head.store(head + _n, std::memory_order_release);
+	}
+
+	void step(uint32_t _execution, uint64_t _pc, uint8_t _op, uint64_t _gas, size_t _stack, size_t _memory)
+	{
+		VMTraceRecord r{_gas, uint32_t(_pc), uint32_t(std::min<size_t>(_memory, UINT32_MAX)), _execution, uint16_t(_stack), _op, VMTraceRecord::Step};
+		push(&r, 1);
+	}
+
+	/// Records the start of a frame and returns its number.
+	uint32_t enter(h160 const& _address, unsigned _depth, uint64_t _gas);
+	void exit(uint32_t _execution, uint64_t _gas, bool _threw);
+	void transaction(h256 const& _hash, uint32_t _nOut, uint64_t _gas);
+
+	/// Appends the records pushed so far to o_records, called by the writer thread only.
+	void drain(std::vector<VMTraceRecord>& o_records, uint64_t& o_dropped);
+
+	uint32_t thread() const { return m_thread; }
+
+	static const size_t c_capacity = 1 << 16;
+
+private:
+	static void setData(VMTraceRecord& o_record, byte const* _data, size_t _size);
+
+	std::unique_ptr<VMTraceRecord[]> m_records;
+	std::atomic<uint64_t> m_head{0};
+	std::atomic<uint64_t> m_tail{0};
+	std::atomic<uint64_t> m_dropped{0};
+	uint32_t m_executions = 0;
+	uint32_t m_thread;
+};
+
+/**
+ * @brief Records every instruction the interpreter runs into per-thread ring buffers.
+ * A background thread appends the buffers to a trace file every c_flushInterval ms. When the
+ * file grows past the size limit it is moved to <file>.old and a new one is started, so at most
+ * twice the limit is kept on disk. Convert a range of a trace to JSON with tesra-vmtrace.
+ */
+class VMTracer
+{
+public:
+	~VMTracer() { stop(); }
+
+	bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+	/// The buffer of the calling thread, created on first use.
+	VMTraceBuffer& local();
+
+	bool start(std::string const& _path, uint64_t _maxSize);
+	void stop();
+	/// Writes what the buffers hold now.
+	void flush();
+
+	uint64_t written() const { return m_written; }
+	uint64_t dropped() const { return m_dropped; }
+
+	static VMTracer& instance() { static VMTracer tracer; return tracer; }
+
+	static const unsigned c_flushInterval = 200;
+
+private:
+	void run();
+	bool openFile();
+	void write(VMTraceRecord const* _records, size_t _n);
+
+	std::atomic<bool> m_enabled{false};
+	std::atomic<bool> m_stop{false};
+	std::unique_ptr<boost::thread> m_thread;
+	/// Buffers have a single consumer, one flush runs at a time.
+	Mutex x_flush;
+
+	/// Registered buffers, a buffer is released once its thread ended and it was drained.
+	Mutex x_buffers;
+	std::vector<std::shared_ptr<VMTraceBuffer>> m_buffers;
+	uint32_t m_threads = 0;
+
+	/// Guards the file.
+	Mutex x_file;
+	std::string m_path;
+	uint64_t m_maxSize = 0;
+	std::FILE* m_file = nullptr;
+	uint64_t m_fileSize = 0;
+	std::atomic<uint64_t> m_written{0};
+	std::atomic<uint64_t> m_dropped{0};
+};
+
+}
+}
@@ -60,7 +60,7 @@ void VM::validate(ExtVMFace& _ext)
 
 
 
-void VM::validateSubroutine(uint64_t _PC, uint64_t* _RP, u256* _SP)
+void VM::validateSubroutine(uint64_t _PC, uint64_t* _RP, Word256* _SP)
 {
 	
 	m_PC = _PC, m_RP = _RP, m_SP = _SP;
@@ -136,7 +136,7 @@ void VM::validateSubroutine(uint64_t _PC, uint64_t* _RP, u256* _SP)
 			for (size_t sub = 0, nSubs = m_code[m_PC+1]; sub < nSubs; ++sub)
 			{
 				
-				u256 slot = sub;
+				Word256 slot = sub;
 				_SP = &slot;
 				size_t destPC = decodeJumpvDest(m_code, _PC, _SP);
 				byte nArgs = m_code[destPC+1];
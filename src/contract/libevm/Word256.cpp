@@ -0,0 +1,261 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http:
+*/
+/** @file Word256.cpp
+ * @date 2018
+ */
+
+#include <cassert>
+#include <limits>
+#include "Word256.h"
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+unsigned significantLimbs(uint64_t const* _a, unsigned _n)
+{
+	while (_n && !_a[_n - 1])
+		--_n;
+	return _n;
+}
+
+}
+
+void word256::divmod(uint64_t const* _u, unsigned _un, uint64_t const* _v, unsigned _vn, uint64_t* o_q, uint64_t* o_r)
+{
+	if (o_q)
+		memset(o_q, 0, _un * sizeof(uint64_t));
+	if (o_r)
+		memset(o_r, 0, _vn * sizeof(uint64_t));
+
+	unsigned m = significantLimbs(_u, _un);
+	unsigned n = significantLimbs(_v, _vn);
+	assert(n);
+	if (m < n || (m == n && _u[m - 1] < _v[n - 1]))
+	{
+		if (o_r)
+			memcpy(o_r, _u, m * sizeof(uint64_t));
+		return;
+	}
+
+#if defined(__SIZEOF_INT128__)
+	typedef unsigned __int128 u128;
+	if (n == 1)
+	{
+		uint64_t rem = 0;
+		for (unsigned i = m; i--;)
+		{
+			u128 num = (u128(rem) << 64) | _u[i];
+			uint64_t q = uint64_t(num / _v[0]);
+			rem = uint64_t(num - u128(q) * _v[0]);
+			if (o_q)
+				o_q[i] = q;
+		}
+		if (o_r)
+			o_r[0] = rem;
+		return;
+	}
+
+	// Knuth, TAOCP vol. 2, 4.3.1, algorithm D with 64-bit digits.
+	uint64_t vn[8];
+	uint64_t un[9];
+	unsigned const s = clz64(_v[n - 1]);
+	for (unsigned i = n - 1; i > 0; --i)
+		vn[i] = (_v[i] << s) | (s ? _v[i - 1] >> (64 - s) : 0);
+	vn[0] = _v[0] << s;
+	un[m] = s ? _u[m - 1] >> (64 - s) : 0;
+	for (unsigned i = m - 1; i > 0; --i)
+		un[i] = (_u[i] << s) | (s ? _u[i - 1] >> (64 - s) : 0);
+	un[0] = _u[0] << s;
+
+	for (unsigned j = m - n + 1; j--;)
+	{
+		u128 num = (u128(un[j + n]) << 64) | un[j + n - 1];
+		u128 qhat = num / vn[n - 1];
+		u128 rhat = num - qhat * vn[n - 1];
+		while ((qhat >> 64) || qhat * vn[n - 2] > ((rhat << 64) | un[j + n - 2]))
+		{
+			--qhat;
+			rhat += vn[n - 1];
+			if (rhat >> 64)
+				break;
+		}
+
+		uint64_t q = uint64_t(qhat);
+		uint64_t carry = 0;
+		uint64_t borrow = 0;
+		for (unsigned i = 0; i < n; ++i)
+		{
+			uint64_t hi;
+			uint64_t lo = mul64(q, vn[i], hi);
+			uint64_t c = 0;
+			lo = addc(lo, carry, c);
+			carry = hi + c;
+			un[i + j] = subb(un[i + j], lo, borrow);
+		}
+		un[j + n] = subb(un[j + n], carry, borrow);
+
+		if (borrow)
+		{
+			--q;
+			uint64_t c = 0;
+			for (unsigned i = 0; i < n; ++i)
+				un[i + j] = addc(un[i + j], vn[i], c);
+			un[j + n] += c;
+		}
+		if (o_q)
+			o_q[j] = q;
+	}
+
+	if (o_r)
+	{
+		for (unsigned i = 0; i + 1 < n; ++i)
+			o_r[i] = (un[i] >> s) | (s ? un[i + 1] << (64 - s) : 0);
+		o_r[n - 1] = un[n - 1] >> s;
+	}
+#else
+	bigint u = 0;
+	bigint v = 0;
+	for (unsigned i = m; i--;)
+		u = (u << 64) | _u[i];
+	for (unsigned i = n; i--;)
+		v = (v << 64) | _v[i];
+	bigint q = u / v;
+	bigint r = u - q * v;
+	for (unsigned i = 0; o_q && i < _un; ++i, q >>= 64)
+		o_q[i] = (q & std::numeric_limits<uint64_t>::max()).convert_to<uint64_t>();
+	for (unsigned i = 0; o_r && i < _vn; ++i, r >>= 64)
+		o_r[i] = (r & std::numeric_limits<uint64_t>::max()).convert_to<uint64_t>();
+#endif
+}
+
+namespace dev
+{
+namespace eth
+{
+
+Word256 div(Word256 const& _a, Word256 const& _b)
+{
+	if (_b.isZero())
+		return Word256();
+	if (_a.fitsUint64() && _b.fitsUint64())
+		return _a.limbs[0] / _b.limbs[0];
+	Word256 q;
+	word256::divmod(_a.limbs, 4, _b.limbs, 4, q.limbs, nullptr);
+	return q;
+}
+
+Word256 mod(Word256 const& _a, Word256 const& _b)
+{
+	if (_b.isZero())
+		return Word256();
+	if (_a.fitsUint64() && _b.fitsUint64())
+		return _a.limbs[0] % _b.limbs[0];
+	Word256 r;
+	word256::divmod(_a.limbs, 4, _b.limbs, 4, nullptr, r.limbs);
+	return r;
+}
+
+Word256 sdiv(Word256 const& _a, Word256 const& _b)
+{
+	if (_b.isZero())
+		return Word256();
+	bool na = _a.isNegative();
+	bool nb = _b.isNegative();
+	Word256 q = div(na ? -_a : _a, nb ? -_b : _b);
+	return na != nb ? -q : q;
+}
+
+Word256 smod(Word256 const& _a, Word256 const& _b)
+{
+	if (_b.isZero())
+		return Word256();
+	bool na = _a.isNegative();
+	Word256 r = mod(na ? -_a : _a, _b.isNegative() ? -_b : _b);
+	return na ? -r : r;
+}
+
+Word256 addmod(Word256 const& _a, Word256 const& _b, Word256 const& _m)
+{
+	if (_m.isZero())
+		return Word256();
+	uint64_t sum[5];
+	uint64_t c = 0;
+	for (unsigned i = 0; i < 4; ++i)
+		sum[i] = word256::addc(_a.limbs[i], _b.limbs[i], c);
+	sum[4] = c;
+	Word256 r;
+	word256::divmod(sum, 5, _m.limbs, 4, nullptr, r.limbs);
+	return r;
+}
+
+Word256 mulmod(Word256 const& _a, Word256 const& _b, Word256 const& _m)
+{
+	if (_m.isZero())
+		return Word256();
+	uint64_t p[8] = {};
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		uint64_t carry = 0;
+		for (unsigned j = 0; j < 4; ++j)
+		{
+			uint64_t hi;
+			uint64_t lo = word256::mul64(_a.limbs[i], _b.limbs[j], hi);
+			uint64_t c = 0;
+			lo = word256::addc(lo, p[i + j], c);
+			hi += c;
+			c = 0;
+			p[i + j] = word256::addc(lo, carry, c);
+			carry = hi + c;
+		}
+		p[i + 4] = carry;
+	}
+	Word256 r;
+	word256::divmod(p, 8, _m.limbs, 4, nullptr, r.limbs);
+	return r;
+}
+
+Word256 exp(Word256 _base, Word256 const& _exponent)
+{
+	Word256 result = 1;
+	for (unsigned i = 0, n = _exponent.bitLength(); i < n; ++i)
+	{
+		if (_exponent.bit(i))
+			result *= _base;
+		_base *= _base;
+	}
+	return result;
+}
+
+}
+}
+
+Word256 dev::eth::u2w(u256 const& _u)
+{
+	Word256 r;
+	boost::multiprecision::export_bits(_u, r.limbs, 64, false);
+	return r;
+}
+
+u256 dev::eth::w2u(Word256 const& _w)
+{
+	u256 r;
+	boost::multiprecision::import_bits(r, _w.limbs, _w.limbs + 4, 64, false);
+	return r;
+}
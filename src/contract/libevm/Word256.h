@@ -0,0 +1,288 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http:
+*/
+/** @file Word256.h
+ * Fixed-width 256-bit machine word used for the VM stack. Stored as four 64-bit limbs,
+ * least significant first, so arithmetic never goes through the generic multiprecision code.
+ * Operators are hidden friends so they do not shadow the container operators of libdevcore.
+ * @date 2018
+ */
+
+#pragma once
+
+#include <cstring>
+#include <libdevcore/Common.h>
+#include <libdevcore/FixedHash.h>
+
+namespace dev
+{
+namespace eth
+{
+
+namespace word256
+{
+
+inline unsigned clz64(uint64_t _v)
+{
+#if defined(__GNUC__)
+	return _v ? __builtin_clzll(_v) : 64;
+#else
+	unsigned n = 0;
+	for (uint64_t m = uint64_t(1) << 63; m && !(_v & m); m >>= 1)
+		++n;
+	return n;
+#endif
+}
+
+inline uint64_t bswap64(uint64_t _v)
+{
+#if defined(__GNUC__)
+	return __builtin_bswap64(_v);
+#else
+	uint64_t r = 0;
+	for (int i = 0; i < 8; ++i, _v >>= 8)
+		r = (r << 8) | (_v & 0xff);
+	return r;
+#endif
+}
+
+/// @returns the low 64 bits of _a * _b and stores the high 64 bits in o_hi.
+inline uint64_t mul64(uint64_t _a, uint64_t _b, uint64_t& o_hi)
+{
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 p = (unsigned __int128)_a * _b;
+	o_hi = uint64_t(p >> 64);
+	return uint64_t(p);
+#else
+	uint64_t al = uint32_t(_a), ah = _a >> 32, bl = uint32_t(_b), bh = _b >> 32;
+	uint64_t ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+	uint64_t mid = (ll >> 32) + uint32_t(lh) + uint32_t(hl);
+	o_hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+	return (mid << 32) | uint32_t(ll);
+#endif
+}
+
+/// @returns _a + _b + io_carry and leaves the carry out in io_carry.
+inline uint64_t addc(uint64_t _a, uint64_t _b, uint64_t& io_carry)
+{
+	uint64_t s = _a + _b;
+	uint64_t c = s < _a;
+	uint64_t r = s + io_carry;
+	io_carry = c | (r < s);
+	return r;
+}
+
+/// @returns _a - _b - io_borrow and leaves the borrow out in io_borrow.
+inline uint64_t subb(uint64_t _a, uint64_t _b, uint64_t& io_borrow)
+{
+	uint64_t d = _a - _b;
+	uint64_t b = _a < _b;
+	uint64_t r = d - io_borrow;
+	io_borrow = b | (d < io_borrow);
+	return r;
+}
+
+/// Long division of little-endian limb arrays (at most eight limbs each). Either output may
+/// be null; o_q receives _un limbs and o_r receives _vn limbs. _v must not be zero.
+void divmod(uint64_t const* _u, unsigned _un, uint64_t const* _v, unsigned _vn, uint64_t* o_q, uint64_t* o_r);
+
+}
+
+struct Word256
+{
+	uint64_t limbs[4];
+
+	Word256(): limbs{0, 0, 0, 0} {}
+	Word256(uint64_t _v): limbs{_v, 0, 0, 0} {}
+	Word256(uint64_t _l0, uint64_t _l1, uint64_t _l2, uint64_t _l3): limbs{_l0, _l1, _l2, _l3} {}
+
+	bool isZero() const { return !(limbs[0] | limbs[1] | limbs[2] | limbs[3]); }
+	bool isNegative() const { return limbs[3] >> 63; }
+	bool fitsUint64() const { return !(limbs[1] | limbs[2] | limbs[3]); }
+	uint64_t low64() const { return limbs[0]; }
+	bool bit(unsigned _i) const { return (limbs[_i / 64] >> (_i % 64)) & 1; }
+
+	unsigned bitLength() const
+	{
+		for (int i = 3; i >= 0; --i)
+			if (limbs[i])
+				return 64 * i + 64 - word256::clz64(limbs[i]);
+		return 0;
+	}
+	unsigned byteLength() const { return (bitLength() + 7) / 8; }
+
+	static Word256 fromBigEndian(byte const* _data, size_t _size = 32)
+	{
+		Word256 r;
+		if (_size == 32)
+			for (unsigned i = 0; i < 4; ++i)
+			{
+				uint64_t v;
+				std::memcpy(&v, _data + 8 * (3 - i), 8);
+				r.limbs[i] = word256::bswap64(v);
+			}
+		else
+			for (size_t i = 0; i < _size; ++i)
+			{
+				size_t k = _size - 1 - i;
+				r.limbs[k / 8] |= uint64_t(_data[i]) << (8 * (k % 8));
+			}
+		return r;
+	}
+
+	void toBigEndian(byte* _out) const
+	{
+		for (unsigned i = 0; i < 4; ++i)
+		{
+			uint64_t v = word256::bswap64(limbs[i]);
+			std::memcpy(_out + 8 * (3 - i), &v, 8);
+		}
+	}
+
+	Word256& operator+=(Word256 const& _b) { return *this = *this + _b; }
+	Word256& operator-=(Word256 const& _b) { return *this = *this - _b; }
+	Word256& operator*=(Word256 const& _b) { return *this = *this * _b; }
+	Word256& operator&=(Word256 const& _b) { return *this = *this & _b; }
+	Word256& operator|=(Word256 const& _b) { return *this = *this | _b; }
+
+	friend bool operator==(Word256 const& _a, Word256 const& _b)
+	{
+		return !((_a.limbs[0] ^ _b.limbs[0]) | (_a.limbs[1] ^ _b.limbs[1]) | (_a.limbs[2] ^ _b.limbs[2]) | (_a.limbs[3] ^ _b.limbs[3]));
+	}
+	friend bool operator!=(Word256 const& _a, Word256 const& _b) { return !(_a == _b); }
+
+	friend bool operator<(Word256 const& _a, Word256 const& _b)
+	{
+		for (int i = 3; i > 0; --i)
+			if (_a.limbs[i] != _b.limbs[i])
+				return _a.limbs[i] < _b.limbs[i];
+		return _a.limbs[0] < _b.limbs[0];
+	}
+	friend bool operator>(Word256 const& _a, Word256 const& _b) { return _b < _a; }
+	friend bool operator<=(Word256 const& _a, Word256 const& _b) { return !(_b < _a); }
+	friend bool operator>=(Word256 const& _a, Word256 const& _b) { return !(_a < _b); }
+
+	friend Word256 operator+(Word256 const& _a, Word256 const& _b)
+	{
+		Word256 r;
+		uint64_t c = 0;
+		for (unsigned i = 0; i < 4; ++i)
+			r.limbs[i] = word256::addc(_a.limbs[i], _b.limbs[i], c);
+		return r;
+	}
+
+	friend Word256 operator-(Word256 const& _a, Word256 const& _b)
+	{
+		Word256 r;
+		uint64_t b = 0;
+		for (unsigned i = 0; i < 4; ++i)
+			r.limbs[i] = word256::subb(_a.limbs[i], _b.limbs[i], b);
+		return r;
+	}
+
+	friend Word256 operator*(Word256 const& _a, Word256 const& _b)
+	{
+		Word256 r;
+		for (unsigned i = 0; i < 4; ++i)
+		{
+			uint64_t carry = 0;
+			for (unsigned j = 0; i + j < 4; ++j)
+			{
+				uint64_t hi;
+				uint64_t lo = word256::mul64(_a.limbs[i], _b.limbs[j], hi);
+				uint64_t c = 0;
+				lo = word256::addc(lo, r.limbs[i + j], c);
+				hi += c;
+				c = 0;
+				r.limbs[i + j] = word256::addc(lo, carry, c);
+				carry = hi + c;
+			}
+		}
+		return r;
+	}
+
+	friend Word256 operator~(Word256 const& _a) { return Word256(~_a.limbs[0], ~_a.limbs[1], ~_a.limbs[2], ~_a.limbs[3]); }
+	friend Word256 operator&(Word256 const& _a, Word256 const& _b) { return Word256(_a.limbs[0] & _b.limbs[0], _a.limbs[1] & _b.limbs[1], _a.limbs[2] & _b.limbs[2], _a.limbs[3] & _b.limbs[3]); }
+	friend Word256 operator|(Word256 const& _a, Word256 const& _b) { return Word256(_a.limbs[0] | _b.limbs[0], _a.limbs[1] | _b.limbs[1], _a.limbs[2] | _b.limbs[2], _a.limbs[3] | _b.limbs[3]); }
+	friend Word256 operator^(Word256 const& _a, Word256 const& _b) { return Word256(_a.limbs[0] ^ _b.limbs[0], _a.limbs[1] ^ _b.limbs[1], _a.limbs[2] ^ _b.limbs[2], _a.limbs[3] ^ _b.limbs[3]); }
+
+	friend Word256 operator<<(Word256 const& _a, unsigned _n)
+	{
+		Word256 r;
+		if (_n >= 256)
+			return r;
+		unsigned const w = _n / 64, s = _n % 64;
+		for (unsigned i = 3; i >= w && i < 4; --i)
+			r.limbs[i] = (_a.limbs[i - w] << s) | (s && i > w ? _a.limbs[i - w - 1] >> (64 - s) : 0);
+		return r;
+	}
+
+	friend Word256 operator>>(Word256 const& _a, unsigned _n)
+	{
+		Word256 r;
+		if (_n >= 256)
+			return r;
+		unsigned const w = _n / 64, s = _n % 64;
+		for (unsigned i = 0; i + w < 4; ++i)
+			r.limbs[i] = (_a.limbs[i + w] >> s) | (s && i + w < 3 ? _a.limbs[i + w + 1] << (64 - s) : 0);
+		return r;
+	}
+
+	/// EVM arithmetic: division and modulo by zero yield zero, signed operations use two's complement.
+	friend Word256 div(Word256 const& _a, Word256 const& _b);
+	friend Word256 mod(Word256 const& _a, Word256 const& _b);
+	friend Word256 sdiv(Word256 const& _a, Word256 const& _b);
+	friend Word256 smod(Word256 const& _a, Word256 const& _b);
+	friend Word256 addmod(Word256 const& _a, Word256 const& _b, Word256 const& _m);
+	friend Word256 mulmod(Word256 const& _a, Word256 const& _b, Word256 const& _m);
+	friend Word256 exp(Word256 _base, Word256 const& _exponent);
+
+	friend Word256 operator-(Word256 const& _a) { return Word256() - _a; }
+	friend bool slt(Word256 const& _a, Word256 const& _b)
+	{
+		bool na = _a.isNegative();
+		return na != _b.isNegative() ? na : _a < _b;
+	}
+	friend bool sgt(Word256 const& _a, Word256 const& _b) { return slt(_b, _a); }
+
+	/// BYTE: the _i-th most significant byte of _x, zero when _i >= 32.
+	friend Word256 byteAt(Word256 const& _i, Word256 const& _x)
+	{
+		if (!_i.fitsUint64() || _i.limbs[0] >= 32)
+			return Word256();
+		unsigned n = 31 - unsigned(_i.limbs[0]);
+		return (_x.limbs[n / 8] >> (8 * (n % 8))) & 0xff;
+	}
+
+	/// SIGNEXTEND: extends the sign of the (_k + 1)-byte value _x, unchanged when _k >= 31.
+	friend Word256 signExtend(Word256 const& _k, Word256 const& _x)
+	{
+		if (!_k.fitsUint64() || _k.limbs[0] >= 31)
+			return _x;
+		unsigned testBit = unsigned(_k.limbs[0]) * 8 + 7;
+		Word256 mask = (Word256(1) << testBit) - 1;
+		return _x.bit(testBit) ? _x | ~mask : _x & mask;
+	}
+};
+
+/// Conversion shims used where stack words meet u256/h256 based interfaces (ExtVMFace, hashing).
+Word256 u2w(u256 const& _u);
+u256 w2u(Word256 const& _w);
+inline Word256 h2w(h256 const& _h) { return Word256::fromBigEndian(_h.data()); }
+inline h256 w2h(Word256 const& _w) { h256 r; _w.toBigEndian(r.data()); return r; }
+
+}
+}
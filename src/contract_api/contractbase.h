@@ -105,6 +105,73 @@ struct CHeightTxIndexKey
     }
 };
 
+/**
+ * Key of the log topic index: one entry per topic of every log, ordered so that all entries
+ * of one (contract, topic position, topic) are adjacent and sorted by their place in the chain.
+ */
+struct CLogTopicIndexKey
+{
+    dev::h160 address;
+    uint8_t position;
+    dev::h256 topic;
+    unsigned int height;
+    unsigned int txIndex;
+    unsigned int logIndex;
+
+    size_t GetSerializeSize(int nType, int nVersion) const
+    {
+        return 65;
+    }
+
+    template<typename Stream>
+    void Serialize(Stream &s,int nType, int nVersion) const
+    {
+        s.write((const char *) address.data(), dev::h160::size);
+        s.write((const char *) &position, 1);
+        s.write((const char *) topic.data(), dev::h256::size);
+        ser_writedata32be(s, height);
+        ser_writedata32be(s, txIndex);
+        ser_writedata32be(s, logIndex);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream &s,int nType, int nVersion)
+    {
+        s.read((char *) address.data(), dev::h160::size);
+        s.read((char *) &position, 1);
+        s.read((char *) topic.data(), dev::h256::size);
+        height = ser_readdata32be(s);
+        txIndex = ser_readdata32be(s);
+        logIndex = ser_readdata32be(s);
+    }
+
+    CLogTopicIndexKey(dev::h160 _address, uint8_t _position, dev::h256 _topic, unsigned int _height,
+                      unsigned int _txIndex = 0, unsigned int _logIndex = 0)
+    {
+        address = _address;
+        position = _position;
+        topic = _topic;
+        height = _height;
+        txIndex = _txIndex;
+        logIndex = _logIndex;
+    }
+
+    CLogTopicIndexKey()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        address.clear();
+        position = 0;
+        topic.clear();
+        height = 0;
+        txIndex = 0;
+        logIndex = 0;
+    }
+};
+
 #endif 
 
 
@@ -4,19 +4,82 @@
 #include "univalue/include/univalue.h"
 #include "timedata.h"
 #include "contractconfig.h"
+#include "statepruner.h"
+#include "statedump.h"
 #include "main.h"
 #include "libdevcore/Common.h"
 #include "libdevcore/Log.h"
+#include "libevm/VMFactory.h"
+#include "libevm/VMProfile.h"
+#include "libevm/VMTrace.h"
 
 #include <fstream>
+#include <list>
 #include <boost/filesystem.hpp>
 
 static std::unique_ptr<TesraState> globalState;
 static std::shared_ptr<dev::eth::SealEngineFace> globalSealEngine;
 static StorageResults *pstorageresult = NULL;
 static bool fRecordLogOpcodes = false;
-static bool fIsVMlogFile = false;
 static bool fGettingValuesDGP = false;
+static unsigned nContractExecThreads = DEFAULT_CONTRACT_EXEC_THREADS;
+static bool fContractDeferCommit = DEFAULT_CONTRACT_DEFER_COMMIT;
+static bool fContractSnapshot = DEFAULT_CONTRACT_SNAPSHOT;
+static std::unique_ptr<StatePruner> pstatepruner;
+
+// Read-only views of past states lent out by GetStateAt, most recently used first. A view keeps
+// the accounts it decoded, so repeated queries at the same block skip most of the trie walk.
+class StateViewCache
+{
+public:
+    void setMaxViews(size_t _maxViews)
+    {
+        LOCK(cs);
+        nMaxViews = _maxViews;
+        shrink();
+    }
+
+    std::unique_ptr<TesraState> take(uint256 const &hashBlock)
+    {
+        LOCK(cs);
+        for (auto it = views.begin(); it != views.end(); ++it)
+        {
+            if (it->first == hashBlock)
+            {
+                std::unique_ptr<TesraState> view = std::move(it->second);
+                views.erase(it);
+                return view;
+            }
+        }
+        return std::unique_ptr<TesraState>();
+    }
+
+    void give(uint256 const &hashBlock, std::unique_ptr<TesraState> view)
+    {
+        LOCK(cs);
+        views.emplace_front(hashBlock, std::move(view));
+        shrink();
+    }
+
+    void clear()
+    {
+        LOCK(cs);
+        views.clear();
+    }
+
+private:
+    void shrink()
+    {
+        while (views.size() > nMaxViews)
+            views.pop_back();
+    }
+
+    CCriticalSection cs;
+    size_t nMaxViews = DEFAULT_STATE_VIEW_CACHE;
+    std::list<std::pair<uint256, std::unique_ptr<TesraState>>> views;
+};
+
+static StateViewCache stateViews;
 
 
 
@@ -31,6 +94,23 @@ bool CheckMinGasPrice(std::vector<EthTransactionParams> &etps, const uint64_t &m
     return true;
 }
 
+static valtype SenderFromScript(const CScript &script)
+{
+    CTxDestination addressBit;
+    txnouttype txType = TX_NONSTANDARD;
+    if (ExtractDestination(script, addressBit, &txType))
+    {
+        if ((txType == TX_PUBKEY || txType == TX_PUBKEYHASH) &&
+                addressBit.type() == typeid(CKeyID))
+        {
+            CKeyID senderAddress(boost::get<CKeyID>(addressBit));
+            return valtype(senderAddress.begin(), senderAddress.end());
+        }
+    }
+    
+    return valtype();
+}
+
 valtype
 GetSenderAddress(const CTransaction &tx, const CCoinsViewCache *coinsView, const std::vector<CTransaction> *blockTxs)
 {
@@ -40,36 +120,27 @@ GetSenderAddress(const CTransaction &tx, const CCoinsViewCache *coinsView, const
     
     if (blockTxs)
     {
-        LogPrintf("tx vin size %d\n", tx.vin.size());
-        if (tx.vin.size() > 0)
-            LogPrintf("tx vin[0] hash %s, n %d", tx.vin[0].prevout.hash.GetHex().c_str(),
-                    tx.vin[0].prevout.n);
-        
-        LogPrintf("vtx size is %d\n\n", blockTxs->size());
-        for (auto btx : *blockTxs)
+        for (const CTransaction &btx : *blockTxs)
         {
-            LogPrintf("vtx vin size: %d, vout size %d\n", btx.vin.size(), btx.vout.size());
-            LogPrintf("vtx vin[0] hash %s\n", btx.GetHash().GetHex().c_str());
             if (btx.GetHash() == tx.vin[0].prevout.hash)
-            {LogPrintf("Find match");
+            {
                 script = btx.vout[tx.vin[0].prevout.n].scriptPubKey;
                 scriptFilled = true;
                 break;
-            }LogPrintf("Not match");
+            }
         }
-    }LogPrintf("GetSenderAddress, scriptFilled: %d, coinsView %d\n", scriptFilled, NULL == coinsView);
+    }
     if (!scriptFilled && coinsView)
     {
         
         script = coinsView->AccessCoins(tx.vin[0].prevout.hash)->vout[tx.vin[0].prevout.n].scriptPubKey;
         scriptFilled = true;
-    }LogPrintf("GetSenderAddress, script: %s\n", script.ToString().c_str());
+    }
     if (!scriptFilled)
     {
 
         CTransaction txPrevout;
         uint256 hashBlock;
-        LogPrintf("before GetTransaction\n");
         if (GetTransaction(tx.vin[0].prevout.hash, txPrevout, hashBlock, true))
         {
             script = txPrevout.vout[tx.vin[0].prevout.n].scriptPubKey;
@@ -80,122 +151,68 @@ GetSenderAddress(const CTransaction &tx, const CCoinsViewCache *coinsView, const
                      tx.vin[0].prevout.hash.ToString().c_str());
             return valtype();
         }
-    }LogPrintf("before ExtractDestination\n");
+    }
 
-    CTxDestination addressBit;
-    txnouttype txType = TX_NONSTANDARD;
-    if (ExtractDestination(script, addressBit, &txType))
-    {
-        LogPrintf(" ExtractDestination done\n");
-        if ((txType == TX_PUBKEY || txType == TX_PUBKEYHASH) &&
-                addressBit.type() == typeid(CKeyID))
-        {
-            CKeyID senderAddress(boost::get<CKeyID>(addressBit));
-            return valtype(senderAddress.begin(), senderAddress.end());
-        }
-    }LogPrintf(" return type 0\n");
-    
-    return valtype();
+    return SenderFromScript(script);
 }
 
-
-UniValue vmLogToJSON(const ResultExecute &execRes, const CTransaction &tx, const CBlock &block)
+ContractBlockPrepass::ContractBlockPrepass(const CBlock &_block, const CCoinsViewCache *view) : block(_block)
 {
-    UniValue result(UniValue::VOBJ);
-
-
-    int height = chainActive.Tip()->nHeight;
-
-    if (tx != CTransaction())
-        result.push_back(Pair("txid", tx.GetHash().GetHex()));
-    result.push_back(Pair("address", execRes.execRes.newAddress.hex()));
-    if (block.GetHash() != CBlock().GetHash())
-    {
-        result.push_back(Pair("time", block.GetBlockTime()));
-        result.push_back(Pair("blockhash", block.GetHash().GetHex()));
-        result.push_back(Pair("blockheight", height + 1));
-
-    } else
-    {
-        result.push_back(Pair("time", GetAdjustedTime()));
-        result.push_back(Pair("blockheight", height));
-    }
-    UniValue logEntries(UniValue::VARR);
-    dev::eth::LogEntries logs = execRes.txRec.log();
-    for (dev::eth::LogEntry log : logs)
+    txIndex.reserve(block.vtx.size());
+    for (uint32_t i = 0; i < block.vtx.size(); i++)
     {
-        UniValue logEntrie(UniValue::VOBJ);
-        logEntrie.push_back(Pair("address", log.address.hex()));
-        UniValue topics(UniValue::VARR);
-        for (dev::h256 l : log.topics)
-        {
-            UniValue topicPair(UniValue::VOBJ);
-            topicPair.push_back(Pair("raw", l.hex()));
-            topics.push_back(topicPair);
-            
-        }
-        UniValue dataPair(UniValue::VOBJ);
-        dataPair.push_back(Pair("raw", HexStr(log.data)));
-        logEntrie.push_back(Pair("data", dataPair));
-        logEntrie.push_back(Pair("topics", topics));
-        logEntries.push_back(logEntrie);
+        txIndex[block.vtx[i].GetHash()] = i;
     }
-    result.push_back(Pair("entries", logEntries));
-    return result;
-}
 
-void writeVMlog(const std::vector<ResultExecute> &res, const CTransaction &tx = CTransaction(),
-                const CBlock &block = CBlock())
-{
-    boost::filesystem::path tesraDir = GetDataDir() / "vmExecLogs.json";
-    std::stringstream ss;
-    if (fIsVMlogFile)
+    for (const CTransaction &tx : block.vtx)
     {
-        ss << ",";
-    } else
-    {
-        std::ofstream file(tesraDir.string(), std::ios::out | std::ios::app);
-        file << "{\"logs\":[]}";
-        file.close();
-    }
+        if (!tx.HasCreateOrCall() || tx.IsCoinBase() || tx.vin.empty())
+            continue;
 
-    for (size_t i = 0; i < res.size(); i++)
-    {
-        ss << vmLogToJSON(res[i], tx, block).write();
-        if (i != res.size() - 1)
+        const COutPoint &prevout = tx.vin[0].prevout;
+        const CTransaction *prevTx = findTransaction(prevout.hash);
+        if (prevTx)
         {
-            ss << ",";
-        } else
+            if (prevout.n < prevTx->vout.size())
+                senders[tx.GetHash()] = SenderFromScript(prevTx->vout[prevout.n].scriptPubKey);
+            continue;
+        }
+
+        const CCoins *coins = view ? view->AccessCoins(prevout.hash) : NULL;
+        if (coins && coins->IsAvailable(prevout.n))
         {
-            ss << "]}";
+            senders[tx.GetHash()] = SenderFromScript(coins->vout[prevout.n].scriptPubKey);
         }
     }
+}
 
-    std::ofstream file(tesraDir.string(), std::ios::in | std::ios::out);
-    file.seekp(-2, std::ios::end);
-    file << ss.str();
-    file.close();
-    fIsVMlogFile = true;
+const CTransaction *ContractBlockPrepass::findTransaction(const uint256 &hash) const
+{
+    auto it = txIndex.find(hash);
+    return it == txIndex.end() ? NULL : &block.vtx[it->second];
 }
 
+bool ContractBlockPrepass::getSender(const uint256 &txid, valtype &sender) const
+{
+    auto it = senders.find(txid);
+    if (it == senders.end())
+        return false;
+    sender = it->second;
+    return true;
+}
 
 
-std::vector<ResultExecute> CallContract(const dev::Address &addrContract, std::vector<unsigned char> opcode,
-                                        const dev::Address &sender = dev::Address(), uint64_t gasLimit = 0)
+// Builds the block a call is executed in on top of pTip, the caller holds cs_main.
+static TesraTransaction PrepareCall(CBlock &block, uint64_t &blockGasLimit, CBlockIndex *pTip, const dev::Address &addrContract,
+                                    std::vector<unsigned char> const &opcode, const dev::Address &sender, uint64_t gasLimit)
 {
-    CBlock block;
     CMutableTransaction tx;
 
-    CBlockIndex *pTip = chainActive.Tip();
-
-    CBlockIndex *pblockindex = mapBlockIndex[pTip->GetBlockHash()];
-
-    ReadBlockFromDisk(block, pblockindex);
+    ReadBlockFromDisk(block, pTip);
     block.nTime = GetAdjustedTime();
     block.vtx.erase(block.vtx.begin() + 1, block.vtx.end());
 
-    TesraDGP tesraDGP(globalState.get(), fGettingValuesDGP);
-    uint64_t blockGasLimit = tesraDGP.getBlockGasLimit(pTip->nHeight + 1);
+    blockGasLimit = TesraDGPCache::instance().get(globalState.get(), fGettingValuesDGP, pTip->nHeight + 1).blockGasLimit;
 
     if (gasLimit == 0)
     {
@@ -210,14 +227,268 @@ std::vector<ResultExecute> CallContract(const dev::Address &addrContract, std::v
     TesraTransaction callTransaction(0, 1, dev::u256(gasLimit), addrContract, opcode, dev::u256(0));
     callTransaction.forceSender(senderAddress);
     callTransaction.setVersion(VersionVM::GetEVMDefault());
+    return callTransaction;
+}
 
+std::vector<ResultExecute> CallContract(const dev::Address &addrContract, std::vector<unsigned char> opcode,
+                                        const dev::Address &sender = dev::Address(), uint64_t gasLimit = 0)
+{
+    CBlock block;
+    uint64_t blockGasLimit = 0;
+    TesraTransaction callTransaction = PrepareCall(block, blockGasLimit, chainActive.Tip(), addrContract, opcode, sender, gasLimit);
 
-    ByteCodeExec exec(block, std::vector<TesraTransaction>(1, callTransaction), blockGasLimit);
+    BlockExecContext execContext(block, 0, blockGasLimit);
+    ByteCodeExec exec(execContext, std::vector<TesraTransaction>(1, callTransaction), blockGasLimit);
     exec.performByteCode(dev::eth::Permanence::Reverted);
     return exec.getResult();
 }
 
+std::vector<ResultExecute> CallContractReadOnly(const dev::Address &addrContract, std::vector<unsigned char> opcode,
+                                                const dev::Address &sender, uint64_t gasLimit, int nHeight)
+{
+    CBlock block;
+    uint64_t blockGasLimit = 0;
+    TesraTransaction callTransaction;
+    std::unique_ptr<BlockExecContext> execContext;
+    std::shared_ptr<TesraState> view;
+    int nTipHeight = -1;
+    if (nHeight >= 0)
+    {
+        string errinfo;
+        view = GetStateAt(nHeight, errinfo);
+        if (!view)
+            return std::vector<ResultExecute>();
+    }
+    {
+        LOCK(cs_main);
+        CBlockIndex *pTip = nHeight >= 0 ? chainActive[nHeight] : chainActive.Tip();
+        if (!pTip)
+            return std::vector<ResultExecute>();
+        nTipHeight = pTip->nHeight;
+        callTransaction = PrepareCall(block, blockGasLimit, pTip, addrContract, opcode, sender, gasLimit);
+        execContext.reset(new BlockExecContext(block, nHeight >= 0 ? pTip->nHeight + 1 : 0, blockGasLimit));
+        if (!view)
+            view.reset(new TesraState(*globalState, globalState->rootHash(), globalState->rootHashUTXO()));
+    }
+
+    // TESRAINFO takes cs_main for its own reads, blocks connected meanwhile stay out of sight
+    ChainDataHeight chainData(nTipHeight);
+    ByteCodeExec exec(*execContext, std::vector<TesraTransaction>(1, callTransaction), blockGasLimit, view.get());
+    exec.performByteCode(dev::eth::Permanence::Reverted);
+    return exec.getResult();
+}
+
+std::shared_ptr<TesraState> GetStateAt(int nHeight, string &errinfo)
+{
+    uint256 hashBlock;
+    std::unique_ptr<TesraState> view;
+    {
+        LOCK(cs_main);
+        if (nHeight == -1)
+            nHeight = chainActive.Height();
+        if (!globalState || nHeight < 0 || nHeight > chainActive.Height())
+        {
+            errinfo = "Incorrect block number";
+            return std::shared_ptr<TesraState>();
+        }
+        CBlockIndex *pindex = chainActive[nHeight];
+        if (!pindex->IsContractEnabled())
+        {
+            errinfo = "contract not enabled at this height";
+            return std::shared_ptr<TesraState>();
+        }
+        if (pstatepruner && nHeight <= chainActive.Height() - (int)pstatepruner->depth())
+        {
+            errinfo = "state at this height has been pruned";
+            return std::shared_ptr<TesraState>();
+        }
+        hashBlock = pindex->GetBlockHash();
+        view = stateViews.take(hashBlock);
+        if (!view)
+        {
+            CBlock block;
+            uint256 hashStateRoot;
+            uint256 hashUTXORoot;
+            if (!ReadBlockFromDisk(block, pindex))
+            {
+                errinfo = strprintf("ReadBlockFromDisk failed at height %d hash: %s", nHeight, hashBlock.ToString());
+                return std::shared_ptr<TesraState>();
+            }
+            if (block.GetVMState(hashStateRoot, hashUTXORoot) != RET_VM_STATE_OK)
+            {
+                errinfo = "Incorrect GetVMState";
+                return std::shared_ptr<TesraState>();
+            }
+            view.reset(new TesraState(*globalState, uintToh256(hashStateRoot), uintToh256(hashUTXORoot)));
+        }
+    }
+    return std::shared_ptr<TesraState>(view.release(), [hashBlock](TesraState *p) {
+        stateViews.give(hashBlock, std::unique_ptr<TesraState>(p));
+    });
+}
+
+
+
+// Block author of pre-executions. Executing a transaction only credits the author with the gas
+// fees before deleting its account again, so the placeholder is left out of the access set.
+static const dev::Address preExecAuthor = dev::right160(dev::sha3(std::string("tesra pre-execution author")));
+
+// Executes txs on a private view of the state at _root and _rootUTXO, the caller holds cs_main.
+static std::shared_ptr<const ContractPreExec> PreExecute(std::vector<TesraTransaction> const &txs, dev::h256 const &_root,
+                                                         dev::h256 const &_rootUTXO, uint64_t blockGasLimit)
+{
+    CBlock block;
+    CMutableTransaction coinbase;
+    coinbase.vout.push_back(
+                CTxOut(0, CScript() << OP_DUP << OP_HASH160 << preExecAuthor.asBytes() << OP_EQUALVERIFY << OP_CHECKSIG));
+    block.vtx.push_back(CTransaction(coinbase));
+    block.nTime = GetAdjustedTime();
+    block.nBits = chainActive.Tip()->nBits;
+
+    std::shared_ptr<ContractPreExec> preExec = std::make_shared<ContractPreExec>();
+    preExec->stateRoot = _root;
+    preExec->utxoRoot = _rootUTXO;
+    preExec->blockGasLimit = blockGasLimit;
+    preExec->txs = txs;
+
+    TesraState view(*globalState, _root, _rootUTXO);
+    view.setDeferredCommit(true);
+    view.setAccessSet(&preExec->access);
+    BlockExecContext execContext(block, 0, blockGasLimit);
+    ByteCodeExec exec(execContext, txs, blockGasLimit, &view);
+    try
+    {
+        preExec->fValid = exec.performByteCode() && exec.processingResults(preExec->result);
+    }
+    catch (const std::exception &e)
+    {
+        LogPrint("contract", "PreExecute : execution failed, %s\n", e.what());
+        view.setAccessSet(nullptr);
+        return std::shared_ptr<const ContractPreExec>();
+    }
+    view.setAccessSet(nullptr);
+
+    preExec->access.readAccounts.erase(preExecAuthor);
+    preExec->access.writtenAccounts.erase(preExecAuthor);
+    preExec->access.accounts.erase(preExecAuthor);
+    return preExec;
+}
+
+void PreExecuteContractTx(const CTransaction &tx)
+{
+    ContractPreExecCache &cache = ContractPreExecCache::instance();
+    if (!cache.enabled() || !globalState || !chainActive.Tip() || !chainActive.Tip()->IsContractEnabled())
+    {
+        return;
+    }
 
+    TesraTxConverter convert(tx, NULL);
+    ExtractTesraTX extracted;
+    if (!convert.extractionTesraTransactions(extracted))
+    {
+        return;
+    }
+    int64_t nStart = GetTimeMicros();
+    std::shared_ptr<const ContractPreExec> preExec = PreExecute(extracted.first, globalState->rootHash(),
+                                                                globalState->rootHashUTXO(),
+                                                                GetBlockGasLimit(chainActive.Height() + 1));
+    if (preExec)
+    {
+        cache.put(tx.GetHash(), preExec);
+    }
+    LogPrint("bench", "    - Pre-execute contract tx %s: %.2fms\n", tx.GetHash().ToString(),
+             0.001 * (GetTimeMicros() - nStart));
+}
+
+void ForgetPreExecutedTxs(std::vector<CTransaction> const &txs)
+{
+    ContractPreExecCache &cache = ContractPreExecCache::instance();
+    for (const CTransaction &tx : txs)
+    {
+        if (tx.HasCreateOrCall())
+        {
+            cache.erase(tx.GetHash());
+        }
+    }
+}
+
+bool DumpContractState(const std::string &strPath, int nHeight, CContractStateDumpHeader &header, uint64_t &nEntries,
+                       string &errinfo)
+{
+    {
+        LOCK(cs_main);
+        if (nHeight == -1)
+            nHeight = chainActive.Height();
+        if (nHeight < 0 || nHeight > chainActive.Height())
+        {
+            errinfo = "Incorrect block number";
+            return false;
+        }
+        header.nHeight = nHeight;
+        header.hashBlock = chainActive[nHeight]->GetBlockHash();
+    }
+    std::shared_ptr<TesraState> state = GetStateAt(nHeight, errinfo);
+    if (!state)
+    {
+        return false;
+    }
+    header.hashStateRoot = h256Touint(state->rootHash());
+    header.hashUTXORoot = h256Touint(state->rootHashUTXO());
+
+    int64_t nStart = GetTimeMillis();
+    if (!ExportContractState(state->db(), state->dbUtxo(), header, strPath, nEntries, errinfo))
+    {
+        return false;
+    }
+    LogPrintf("DumpContractState: wrote %u nodes of block %d to %s in %dms\n", nEntries, nHeight, strPath,
+              GetTimeMillis() - nStart);
+    return true;
+}
+
+bool LoadContractState(const std::string &strPath, string &errinfo)
+{
+    CContractStateDumpHeader header;
+    if (!ReadContractStateHeader(strPath, header, errinfo))
+    {
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        CBlockIndex *pTip = chainActive.Tip();
+        if (!pTip || pTip->GetBlockHash() != header.hashBlock)
+        {
+            errinfo = strprintf("the contract state dump is of block %d %s, the chain tip must be that block",
+                                header.nHeight, header.hashBlock.ToString());
+            return false;
+        }
+        CBlock block;
+        uint256 hashStateRoot;
+        uint256 hashUTXORoot;
+        if (!ReadBlockFromDisk(block, pTip) || block.GetVMState(hashStateRoot, hashUTXORoot) != RET_VM_STATE_OK ||
+                hashStateRoot != header.hashStateRoot || hashUTXORoot != header.hashUTXORoot)
+        {
+            errinfo = strprintf("the state roots of the contract state dump do not match block %d", header.nHeight);
+            return false;
+        }
+    }
+
+    boost::filesystem::path stateDir = GetDataDir() / CONTRACT_STATE_DIR;
+    const std::string dirTesra(stateDir.string());
+    const dev::h256 hashDB(dev::sha3(dev::rlp("")));
+    dev::OverlayDB state = TesraState::openDB(dirTesra, hashDB, dev::WithExisting::Trust);
+    dev::OverlayDB utxo = TesraState::openDB(dirTesra + "/tesraDB", hashDB, dev::WithExisting::Trust);
+
+    int64_t nStart = GetTimeMillis();
+    uint64_t nEntries = 0;
+    if (!ImportContractState(state, utxo, strPath, nEntries, errinfo))
+    {
+        return false;
+    }
+    LogPrintf("LoadContractState: imported %u nodes of block %d from %s in %dms\n", nEntries, header.nHeight, strPath,
+              GetTimeMillis() - nStart);
+    return true;
+}
 
 bool ComponentInitialize()
 {
@@ -262,7 +533,9 @@ bool ContractInit()
     
     
 
-    pstorageresult = new StorageResults(stateDir.string());
+    pstorageresult = new StorageResults(stateDir.string(), std::max<int64_t>(0, GetArg("-receiptcache", DEFAULT_RECEIPT_CACHE)) << 20,
+                                        GetBoolArg("-receiptcompression", DEFAULT_RECEIPT_COMPRESSION));
+    stateViews.setMaxViews(std::max<int64_t>(0, GetArg("-stateviewcache", DEFAULT_STATE_VIEW_CACHE)));
 
 
     bool IsEnabled =  [&]()->bool{
@@ -308,13 +581,71 @@ bool ContractInit()
     globalState->dbUtxo().commit();
 
     fRecordLogOpcodes = GetBoolArg("-record-log-opcodes", false);
-    fIsVMlogFile = boost::filesystem::exists(GetDataDir() / "vmExecLogs.json");
+    if (fRecordLogOpcodes)
+    {
+        uint64_t nTraceMaxSize = uint64_t(std::max<int64_t>(0, GetArg("-vmtracemaxsize", DEFAULT_VM_TRACE_MAX_SIZE))) << 20;
+        if (!dev::eth::VMTracer::instance().start((GetDataDir() / "vmExecTrace.bin").string(), nTraceMaxSize))
+        {
+            LogPrintf("ContractInit: cannot open vmExecTrace.bin, VM tracing is off\n");
+        }
+    }
+    dev::eth::CodeAnalysisCache::instance().setMaxMemory(std::max<int64_t>(0, GetArg("-evmanalysiscache", DEFAULT_EVM_ANALYSIS_CACHE)) << 20);
+    dev::TrieNodeCache::instance().setMaxMemory(std::max<int64_t>(0, GetArg("-trienodecache", DEFAULT_TRIE_NODE_CACHE)) << 20);
+    dev::eth::CodeCache::instance().setMaxMemory(std::max<int64_t>(0, GetArg("-evmcodecache", DEFAULT_EVM_CODE_CACHE)) << 20);
+    ContractPreExecCache::instance().setMaxEntries(std::max<int64_t>(0, GetArg("-contractpreexec", DEFAULT_CONTRACT_PREEXEC_CACHE)));
+
+    dev::eth::VMProfiler::instance().setEnabled(GetBoolArg("-vmprofile", DEFAULT_VM_PROFILE));
+    nContractExecThreads = std::max<int64_t>(0, std::min<int64_t>(GetArg("-contractexecthreads", DEFAULT_CONTRACT_EXEC_THREADS),
+                                                                   MAX_CONTRACT_EXEC_THREADS));
+    fContractDeferCommit = GetBoolArg("-contractdefercommit", DEFAULT_CONTRACT_DEFER_COMMIT);
+    fContractSnapshot = GetBoolArg("-contractsnapshot", DEFAULT_CONTRACT_SNAPSHOT);
+    if (fContractSnapshot)
+    {
+        globalState->setSnapshot(dev::eth::StateSnapshot::open((stateDir / "snapshot").string()));
+        if (globalState->snapshot()->root() != globalState->rootHash())
+        {
+            LogPrintf("ContractInit: state snapshot is not at the tip, it is rebuilt with the next block\n");
+        }
+    }
+
+    std::string strVMKind = GetArg("-vm", DEFAULT_VM_KIND);
+    if (strVMKind == "threaded")
+        dev::eth::VMFactory::setKind(dev::eth::VMKind::Threaded);
+    else if (strVMKind != "interpreter")
+        LogPrintf("ContractInit: unknown -vm=%s, using interpreter\n", strVMKind);
 
     if (!fLogEvents)
     {
         pstorageresult->wipeResults();
     }
 
+    int64_t nPruneDepth = GetArg("-prunestate", DEFAULT_PRUNE_STATE);
+    if (nPruneDepth > 0)
+    {
+        nPruneDepth = std::max<int64_t>(nPruneDepth, MIN_PRUNE_STATE_DEPTH);
+        pstatepruner.reset(new StatePruner(globalState->db(), globalState->dbUtxo(), cs_main, nPruneDepth, nPruneDepth));
+
+        // Keep the roots of the blocks already in the window, they are needed to disconnect them
+        std::vector<CBlockIndex *> vWindow;
+        for (CBlockIndex *pindex = chainActive.Tip(); pindex && pindex->IsContractEnabled() &&
+                pindex->nHeight > chainActive.Height() - nPruneDepth; pindex = pindex->pprev)
+        {
+            vWindow.push_back(pindex);
+        }
+        for (auto it = vWindow.rbegin(); it != vWindow.rend(); ++it)
+        {
+            CBlock block;
+            uint256 hashStateRoot;
+            uint256 hashUTXORoot;
+            if (ReadBlockFromDisk(block, *it) && block.GetVMState(hashStateRoot, hashUTXORoot) == RET_VM_STATE_OK)
+            {
+                pstatepruner->keep((*it)->nHeight, uintToh256(hashStateRoot), uintToh256(hashUTXORoot));
+            }
+        }
+        pstatepruner->start();
+        LogPrintf("ContractInit: pruning contract state, keeping the last %d blocks\n", nPruneDepth);
+    }
+
     return true;
 }
 
@@ -330,8 +661,16 @@ bool ComponentShutdown()
 {
     LogPrintStr("shutdown CContract component");
 
+    if (pstatepruner)
+    {
+        pstatepruner->stop();
+        pstatepruner.reset();
+    }
     delete pstorageresult;
     pstorageresult = NULL;
+    stateViews.clear();
+    ContractPreExecCache::instance().clear();
+    dev::eth::VMTracer::instance().stop();
     delete globalState.release();
     
     return true;
@@ -351,9 +690,7 @@ uint64_t GetMinGasPrice(int height)
         return 0;
     }
 
-    TesraDGP tesraDGP(globalState.get(), fGettingValuesDGP);
-    
-    minGasPrice = tesraDGP.getMinGasPrice(height);
+    minGasPrice = TesraDGPCache::instance().get(globalState.get(), fGettingValuesDGP, height).minGasPrice;
 
     return minGasPrice;
 }
@@ -372,9 +709,7 @@ uint64_t GetBlockGasLimit(int height)
         return 0;
     }
 
-    TesraDGP tesraDGP(globalState.get(), fGettingValuesDGP);
-    
-    blockGasLimit = tesraDGP.getBlockGasLimit(height);
+    blockGasLimit = TesraDGPCache::instance().get(globalState.get(), fGettingValuesDGP, height).blockGasLimit;
 
     return blockGasLimit;
 }
@@ -393,14 +728,12 @@ uint32_t GetBlockSize(int height)
         return 0;
     }
 
-    TesraDGP tesraDGP(globalState.get(), fGettingValuesDGP);
-    
-    blockSize = tesraDGP.getBlockSize(height);
+    blockSize = TesraDGPCache::instance().get(globalState.get(), fGettingValuesDGP, height).blockSize;
 
     return blockSize;
 }
 
-bool AddressInUse(string contractaddress)
+bool AddressInUse(string contractaddress, TesraState *state)
 {
     
     bool IsEnabled =  [&]()->bool{
@@ -413,7 +746,7 @@ bool AddressInUse(string contractaddress)
         return false;
     }
     dev::Address addrAccount(contractaddress);
-    return globalState->addressInUse(addrAccount);
+    return (state ? state : globalState.get())->addressInUse(addrAccount);
 }
 
 bool CheckContractTx(const CTransaction tx,CAmount &nFees,
@@ -574,6 +907,7 @@ bool CheckContractTx(const CTransaction tx,CAmount &nFees,
 }
 
 bool RunContractTx(CTransaction tx, CCoinsViewCache *v, CBlock *pblock,
+                   BlockExecContext &execContext,
                    uint64_t minGasPrice,
                    uint64_t hardBlockGasLimit,
                    uint64_t softBlockGasLimit,
@@ -624,7 +958,7 @@ bool RunContractTx(CTransaction tx, CCoinsViewCache *v, CBlock *pblock,
         }
     }
     
-    ByteCodeExec exec(*pblock, tesraTransactions, hardBlockGasLimit);
+    ByteCodeExec exec(execContext, tesraTransactions, hardBlockGasLimit);
     if (!exec.performByteCode())
     {
         
@@ -740,24 +1074,18 @@ string GetExceptedInfo(uint32_t index)
         return "";
     }
 }
-extern UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails);
-
 bool ContractTxConnectBlock(CTransaction tx, uint32_t transactionIndex, CCoinsViewCache *v,
                             const CBlock &block,
-                            int nHeight,
+                            int nHeight, BlockExecContext &execContext,
+                            const ContractBlockPrepass &prepass,
                             ByteCodeExecResult &bcer,
                             bool bLogEvents,
                             bool fJustCheck,
                             std::map<dev::Address, std::pair<CHeightTxIndexKey, std::vector<uint256>>> &heightIndexes,
+                            dev::eth::LogBloom &blockBloom,
+                            std::vector<std::pair<CLogTopicIndexKey, uint256>> &topicIndexes,
                             int &level, string &errinfo,uint64_t &countCumulativeGasUsed,uint64_t &blockGasUsed)
 {
-    CBlockIndex* pblockindex = chainActive.Tip();
-
-    UniValue blockJson = blockToJSON(block, pblockindex, true);
-
-    
-    
-
     if (!block.IsContractEnabled())
     {
         return false;
@@ -769,7 +1097,7 @@ bool ContractTxConnectBlock(CTransaction tx, uint32_t transactionIndex, CCoinsVi
     
     
 
-    TesraTxConverter convert(tx, v, &block.vtx);
+    TesraTxConverter convert(tx, v, &block.vtx, &prepass);
 
     ExtractTesraTX resultConvertQtumTX;
     
@@ -789,7 +1117,7 @@ bool ContractTxConnectBlock(CTransaction tx, uint32_t transactionIndex, CCoinsVi
 
     dev::u256 gasAllTxs = dev::u256(0);
     LogPrintf("ContractTxConnectBlock() : before ByteCodeExec\n");
-    ByteCodeExec exec(block, resultConvertQtumTX.first, blockGasLimit);
+    ByteCodeExec exec(execContext, resultConvertQtumTX.first, blockGasLimit);
     LogPrintf("ContractTxConnectBlock() : after ByteCodeExec\n");
     
     
@@ -894,7 +1222,7 @@ bool ContractTxConnectBlock(CTransaction tx, uint32_t transactionIndex, CCoinsVi
     }
 
     LogPrintf("ContractTxConnectBlock() : before exec.performByteCode\n");
-    if (!exec.performByteCode(dev::eth::Permanence::Committed,nHeight))
+    if (!exec.performByteCode(dev::eth::Permanence::Committed))
     {LogPrintf("ContractTxConnectBlock() : after exec.performByteCode fail\n");
         level = 100;
         errinfo = "bad-tx-unknown-error";
@@ -913,6 +1241,7 @@ bool ContractTxConnectBlock(CTransaction tx, uint32_t transactionIndex, CCoinsVi
     std::vector<TransactionReceiptInfo> tri;
     if (bLogEvents)
     {
+        uint32_t logIndex = 0;
         for (size_t k = 0; k < resultConvertQtumTX.first.size(); k++)
         {
             dev::Address key = resultExec[k].execRes.newAddress;
@@ -921,6 +1250,24 @@ bool ContractTxConnectBlock(CTransaction tx, uint32_t transactionIndex, CCoinsVi
                 heightIndexes[key].first = CHeightTxIndexKey(nHeight, resultExec[k].execRes.newAddress);
             }
             heightIndexes[key].second.push_back(tx.GetHash());
+            if (!resultExec[k].txRec.log().empty())
+            {
+                blockBloom.shiftBloom<3>(dev::sha3(key.ref()));
+                blockBloom |= resultExec[k].txRec.bloom();
+            }
+            if (fLogTopicIndex)
+            {
+                for (const dev::eth::LogEntry &log : resultExec[k].txRec.log())
+                {
+                    for (size_t i = 0; i < log.topics.size() && i <= 0xff; i++)
+                    {
+                        topicIndexes.push_back(std::make_pair(
+                                CLogTopicIndexKey(log.address, uint8_t(i), log.topics[i], nHeight, transactionIndex, logIndex),
+                                tx.GetHash()));
+                    }
+                    logIndex++;
+                }
+            }
             uint32_t excepted = GetExcepted(resultExec[k].execRes.excepted);
             tri.push_back(
                         TransactionReceiptInfo{block.GetHash(), uint32_t(nHeight), tx.GetHash(), uint32_t(transactionIndex),
@@ -941,11 +1288,6 @@ bool ContractTxConnectBlock(CTransaction tx, uint32_t transactionIndex, CCoinsVi
         return false;
     }
 
-    
-    if (fRecordLogOpcodes && !fJustCheck)
-    {
-        writeVMlog(resultExec, tx, block);
-    }
 
     for (ResultExecute &re: resultExec)
     {
@@ -995,6 +1337,29 @@ void UpdateState(uint256 hashStateRoot, uint256 hashUTXORoot)
     globalState->setRootUTXO(uintToh256(hashUTXORoot));
 }
 
+void RevertStateSnapshot()
+{
+    std::shared_ptr<dev::eth::StateSnapshot> snapshot = globalState->snapshot();
+    if (!snapshot || snapshot->root() == globalState->rootHash())
+    {
+        return;
+    }
+    if (!snapshot->revert(globalState->rootHash()))
+    {
+        LogPrintf("RevertStateSnapshot: no undo data back to %s, the snapshot is rebuilt with the next block\n",
+                  globalState->rootHash().hex());
+    }
+}
+
+void KeepStateRoots(int nHeight)
+{
+    if (!pstatepruner)
+    {
+        return;
+    }
+    pstatepruner->keep(nHeight, globalState->rootHash(), globalState->rootHashUTXO());
+}
+
 void DeleteResults(std::vector<CTransaction> const &txs)
 {
     bool IsEnabled =  [&]()->bool{
@@ -1051,7 +1416,7 @@ void ClearCacheResult()
     pstorageresult->clearCacheResult();
 }
 
-std::map<dev::h256, std::pair<dev::u256, dev::u256>> GetStorageByAddress(string address)
+std::map<dev::h256, std::pair<dev::u256, dev::u256>> GetStorageByAddress(string address, TesraState *state)
 {
     bool IsEnabled =  [&]()->bool{
 
@@ -1064,13 +1429,12 @@ std::map<dev::h256, std::pair<dev::u256, dev::u256>> GetStorageByAddress(string
     }
 
     dev::Address addrAccount(address);
-    auto storage(globalState->storage(addrAccount));
+    auto storage((state ? state : globalState.get())->storage(addrAccount));
     return storage;
 };
 
-void SetTemporaryState(uint256 hashStateRoot, uint256 hashUTXORoot)
+std::unordered_map<dev::h160, dev::u256> GetContractList()
 {
-
     bool IsEnabled =  [&]()->bool{
 
             if(chainActive.Tip()== nullptr) return false;
@@ -1078,18 +1442,15 @@ void SetTemporaryState(uint256 hashStateRoot, uint256 hashUTXORoot)
 }();
     if (!IsEnabled)
     {
-        return;
-    }
-    if (hashStateRoot.IsNull() || hashUTXORoot.IsNull())
-    {
-        return;
+        return std::unordered_map<dev::h160, dev::u256>();
     }
-    TemporaryState ts(globalState);
-    ts.SetRoot(uintToh256(hashStateRoot), uintToh256(hashUTXORoot));
-}
+    auto map = globalState->addresses();
+    return map;
+};
 
-std::unordered_map<dev::h160, dev::u256> GetContractList()
+std::vector<std::pair<dev::h160, dev::u256>> GetContractList(dev::h256 const &from, size_t max, dev::h256 &next)
 {
+    next = dev::h256();
     bool IsEnabled =  [&]()->bool{
 
             if(chainActive.Tip()== nullptr) return false;
@@ -1097,14 +1458,13 @@ std::unordered_map<dev::h160, dev::u256> GetContractList()
 }();
     if (!IsEnabled)
     {
-        return std::unordered_map<dev::h160, dev::u256>();
+        return std::vector<std::pair<dev::h160, dev::u256>>();
     }
-    auto map = globalState->addresses();
-    return map;
-};
+    return globalState->addresses(from, max, next);
+}
 
 
-CAmount GetContractBalance(dev::h160 address)
+CAmount GetContractBalance(dev::h160 address, TesraState *state)
 {
     bool IsEnabled =  [&]()->bool{
 
@@ -1115,10 +1475,10 @@ CAmount GetContractBalance(dev::h160 address)
     {
         return CAmount(0);
     }
-    return CAmount(globalState->balance(address));
+    return CAmount((state ? state : globalState.get())->balance(address));
 }
 
-std::vector<uint8_t> GetContractCode(dev::Address address)
+std::vector<uint8_t> GetContractCode(dev::Address address, TesraState *state)
 {
     bool IsEnabled =  [&]()->bool{
 
@@ -1129,11 +1489,11 @@ std::vector<uint8_t> GetContractCode(dev::Address address)
     {
         return std::vector<uint8_t>();
     }
-    return globalState->code(address);
+    return (state ? state : globalState.get())->code(address);
 }
 
 bool GetContractVin(dev::Address address, dev::h256 &hash, uint32_t &nVout, dev::u256 &value,
-                    uint8_t &alive)
+                    uint8_t &alive, TesraState *state)
 {
     bool ret = false;
     bool IsEnabled =  [&]()->bool{
@@ -1145,7 +1505,7 @@ bool GetContractVin(dev::Address address, dev::h256 &hash, uint32_t &nVout, dev:
     {
         return ret;
     }
-    std::unordered_map<dev::Address, Vin> vins = globalState->vins();
+    std::unordered_map<dev::Address, Vin> vins = (state ? state : globalState.get())->vins();
     if (vins.count(address))
     {
         hash = vins[address].hash;
@@ -1199,10 +1559,10 @@ UniValue transactionReceiptToJSON(const dev::eth::TransactionReceipt &txRec)
 }
 
 void RPCCallContract(UniValue &result, const string addrContract, std::vector<unsigned char> opcode,
-                     string sender, uint64_t gasLimit)
+                     string sender, uint64_t gasLimit, int nHeight)
 {
     bool IsEnabled =  [&]()->bool{
-
+            LOCK(cs_main);
             if(chainActive.Tip()== nullptr) return false;
             return chainActive.Tip()->IsContractEnabled();
 }();
@@ -1214,19 +1574,248 @@ void RPCCallContract(UniValue &result, const string addrContract, std::vector<un
     dev::Address addrAccount(addrContract);
     dev::Address senderAddress(sender);
 
-    std::vector<ResultExecute> execResults = CallContract(addrAccount, opcode, senderAddress, gasLimit);
-    if (fRecordLogOpcodes)
+    std::vector<ResultExecute> execResults = CallContractReadOnly(addrAccount, opcode, senderAddress, gasLimit, nHeight);
+    if (execResults.empty())
     {
-        writeVMlog(execResults);
+        return;
     }
     result.push_back(Pair("executionResult", executionResultToJSON(execResults[0].execRes)));
     result.push_back(Pair("transactionReceipt", transactionReceiptToJSON(execResults[0].txRec)));
 }
 
 
-dev::eth::EnvInfo ByteCodeExec::BuildEVMEnvironment(int nHeight){
+static dev::eth::ChainParams &EVMChainParams()
+{
+    static dev::eth::ChainParams params(dev::eth::genesisInfo(dev::eth::Network::HomesteadTest));
+    return params;
+}
+
+BlockExecContext::BlockExecContext(const CBlock &_block, int nHeight, uint64_t _blockGasLimit) : block(_block),
+                                                                                                    se(EVMChainParams().createSealEngine()),
+                                                                                                    env(BuildEVMEnvironment(nHeight, _blockGasLimit))
+{
+    schedule = &se->evmSchedule(env);
+    se->pinEVMSchedule(schedule);
+}
+
+BlockExecContext::~BlockExecContext()
+{
+    if (fSnapshotStaged)
+    {
+        globalState->snapshot()->discard();
+    }
+    if (fTemplate)
+    {
+        globalState->setKeepChanges(false);
+    }
+    if (fDeferred)
+    {
+        globalState->setDeferredCommit(false);
+    }
+}
+
+void BlockExecContext::deferCommit()
+{
+    if ((fContractDeferCommit || fContractSnapshot) && !fDeferred)
+    {
+        globalState->setDeferredCommit(true);
+        fDeferred = true;
+    }
+}
+
+void BlockExecContext::commitBlock(bool fSnapshot)
+{
+    if (!fDeferred)
+    {
+        return;
+    }
+    int64_t nStart = GetTimeMicros();
+    fSnapshot = fSnapshot && !fTemplate && globalState->snapshot();
+    globalState->commitBlock(fSnapshot);
+    fSnapshotStaged = fSnapshot;
+    LogPrint("bench", "    - Commit contract state: %.2fms\n", 0.001 * (GetTimeMicros() - nStart));
+}
+
+void BlockExecContext::acceptBlock()
+{
+    if (!fSnapshotStaged)
+    {
+        return;
+    }
+    globalState->snapshot()->flush();
+    fSnapshotStaged = false;
+}
+
+void BlockExecContext::startProfile()
+{
+    if (!dev::eth::VMProfiler::instance().enabled() || profile)
+    {
+        return;
+    }
+    profile.reset(new dev::eth::VMProfile());
+    profileScope.reset(new dev::eth::VMProfileScope(profile.get()));
+}
+
+void BlockExecContext::finishProfile()
+{
+    if (!profile)
+    {
+        return;
+    }
+    profileScope.reset();
+    dev::eth::VMProfiler::instance().addBlock(unsigned(env.number()), uintToh256(block.GetHash()), profile->data());
+    profile.reset();
+}
+
+void BlockExecContext::buildTemplate()
+{
+    if (fTemplate)
+    {
+        return;
+    }
+    templateStateRoot = globalState->rootHash();
+    templateUTXORoot = globalState->rootHashUTXO();
+    if (!fDeferred)
+    {
+        globalState->setDeferredCommit(true);
+        fDeferred = true;
+    }
+    globalState->setKeepChanges(true);
+    fTemplate = true;
+}
+
+TesraState::BlockSavepoint BlockExecContext::savepoint() const
+{
+    return globalState->blockSavepoint();
+}
+
+void BlockExecContext::rollback(TesraState::BlockSavepoint const &_savepoint)
+{
+    globalState->rollbackBlock(_savepoint);
+}
+
+void BlockExecContext::finishTemplate(uint256 &hashStateRoot, uint256 &hashUTXORoot)
+{
+    if (!fTemplate)
+    {
+        return;
+    }
+    int64_t nStart = GetTimeMicros();
+    globalState->hashBlock();
+    hashStateRoot = h256Touint(globalState->rootHash());
+    hashUTXORoot = h256Touint(globalState->rootHashUTXO());
+
+    // Nothing else is pending between two blocks: the nodes in the overlays are the template's own
+    // and are dropped, the block is executed again when it is connected.
+    globalState->setKeepChanges(false);
+    globalState->setDeferredCommit(false);
+    globalState->db().rollback();
+    globalState->dbUtxo().rollback();
+    globalState->setRoot(templateStateRoot);
+    globalState->setRootUTXO(templateUTXORoot);
+    fTemplate = false;
+    fDeferred = false;
+    LogPrint("bench", "    - Hash contract state of block template: %.2fms, %u pre-executed contract txs reused\n",
+             0.001 * (GetTimeMicros() - nStart), nPreExecReused);
+    templateWritten.clear();
+    nPreExecReused = 0;
+}
+
+std::shared_ptr<const ContractPreExec> BlockExecContext::preExecuted(const CTransaction &tx,
+                                                                     std::vector<TesraTransaction> const &txs,
+                                                                     uint64_t _blockGasLimit)
+{
+    ContractPreExecCache &cache = ContractPreExecCache::instance();
+    if (!fTemplate || !cache.enabled())
+    {
+        return std::shared_ptr<const ContractPreExec>();
+    }
+
+    std::shared_ptr<const ContractPreExec> preExec = cache.get(tx.GetHash(), templateStateRoot, templateUTXORoot);
+    if (!preExec)
+    {
+        preExec = PreExecute(txs, templateStateRoot, templateUTXORoot, _blockGasLimit);
+        if (!preExec)
+        {
+            return preExec;
+        }
+        cache.put(tx.GetHash(), preExec);
+    }
+
+    if (preExec->blockGasLimit != _blockGasLimit || preExec->access.readBlockInfo || preExec->txs.size() != txs.size())
+    {
+        return std::shared_ptr<const ContractPreExec>();
+    }
+    for (size_t i = 0; i < txs.size(); i++)
+    {
+        if (!ParallelContractExecutor::sameTransaction(preExec->txs[i], txs[i]))
+        {
+            return std::shared_ptr<const ContractPreExec>();
+        }
+    }
+
+    // The real author gets the fees and is deleted like the placeholder, as long as it has no account
+    if (preExec->access.readAccounts.count(env.author()) || globalState->addressInUse(env.author()) ||
+        preExec->access.conflictsWith(templateWritten))
+    {
+        return std::shared_ptr<const ContractPreExec>();
+    }
+    return preExec;
+}
+
+void BlockExecContext::applyPreExecuted(ContractPreExec const &_preExec)
+{
+    globalState->applyAccessSet(_preExec.access);
+    templateWritten.mergeWrites(_preExec.access);
+    nPreExecReused++;
+}
+
+dev::eth::EnvInfo const &BlockExecContext::envInfo(uint64_t _blockGasLimit)
+{
+    if (env.gasLimit() != int64_t(_blockGasLimit))
+    {
+        env.setGasLimit(_blockGasLimit);
+    }
+    return env;
+}
+
+
+void BlockExecContext::speculate(CCoinsViewCache *v, const ContractBlockPrepass &prepass, uint64_t _blockGasLimit)
+{
+    if (nContractExecThreads == 0)
+    {
+        return;
+    }
+
+    std::vector<TesraTransaction> txs;
+    for (const CTransaction &tx : block.vtx)
+    {
+        if (!tx.HasCreateOrCall() || tx.HasOpSpend())
+        {
+            continue;
+        }
+        TesraTxConverter convert(tx, v, &block.vtx, &prepass);
+        ExtractTesraTX extracted;
+        if (convert.extractionTesraTransactions(extracted))
+        {
+            txs.insert(txs.end(), extracted.first.begin(), extracted.first.end());
+        }
+    }
+
+    if (!parallel)
+    {
+        parallel.reset(new ParallelContractExecutor(nContractExecThreads, EVMChainParams()));
+    }
+    int64_t nStart = GetTimeMicros();
+    parallel->speculate(*globalState, envInfo(_blockGasLimit), *schedule, txs);
+    LogPrint("bench", "    - Speculate %u contract txs on %u threads: %.2fms\n", txs.size(), nContractExecThreads,
+             0.001 * (GetTimeMicros() - nStart));
+}
+
+
+dev::eth::EnvInfo BlockExecContext::BuildEVMEnvironment(int nHeight, uint64_t _blockGasLimit){
     dev::eth::EnvInfo env;
-    CBlockIndex* tip = chainActive.Tip();
+    CBlockIndex* tip = nHeight > 0 && chainActive[nHeight - 1] ? chainActive[nHeight - 1] : chainActive.Tip();
     
 
     
@@ -1264,7 +1853,7 @@ dev::eth::EnvInfo ByteCodeExec::BuildEVMEnvironment(int nHeight){
         tip = tip->pprev;
     }
     env.setLastHashes(std::move(lh));
-    env.setGasLimit(blockGasLimit);
+    env.setGasLimit(_blockGasLimit);
 
     if(block.IsProofOfStake()){
         if(block.GetBlockHeader().nVersion < SMART_CONTRACT_VERSION)
@@ -1280,8 +1869,33 @@ dev::eth::EnvInfo ByteCodeExec::BuildEVMEnvironment(int nHeight){
 
 
 
-bool ByteCodeExec::performByteCode(dev::eth::Permanence type, int nHeight)
+// Executes _tx on _state and adds what it wrote to _written.
+static ResultExecute ExecuteRecordingWrites(TesraState &_state, dev::eth::EnvInfo const &_envInfo,
+                                            dev::eth::SealEngineFace const &_sealEngine, TesraTransaction const &_tx,
+                                            TxAccessSet &_written)
 {
+    TxAccessSet access;
+    _state.setAccessSet(&access);
+    try
+    {
+        ResultExecute res = _state.execute(_envInfo, _sealEngine, _tx);
+        _state.setAccessSet(nullptr);
+        _written.mergeWrites(access);
+        return res;
+    }
+    catch (...)
+    {
+        _state.setAccessSet(nullptr);
+        throw;
+    }
+}
+
+bool ByteCodeExec::performByteCode(dev::eth::Permanence type)
+{
+    dev::eth::EnvInfo const &envInfo = context.envInfo(blockGasLimit);
+    dev::eth::SealEngineFace const &se = context.sealEngine();
+    TesraState &target = state ? *state : *globalState;
+
     for (TesraTransaction &tx : txs)
     {
         
@@ -1293,12 +1907,7 @@ bool ByteCodeExec::performByteCode(dev::eth::Permanence type, int nHeight)
         }
         
 
-        dev::eth::EnvInfo envInfo(BuildEVMEnvironment(nHeight));
-
-        std::unique_ptr<dev::eth::SealEngineFace> se(dev::eth::ChainParams(dev::eth::genesisInfo(dev::eth::Network::HomesteadTest)).createSealEngine());
-
-
-        if (!tx.isCreation() && !globalState->addressInUse(tx.receiveAddress()))
+        if (!tx.isCreation() && !target.addressInUse(tx.receiveAddress()))
         {
            
             dev::eth::ExecutionResult execRes;
@@ -1311,16 +1920,24 @@ bool ByteCodeExec::performByteCode(dev::eth::Permanence type, int nHeight)
         
 
         
-
-        ResultExecute res_ = globalState->execute(envInfo, *se.get(), tx, type, OnOpFunc());
+        se.deleteAddresses.clear();
+        ParallelContractExecutor *parallel = type == dev::eth::Permanence::Committed && !state ? context.executor() : NULL;
+        TxAccessSet *written = type == dev::eth::Permanence::Committed && !state ? context.templateWrites() : NULL;
+        ResultExecute res_ = parallel ? parallel->execute(target, envInfo, se, tx)
+                                      : written ? ExecuteRecordingWrites(target, envInfo, se, tx, *written)
+                                                : target.execute(envInfo, se, tx, type, OnOpFunc());
 
 
         
 
         result.push_back(res_);
     }
-    globalState->db().commit();
-    globalState->dbUtxo().commit();
+    // A read-only view never writes to the databases it shares
+    if (!state && !globalState->deferredCommit())
+    {
+        globalState->db().commit();
+        globalState->dbUtxo().commit();
+    }
     
     return true;
 }
@@ -1395,7 +2012,7 @@ bool ByteCodeExec::processingResults(ByteCodeExecResult &resultBCE)
 }
 
 
-dev::Address ByteCodeExec::EthAddrFromScript(const CScript &script)
+dev::Address BlockExecContext::EthAddrFromScript(const CScript &script)
 {
     CTxDestination addressBit;
     txnouttype txType = TX_NONSTANDARD;
@@ -1533,10 +2150,12 @@ TesraTransaction TesraTxConverter::createEthTX(const EthTransactionParams &etp,
         txEth = TesraTransaction(txBit.vout[nOut].nValue, etp.gasPrice, etp.gasLimit, etp.receiveAddress, etp.code,
                                 dev::u256(0));
     }
-    LogPrintStr("createEthTX before GetSenderAddress\n");
-    valtype types = GetSenderAddress(txBit, view, blockTransactions);
-    LogPrintStr("createEthTX after GetSenderAddress, type: \n");
-    dev::Address sender(GetSenderAddress(txBit, view, blockTransactions));
+    valtype senderBytes;
+    if (!prepass || !prepass->getSender(txBit.GetHash(), senderBytes))
+    {
+        senderBytes = GetSenderAddress(txBit, view, blockTransactions);
+    }
+    dev::Address sender(senderBytes);
     txEth.forceSender(sender);
     txEth.setHashWith(uintToh256(txBit.GetHash()));
     txEth.setNVout(nOut);
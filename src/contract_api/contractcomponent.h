@@ -12,12 +12,16 @@
 #include "tesrastate.h"
 #include "tesraDGP.h"
 #include "tesratransaction.h"
+#include "parallelexec.h"
+#include "preexeccache.h"
 #include <libethereum/ChainParams.h>
 #include <libethashseal/Ethash.h>
 #include <libethashseal/GenesisInfo.h>
 #include <script/standard.h>
 #include <serialize.h>
 #include <libethereum/Transaction.h>
+#include <libevm/CodeAnalysis.h>
+#include <libevm/VMProfile.h>
 
 
 #include "contractbase.h"
@@ -48,13 +52,34 @@ struct EthTransactionParams
 using ExtractTesraTX = std::pair<std::vector<TesraTransaction>, std::vector<EthTransactionParams>>;
 
 
+class ContractBlockPrepass
+{
+
+public:
+
+    ContractBlockPrepass(const CBlock &_block, const CCoinsViewCache *view);
+
+    const CTransaction *findTransaction(const uint256 &hash) const;
+
+    bool getSender(const uint256 &txid, valtype &sender) const;
+
+private:
+
+    const CBlock &block;
+    boost::unordered_map<uint256, uint32_t, CCoinsKeyHasher> txIndex;
+    boost::unordered_map<uint256, valtype, CCoinsKeyHasher> senders;
+
+};
+
+
 class TesraTxConverter
 {
 
 public:
 
-    TesraTxConverter(CTransaction tx, CCoinsViewCache *v = NULL, const std::vector<CTransaction> *blockTxs = NULL)
-            : txBit(tx), view(v), blockTransactions(blockTxs)
+    TesraTxConverter(CTransaction tx, CCoinsViewCache *v = NULL, const std::vector<CTransaction> *blockTxs = NULL,
+                     const ContractBlockPrepass *blockPrepass = NULL)
+            : txBit(tx), view(v), blockTransactions(blockTxs), prepass(blockPrepass)
     {
     }
 
@@ -73,6 +98,106 @@ private:
     std::vector<valtype> stack;
     opcodetype opcode;
     const std::vector<CTransaction> *blockTransactions;
+    const ContractBlockPrepass *prepass;
+
+};
+
+
+class BlockExecContext
+{
+
+public:
+
+    BlockExecContext(const CBlock &_block, int nHeight = 0, uint64_t _blockGasLimit = 0);
+
+    ~BlockExecContext();
+
+    dev::eth::SealEngineFace const &sealEngine() const
+    {
+        return *se;
+    }
+
+    dev::eth::EnvInfo const &envInfo(uint64_t _blockGasLimit);
+
+    dev::eth::EVMSchedule const &evmSchedule() const
+    {
+        return *schedule;
+    }
+
+    const CBlock &getBlock() const
+    {
+        return block;
+    }
+
+    // Runs the contract transactions of the block ahead on -contractexecthreads workers, no-op when 0.
+    void speculate(CCoinsViewCache *v, const ContractBlockPrepass &prepass, uint64_t _blockGasLimit);
+
+    ParallelContractExecutor *executor() const
+    {
+        return parallel.get();
+    }
+
+    // Keeps the contract state of the block in memory until commitBlock() when -contractdefercommit or
+    // -contractsnapshot is set.
+    void deferCommit();
+
+    // Writes the contract state of the block. With fSnapshot, outside of a template, the changes are
+    // also staged in the state snapshot; acceptBlock() writes them, they are dropped if it is not called.
+    void commitBlock(bool fSnapshot);
+
+    void acceptBlock();
+
+    // Builds a block template on the in-memory state: a rejected candidate is undone with
+    // rollback() and the databases are never written. finishTemplate() hashes the tries for the
+    // template roots and puts the state back at the parent block.
+    void buildTemplate();
+
+    TesraState::BlockSavepoint savepoint() const;
+
+    void rollback(TesraState::BlockSavepoint const &_savepoint);
+
+    void finishTemplate(uint256 &hashStateRoot, uint256 &hashUTXORoot);
+
+    // The pre-execution of a mempool transaction on the state the template started from, when
+    // applying it is the same as executing txs on the template as it is now. A stale one is
+    // refreshed first. Null outside of a template.
+    std::shared_ptr<const ContractPreExec> preExecuted(const CTransaction &tx, std::vector<TesraTransaction> const &txs,
+                                                       uint64_t _blockGasLimit);
+
+    void applyPreExecuted(ContractPreExec const &_preExec);
+
+    // What the transactions of the template wrote so far, null when nothing uses it.
+    TxAccessSet *templateWrites()
+    {
+        return fTemplate && ContractPreExecCache::instance().enabled() ? &templateWritten : NULL;
+    }
+
+    // Profiles the contract executions of the block, on this thread and the speculation workers, when
+    // -vmprofile is set. finishProfile() adds them to the block profiles of getvmprofile.
+    void startProfile();
+
+    void finishProfile();
+
+private:
+
+    dev::eth::EnvInfo BuildEVMEnvironment(int nHeight, uint64_t _blockGasLimit);
+
+    dev::Address EthAddrFromScript(const CScript &scriptIn);
+
+    const CBlock &block;
+    std::unique_ptr<dev::eth::SealEngineFace> se;
+    dev::eth::EnvInfo env;
+    dev::eth::EVMSchedule const *schedule;
+    std::unique_ptr<ParallelContractExecutor> parallel;
+    bool fDeferred = false;
+    bool fTemplate = false;
+    bool fSnapshotStaged = false;
+    dev::h256 templateStateRoot;
+    dev::h256 templateUTXORoot;
+    TxAccessSet templateWritten;
+    unsigned nPreExecReused = 0;
+    std::unique_ptr<dev::eth::VMProfile> profile;
+    std::unique_ptr<dev::eth::VMProfileScope> profileScope;
 
 };
 
@@ -82,14 +207,16 @@ class ByteCodeExec
 
 public:
 
-    ByteCodeExec(const CBlock &_block, std::vector<TesraTransaction> _txs, const uint64_t _blockGasLimit) : txs(_txs),
-                                                                                                           block(_block),
-                                                                                                           blockGasLimit(
-                                                                                                                   _blockGasLimit)
+    // Runs on _state when given, on the global state otherwise.
+    ByteCodeExec(BlockExecContext &_context, std::vector<TesraTransaction> _txs, const uint64_t _blockGasLimit,
+                 TesraState *_state = NULL) : txs(_txs),
+                                              context(_context),
+                                              blockGasLimit(_blockGasLimit),
+                                              state(_state)
     {
     }
 
-    bool performByteCode(dev::eth::Permanence type = dev::eth::Permanence::Committed,int nHeight = 0);
+    bool performByteCode(dev::eth::Permanence type = dev::eth::Permanence::Committed);
 
     bool processingResults(ByteCodeExecResult &result);
 
@@ -100,17 +227,13 @@ public:
 
 private:
 
-
-    dev::eth::EnvInfo BuildEVMEnvironment(int nHeight);
-
-    dev::Address EthAddrFromScript(const CScript &scriptIn);
-
     std::vector<TesraTransaction> txs;
 
     std::vector<ResultExecute> result;
 
-    const CBlock &block;
+    BlockExecContext &context;
     const uint64_t blockGasLimit;
+    TesraState *state;
 
 };
 
@@ -127,13 +250,14 @@ uint64_t GetMinGasPrice(int height);
 uint64_t GetBlockGasLimit(int height);
 uint32_t GetBlockSize(int height);
 
-bool AddressInUse(string contractaddress);
+bool AddressInUse(string contractaddress, TesraState *state = NULL);
 
 bool CheckContractTx(const CTransaction tx, CAmount &nFees,
                          CAmount &nMinGasPrice, int &level,
                          string &errinfo, const CAmount nAbsurdFee = 0, bool rawTx = false);
 
 bool RunContractTx(CTransaction tx, CCoinsViewCache *v, CBlock *pblock,
+                       BlockExecContext &execContext,
                        uint64_t minGasPrice,
                        uint64_t hardBlockGasLimit,
                        uint64_t softBlockGasLimit,
@@ -142,17 +266,42 @@ bool RunContractTx(CTransaction tx, CCoinsViewCache *v, CBlock *pblock,
                        ByteCodeExecResult &testExecResult);
 
 bool ContractTxConnectBlock(CTransaction tx, uint32_t transactionIndex, CCoinsViewCache *v, const CBlock &block,
-                                int nHeight,
+                                int nHeight, BlockExecContext &execContext,
+                                const ContractBlockPrepass &prepass,
                                 ByteCodeExecResult &bcer,
                                 bool bLogEvents,
                                 bool fJustCheck,
                                 std::map<dev::Address, std::pair<CHeightTxIndexKey, std::vector<uint256>>> &heightIndexes,
+                                dev::eth::LogBloom &blockBloom,
+                                std::vector<std::pair<CLogTopicIndexKey, uint256>> &topicIndexes,
                                 int &level, string &errinfo,uint64_t &countCumulativeGasUsed,uint64_t &blockGasUsed);
 
 void GetState(uint256 &hashStateRoot, uint256 &hashUTXORoot);
 
 void UpdateState(uint256 hashStateRoot, uint256 hashUTXORoot);
 
+// Takes the state snapshot, if any, back to the global state after blocks were disconnected.
+void RevertStateSnapshot();
+
+struct CContractStateDumpHeader;
+
+// Writes the contract state after the block at nHeight (-1 for the tip) to strPath, see ExportContractState.
+bool DumpContractState(const std::string &strPath, int nHeight, CContractStateDumpHeader &header, uint64_t &nEntries,
+                       string &errinfo);
+
+// Imports a dump of the contract state at the chain tip into the state directory, called before ContractInit.
+bool LoadContractState(const std::string &strPath, string &errinfo);
+
+// Hands the state roots of the block just connected at nHeight to the state pruner, if any.
+void KeepStateRoots(int nHeight);
+
+// Executes the contract outputs of a transaction just accepted to the mempool on the tip state and
+// keeps the outcome for block templates, the caller holds cs_main.
+void PreExecuteContractTx(const CTransaction &tx);
+
+// Drops the pre-executions of transactions that left the mempool.
+void ForgetPreExecutedTxs(std::vector<CTransaction> const &txs);
+
 void DeleteResults(std::vector<CTransaction> const &txs);
 
 std::vector<TransactionReceiptInfo> GetResult(uint256 const &hashTx);
@@ -161,19 +310,30 @@ void CommitResults();
 
 void ClearCacheResult();
 
-std::map<dev::h256, std::pair<dev::u256, dev::u256>> GetStorageByAddress(string address);
+std::map<dev::h256, std::pair<dev::u256, dev::u256>> GetStorageByAddress(string address, TesraState *state = NULL);
 
-void SetTemporaryState(uint256 hashStateRoot, uint256 hashUTXORoot);
+// Read-only view of the contract state after the active block at nHeight (-1 for the tip), borrowed from a small
+// LRU and handed back to it when released. Null with errinfo set when there is no such state.
+std::shared_ptr<TesraState> GetStateAt(int nHeight, string &errinfo);
 
 std::unordered_map<dev::h160, dev::u256> GetContractList();
 
-CAmount GetContractBalance(dev::h160 address);
+std::vector<std::pair<dev::h160, dev::u256>> GetContractList(dev::h256 const &from, size_t max, dev::h256 &next);
+
+CAmount GetContractBalance(dev::h160 address, TesraState *state = NULL);
+
+std::vector<uint8_t> GetContractCode(dev::Address address, TesraState *state = NULL);
 
-std::vector<uint8_t> GetContractCode(dev::Address address);
+bool GetContractVin(dev::Address address, dev::h256 &hash, uint32_t &nVout, dev::u256 &value, uint8_t &alive,
+                    TesraState *state = NULL);
 
-bool GetContractVin(dev::Address address, dev::h256 &hash, uint32_t &nVout, dev::u256 &value, uint8_t &alive);
+// Executes a call against a private view of the tip state, or of the state after the block at
+// nHeight when it is not negative. cs_main is only held to set the call up.
+std::vector<ResultExecute> CallContractReadOnly(const dev::Address &addrContract, std::vector<unsigned char> opcode,
+                                                const dev::Address &sender, uint64_t gasLimit, int nHeight = -1);
 
-void RPCCallContract(UniValue &result, const string addrContract, std::vector<unsigned char> opcode, string sender = "", uint64_t gasLimit = 0);
+void RPCCallContract(UniValue &result, const string addrContract, std::vector<unsigned char> opcode, string sender = "", uint64_t gasLimit = 0,
+                     int nHeight = -1);
 
 string GetExceptedInfo(uint32_t index);
 
@@ -26,6 +26,39 @@ static const uint64_t MINIMUM_GAS_LIMIT = 10000;
 
 static const uint64_t MEMPOOL_MIN_GAS_LIMIT = 22000;
 
+
+static const int64_t DEFAULT_EVM_ANALYSIS_CACHE = 32;
+
+static const int64_t DEFAULT_TRIE_NODE_CACHE = 64;
+
+static const int64_t DEFAULT_EVM_CODE_CACHE = 32;
+
+static const char* const DEFAULT_VM_KIND = "interpreter";
+
+static const int64_t DEFAULT_CONTRACT_EXEC_THREADS = 0;
+static const int64_t MAX_CONTRACT_EXEC_THREADS = 16;
+
+static const bool DEFAULT_CONTRACT_DEFER_COMMIT = false;
+
+static const bool DEFAULT_CONTRACT_SNAPSHOT = false;
+
+static const int64_t DEFAULT_CONTRACT_PREEXEC_CACHE = 0;
+
+static const int64_t DEFAULT_VM_TRACE_MAX_SIZE = 1024;
+
+static const bool DEFAULT_VM_PROFILE = false;
+
+static const int64_t DEFAULT_RECEIPT_CACHE = 16;
+
+static const bool DEFAULT_RECEIPT_COMPRESSION = true;
+
+static const bool DEFAULT_LOG_TOPIC_INDEX = false;
+
+static const int64_t DEFAULT_STATE_VIEW_CACHE = 8;
+
+static const int64_t DEFAULT_PRUNE_STATE = 0;
+static const int64_t MIN_PRUNE_STATE_DEPTH = 288;
+
 #define CONTRACT_STATE_DIR "stateContract"
 
 static const uint256 DEFAULT_HASH_STATE_ROOT = uint256S("0x21b463e3b52f6201c0ad6c991be0485b6ef8c092e64583ffa655cc1b171fe856");
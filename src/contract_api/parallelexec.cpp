@@ -0,0 +1,142 @@
+#include "parallelexec.h"
+#include "util.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+ParallelContractExecutor::ParallelContractExecutor(unsigned _threads, dev::eth::ChainParams &_params) : nThreads(_threads),
+                                                                                                      params(_params)
+{
+}
+
+void ParallelContractExecutor::speculate(TesraState const &_base, dev::eth::EnvInfo const &_envInfo,
+                                         dev::eth::EVMSchedule const &_schedule,
+                                         std::vector<TesraTransaction> const &_txs)
+{
+    baseRoot = _base.rootHash();
+    baseRootUTXO = _base.rootHashUTXO();
+    speculations.clear();
+    speculations.resize(_txs.size());
+    index.clear();
+    written.clear();
+    for (size_t i = 0; i < _txs.size(); i++)
+    {
+        index[std::make_pair(_txs[i].getHashWith(), _txs[i].getNVout())] = i;
+        speculations[i].gasLimit = _envInfo.gasLimit();
+        speculations[i].tx = _txs[i];
+    }
+    if (_txs.empty() || nThreads == 0)
+        return;
+
+
+    std::vector<std::unique_ptr<TesraState>> states;
+    std::vector<std::unique_ptr<dev::eth::SealEngineFace>> engines;
+    unsigned workers = std::min<size_t>(nThreads, _txs.size());
+    for (unsigned i = 0; i < workers; i++)
+    {
+        states.emplace_back(new TesraState(_base));
+        engines.emplace_back(params.createSealEngine());
+        engines.back()->pinEVMSchedule(&_schedule);
+    }
+
+    std::atomic<size_t> next(0);
+    boost::thread_group threadGroup;
+    for (unsigned i = 0; i < workers; i++)
+    {
+        threadGroup.create_thread(boost::bind(&ParallelContractExecutor::worker, this, states[i].get(),
+                                              engines[i].get(), &_envInfo, &_txs, &next,
+                                              dev::eth::VMProfileScope::current()));
+    }
+    threadGroup.join_all();
+}
+
+void ParallelContractExecutor::worker(TesraState *_state, dev::eth::SealEngineFace *_sealEngine,
+                                      dev::eth::EnvInfo const *_envInfo, std::vector<TesraTransaction> const *_txs,
+                                      std::atomic<size_t> *_next, dev::eth::VMProfile *_profile)
+{
+    // Speculations count towards the profile of the block like the executions that use them
+    dev::eth::VMProfileScope profileScope(_profile);
+    for (size_t i = (*_next)++; i < _txs->size(); i = (*_next)++)
+    {
+        TesraTransaction const &tx = (*_txs)[i];
+        Speculation &spec = speculations[i];
+
+        _state->setRoot(baseRoot);
+        _state->setRootUTXO(baseRootUTXO);
+        if (tx.getVersion().toRaw() != VersionVM::GetEVMDefault().toRaw() ||
+            (!tx.isCreation() && !_state->addressInUse(tx.receiveAddress())))
+        {
+            continue;
+        }
+
+        _sealEngine->deleteAddresses.clear();
+        _state->setAccessSet(&spec.access);
+        try
+        {
+            // The block holds cs_main while it waits for the workers, chain data is read in block order
+            ChainDataBlocker chainData;
+            spec.result = _state->execute(*_envInfo, *_sealEngine, tx);
+            spec.done = !chainData.reached();
+        }
+        catch (const std::exception &e)
+        {
+            LogPrint("contract", "ParallelContractExecutor::worker : speculation failed, %s\n", e.what());
+        }
+        _state->setAccessSet(nullptr);
+    }
+}
+
+bool ParallelContractExecutor::sameTransaction(TesraTransaction const &_a, TesraTransaction const &_b)
+{
+    return _a.sender() == _b.sender() && _a.isCreation() == _b.isCreation() &&
+           _a.receiveAddress() == _b.receiveAddress() && _a.value() == _b.value() && _a.gas() == _b.gas() &&
+           _a.gasPrice() == _b.gasPrice() && _a.data() == _b.data();
+}
+
+ResultExecute ParallelContractExecutor::execute(TesraState &_state, dev::eth::EnvInfo const &_envInfo,
+                                                dev::eth::SealEngineFace const &_sealEngine,
+                                                TesraTransaction const &_tx)
+{
+    if (speculations.empty())
+    {
+        _sealEngine.deleteAddresses.clear();
+        return _state.execute(_envInfo, _sealEngine, _tx);
+    }
+
+    auto it = index.find(std::make_pair(_tx.getHashWith(), _tx.getNVout()));
+    if (it != index.end())
+    {
+        Speculation &spec = speculations[it->second];
+        if (spec.done && spec.gasLimit == _envInfo.gasLimit() && sameTransaction(spec.tx, _tx) &&
+            !spec.access.conflictsWith(written))
+        {
+            spec.done = false;
+            _state.applyAccessSet(spec.access);
+            written.mergeWrites(spec.access);
+            nReused++;
+
+
+            ResultExecute res = spec.result;
+            res.txRec = dev::eth::TransactionReceipt(_state.rootHash(), spec.result.txRec.gasUsed(),
+                                                     spec.result.txRec.log());
+            return res;
+        }
+    }
+
+    TxAccessSet access;
+    _sealEngine.deleteAddresses.clear();
+    _state.setAccessSet(&access);
+    try
+    {
+        ResultExecute res = _state.execute(_envInfo, _sealEngine, _tx);
+        _state.setAccessSet(nullptr);
+        written.mergeWrites(access);
+        nReexecuted++;
+        return res;
+    }
+    catch (...)
+    {
+        _state.setAccessSet(nullptr);
+        throw;
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef TESRA_PARALLELEXEC_H
+#define TESRA_PARALLELEXEC_H
+
+#include "tesrastate.h"
+
+#include <libethereum/ChainParams.h>
+#include <libevm/VMProfile.h>
+
+#include <atomic>
+#include <map>
+
+/**
+ * Optimistic parallel execution of the contract transactions of one block.
+ *
+ * speculate() runs every transaction on its own copy of the pre-block state, spread over a fixed
+ * number of worker threads, and records what each one read and wrote. execute() is then called
+ * for the transactions in block order: a speculative result is committed as is when none of its
+ * reads were written by an earlier transaction of the block, otherwise the transaction is executed
+ * again on the real state. The committed state is therefore always the one of sequential execution.
+ * Transactions that read chain data through TESRAINFO are always executed again, see ChainDataBlocker.
+ */
+class ParallelContractExecutor
+{
+
+public:
+
+    ParallelContractExecutor(unsigned _threads, dev::eth::ChainParams &_params);
+
+    void speculate(TesraState const &_base, dev::eth::EnvInfo const &_envInfo, dev::eth::EVMSchedule const &_schedule,
+                   std::vector<TesraTransaction> const &_txs);
+
+    ResultExecute execute(TesraState &_state, dev::eth::EnvInfo const &_envInfo,
+                          dev::eth::SealEngineFace const &_sealEngine, TesraTransaction const &_tx);
+
+    unsigned threads() const
+    {
+        return nThreads;
+    }
+
+    uint64_t reused() const
+    {
+        return nReused;
+    }
+
+    uint64_t reexecuted() const
+    {
+        return nReexecuted;
+    }
+
+    static bool sameTransaction(TesraTransaction const &_a, TesraTransaction const &_b);
+
+private:
+
+    struct Speculation
+    {
+        bool done = false;
+        int64_t gasLimit = 0;
+        TesraTransaction tx;
+        ResultExecute result{dev::eth::ExecutionResult(), dev::eth::TransactionReceipt(dev::h256(), dev::u256(),
+                             dev::eth::LogEntries()), CTransaction()};
+        TxAccessSet access;
+    };
+
+    void worker(TesraState *_state, dev::eth::SealEngineFace *_sealEngine, dev::eth::EnvInfo const *_envInfo,
+                std::vector<TesraTransaction> const *_txs, std::atomic<size_t> *_next, dev::eth::VMProfile *_profile);
+
+    unsigned nThreads;
+    dev::eth::ChainParams &params;
+
+    dev::h256 baseRoot;
+    dev::h256 baseRootUTXO;
+    std::vector<Speculation> speculations;
+    std::map<std::pair<dev::h256, uint32_t>, size_t> index;
+    TxAccessSet written;
+
+    uint64_t nReused = 0;
+    uint64_t nReexecuted = 0;
+
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include "preexeccache.h"
+
+ContractPreExecCache &ContractPreExecCache::instance()
+{
+    static ContractPreExecCache cache;
+    return cache;
+}
+
+void ContractPreExecCache::setMaxEntries(size_t _maxEntries)
+{
+    LOCK(cs);
+    nMaxEntries = _maxEntries;
+    shrink();
+}
+
+std::shared_ptr<const ContractPreExec> ContractPreExecCache::get(uint256 const &txid, dev::h256 const &_root,
+                                                                 dev::h256 const &_rootUTXO)
+{
+    LOCK(cs);
+    auto it = index.find(txid);
+    if (it == index.end() || it->second->second->stateRoot != _root || it->second->second->utxoRoot != _rootUTXO)
+    {
+        nMisses++;
+        return std::shared_ptr<const ContractPreExec>();
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    nHits++;
+    return it->second->second;
+}
+
+void ContractPreExecCache::put(uint256 const &txid, std::shared_ptr<const ContractPreExec> const &_entry)
+{
+    LOCK(cs);
+    if (nMaxEntries == 0)
+    {
+        return;
+    }
+    auto it = index.find(txid);
+    if (it != index.end())
+    {
+        entries.erase(it->second);
+    }
+    entries.emplace_front(txid, _entry);
+    index[txid] = entries.begin();
+    shrink();
+}
+
+void ContractPreExecCache::erase(uint256 const &txid)
+{
+    LOCK(cs);
+    auto it = index.find(txid);
+    if (it != index.end())
+    {
+        entries.erase(it->second);
+        index.erase(it);
+    }
+}
+
+void ContractPreExecCache::clear()
+{
+    LOCK(cs);
+    entries.clear();
+    index.clear();
+}
+
+size_t ContractPreExecCache::size() const
+{
+    LOCK(cs);
+    return entries.size();
+}
+
+void ContractPreExecCache::shrink()
+{
+    while (entries.size() > nMaxEntries)
+    {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
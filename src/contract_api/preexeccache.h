@@ -0,0 +1,88 @@
+#ifndef TESRA_PREEXECCACHE_H
+#define TESRA_PREEXECCACHE_H
+
+#include "contractbase.h"
+#include "sync.h"
+#include "tesrastate.h"
+#include "uint256.h"
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+
+/**
+ * Outcome of a mempool contract transaction executed ahead on the state at stateRoot/utxoRoot,
+ * with a placeholder block author whose account is left out of the access set. It stands for
+ * executing the transaction again on a state that still has everything it read, unless it read a
+ * block header field.
+ */
+struct ContractPreExec
+{
+    dev::h256 stateRoot;
+    dev::h256 utxoRoot;
+    uint64_t blockGasLimit = 0;
+
+    // performByteCode and processingResults succeeded, a miner drops the transaction otherwise
+    bool fValid = false;
+
+    std::vector<TesraTransaction> txs;
+    ByteCodeExecResult result;
+    TxAccessSet access;
+};
+
+/**
+ * Most recently used pre-executions by txid. Entries are replaced when the transaction is
+ * executed again on a newer state and dropped when it leaves the mempool for a block.
+ */
+class ContractPreExecCache
+{
+
+public:
+
+    static ContractPreExecCache &instance();
+
+    void setMaxEntries(size_t _maxEntries);
+
+    bool enabled() const
+    {
+        return nMaxEntries > 0;
+    }
+
+    // The entry of txid when it was executed on the given roots, null otherwise.
+    std::shared_ptr<const ContractPreExec> get(uint256 const &txid, dev::h256 const &_root, dev::h256 const &_rootUTXO);
+
+    void put(uint256 const &txid, std::shared_ptr<const ContractPreExec> const &_entry);
+
+    void erase(uint256 const &txid);
+
+    void clear();
+
+    size_t size() const;
+
+    uint64_t hits() const
+    {
+        return nHits;
+    }
+
+    uint64_t misses() const
+    {
+        return nMisses;
+    }
+
+private:
+
+    typedef std::list<std::pair<uint256, std::shared_ptr<const ContractPreExec>>> EntryList;
+
+    void shrink();
+
+    mutable CCriticalSection cs;
+    size_t nMaxEntries = 0;
+    EntryList entries;
+    std::map<uint256, EntryList::iterator> index;
+    std::atomic<uint64_t> nHits{0};
+    std::atomic<uint64_t> nMisses{0};
+
+};
+
+#endif
@@ -0,0 +1,292 @@
+#include "statedump.h"
+#include "statepruner.h"
+#include "clientversion.h"
+#include "crypto/common.h"
+#include "hash.h"
+#include "streams.h"
+#include "util.h"
+
+#include <libdevcore/SHA3.h>
+#include <libdevcore/TrieDB.h>
+
+#include <lz4.h>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <unordered_set>
+
+namespace
+{
+
+const unsigned char DUMP_STATE = 0;
+const unsigned char DUMP_UTXO = 1;
+const unsigned char DUMP_STATE_AUX = 2;
+const unsigned char DUMP_UTXO_AUX = 3;
+
+uint32_t ChunkChecksum(std::vector<char> const &raw)
+{
+    uint256 hash = Hash(raw.begin(), raw.end());
+    return ReadLE32(hash.begin());
+}
+
+void WriteChunk(CAutoFile &file, CDataStream &chunk)
+{
+    std::vector<char> raw(chunk.begin(), chunk.end());
+    std::vector<char> packed(LZ4_compressBound(raw.size()));
+    int size = raw.empty() ? 0 : LZ4_compress_default(raw.data(), packed.data(), raw.size(), packed.size());
+    packed.resize(size);
+    file << (uint32_t)raw.size() << ChunkChecksum(raw) << packed;
+    chunk.clear();
+}
+
+/**
+ * Calls _leaf once with the hashed key of every leaf of the complete trie at _root and, with _accounts,
+ * of the storage tries of its accounts. The secure tries keep each key as the aux entry of its hash.
+ */
+void WalkLeafKeys(dev::OverlayDB const &_db, dev::h256 const &_root, bool _accounts,
+                  std::function<void(dev::h256 const &)> const &_leaf)
+{
+    std::unordered_set<dev::h256> seenKeys;
+    std::unordered_set<dev::h256> seenStorage;
+    std::vector<std::pair<dev::h256, bool>> roots(1, std::make_pair(_root, _accounts));
+    dev::OverlayDB *db = const_cast<dev::OverlayDB *>(&_db);
+    while (!roots.empty())
+    {
+        std::pair<dev::h256, bool> root = roots.back();
+        roots.pop_back();
+        if (root.first == dev::EmptyTrie)
+            continue;
+        dev::GenericTrieDB<dev::OverlayDB> trie(db, root.first, dev::Verification::Skip);
+        for (auto it = trie.begin(); it != trie.end(); ++it)
+        {
+            auto entry = *it;
+            dev::h256 hashed(entry.first, dev::h256::AlignLeft);
+            if (seenKeys.insert(hashed).second)
+                _leaf(hashed);
+            if (root.second)
+            {
+                dev::h256 storageRoot = dev::RLP(entry.second)[2].toHash<dev::h256>();
+                if (seenStorage.insert(storageRoot).second)
+                    roots.push_back(std::make_pair(storageRoot, false));
+            }
+        }
+    }
+}
+
+bool WalkDump(dev::OverlayDB const &_db, dev::h256 const &_root, bool _accounts, unsigned char _kind,
+              unsigned char _auxKind, CAutoFile &file, CDataStream &chunk, uint64_t &nEntries, std::string &errinfo)
+{
+    std::unordered_set<dev::h256> seen;
+    bool fMissing = false;
+    WalkStateTrie(_db, _root, _accounts, [&](dev::h256 const &h) {
+        return !fMissing && seen.insert(h).second;
+    }, [&](dev::h256 const &h, std::string const &data) {
+        if (data.empty())
+        {
+            errinfo = strprintf("state node %s is missing", h.hex());
+            fMissing = true;
+            return;
+        }
+        chunk << _kind << data;
+        ++nEntries;
+        if (chunk.size() >= STATE_DUMP_CHUNK_SIZE)
+            WriteChunk(file, chunk);
+    });
+    if (fMissing)
+        return false;
+
+    WalkLeafKeys(_db, _root, _accounts, [&](dev::h256 const &h) {
+        if (fMissing)
+            return;
+        dev::bytes key = _db.lookupAux(h);
+        if (key.empty())
+        {
+            errinfo = strprintf("key of state leaf %s is missing", h.hex());
+            fMissing = true;
+            return;
+        }
+        chunk << _auxKind << std::string(key.begin(), key.end());
+        ++nEntries;
+        if (chunk.size() >= STATE_DUMP_CHUNK_SIZE)
+            WriteChunk(file, chunk);
+    });
+    return !fMissing;
+}
+
+bool OpenDump(boost::filesystem::path const &_path, CAutoFile &file, CContractStateDumpHeader &_header, std::string &errinfo)
+{
+    if (file.IsNull())
+    {
+        errinfo = strprintf("cannot open %s", _path.string());
+        return false;
+    }
+    file >> _header;
+    if (_header.nMagic != STATE_DUMP_MAGIC || _header.nDumpVersion != STATE_DUMP_VERSION)
+    {
+        errinfo = strprintf("%s is not a contract state dump of version %d", _path.string(), STATE_DUMP_VERSION);
+        return false;
+    }
+    return true;
+}
+
+}
+
+bool ExportContractState(dev::OverlayDB const &_state, dev::OverlayDB const &_utxo, CContractStateDumpHeader const &_header,
+                         boost::filesystem::path const &_path, uint64_t &nEntries, std::string &errinfo)
+{
+    nEntries = 0;
+    boost::filesystem::path pathTmp = _path;
+    pathTmp += ".tmp";
+    try
+    {
+        CAutoFile file(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull())
+        {
+            errinfo = strprintf("cannot open %s", pathTmp.string());
+            return false;
+        }
+        file << _header;
+
+        CDataStream chunk(SER_DISK, CLIENT_VERSION);
+        if (!WalkDump(_state, uintToh256(_header.hashStateRoot), true, DUMP_STATE, DUMP_STATE_AUX, file, chunk, nEntries,
+                      errinfo) ||
+                !WalkDump(_utxo, uintToh256(_header.hashUTXORoot), false, DUMP_UTXO, DUMP_UTXO_AUX, file, chunk, nEntries,
+                          errinfo))
+        {
+            file.fclose();
+            boost::filesystem::remove(pathTmp);
+            return false;
+        }
+        if (chunk.size())
+            WriteChunk(file, chunk);
+        WriteChunk(file, chunk);
+        FileCommit(file.Get());
+        file.fclose();
+    } catch (const std::exception &e)
+    {
+        errinfo = strprintf("failed to write %s: %s", pathTmp.string(), e.what());
+        return false;
+    }
+    if (!RenameOver(pathTmp, _path))
+    {
+        errinfo = strprintf("cannot rename %s", pathTmp.string());
+        return false;
+    }
+    return true;
+}
+
+bool ReadContractStateHeader(boost::filesystem::path const &_path, CContractStateDumpHeader &_header, std::string &errinfo)
+{
+    try
+    {
+        CAutoFile file(fopen(_path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        return OpenDump(_path, file, _header, errinfo);
+    } catch (const std::exception &e)
+    {
+        errinfo = strprintf("failed to read %s: %s", _path.string(), e.what());
+        return false;
+    }
+}
+
+bool ImportContractState(dev::OverlayDB const &_state, dev::OverlayDB const &_utxo, boost::filesystem::path const &_path,
+                         uint64_t &nEntries, std::string &errinfo)
+{
+    nEntries = 0;
+    CContractStateDumpHeader header;
+    try
+    {
+        CAutoFile file(fopen(_path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        if (!OpenDump(_path, file, header, errinfo))
+            return false;
+
+        for (unsigned nChunk = 0;; nChunk++)
+        {
+            uint32_t nRawSize;
+            uint32_t nChecksum;
+            std::vector<char> packed;
+            file >> nRawSize >> nChecksum >> packed;
+            if (nRawSize == 0)
+                break;
+
+            std::vector<char> raw;
+            if (nRawSize <= MAX_SIZE)
+                raw.resize(nRawSize);
+            if (raw.empty() || LZ4_decompress_safe(packed.data(), raw.data(), packed.size(), raw.size()) != (int)nRawSize ||
+                    ChunkChecksum(raw) != nChecksum)
+            {
+                errinfo = strprintf("chunk %u of %s is corrupt", nChunk, _path.string());
+                return false;
+            }
+
+            ldb::WriteBatch batchState;
+            ldb::WriteBatch batchUTXO;
+            CDataStream chunk(raw, SER_DISK, CLIENT_VERSION);
+            while (!chunk.empty())
+            {
+                unsigned char kind;
+                std::string data;
+                chunk >> kind >> data;
+                // Aux entries are stored under the hash of their content followed by 0xff, as OverlayDB does
+                dev::bytes key = dev::sha3(data).asBytes();
+                if (kind == DUMP_STATE_AUX || kind == DUMP_UTXO_AUX)
+                    key.push_back(255);
+                ldb::Slice slice((char const *)key.data(), key.size());
+                if (kind == DUMP_STATE || kind == DUMP_STATE_AUX)
+                    batchState.Put(slice, ldb::Slice(data));
+                else if (kind == DUMP_UTXO || kind == DUMP_UTXO_AUX)
+                    batchUTXO.Put(slice, ldb::Slice(data));
+                else
+                {
+                    errinfo = strprintf("chunk %u of %s has an unknown entry", nChunk, _path.string());
+                    return false;
+                }
+                ++nEntries;
+            }
+            ldb::Status status = _state.db()->Write(ldb::WriteOptions(), &batchState);
+            if (status.ok())
+                status = _utxo.db()->Write(ldb::WriteOptions(), &batchUTXO);
+            if (!status.ok())
+            {
+                errinfo = strprintf("failed to write the contract state: %s", status.ToString());
+                return false;
+            }
+        }
+    } catch (const std::exception &e)
+    {
+        errinfo = strprintf("failed to read %s: %s", _path.string(), e.what());
+        return false;
+    }
+
+    // Every node is stored under its own hash, so complete tries under the header roots are the expected state
+    dev::OverlayDB state = _state.share();
+    dev::OverlayDB utxo = _utxo.share();
+    std::unordered_set<dev::h256> seen;
+    bool fMissing = false;
+    auto enter = [&](dev::h256 const &h) {
+        return !fMissing && seen.insert(h).second;
+    };
+    auto visit = [&](dev::h256 const &h, std::string const &data) {
+        if (data.empty())
+        {
+            errinfo = strprintf("state node %s is missing from %s", h.hex(), _path.string());
+            fMissing = true;
+        }
+    };
+    WalkStateTrie(state, uintToh256(header.hashStateRoot), true, enter, visit);
+    seen.clear();
+    WalkStateTrie(utxo, uintToh256(header.hashUTXORoot), false, enter, visit);
+    if (fMissing)
+        return false;
+
+    // Account addresses and storage slots are only found through the aux entries of the leaves
+    auto checkKey = [&](dev::OverlayDB const &_db, dev::h256 const &h) {
+        if (!fMissing && _db.lookupAux(h).empty())
+        {
+            errinfo = strprintf("key of state leaf %s is missing from %s", h.hex(), _path.string());
+            fMissing = true;
+        }
+    };
+    WalkLeafKeys(state, uintToh256(header.hashStateRoot), true, [&](dev::h256 const &h) { checkKey(state, h); });
+    WalkLeafKeys(utxo, uintToh256(header.hashUTXORoot), false, [&](dev::h256 const &h) { checkKey(utxo, h); });
+    return !fMissing;
+}
@@ -0,0 +1,63 @@
+#ifndef TESRA_STATEDUMP_H
+#define TESRA_STATEDUMP_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+#include <libdevcore/OverlayDB.h>
+
+#include <boost/filesystem/path.hpp>
+
+static const uint32_t STATE_DUMP_MAGIC = 0x504d4453;
+static const uint32_t STATE_DUMP_VERSION = 2;
+static const size_t STATE_DUMP_CHUNK_SIZE = 1 << 20;
+
+/**
+ * Contract state dump: the account trie with its storage tries and code, and the UTXO trie, as of
+ * one block. The file is this header followed by LZ4 compressed chunks of about
+ * STATE_DUMP_CHUNK_SIZE bytes, each carrying its size and a checksum of its content, and an empty
+ * chunk at the end. Entries are raw nodes without their key, the key of a node being its sha3, and
+ * the account addresses and storage slots the secure tries keep as aux entries under their sha3.
+ */
+struct CContractStateDumpHeader
+{
+    uint32_t nMagic;
+    uint32_t nDumpVersion;
+    int nHeight;
+    uint256 hashBlock;
+    uint256 hashStateRoot;
+    uint256 hashUTXORoot;
+
+    CContractStateDumpHeader()
+    {
+        nMagic = STATE_DUMP_MAGIC;
+        nDumpVersion = STATE_DUMP_VERSION;
+        nHeight = -1;
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nMagic);
+        READWRITE(nDumpVersion);
+        READWRITE(nHeight);
+        READWRITE(hashBlock);
+        READWRITE(hashStateRoot);
+        READWRITE(hashUTXORoot);
+    }
+};
+
+// Writes the tries at the roots of _header found in _state and _utxo to _path, nEntries is the number of nodes written.
+bool ExportContractState(dev::OverlayDB const &_state, dev::OverlayDB const &_utxo, CContractStateDumpHeader const &_header,
+                         boost::filesystem::path const &_path, uint64_t &nEntries, std::string &errinfo);
+
+bool ReadContractStateHeader(boost::filesystem::path const &_path, CContractStateDumpHeader &_header, std::string &errinfo);
+
+// Writes the nodes of the dump at _path to the databases and checks that both roots are complete, with
+// the aux entry of every leaf.
+bool ImportContractState(dev::OverlayDB const &_state, dev::OverlayDB const &_utxo, boost::filesystem::path const &_path,
+                         uint64_t &nEntries, std::string &errinfo);
+
+#endif
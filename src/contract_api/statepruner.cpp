@@ -0,0 +1,254 @@
+#include "statepruner.h"
+#include "util.h"
+
+#include <libdevcore/RLP.h>
+#include <libdevcore/SHA3.h>
+#include <libdevcore/TrieCommon.h>
+#include <libdevcore/TrieDB.h>
+
+#include <boost/bind.hpp>
+
+static const size_t PRUNE_BATCH_SIZE = 10000;
+
+StatePruner::StatePruner(dev::OverlayDB const &_state, dev::OverlayDB const &_utxo, CCriticalSection &_csCommit,
+                         unsigned _depth, unsigned _interval) : state(_state.share()),
+                                                                utxo(_utxo.share()),
+                                                                csCommit(_csCommit),
+                                                                nDepth(_depth),
+                                                                nInterval(std::max(1u, _interval))
+{
+}
+
+StatePruner::~StatePruner()
+{
+    stop();
+}
+
+void StatePruner::keep(int nHeight, dev::h256 const &_root, dev::h256 const &_rootUTXO)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (!roots.empty() && roots.front().nHeight <= nHeight - (int)nDepth)
+            roots.pop_front();
+        roots.push_back(KeptRoots{nHeight, ++nSequence, _root, _rootUTXO});
+    }
+    cond.notify_all();
+}
+
+void WalkStateTrie(dev::OverlayDB const &_db, dev::h256 const &_root, bool _accounts,
+                   std::function<bool(dev::h256 const &)> const &_enter,
+                   std::function<void(dev::h256 const &, std::string const &)> const &_visit)
+{
+    std::vector<std::pair<dev::h256, bool>> pending(1, std::make_pair(_root, _accounts));
+    std::vector<std::pair<dev::RLP, bool>> nodes;
+    while (!pending.empty())
+    {
+        dev::h256 hash = pending.back().first;
+        bool accounts = pending.back().second;
+        pending.pop_back();
+        if (!_enter(hash))
+            continue;
+        std::string data = _db.lookup(hash);
+        if (_visit)
+            _visit(hash, data);
+        if (data.empty())
+            continue;
+
+        // Nodes shorter than a hash are embedded in their parent instead of being stored
+        nodes.assign(1, std::make_pair(dev::RLP(data), accounts));
+        while (!nodes.empty())
+        {
+            dev::RLP node = nodes.back().first;
+            bool nodeAccounts = nodes.back().second;
+            nodes.pop_back();
+
+            dev::bytesConstRef value;
+            std::vector<dev::RLP> children;
+            if (node.isList() && node.itemCount() == 17)
+            {
+                for (unsigned i = 0; i < 16; i++)
+                    children.push_back(node[i]);
+                value = node[16].payload();
+            } else if (node.isList() && node.itemCount() == 2)
+            {
+                if (dev::isLeaf(node))
+                    value = node[1].payload();
+                else
+                    children.push_back(node[1]);
+            }
+
+            for (dev::RLP const &child : children)
+            {
+                if (child.isList())
+                    nodes.push_back(std::make_pair(child, nodeAccounts));
+                else if (child.isData() && child.size() == dev::h256::size)
+                    pending.push_back(std::make_pair(child.toHash<dev::h256>(), nodeAccounts));
+            }
+
+            // Account payloads reference a storage trie and a code blob stored in the same database
+            if (nodeAccounts && !value.empty())
+            {
+                dev::RLP account(value);
+                if (account.isList() && account.itemCount() >= 4)
+                {
+                    dev::h256 storageRoot = account[2].toHash<dev::h256>();
+                    dev::h256 codeHash = account[3].toHash<dev::h256>();
+                    if (storageRoot != dev::EmptyTrie)
+                        pending.push_back(std::make_pair(storageRoot, false));
+                    if (codeHash != dev::EmptySHA3 && _enter(codeHash) && _visit)
+                        _visit(codeHash, _db.lookup(codeHash));
+                }
+            }
+        }
+    }
+}
+
+void StatePruner::markTrie(dev::OverlayDB const &_db, MarkedSet &_marked, dev::h256 const &_root, bool _accounts)
+{
+    WalkStateTrie(_db, _root, _accounts, [&](dev::h256 const &h) {
+        return !fStop && _marked.insert(h).second;
+    }, nullptr);
+}
+
+void StatePruner::markKeptSince(uint64_t &_nSequence)
+{
+    std::vector<KeptRoots> kept;
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        for (KeptRoots const &r : roots)
+            if (r.nSequence > _nSequence)
+                kept.push_back(r);
+    }
+    for (KeptRoots const &r : kept)
+    {
+        markTrie(state, markedState, r.root, true);
+        markTrie(utxo, markedUTXO, r.rootUTXO, false);
+        _nSequence = std::max(_nSequence, r.nSequence);
+    }
+}
+
+size_t StatePruner::erase(dev::OverlayDB const &_db, MarkedSet &_marked, std::vector<dev::h256> const &_candidates)
+{
+    LOCK(csCommit);
+    markKeptSince(nMarkedSequence);
+    if (fStop)
+        return 0;
+
+    ldb::WriteBatch batch;
+    size_t nDeleted = 0;
+    for (dev::h256 const &h : _candidates)
+    {
+        if (_marked.count(h))
+            continue;
+        batch.Delete(ldb::Slice((char const *)h.data(), dev::h256::size));
+        if (_db.nodeCache())
+            _db.nodeCache()->erase(h);
+        ++nDeleted;
+    }
+    ldb::Status status = _db.db()->Write(ldb::WriteOptions(), &batch);
+    if (!status.ok())
+    {
+        LogPrintf("StatePruner: failed to delete state nodes: %s\n", status.ToString());
+        return 0;
+    }
+    return nDeleted;
+}
+
+size_t StatePruner::sweep(dev::OverlayDB const &_db, MarkedSet &_marked)
+{
+    ldb::DB *db = _db.db();
+    ldb::ReadOptions options;
+    options.fill_cache = false;
+    options.snapshot = db->GetSnapshot();
+
+    size_t nDeleted = 0;
+    std::vector<dev::h256> candidates;
+    {
+        std::unique_ptr<ldb::Iterator> it(db->NewIterator(options));
+        for (it->SeekToFirst(); it->Valid() && !fStop; it->Next())
+        {
+            // Trie nodes and code are stored under their 32-byte hash, everything else is kept
+            if (it->key().size() != dev::h256::size)
+                continue;
+            dev::h256 h((byte const *)it->key().data(), dev::h256::ConstructFromPointer);
+            if (_marked.count(h) || h == dev::EmptyTrie)
+                continue;
+            candidates.push_back(h);
+            if (candidates.size() >= PRUNE_BATCH_SIZE)
+            {
+                nDeleted += erase(_db, _marked, candidates);
+                candidates.clear();
+            }
+        }
+    }
+    if (!candidates.empty() && !fStop)
+        nDeleted += erase(_db, _marked, candidates);
+    db->ReleaseSnapshot(options.snapshot);
+    return nDeleted;
+}
+
+size_t StatePruner::prune()
+{
+    int64_t nStart = GetTimeMillis();
+    markedState.clear();
+    markedUTXO.clear();
+    nMarkedSequence = 0;
+    markKeptSince(nMarkedSequence);
+    if (markedState.empty() || fStop)
+        return 0;
+    int64_t nMarked = GetTimeMillis();
+
+    size_t nDeleted = sweep(state, markedState) + sweep(utxo, markedUTXO);
+    if (nDeleted && !fStop)
+    {
+        state.db()->CompactRange(nullptr, nullptr);
+        utxo.db()->CompactRange(nullptr, nullptr);
+    }
+    LogPrint("bench", "StatePruner: marked %u state and %u UTXO nodes in %dms, deleted %u nodes in %dms\n",
+             markedState.size(), markedUTXO.size(), nMarked - nStart, nDeleted, GetTimeMillis() - nMarked);
+
+    markedState.clear();
+    markedUTXO.clear();
+    return nDeleted;
+}
+
+void StatePruner::thread()
+{
+    RenameThread("tesra-statepruner");
+    while (!fStop)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            while (!fStop && (roots.empty() || roots.back().nHeight - nPrunedHeight < (int)nInterval))
+                cond.wait(lock);
+            if (fStop)
+                return;
+            if (nPrunedHeight < 0)
+            {
+                // Nothing was pruned since startup, wait for one interval first
+                nPrunedHeight = roots.back().nHeight;
+                continue;
+            }
+            nPrunedHeight = roots.back().nHeight;
+        }
+        size_t nDeleted = prune();
+        LogPrintf("StatePruner: deleted %u contract state nodes\n", nDeleted);
+    }
+}
+
+void StatePruner::start()
+{
+    fStop = false;
+    worker = boost::thread(boost::bind(&StatePruner::thread, this));
+}
+
+void StatePruner::stop()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fStop = true;
+    }
+    cond.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
@@ -0,0 +1,102 @@
+#ifndef TESRA_STATEPRUNER_H
+#define TESRA_STATEPRUNER_H
+
+#include "sync.h"
+
+#include <libdevcore/OverlayDB.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <unordered_set>
+
+#include <boost/thread.hpp>
+
+/**
+ * Walks the trie at _root depth first. _enter is called once for every referenced node and code
+ * blob and decides whether it is loaded, _visit receives each loaded one, empty when it is missing.
+ * With _accounts the leaves are accounts and their storage tries and code are walked as well.
+ */
+void WalkStateTrie(dev::OverlayDB const &_db, dev::h256 const &_root, bool _accounts,
+                   std::function<bool(dev::h256 const &)> const &_enter,
+                   std::function<void(dev::h256 const &, std::string const &)> const &_visit);
+
+/**
+ * Reclaims the contract state and UTXO trie nodes that are no longer reachable from the roots of
+ * the last nDepth blocks.
+ *
+ * prune() is a mark-and-sweep pass: the nodes reachable from the kept roots are marked without any
+ * lock, then the unmarked nodes of a LevelDB snapshot are deleted in batches. Each batch is deleted
+ * under csCommit, the lock writers of the databases hold, after the roots kept since the pass began
+ * have been marked as well, so a node that a newer block wrote again is never deleted. start() runs
+ * a pass on a background thread every nInterval blocks.
+ */
+class StatePruner
+{
+
+public:
+
+    StatePruner(dev::OverlayDB const &_state, dev::OverlayDB const &_utxo, CCriticalSection &_csCommit,
+                unsigned _depth, unsigned _interval);
+
+    ~StatePruner();
+
+    unsigned depth() const
+    {
+        return nDepth;
+    }
+
+    // Keeps the roots of a connected block, the roots of blocks nDepth below it are released.
+    void keep(int nHeight, dev::h256 const &_root, dev::h256 const &_rootUTXO);
+
+    // Runs one pass on the calling thread and returns the number of deleted nodes.
+    size_t prune();
+
+    void start();
+
+    void stop();
+
+private:
+
+    struct KeptRoots
+    {
+        int nHeight;
+        uint64_t nSequence;
+        dev::h256 root;
+        dev::h256 rootUTXO;
+    };
+
+    typedef std::unordered_set<dev::h256> MarkedSet;
+
+    void markTrie(dev::OverlayDB const &_db, MarkedSet &_marked, dev::h256 const &_root, bool _accounts);
+
+    void markKeptSince(uint64_t &_nSequence);
+
+    size_t sweep(dev::OverlayDB const &_db, MarkedSet &_marked);
+
+    size_t erase(dev::OverlayDB const &_db, MarkedSet &_marked, std::vector<dev::h256> const &_candidates);
+
+    void thread();
+
+    dev::OverlayDB state;
+    dev::OverlayDB utxo;
+    CCriticalSection &csCommit;
+    const unsigned nDepth;
+    const unsigned nInterval;
+
+    CWaitableCriticalSection cs;
+    CConditionVariable cond;
+    std::deque<KeptRoots> roots;
+    uint64_t nSequence = 0;
+    int nPrunedHeight = -1;
+
+    MarkedSet markedState;
+    MarkedSet markedUTXO;
+    uint64_t nMarkedSequence = 0;
+
+    std::atomic<bool> fStop{false};
+    boost::thread worker;
+
+};
+
+#endif
@@ -1,13 +1,62 @@
 #include "storageresults.h"
 #include "tesratransaction.h"
 #include "contractbase.h"
+#include "crypto/common.h"
 
-StorageResults::StorageResults(std::string const &_path)
+#include <lz4.h>
+
+namespace
+{
+
+// Values start with one of these tags, a compressed value is followed by the size of the
+// RLP it expands to as 4 bytes little endian.
+const char RESULT_RAW = 0;
+const char RESULT_LZ4 = 1;
+
+const char *const VERSION_KEY = "version";
+const char *const VERSION = "1";
+
+const size_t MIGRATE_BATCH_SIZE = 10000;
+
+std::string packResult(const char *data, size_t size, bool compress)
+{
+    if (compress)
+    {
+        std::string value(5 + LZ4_compressBound(size), 0);
+        int packed = LZ4_compress_default(data, &value[5], size, value.size() - 5);
+        if (packed > 0 && size_t(packed) + 4 < size)
+        {
+            value[0] = RESULT_LZ4;
+            WriteLE32((unsigned char *) &value[1], size);
+            value.resize(packed + 5);
+            return value;
+        }
+    }
+    std::string value(1, RESULT_RAW);
+    value.append(data, size);
+    return value;
+}
+
+size_t resultMemory(std::vector<TransactionReceiptInfo> const &result)
+{
+    size_t memory = sizeof(dev::h256) + sizeof(std::vector<TransactionReceiptInfo>) + 64;
+    for (TransactionReceiptInfo const &info : result)
+    {
+        memory += sizeof(TransactionReceiptInfo);
+        for (dev::eth::LogEntry const &log : info.logs)
+            memory += sizeof(dev::eth::LogEntry) + log.topics.size() * sizeof(dev::h256) + log.data.size();
+    }
+    return memory;
+}
+
+}
+
+StorageResults::StorageResults(std::string const &_path, size_t _maxCacheMemory, bool _compress) :
+        fCompress(_compress), nMaxCacheMemory(_maxCacheMemory)
 {
     path = _path + "/resultsDB";
     options.create_if_missing = true;
-    leveldb::Status status = leveldb::DB::Open(options, path, &db);
-    assert(status.ok());
+    open();
 }
 
 StorageResults::~StorageResults()
@@ -16,135 +65,245 @@ StorageResults::~StorageResults()
     db = NULL;
 }
 
+void StorageResults::open()
+{
+    leveldb::Status status = leveldb::DB::Open(options, path, &db);
+    assert(status.ok());
+    migrate();
+}
+
+void StorageResults::migrate()
+{
+    std::string version;
+    if (db->Get(leveldb::ReadOptions(), VERSION_KEY, &version).ok())
+        return;
+
+    size_t converted = 0;
+    leveldb::WriteBatch batch;
+    std::unique_ptr<leveldb::Iterator> it(db->NewIterator(leveldb::ReadOptions()));
+    for (it->SeekToFirst(); it->Valid(); it->Next())
+    {
+        if (it->key().size() != 2 * dev::h256::size)
+            continue;
+
+        dev::h256 hashTx(it->key().ToString());
+        batch.Put(leveldb::Slice((const char *) hashTx.data(), dev::h256::size),
+                  packResult(it->value().data(), it->value().size(), fCompress));
+        batch.Delete(it->key());
+        if (++converted % MIGRATE_BATCH_SIZE == 0)
+        {
+            leveldb::Status status = db->Write(leveldb::WriteOptions(), &batch);
+            assert(status.ok());
+            batch.Clear();
+            LogPrintf("StorageResults: converted %u receipts\n", converted);
+        }
+    }
+    batch.Put(VERSION_KEY, VERSION);
+    leveldb::Status status = db->Write(leveldb::WriteOptions(), &batch);
+    assert(status.ok());
+    if (converted)
+        LogPrintf("StorageResults: converted %u receipts to binary keys\n", converted);
+}
+
 void StorageResults::addResult(dev::h256 hashTx, std::vector<TransactionReceiptInfo> &result)
 {
-    m_cache_result.insert(std::make_pair(hashTx, result));
+    LOCK(cs);
+    m_pending_result.insert(std::make_pair(hashTx, result));
 }
 
 void StorageResults::clearCacheResult()
 {
-    m_cache_result.clear();
+    LOCK(cs);
+    m_pending_result.clear();
 }
 
 void StorageResults::wipeResults()
 {
+    LOCK(cs);
+    m_pending_result.clear();
+    m_cache_result.clear();
+    m_lru.clear();
+    nCacheMemory = 0;
+
+    delete db;
+    db = NULL;
     leveldb::Status result = leveldb::DestroyDB(path, leveldb::Options());
+    open();
 }
 
 void StorageResults::deleteResults(std::vector<CTransaction> const &txs)
 {
-    for (CTransaction tx : txs)
+    LOCK(cs);
+    leveldb::WriteBatch batch;
+    for (CTransaction const &tx : txs)
     {
         dev::h256 hashTx = uintToh256(tx.GetHash());
-        m_cache_result.erase(hashTx);
-
-        std::string keyTemp = hashTx.hex();
-        leveldb::Slice key(keyTemp);
-        leveldb::Status status = db->Delete(leveldb::WriteOptions(), key);
-        assert(status.ok());
+        m_pending_result.erase(hashTx);
+        uncacheResult(hashTx);
+        batch.Delete(leveldb::Slice((const char *) hashTx.data(), dev::h256::size));
     }
+    leveldb::Status status = db->Write(leveldb::WriteOptions(), &batch);
+    assert(status.ok());
 }
 
 std::vector<TransactionReceiptInfo> StorageResults::getResult(dev::h256 const &hashTx)
 {
+    LOCK(cs);
     std::vector<TransactionReceiptInfo> result;
+    auto pending = m_pending_result.find(hashTx);
+    if (pending != m_pending_result.end())
+        return pending->second;
+
     auto it = m_cache_result.find(hashTx);
     if (it == m_cache_result.end())
     {
         if (readResult(hashTx, result))
-            m_cache_result.insert(std::make_pair(hashTx, result));
+            cacheResult(hashTx, result);
     } else
     {
-        result = it->second;
+        m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+        result = it->second.result;
     }
     return result;
 }
 
 void StorageResults::commitResults()
 {
-    if (m_cache_result.size())
+    LOCK(cs);
+    if (m_pending_result.size())
     {
-        for (auto const &i: m_cache_result)
+        leveldb::WriteBatch batch;
+        for (auto const &i: m_pending_result)
         {
-            std::string valueTemp;
-            std::string keyTemp = i.first.hex();
-            leveldb::Slice key(keyTemp);
-            leveldb::Status status = db->Get(leveldb::ReadOptions(), key, &valueTemp);
-
-            if (status.IsNotFound())
-            {
-
-                TransactionReceiptInfoSerialized tris;
-
-                for (size_t j = 0; j < i.second.size(); j++)
-                {
-                    tris.blockHashes.push_back(uintToh256(i.second[j].blockHash));
-                    tris.blockNumbers.push_back(i.second[j].blockNumber);
-                    tris.transactionHashes.push_back(uintToh256(i.second[j].transactionHash));
-                    tris.transactionIndexes.push_back(i.second[j].transactionIndex);
-                    tris.senders.push_back(i.second[j].from);
-                    tris.receivers.push_back(i.second[j].to);
-                    tris.cumulativeGasUsed.push_back(dev::u256(i.second[j].cumulativeGasUsed));
-                    tris.gasUsed.push_back(dev::u256(i.second[j].gasUsed));
-                    tris.contractAddresses.push_back(i.second[j].contractAddress);
-                    tris.logs.push_back(logEntriesSerialization(i.second[j].logs));
-                    tris.excepted.push_back(i.second[j].excepted);
-                }
-
-                dev::RLPStream streamRLP(11);
-                streamRLP << tris.blockHashes << tris.blockNumbers << tris.transactionHashes << tris.transactionIndexes
-                          << tris.senders;
-                streamRLP << tris.receivers << tris.cumulativeGasUsed << tris.gasUsed << tris.contractAddresses
-                          << tris.logs
-                          << tris.excepted;
-
-                dev::bytes data = streamRLP.out();
-                std::string stringData(data.begin(), data.end());
-                leveldb::Slice value(stringData);
-                status = db->Put(leveldb::WriteOptions(), key, value);
-                assert(status.ok());
-            }
+            batch.Put(leveldb::Slice((const char *) i.first.data(), dev::h256::size), encodeResult(i.second));
         }
-        m_cache_result.clear();
+        leveldb::Status status = db->Write(leveldb::WriteOptions(), &batch);
+        assert(status.ok());
+
+        for (auto const &i: m_pending_result)
+            cacheResult(i.first, i.second);
+        m_pending_result.clear();
+    }
+}
+
+void StorageResults::cacheResult(dev::h256 const &hashTx, std::vector<TransactionReceiptInfo> const &result)
+{
+    uncacheResult(hashTx);
+    size_t memory = resultMemory(result);
+    if (memory > nMaxCacheMemory)
+        return;
+
+    m_lru.push_front(hashTx);
+    m_cache_result.insert(std::make_pair(hashTx, CacheEntry{result, memory, m_lru.begin()}));
+    nCacheMemory += memory;
+    while (nCacheMemory > nMaxCacheMemory)
+    {
+        auto it = m_cache_result.find(m_lru.back());
+        nCacheMemory -= it->second.memory;
+        m_cache_result.erase(it);
+        m_lru.pop_back();
     }
 }
 
+void StorageResults::uncacheResult(dev::h256 const &hashTx)
+{
+    auto it = m_cache_result.find(hashTx);
+    if (it == m_cache_result.end())
+        return;
+    nCacheMemory -= it->second.memory;
+    m_lru.erase(it->second.lru);
+    m_cache_result.erase(it);
+}
+
+std::string StorageResults::encodeResult(std::vector<TransactionReceiptInfo> const &_result)
+{
+    TransactionReceiptInfoSerialized tris;
+
+    for (size_t j = 0; j < _result.size(); j++)
+    {
+        tris.blockHashes.push_back(uintToh256(_result[j].blockHash));
+        tris.blockNumbers.push_back(_result[j].blockNumber);
+        tris.transactionHashes.push_back(uintToh256(_result[j].transactionHash));
+        tris.transactionIndexes.push_back(_result[j].transactionIndex);
+        tris.senders.push_back(_result[j].from);
+        tris.receivers.push_back(_result[j].to);
+        tris.cumulativeGasUsed.push_back(dev::u256(_result[j].cumulativeGasUsed));
+        tris.gasUsed.push_back(dev::u256(_result[j].gasUsed));
+        tris.contractAddresses.push_back(_result[j].contractAddress);
+        tris.logs.push_back(logEntriesSerialization(_result[j].logs));
+        tris.excepted.push_back(_result[j].excepted);
+    }
+
+    dev::RLPStream streamRLP(11);
+    streamRLP << tris.blockHashes << tris.blockNumbers << tris.transactionHashes << tris.transactionIndexes
+              << tris.senders;
+    streamRLP << tris.receivers << tris.cumulativeGasUsed << tris.gasUsed << tris.contractAddresses
+              << tris.logs
+              << tris.excepted;
+
+    dev::bytes const &data = streamRLP.out();
+    return packResult((const char *) data.data(), data.size(), fCompress);
+}
+
+bool StorageResults::decodeResult(std::string const &_value, std::vector<TransactionReceiptInfo> &_result)
+{
+    if (_value.empty())
+        return false;
+
+    std::string rlp;
+    if (_value[0] == RESULT_LZ4)
+    {
+        if (_value.size() < 5)
+            return false;
+        rlp.resize(ReadLE32((const unsigned char *) _value.data() + 1));
+        int size = LZ4_decompress_safe(_value.data() + 5, &rlp[0], _value.size() - 5, rlp.size());
+        if (size < 0 || size_t(size) != rlp.size())
+            return false;
+    } else if (_value[0] == RESULT_RAW)
+    {
+        rlp = _value.substr(1);
+    } else
+    {
+        return false;
+    }
+
+    TransactionReceiptInfoSerialized tris;
+
+    dev::RLP state(rlp);
+    tris.blockHashes = state[0].toVector<dev::h256>();
+    tris.blockNumbers = state[1].toVector<uint32_t>();
+    tris.transactionHashes = state[2].toVector<dev::h256>();
+    tris.transactionIndexes = state[3].toVector<uint32_t>();
+    tris.senders = state[4].toVector<dev::h160>();
+    tris.receivers = state[5].toVector<dev::h160>();
+    tris.cumulativeGasUsed = state[6].toVector<dev::u256>();
+    tris.gasUsed = state[7].toVector<dev::u256>();
+    tris.contractAddresses = state[8].toVector<dev::h160>();
+    tris.logs = state[9].toVector<logEntriesSerializ>();
+    tris.excepted = state[10].toVector<uint32_t>();
+
+    for (size_t j = 0; j < tris.blockHashes.size(); j++)
+    {
+        TransactionReceiptInfo tri{h256Touint(tris.blockHashes[j]), tris.blockNumbers[j],
+                                   h256Touint(tris.transactionHashes[j]), tris.transactionIndexes[j],
+                                   tris.senders[j],
+                                   tris.receivers[j], uint64_t(tris.cumulativeGasUsed[j]),
+                                   uint64_t(tris.gasUsed[j]), tris.contractAddresses[j],
+                                   logEntriesDeserialize(tris.logs[j]), tris.excepted[j]};
+        _result.push_back(tri);
+    }
+    return true;
+}
+
 bool StorageResults::readResult(dev::h256 const &_key, std::vector<TransactionReceiptInfo> &_result)
 {
     std::string value;
-    std::string keyTemp = _key.hex();
-    leveldb::Slice key(keyTemp);
+    leveldb::Slice key((const char *) _key.data(), dev::h256::size);
     leveldb::Status s = db->Get(leveldb::ReadOptions(), key, &value);
 
     if (!s.IsNotFound() && s.ok())
     {
-
-        TransactionReceiptInfoSerialized tris;
-
-        dev::RLP state(value);
-        tris.blockHashes = state[0].toVector<dev::h256>();
-        tris.blockNumbers = state[1].toVector<uint32_t>();
-        tris.transactionHashes = state[2].toVector<dev::h256>();
-        tris.transactionIndexes = state[3].toVector<uint32_t>();
-        tris.senders = state[4].toVector<dev::h160>();
-        tris.receivers = state[5].toVector<dev::h160>();
-        tris.cumulativeGasUsed = state[6].toVector<dev::u256>();
-        tris.gasUsed = state[7].toVector<dev::u256>();
-        tris.contractAddresses = state[8].toVector<dev::h160>();
-        tris.logs = state[9].toVector<logEntriesSerializ>();
-        tris.excepted = state[10].toVector<uint32_t>();
-
-        for (size_t j = 0; j < tris.blockHashes.size(); j++)
-        {
-            TransactionReceiptInfo tri{h256Touint(tris.blockHashes[j]), tris.blockNumbers[j],
-                                       h256Touint(tris.transactionHashes[j]), tris.transactionIndexes[j],
-                                       tris.senders[j],
-                                       tris.receivers[j], uint64_t(tris.cumulativeGasUsed[j]),
-                                       uint64_t(tris.gasUsed[j]), tris.contractAddresses[j],
-                                       logEntriesDeserialize(tris.logs[j]), tris.excepted[j]};
-            _result.push_back(tri);
-        }
-        return true;
+        return decodeResult(value, _result);
     }
     return false;
 }
@@ -3,6 +3,10 @@
 
 #include <libethereum/State.h>
 
+#include "sync.h"
+
+#include <list>
+
 using logEntriesSerializ = std::vector<std::pair<dev::Address, std::pair<dev::h256s, dev::bytes>>>;
 
 struct TransactionReceiptInfo
@@ -35,12 +39,19 @@ struct TransactionReceiptInfoSerialized
     std::vector<uint32_t> excepted;
 };
 
+/**
+ * Receipts of the contract transactions, keyed by the raw 32 byte transaction hash.
+ * Results of the block being connected are kept until commitResults() writes them in one
+ * batch, values are LZ4 compressed when that makes them smaller. Reads go through a
+ * least recently used cache bounded by memory. A store written with hex keys is converted
+ * in place when it is opened.
+ */
 class StorageResults
 {
 
 public:
 
-    StorageResults(std::string const &_path);
+    StorageResults(std::string const &_path, size_t _maxCacheMemory = DEFAULT_CACHE_MEMORY, bool _compress = true);
 
     ~StorageResults();
 
@@ -56,10 +67,37 @@ public:
 
     void wipeResults();
 
+    size_t cacheMemoryUsage() const
+    {
+        LOCK(cs);
+        return nCacheMemory;
+    }
+
+    static const size_t DEFAULT_CACHE_MEMORY = 16 * 1024 * 1024;
+
 private:
 
+    struct CacheEntry
+    {
+        std::vector<TransactionReceiptInfo> result;
+        size_t memory;
+        std::list<dev::h256>::iterator lru;
+    };
+
+    void open();
+
+    void migrate();
+
     bool readResult(dev::h256 const &_key, std::vector<TransactionReceiptInfo> &_result);
 
+    std::string encodeResult(std::vector<TransactionReceiptInfo> const &_result);
+
+    bool decodeResult(std::string const &_value, std::vector<TransactionReceiptInfo> &_result);
+
+    void cacheResult(dev::h256 const &hashTx, std::vector<TransactionReceiptInfo> const &result);
+
+    void uncacheResult(dev::h256 const &hashTx);
+
     logEntriesSerializ logEntriesSerialization(dev::eth::LogEntries const &_logs);
 
     dev::eth::LogEntries logEntriesDeserialize(logEntriesSerializ const &_logs);
@@ -70,7 +108,18 @@ private:
 
     leveldb::Options options;
 
-    std::unordered_map<dev::h256, std::vector<TransactionReceiptInfo>> m_cache_result;
+    bool fCompress;
+
+    mutable CCriticalSection cs;
+
+    std::unordered_map<dev::h256, std::vector<TransactionReceiptInfo>> m_pending_result;
+
+    std::unordered_map<dev::h256, CacheEntry> m_cache_result;
+
+    std::list<dev::h256> m_lru;
+
+    size_t nMaxCacheMemory;
 
+    size_t nCacheMemory = 0;
 
 };
@@ -305,3 +305,99 @@ void TesraDGP::clear()
     storageTemplate.clear();
     paramsInstance.clear();
 }
+
+TesraDGPCache &TesraDGPCache::instance()
+{
+    static TesraDGPCache cache;
+    return cache;
+}
+
+bool TesraDGPCache::hasUncommittedDGP(const TesraState *state)
+{
+    for (const dev::Address &addr : {GasScheduleDGP, BlockSizeDGP, GasPriceDGP, DGPCONTRACT4, BlockGasLimitDGP})
+    {
+        if (state->hasUncommittedChanges(addr))
+            return true;
+    }
+    return false;
+}
+
+dev::h256 TesraDGPCache::dgpRoot(const TesraState *state)
+{
+    dev::h256 stateRoot = state->rootHash();
+    if (stateRoot == lastStateRoot && lastDGPRoot)
+        return lastDGPRoot;
+
+    dev::RLPStream roots(5);
+    for (const dev::Address &addr : {GasScheduleDGP, BlockSizeDGP, GasPriceDGP, DGPCONTRACT4, BlockGasLimitDGP})
+    {
+        roots << state->storageRoot(addr);
+    }
+    lastStateRoot = stateRoot;
+    lastDGPRoot = dev::sha3(roots.out());
+    return lastDGPRoot;
+}
+
+TesraDGPParams TesraDGPCache::compute(TesraState *state, bool dgpevm, unsigned int blockHeight)
+{
+    TesraDGPParams params;
+    fComputing = true;
+    try
+    {
+        TesraDGP tesraDGP(state, dgpevm);
+        params.blockSize = tesraDGP.getBlockSize(blockHeight);
+        params.minGasPrice = tesraDGP.getMinGasPrice(blockHeight);
+        params.blockGasLimit = tesraDGP.getBlockGasLimit(blockHeight);
+    }
+    catch (...)
+    {
+        fComputing = false;
+        throw;
+    }
+    fComputing = false;
+    return params;
+}
+
+TesraDGPParams TesraDGPCache::get(TesraState *state, bool dgpevm, unsigned int blockHeight)
+{
+    LOCK(cs);
+    if (fComputing)
+    {
+        return TesraDGPParams();
+    }
+
+    // The roots come from the trie, writes that earlier transactions of the block being connected
+    // left in the account cache (deferred commit, snapshot mode) are not in them yet
+    if (hasUncommittedDGP(state))
+    {
+        ++nMisses;
+        return compute(state, dgpevm, blockHeight);
+    }
+
+    std::pair<unsigned int, dev::h256> key(blockHeight, dgpRoot(state));
+    auto it = entries.find(key);
+    if (it != entries.end())
+    {
+        ++nHits;
+        return it->second;
+    }
+    ++nMisses;
+
+    TesraDGPParams params = compute(state, dgpevm, blockHeight);
+    if (entries.size() >= MAX_DGP_CACHE_ENTRIES)
+    {
+        entries.erase(entries.begin());
+    }
+    entries[key] = params;
+    return params;
+}
+
+void TesraDGPCache::clear()
+{
+    LOCK(cs);
+    entries.clear();
+    lastStateRoot = dev::h256();
+    lastDGPRoot = dev::h256();
+    nHits = 0;
+    nMisses = 0;
+}
@@ -5,6 +5,7 @@
 #include "primitives/block.h"
 
 #include "utilstrencodings.h"
+#include "sync.h"
 
 static const dev::Address GasScheduleDGP = dev::Address("0000000000000000000000000000000000000080");
 static const dev::Address BlockSizeDGP = dev::Address("0000000000000000000000000000000000000081");
@@ -24,6 +25,8 @@ static const uint64_t MIN_BLOCK_GAS_LIMIT_DGP = 1000000;
 static const uint64_t MAX_BLOCK_GAS_LIMIT_DGP = 1000000000;
 static const uint64_t DEFAULT_BLOCK_GAS_LIMIT_DGP = 40000000;
 
+static const size_t MAX_DGP_CACHE_ENTRIES = 16;
+
 class TesraDGP
 {
 
@@ -94,4 +97,65 @@ private:
 
 };
 
+struct TesraDGPParams
+{
+    uint32_t blockSize = DEFAULT_BLOCK_SIZE_DGP;
+    uint64_t minGasPrice = DEFAULT_MIN_GAS_PRICE_DGP;
+    uint64_t blockGasLimit = DEFAULT_BLOCK_GAS_LIMIT_DGP;
+};
+
+/**
+ * Governance parameters keyed by block height and by the storage roots of the DGP contracts,
+ * so entries stay valid until a block actually writes to one of 0x80-0x84. The DGP roots are
+ * only recomputed when the global state root moves. While one of the DGP contracts has writes
+ * that are not committed to the trie yet, lookups bypass the cache. A lookup made while an entry
+ * is being computed (the -dgpevm template call goes back through CallContract) gets the defaults.
+ */
+class TesraDGPCache
+{
+
+public:
+
+    static TesraDGPCache &instance();
+
+    TesraDGPParams get(TesraState *state, bool dgpevm, unsigned int blockHeight);
+
+    void clear();
+
+    uint64_t hits() const
+    {
+        LOCK(cs);
+        return nHits;
+    }
+
+    uint64_t misses() const
+    {
+        LOCK(cs);
+        return nMisses;
+    }
+
+private:
+
+    static bool hasUncommittedDGP(const TesraState *state);
+
+    dev::h256 dgpRoot(const TesraState *state);
+
+    TesraDGPParams compute(TesraState *state, bool dgpevm, unsigned int blockHeight);
+
+    mutable CCriticalSection cs;
+
+    std::map<std::pair<unsigned int, dev::h256>, TesraDGPParams> entries;
+
+    dev::h256 lastStateRoot;
+
+    dev::h256 lastDGPRoot;
+
+    bool fComputing = false;
+
+    uint64_t nHits = 0;
+
+    uint64_t nMisses = 0;
+
+};
+
 #endif
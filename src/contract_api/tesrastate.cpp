@@ -7,6 +7,8 @@
 #include "utilstrencodings.h"
 #include "contractbase.h"
 #include "libethereum/Transaction.h"
+#include "libevm/VMFactory.h"
+#include "libevm/VMTrace.h"
 using namespace std;
 using namespace dev;
 using namespace dev::eth;
@@ -21,9 +23,24 @@ TesraState::TesraState(u256 const &_accountStartNonce, OverlayDB const &_db, con
         State(_accountStartNonce, _db, _bs)
 {
     dbUTXO = TesraState::openDB(_path + "/tesraDB", sha3(rlp("")), WithExisting::Trust);
+    db().setNodeCache(&TrieNodeCache::instance());
+    dbUTXO.setNodeCache(&TrieNodeCache::instance());
     stateUTXO = SecureTrieDB<Address, OverlayDB>(&dbUTXO);
 }
 
+TesraState::TesraState(TesraState const &_s) : State(_s), dbUTXO(_s.dbUTXO),
+                                               stateUTXO(&dbUTXO, _s.stateUTXO.root(), dev::Verification::Skip),
+                                               cacheUTXO(_s.cacheUTXO), deadUTXO(_s.deadUTXO)
+{
+}
+
+TesraState::TesraState(TesraState const &_s, h256 const &_root, h256 const &_rootUTXO) :
+        State(_s.accountStartNonce(), _s.db().share(), BaseState::PreExisting), dbUTXO(_s.dbUTXO.share()),
+        stateUTXO(&dbUTXO, _rootUTXO, dev::Verification::Skip)
+{
+    setRoot(_root);
+}
+
 TesraState::TesraState() : dev::eth::State(dev::Invalid256, dev::OverlayDB(), dev::eth::BaseState::PreExisting)
 {
     dbUTXO = OverlayDB();
@@ -37,6 +54,12 @@ TesraState::execute(EnvInfo const &_envInfo, SealEngineFace const &_sealEngine,
 
     assert(_t.getVersion().toRaw() == VersionVM::GetEVMDefault().toRaw());
 
+    size_t startSavepoint = savepoint();
+    std::unordered_map<dev::Address, Vin> startCacheUTXO;
+    if (deferCommit)
+        startCacheUTXO = cacheUTXO;
+    killedAccounts.clear();
+
     addBalance(_t.sender(), _t.value() + (_t.gas() * _t.gasPrice()));
     newAddress = _t.isCreation() ? createTesraAddress(_t.getHashWith(), _t.getNVout()) : dev::Address();
 
@@ -67,6 +90,8 @@ TesraState::execute(EnvInfo const &_envInfo, SealEngineFace const &_sealEngine,
             BOOST_THROW_EXCEPTION(CreateWithValue());
        
         e.initialize(_t);
+        if (VMTracer::instance().enabled())
+            VMTracer::instance().local().transaction(_t.getHashWith(), _t.getNVout(), uint64_t(_t.gas()));
         
         startGasUsed = _envInfo.gasUsed();
         if (!e.execute())
@@ -81,8 +106,7 @@ TesraState::execute(EnvInfo const &_envInfo, SealEngineFace const &_sealEngine,
         e.finalize();
         if (_p == Permanence::Reverted)
         {
-            m_cache.clear();
-            cacheUTXO.clear();
+            revertTransaction(startSavepoint, startCacheUTXO);
         } else
         {
             
@@ -95,6 +119,7 @@ TesraState::execute(EnvInfo const &_envInfo, SealEngineFace const &_sealEngine,
                 {
                    
                     voutLimit = true;
+                    restoreKilled();
                     e.revert();
                     throw Exception();
                 }
@@ -106,18 +131,10 @@ TesraState::execute(EnvInfo const &_envInfo, SealEngineFace const &_sealEngine,
                 printfErrorLog(res.excepted);
             }
 
-          
-            tesra::commit(cacheUTXO, stateUTXO, m_cache);
-            cacheUTXO.clear();
-          
-
-            
-            
-            bool removeEmptyAccounts = false;
-            commit(removeEmptyAccounts ? State::CommitBehaviour::RemoveEmptyAccounts
-                                       : State::CommitBehaviour::KeepEmptyAccounts);
+            if (access)
+                captureWrites(*access);
 
-          
+            endTransaction();
 
         }
     }
@@ -134,12 +151,9 @@ TesraState::execute(EnvInfo const &_envInfo, SealEngineFace const &_sealEngine,
         
         
         
-        {
-            m_cache.clear();
-            cacheUTXO.clear();
-        }
+        revertTransaction(startSavepoint, startCacheUTXO);
     }
-    
+    VMFactory::releaseFrames();
 
     if (!_t.isCreation())
         res.newAddress = _t.receiveAddress();
@@ -328,9 +342,58 @@ static bool findExtendedKeyData(const std::vector<unsigned char> vExtendData, co
     return false;
 }
 
+static thread_local ChainDataBlocker *chainDataBlocker = nullptr;
+
+ChainDataBlocker::ChainDataBlocker() : previous(chainDataBlocker)
+{
+    chainDataBlocker = this;
+}
+
+ChainDataBlocker::~ChainDataBlocker()
+{
+    chainDataBlocker = previous;
+}
+
+bool ChainDataBlocker::block()
+{
+    if (!chainDataBlocker)
+        return false;
+    chainDataBlocker->fReached = true;
+    return true;
+}
+
+static thread_local ChainDataHeight *chainDataHeight = nullptr;
+
+ChainDataHeight::ChainDataHeight(int _nHeight) : previous(chainDataHeight), nHeight(_nHeight)
+{
+    chainDataHeight = this;
+}
+
+ChainDataHeight::~ChainDataHeight()
+{
+    chainDataHeight = previous;
+}
+
+bool ChainDataHeight::visible(uint32_t height)
+{
+    return !chainDataHeight || (chainDataHeight->nHeight >= 0 && height <= uint32_t(chainDataHeight->nHeight));
+}
+
 bool getData(uint32_t height, const std::string & strKey, eExtendDataType & type, std::vector<uint8_t>& value, dev::Address const& _owner)
 {
-    if (height > chainActive.Tip()->nHeight || NULL == chainActive[height])
+    if (ChainDataBlocker::block())
+    {
+        return 0;
+    }
+
+    if (!ChainDataHeight::visible(height))
+    {
+        return 0;
+    }
+
+    // Read-only calls run without cs_main, so take it for chainActive here
+    LOCK(cs_main);
+    if (!chainActive.Tip() || height > chainActive.Tip()->nHeight || NULL == chainActive[height])
     {
         return 0;
     }
@@ -411,9 +474,15 @@ Vin const *TesraState::vin(dev::Address const &_a) const
 
 Vin *TesraState::vin(dev::Address const &_addr)
 {
+    if (access)
+        access->readUTXO.insert(_addr);
+
     auto it = cacheUTXO.find(_addr);
     if (it == cacheUTXO.end())
     {
+        if (deadUTXO.count(_addr))
+            return nullptr;
+
         std::string stateBack = stateUTXO.at(_addr);
         LogPrint("TesraState::stateBack ", "%s", stateBack); 
         if (stateBack.empty())
@@ -448,11 +517,226 @@ Vin *TesraState::vin(dev::Address const &_addr)
 
 
 
+void TesraState::captureWrites(TxAccessSet &_access)
+{
+    for (auto const &i : m_cache)
+    {
+        if (!i.second.isDirty())
+            continue;
+
+        std::string before = m_state.at(i.first);
+        bool changed = before.empty() ? i.second.isAlive() : !i.second.isAlive();
+        if (!changed && i.second.isAlive())
+        {
+            dev::RLP r(before);
+            changed = r[0].toInt<dev::u256>() != i.second.nonce() || r[1].toInt<dev::u256>() != i.second.balance() ||
+                      r[3].toHash<dev::h256>() != i.second.codeHash() || i.second.hasNewCode();
+        }
+        if (changed)
+            _access.writtenAccounts.insert(i.first);
+        _access.accounts[i.first] = i.second;
+    }
+    for (auto const &c : m_changeLog)
+    {
+        if (c.kind == dev::eth::detail::Change::Storage)
+            _access.writtenSlots.insert(std::make_pair(c.address, c.key));
+    }
+    for (auto const &i : cacheUTXO)
+    {
+        std::string before = stateUTXO.at(i.first);
+        bool changed = before.empty() ? i.second.alive != 0 : true;
+        if (!before.empty())
+        {
+            dev::RLP r(before);
+            changed = r[0].toHash<dev::h256>() != i.second.hash || r[1].toInt<uint32_t>() != i.second.nVout ||
+                      r[2].toInt<dev::u256>() != i.second.value || r[3].toInt<uint8_t>() != i.second.alive;
+        }
+        if (changed)
+            _access.writtenUTXO.insert(i.first);
+    }
+    for (auto const &i : cacheUTXO)
+        _access.utxo[i.first] = i.second;
+}
+
+void TesraState::applyAccessSet(const TxAccessSet &_access)
+{
+    for (auto const &i : _access.accounts)
+    {
+        const dev::eth::Account &acc = i.second;
+        auto it = m_cache.find(i.first);
+        if (acc.isAlive() && !acc.hasNewCode() && it != m_cache.end() && it->second.isAlive())
+        {
+            
+            
+            it->second.setNonce(acc.nonce());
+            it->second.addBalance(acc.balance() - it->second.balance());
+            for (auto const &j : acc.storageOverlay())
+                it->second.setStorage(j.first, j.second);
+        } else if (acc.isAlive() && !acc.hasNewCode() && acc.baseRoot() != storageRoot(i.first))
+        {
+            
+            
+            dev::eth::Account rebased(acc.nonce(), acc.balance(), storageRoot(i.first), acc.codeHash(),
+                                      dev::eth::Account::Changed);
+            for (auto const &j : acc.storageOverlay())
+                rebased.setStorage(j.first, j.second);
+            m_cache[i.first] = rebased;
+        } else
+        {
+            m_cache[i.first] = acc;
+        }
+        m_nonExistingAccountsCache.erase(i.first);
+    }
+    for (auto const &i : _access.utxo)
+        cacheUTXO[i.first] = i.second;
+
+    endTransaction();
+}
+
+void TesraState::endTransaction()
+{
+    if (deferCommit)
+    {
+        for (auto it = cacheUTXO.begin(); it != cacheUTXO.end();)
+        {
+            if (it->second.alive == 0)
+            {
+                deadUTXO.insert(it->first);
+                it = cacheUTXO.erase(it);
+            } else
+            {
+                ++it;
+            }
+        }
+        settle();
+        return;
+    }
+
+    tesra::commit(cacheUTXO, stateUTXO, m_cache);
+    cacheUTXO.clear();
+    commit(State::CommitBehaviour::KeepEmptyAccounts);
+}
+
+void TesraState::revertTransaction(size_t _savepoint, std::unordered_map<dev::Address, Vin> const &_cacheUTXO)
+{
+    if (!deferCommit)
+    {
+        m_cache.clear();
+        cacheUTXO.clear();
+        return;
+    }
+
+    restoreKilled();
+    rollback(_savepoint);
+    cacheUTXO = _cacheUTXO;
+}
+
+void TesraState::restoreKilled()
+{
+    for (auto const &i : killedAccounts)
+        m_cache[i.first] = i.second;
+    killedAccounts.clear();
+}
+
+void TesraState::setDeferredCommit(bool _defer)
+{
+    if (deferCommit && !_defer)
+    {
+        setRoot(rootHash());
+        setRootUTXO(rootHashUTXO());
+    }
+    deferCommit = _defer;
+}
+
+void TesraState::commitDeferredUTXO()
+{
+    for (const dev::Address &a : deadUTXO)
+    {
+        if (!cacheUTXO.count(a))
+            stateUTXO.remove(a);
+    }
+    deadUTXO.clear();
+    tesra::commit(cacheUTXO, stateUTXO, m_cache);
+    cacheUTXO.clear();
+}
+
+void TesraState::commitBlock(bool _snapshot)
+{
+    if (deferCommit)
+    {
+        commitDeferredUTXO();
+        if (_snapshot)
+            commitSnapshot(State::CommitBehaviour::KeepEmptyAccounts);
+        else
+            commit(State::CommitBehaviour::KeepEmptyAccounts);
+    }
+    db().commit();
+    dbUTXO.commit();
+}
+
+TesraState::BlockSavepoint TesraState::blockSavepoint() const
+{
+    return BlockSavepoint{savepoint(), cacheUTXO, deadUTXO};
+}
+
+void TesraState::rollbackBlock(BlockSavepoint const &_savepoint)
+{
+    rollback(_savepoint.changes);
+    cacheUTXO = _savepoint.cacheUTXO;
+    deadUTXO = _savepoint.deadUTXO;
+}
+
+void TesraState::hashBlock()
+{
+    if (!deferCommit)
+        return;
+    commitDeferredUTXO();
+    commit(State::CommitBehaviour::KeepEmptyAccounts);
+}
+
+bool TxAccessSet::conflictsWith(const TxAccessSet &writes) const
+{
+    for (const dev::Address &a : readAccounts)
+        if (writes.writtenAccounts.count(a))
+            return true;
+    for (const std::pair<dev::Address, dev::u256> &k : readSlots)
+        if (writes.writtenSlots.count(k))
+            return true;
+    for (const dev::Address &a : readUTXO)
+        if (writes.writtenUTXO.count(a))
+            return true;
+    return false;
+}
+
+void TxAccessSet::mergeWrites(const TxAccessSet &other)
+{
+    writtenAccounts.insert(other.writtenAccounts.begin(), other.writtenAccounts.end());
+    writtenSlots.insert(other.writtenSlots.begin(), other.writtenSlots.end());
+    writtenUTXO.insert(other.writtenUTXO.begin(), other.writtenUTXO.end());
+}
+
+void TxAccessSet::clear()
+{
+    readAccounts.clear();
+    readSlots.clear();
+    readUTXO.clear();
+    writtenAccounts.clear();
+    writtenSlots.clear();
+    writtenUTXO.clear();
+    accounts.clear();
+    utxo.clear();
+    readBlockInfo = false;
+}
+
 void TesraState::kill(dev::Address _addr)
 {
     
     if (auto a = account(_addr))
+    {
+        if (deferCommit)
+            killedAccounts.emplace(_addr, *a);
         a->kill();
+    }
     if (auto v = vin(_addr))
         v->alive = 0;
 }
@@ -513,7 +797,11 @@ void TesraState::deleteAccounts(std::set<dev::Address> &addrs)
     {
         dev::eth::Account *acc = const_cast<dev::eth::Account *>(account(addr));
         if (acc)
+        {
+            if (deferCommit)
+                killedAccounts.emplace(addr, *acc);
             acc->kill();
+        }
         Vin *in = const_cast<Vin *>(vin(addr));
         if (in)
             in->alive = 0;
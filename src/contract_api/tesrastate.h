@@ -72,6 +72,49 @@ namespace tesra
 
 class CondensingTX;
 
+/**
+ * What one contract transaction read and wrote, recorded while TesraState executes it. Reads are
+ * collected as they happen; writes, together with the dirty accounts and contract UTXOs the
+ * transaction is about to commit, are captured just before the commit. Capturing several
+ * transactions into one set keeps the latest value of each account and UTXO.
+ */
+struct TxAccessSet : public dev::eth::StateAccessObserver
+{
+    std::set<dev::Address> readAccounts;
+    std::set<std::pair<dev::Address, dev::u256>> readSlots;
+    std::set<dev::Address> readUTXO;
+
+    std::set<dev::Address> writtenAccounts;
+    std::set<std::pair<dev::Address, dev::u256>> writtenSlots;
+    std::set<dev::Address> writtenUTXO;
+
+    std::unordered_map<dev::Address, dev::eth::Account> accounts;
+    std::unordered_map<dev::Address, Vin> utxo;
+
+    bool readBlockInfo = false;
+
+    void onAccount(dev::Address const &_address) override
+    {
+        readAccounts.insert(_address);
+    }
+
+    void onStorage(dev::Address const &_address, dev::u256 const &_key) override
+    {
+        readSlots.insert(std::make_pair(_address, _key));
+    }
+
+    void onBlockInfo() override
+    {
+        readBlockInfo = true;
+    }
+
+    bool conflictsWith(const TxAccessSet &writes) const;
+
+    void mergeWrites(const TxAccessSet &other);
+
+    void clear();
+};
+
 enum eExtendDataType {
     EXT_DATA_STRING     = 0x00,     
     EXT_DATA_DOUBLE     = 0x01,     
@@ -91,8 +134,69 @@ enum eExtendDataType {
     EXT_DATA_RESERVED   = 0x0f,     
 };
 
+// Reads the extended data TESRAINFO returns, taking cs_main around the chain reads.
 bool getData(uint32_t _height, const std::string & _key, eExtendDataType & _type, std::vector<uint8_t>& _value, dev::Address const& _owner = dev::Address());
 
+/**
+ * Keeps getData from reading the chain on the calling thread while it is open. Speculative
+ * executions run on workers the block connecting thread waits for while holding cs_main, an
+ * execution that reached TESRAINFO is discarded and runs again in block order.
+ */
+class ChainDataBlocker
+{
+
+public:
+
+    ChainDataBlocker();
+
+    ~ChainDataBlocker();
+
+    bool reached() const
+    {
+        return fReached;
+    }
+
+    // True when a blocker is open on the calling thread, which then counts as reached.
+    static bool block();
+
+private:
+
+    ChainDataBlocker(ChainDataBlocker const &) = delete;
+
+    ChainDataBlocker &operator=(ChainDataBlocker const &) = delete;
+
+    ChainDataBlocker *previous;
+    bool fReached = false;
+
+};
+
+/**
+ * Hides the blocks above nHeight from getData on the calling thread while it is open, so a
+ * read-only call that runs without cs_main sees the chain of the block it executes on.
+ */
+class ChainDataHeight
+{
+
+public:
+
+    explicit ChainDataHeight(int nHeight);
+
+    ~ChainDataHeight();
+
+    // Whether the block at height may be read on the calling thread.
+    static bool visible(uint32_t height);
+
+private:
+
+    ChainDataHeight(ChainDataHeight const &) = delete;
+
+    ChainDataHeight &operator=(ChainDataHeight const &) = delete;
+
+    ChainDataHeight *previous;
+    int nHeight;
+
+};
+
 class TesraState : public dev::eth::State
 {
 
@@ -103,6 +207,12 @@ public:
     TesraState(dev::u256 const &_accountStartNonce, dev::OverlayDB const &_db, const std::string &_path,
               dev::eth::BaseState _bs = dev::eth::BaseState::PreExisting);
 
+    TesraState(TesraState const &_s);
+
+    // Read-only view of the committed state of _s at the given roots. It shares the databases of
+    // _s but no cache or pending change, so it can be used on another thread while _s moves on.
+    TesraState(TesraState const &_s, dev::h256 const &_root, dev::h256 const &_rootUTXO);
+
     ResultExecute
     execute(dev::eth::EnvInfo const &_envInfo, dev::eth::SealEngineFace const &_sealEngine, TesraTransaction const &_t,
             dev::eth::Permanence _p = dev::eth::Permanence::Committed, dev::eth::OnOpFunc const &_onOp = OnOpFunc());
@@ -110,6 +220,7 @@ public:
     void setRootUTXO(dev::h256 const &_r)
     {
         cacheUTXO.clear();
+        deadUTXO.clear();
         stateUTXO.setRoot(_r);
     }
 
@@ -125,6 +236,49 @@ public:
 
     std::unordered_map<dev::Address, Vin> vins() const; 
 
+    void setAccessSet(TxAccessSet *_access)
+    {
+        access = _access;
+        setAccessObserver(_access);
+    }
+
+    void applyAccessSet(const TxAccessSet &_access);
+
+    /**
+     * In deferred commit mode committed transactions leave their changes in the account and UTXO
+     * caches instead of hashing both tries and the receipts carry the root the block started
+     * from. commitBlock() writes everything at once; leaving the mode drops what was not written.
+     * With _snapshot it also stages the changes in the state snapshot, if there is one. They are
+     * written by its flush() once the block is accepted or dropped by its discard().
+     */
+    void setDeferredCommit(bool _defer);
+
+    bool deferredCommit() const
+    {
+        return deferCommit;
+    }
+
+    void commitBlock(bool _snapshot = true);
+
+    /**
+     * Savepoint spanning whole transactions, for a block template built in deferred commit mode
+     * with setKeepChanges(true): the change log position and the contract UTXOs changed so far.
+     */
+    struct BlockSavepoint
+    {
+        size_t changes;
+        std::unordered_map<dev::Address, Vin> cacheUTXO;
+        std::set<dev::Address> deadUTXO;
+    };
+
+    BlockSavepoint blockSavepoint() const;
+
+    void rollbackBlock(BlockSavepoint const &_savepoint);
+
+    /// Hashes the block's changes into both tries in memory, leaving the databases and the state
+    /// snapshot alone. Used to get the roots of a block template.
+    void hashBlock();
+
     dev::OverlayDB const &dbUtxo() const
     {
         return dbUTXO;
@@ -163,6 +317,15 @@ private:
 
     void printfErrorLog(const dev::eth::TransactionException er);
 
+    void captureWrites(TxAccessSet &_access);
+
+    void endTransaction();
+
+    void revertTransaction(size_t _savepoint, std::unordered_map<dev::Address, Vin> const &_cacheUTXO);
+    void commitDeferredUTXO();
+
+    void restoreKilled();
+
     dev::Address newAddress;   
 
     std::vector<TransferInfo> transfers;
@@ -172,6 +335,14 @@ private:
     dev::eth::SecureTrieDB<dev::Address, dev::OverlayDB> stateUTXO;
 
     std::unordered_map<dev::Address, Vin> cacheUTXO;
+
+    TxAccessSet *access = nullptr;
+
+    bool deferCommit = false;
+
+    std::set<dev::Address> deadUTXO;
+
+    std::unordered_map<dev::Address, dev::eth::Account> killedAccounts;
 };
 
 
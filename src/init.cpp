@@ -518,6 +518,25 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-blockmaxsize=<n>", strprintf(_("Set maximum block size in bytes (default: %d)"), DEFAULT_BLOCK_MAX_SIZE));
     strUsage += HelpMessageOpt("-blockprioritysize=<n>", strprintf(_("Set maximum size of high-priority/low-fee transactions in bytes (default: %d)"), DEFAULT_BLOCK_PRIORITY_SIZE));
 
+    strUsage += HelpMessageGroup(_("Smart contract options:"));
+    strUsage += HelpMessageOpt("-evmanalysiscache=<n>", strprintf(_("Maximum memory used to cache EVM code analysis per code hash in megabytes, 0 to disable (default: %u)"), DEFAULT_EVM_ANALYSIS_CACHE));
+    strUsage += HelpMessageOpt("-trienodecache=<n>", strprintf(_("Maximum memory used to cache contract state and UTXO trie nodes in megabytes, 0 to disable (default: %u)"), DEFAULT_TRIE_NODE_CACHE));
+    strUsage += HelpMessageOpt("-evmcodecache=<n>", strprintf(_("Maximum memory used to cache contract bytecode per code hash in megabytes, 0 to disable (default: %u)"), DEFAULT_EVM_CODE_CACHE));
+    strUsage += HelpMessageOpt("-vm=<kind>", strprintf(_("EVM engine used to execute contracts, <kind> can be interpreter or threaded (default: %s)"), DEFAULT_VM_KIND));
+    strUsage += HelpMessageOpt("-contractexecthreads=<n>", strprintf(_("Speculatively execute the contract transactions of a block on <n> threads, conflicting transactions are executed again in block order, 0 = off, max %d (default: %d)"), MAX_CONTRACT_EXEC_THREADS, DEFAULT_CONTRACT_EXEC_THREADS));
+    strUsage += HelpMessageOpt("-contractdefercommit", strprintf(_("Keep the contract state changes of a block in memory and write the state tries once per block (default: %u)"), DEFAULT_CONTRACT_DEFER_COMMIT));
+    strUsage += HelpMessageOpt("-contractsnapshot", strprintf(_("Keep a flat copy of the contract state next to the state trie and read accounts and storage from it, implies -contractdefercommit (default: %u)"), DEFAULT_CONTRACT_SNAPSHOT));
+    strUsage += HelpMessageOpt("-contractpreexec=<n>", strprintf(_("Execute contract transactions ahead when they enter the mempool and keep the outcome of up to <n> of them for the block templates of a staking node, 0 to disable (default: %u)"), DEFAULT_CONTRACT_PREEXEC_CACHE));
+    strUsage += HelpMessageOpt("-record-log-opcodes", _("Record every EVM instruction executed to vmExecTrace.bin in the data directory, convert it to JSON with tesra-vmtrace"));
+    strUsage += HelpMessageOpt("-vmtracemaxsize=<n>", strprintf(_("Start a new VM trace file when it exceeds <n> megabytes, the previous one is kept as vmExecTrace.bin.old, 0 = unlimited (default: %u)"), DEFAULT_VM_TRACE_MAX_SIZE));
+    strUsage += HelpMessageOpt("-vmprofile", strprintf(_("Profile EVM instructions and contracts of connected blocks, see getvmprofile (default: %u)"), DEFAULT_VM_PROFILE));
+    strUsage += HelpMessageOpt("-receiptcache=<n>", strprintf(_("Maximum memory used to cache contract transaction receipts in megabytes (default: %u)"), DEFAULT_RECEIPT_CACHE));
+    strUsage += HelpMessageOpt("-logtopicindex", strprintf(_("Maintain an index of event logs by contract and topic, used by indexed searchlogs calls, requires -logevents (default: %u)"), DEFAULT_LOG_TOPIC_INDEX));
+    strUsage += HelpMessageOpt("-loadcontractstate=<file>", _("Import a contract state dump written by dumpcontractstate at the current chain tip on startup"));
+    strUsage += HelpMessageOpt("-prunestate=<n>", strprintf(_("Delete contract state that is not reachable from the last <n> blocks in the background, 0 = off, min %d (default: %d)"), MIN_PRUNE_STATE_DEPTH, DEFAULT_PRUNE_STATE));
+    strUsage += HelpMessageOpt("-stateviewcache=<n>", strprintf(_("Number of past contract states kept open for RPC queries by block height (default: %u)"), DEFAULT_STATE_VIEW_CACHE));
+    strUsage += HelpMessageOpt("-receiptcompression", strprintf(_("Compress contract transaction receipts with LZ4 when they are written (default: %u)"), DEFAULT_RECEIPT_COMPRESSION));
+
     strUsage += HelpMessageGroup(_("RPC server options:"));
     strUsage += HelpMessageOpt("-server", _("Accept command line and JSON-RPC commands"));
     strUsage += HelpMessageOpt("-rest", strprintf(_("Accept public REST requests (default: %u)"), 0));
@@ -1411,14 +1430,32 @@ bool AppInit2(boost::thread_group& threadGroup)
                 if (!GetBoolArg("-logevents", true))
                 {
                     pblocktree->WipeHeightIndex();
+                    pblocktree->WipeLogBlooms();
                     fLogEvents = false;
 
                     pblocktree->WriteFlag("logevents", fLogEvents);
                 }
 
-                
-                
-                
+                if (fLogTopicIndex != GetBoolArg("-logtopicindex", DEFAULT_LOG_TOPIC_INDEX) && !fLogTopicIndex) {
+                    strLoadError = _("You need to rebuild the database using -reindex to enable -logtopicindex");
+                    break;
+                }
+
+                if (fLogTopicIndex && (!fLogEvents || !GetBoolArg("-logtopicindex", DEFAULT_LOG_TOPIC_INDEX)))
+                {
+                    pblocktree->WipeLogTopicIndex();
+                    fLogTopicIndex = false;
+
+                    pblocktree->WriteFlag("logtopicindex", fLogTopicIndex);
+                }
+
+                if (mapArgs.count("-loadcontractstate"))
+                {
+                    std::string errinfo;
+                    uiInterface.InitMessage(_("Loading contract state..."));
+                    if (!LoadContractState(GetArg("-loadcontractstate", ""), errinfo))
+                        return InitError(strprintf(_("Error loading contract state: %s"), errinfo));
+                }
 
                 ContractInit();
 
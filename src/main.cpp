@@ -77,6 +77,7 @@ bool fReindex = false;
 bool fTxIndex = true;
 bool fAddrIndex = false;
 bool fLogEvents = true;
+bool fLogTopicIndex = false;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
 bool fVerifyingBlocks = false;
@@ -1908,6 +1909,9 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 
         
         pool.addUnchecked(hash, entry);
+
+        if (tx.HasCreateOrCall())
+            PreExecuteContractTx(tx);
     }
 
     SyncWithWallets(tx, NULL);
@@ -3136,10 +3140,18 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
 
     UpdateState(hashStateRoot, hashUTXORoot);
 
+    if (pfClean == NULL)
+    {
+        RevertStateSnapshot();
+    }
+
     if (pfClean == NULL && fLogEvents)
     {
         DeleteResults(block.vtx);
         pblocktree->EraseHeightIndex(pindex->nHeight);
+        pblocktree->EraseLogBloom(pindex->nHeight);
+        if (fLogTopicIndex)
+            pblocktree->EraseLogTopicIndex(pindex->nHeight);
     }
 
 
@@ -3535,6 +3547,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     
     std::map<dev::Address, std::pair<CHeightTxIndexKey, std::vector<uint256>>> heightIndexes;
+    dev::eth::LogBloom blockBloom;
+    std::vector<std::pair<CLogTopicIndexKey, uint256>> topicIndexes;
+    std::unique_ptr<BlockExecContext> pexecContext;
+    std::unique_ptr<ContractBlockPrepass> pprepass;
 
     
 
@@ -3697,8 +3713,18 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             LogPrintf("ConnectBlock call ContractTxConnectBlock: vtx addr %p\n", &block.vtx);
             LogPrintf("ConnectBlock call ContractTxConnectBlock: vtx addr %p\n", &(block.vtx));
 
-            if (!ContractTxConnectBlock(tx, i, &view, block, pindex->nHeight,
-                                                          bcer, fLogEvents, fJustCheck, heightIndexes,
+            if (!pexecContext)
+            {
+                pexecContext.reset(new BlockExecContext(block, pindex->nHeight));
+                if (!fJustCheck)
+                    pexecContext->startProfile();
+                pprepass.reset(new ContractBlockPrepass(block, &view));
+                pexecContext->deferCommit();
+                pexecContext->speculate(&view, *pprepass, GetBlockGasLimit(pindex->nHeight + 1));
+            }
+
+            if (!ContractTxConnectBlock(tx, i, &view, block, pindex->nHeight, *pexecContext, *pprepass,
+                                                          bcer, fLogEvents, fJustCheck, heightIndexes, blockBloom, topicIndexes,
                                                           level, errinfo,countCumulativeGasUsed,blockGasUsed))
             {
                 LogPrintStr("ConnectBlock -> ContractTxConnectBlock failed\n");
@@ -3740,6 +3766,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
     }
 
+    if (pexecContext)
+    {
+        pexecContext->commitBlock(!fJustCheck);
+        pexecContext->finishProfile();
+    }
+
     std::list<CZerocoinMint> listMints;
     bool fFilterInvalid = false;
     BlockToZerocoinMintList(block, listMints, fFilterInvalid);
@@ -3790,6 +3822,15 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     int64_t nTime1 = GetTimeMicros();
     nTimeConnect += nTime1 - nTimeStart;
+    LogPrint("bench", "      - EVM code analysis cache: %u hits, %u misses, %u entries\n",
+             dev::eth::CodeAnalysisCache::instance().hits(), dev::eth::CodeAnalysisCache::instance().misses(),
+             dev::eth::CodeAnalysisCache::instance().size());
+    LogPrint("bench", "      - Trie node cache: %u hits, %u misses, %u entries, %.2fMiB\n",
+             dev::TrieNodeCache::instance().hits(), dev::TrieNodeCache::instance().misses(),
+             dev::TrieNodeCache::instance().size(), dev::TrieNodeCache::instance().memoryUsage() * (1.0 / (1 << 20)));
+    LogPrint("bench", "      - EVM code cache: %u hits, %u misses, %u entries, %.2fMiB\n",
+             dev::eth::CodeCache::instance().hits(), dev::eth::CodeCache::instance().misses(),
+             dev::eth::CodeCache::instance().size(), dev::eth::CodeCache::instance().memoryUsage() * (1.0 / (1 << 20)));
    
 
 
@@ -3998,6 +4039,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             if (!pblocktree->WriteHeightIndex(e.second.first, e.second.second))
                 return AbortNode(state.GetRejectReason(), "Failed to write height index");
         }
+        if (!heightIndexes.empty() && !pblocktree->WriteLogBloom(pindex->nHeight, blockBloom))
+            return AbortNode(state.GetRejectReason(), "Failed to write log bloom");
+        if (fLogTopicIndex && !topicIndexes.empty() && !pblocktree->WriteLogTopicIndex(pindex->nHeight, topicIndexes))
+            return AbortNode(state.GetRejectReason(), "Failed to write log topic index");
     }
 
     if (fTxIndex)
@@ -4030,6 +4075,16 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         CommitResults();
     }
 
+    if (pexecContext)
+    {
+        pexecContext->acceptBlock();
+    }
+
+    if (pindex->IsContractEnabled())
+    {
+        KeepStateRoots(pindex->nHeight);
+    }
+
     return true;
 }
 
@@ -4264,6 +4319,7 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
     
     list<CTransaction> txConflicted;
     mempool.removeForBlock(pblock->vtx, pindexNew->nHeight, txConflicted);
+    ForgetPreExecutedTxs(pblock->vtx);
     mempool.check(pcoinsTip);
     
     UpdateTip(pindexNew);
@@ -5791,6 +5847,9 @@ bool static LoadBlockIndexDB(string& strError)
     pblocktree->ReadFlag("logevents", fLogEvents);
     LogPrintf("logevents %s", fLogEvents ? "enabled" : "disabled");
 
+    pblocktree->ReadFlag("logtopicindex", fLogTopicIndex);
+    LogPrintf("LoadBlockIndexDB(): log topic index %s\n", fLogTopicIndex ? "enabled" : "disabled");
+
     
     pblocktree->WriteFlag("shutdown", false);
 
@@ -5948,6 +6007,9 @@ bool InitBlockIndex()
     
     fAddrIndex = GetBoolArg("-addrindex", false);
     paddressmap->WriteEnable(fAddrIndex);
+
+    fLogTopicIndex = fLogEvents && GetBoolArg("-logtopicindex", DEFAULT_LOG_TOPIC_INDEX);
+    pblocktree->WriteFlag("logtopicindex", fLogTopicIndex);
     LogPrintf("Initializing databases...\n");
 
     
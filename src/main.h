@@ -155,6 +155,7 @@ extern int nScriptCheckThreads;
 extern bool fTxIndex;
 extern bool fAddrIndex;
 extern bool fLogEvents;
+extern bool fLogTopicIndex;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
 extern unsigned int nCoinCacheSize;
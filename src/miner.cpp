@@ -71,6 +71,64 @@ public:
     }
 };
 
+// Contract transaction held back from the priority heap of CreateNewBlock. Candidates are taken
+// once the other transactions are in, highest effective gas price first.
+class CContractCandidate
+{
+public:
+    const CTransaction* ptx;
+    double dPriority;
+    CFeeRate feeRate;
+    uint64_t nGasLimit;
+    uint64_t nGasPrice;
+    // The contract outputs, handed to AttemptToAddContractToBlock so they are not decoded again
+    ExtractTesraTX extracted;
+
+    CContractCandidate(const CTransaction* ptxIn, double dPriorityIn, CFeeRate feeRateIn, uint64_t nGasLimitIn, uint64_t nGasPriceIn,
+                       ExtractTesraTX&& extractedIn)
+        : ptx(ptxIn), dPriority(dPriorityIn), feeRate(feeRateIn), nGasLimit(nGasLimitIn), nGasPrice(nGasPriceIn),
+          extracted(std::move(extractedIn))
+    {
+    }
+};
+
+// Orders a heap of contract candidates by gas price weighted by gas limit, then by the smaller gas
+// limit so more of the block gas is left for the next candidates.
+class ContractCandidateCompare
+{
+public:
+    bool operator()(const CContractCandidate& a, const CContractCandidate& b)
+    {
+        if (a.nGasPrice != b.nGasPrice)
+            return a.nGasPrice < b.nGasPrice;
+        if (a.nGasLimit != b.nGasLimit)
+            return a.nGasLimit > b.nGasLimit;
+        return a.feeRate < b.feeRate;
+    }
+};
+
+// Decodes the contract outputs of tx into resultConverter, with their total gas limit and effective
+// gas price. False when they cannot be decoded and the transaction would be rejected anyway. The
+// inputs of tx are in view or in blockTxs, so the sender never has to be looked up on disk.
+static bool GetContractGas(const CTransaction& tx, CCoinsViewCache& view, const std::vector<CTransaction>& blockTxs,
+                           ExtractTesraTX& resultConverter, uint64_t& nGasLimit, uint64_t& nGasPrice)
+{
+    TesraTxConverter convert(tx, &view, &blockTxs);
+    if (!convert.extractionTesraTransactions(resultConverter))
+        return false;
+    dev::u256 gas = 0;
+    dev::u256 gasFee = 0;
+    for (const TesraTransaction& tesraTransaction : resultConverter.first) {
+        gas += tesraTransaction.gas();
+        gasFee += tesraTransaction.gas() * tesraTransaction.gasPrice();
+    }
+    if (gas == 0 || gas > dev::u256(INT64_MAX) || gasFee > dev::u256(INT64_MAX))
+        return false;
+    nGasLimit = (uint64_t)gas;
+    nGasPrice = (uint64_t)(gasFee / gas);
+    return true;
+}
+
 uint64_t nLastBlockTx = 0;
 uint64_t nLastBlockSize = 0;
 int64_t nLastCoinStakeSearchInterval = 0;
@@ -197,7 +255,8 @@ void RebuildRefundTransaction(CBlock *pblock,CAmount &nFees)
 }
 
 
-bool AttemptToAddContractToBlock(const CTransaction &iter, uint64_t minGasPrice,CBlockTemplate *pblockTemplate,uint64_t &nBlockSize,int &nBlockSigOps,uint64_t &nBlockTx,CCoinsViewCache &view,CAmount &nFees)
+bool AttemptToAddContractToBlock(const CTransaction &iter, uint64_t minGasPrice,CBlockTemplate *pblockTemplate,BlockExecContext &execContext,uint64_t &nBlockSize,int &nBlockSigOps,uint64_t &nBlockTx,CCoinsViewCache &view,CAmount &nFees,
+                                 const std::vector<TesraTransaction> *pTesraTransactions)
 {
 
     
@@ -209,10 +268,7 @@ bool AttemptToAddContractToBlock(const CTransaction &iter, uint64_t minGasPrice,
         return false;
     }
 
-    uint256 oldHashStateRoot;
-    uint256 oldHashUTXORoot;
-
-    GetState(oldHashStateRoot, oldHashUTXORoot);
+    TesraState::BlockSavepoint savepoint = execContext.savepoint();
 
     
     uint64_t nBlockWeight = nBlockSize;
@@ -220,15 +276,17 @@ bool AttemptToAddContractToBlock(const CTransaction &iter, uint64_t minGasPrice,
 
     CBlock *pblock = &pblockTemplate->block;
 
-    TesraTxConverter convert(iter, NULL, &pblock->vtx);
-
     ExtractTesraTX resultConverter;
-    if(!convert.extractionTesraTransactions(resultConverter)){
-        
-        
-        return false;
+    if (!pTesraTransactions) {
+        TesraTxConverter convert(iter, &view, &pblock->vtx);
+        if(!convert.extractionTesraTransactions(resultConverter)){
+            
+            
+            return false;
+        }
+        pTesraTransactions = &resultConverter.first;
     }
-    std::vector<TesraTransaction> tesraTransactions = resultConverter.first;
+    const std::vector<TesraTransaction>& tesraTransactions = *pTesraTransactions;
     dev::u256 txGas = 0;
     for(TesraTransaction tesraTransaction : tesraTransactions){
         txGas += tesraTransaction.gas();
@@ -246,26 +304,33 @@ bool AttemptToAddContractToBlock(const CTransaction &iter, uint64_t minGasPrice,
             return false;
         }
     }
-    
-    ByteCodeExec exec(*pblock, tesraTransactions, hardBlockGasLimit);
-    if(!exec.performByteCode()){
-        
-        UpdateState(oldHashStateRoot,oldHashUTXORoot);
-        return false;
-    }
-
-
 
+    // A pre-execution that still holds is applied once the transaction is known to fit, the
+    // rollbacks below have nothing to undo for it
+    std::shared_ptr<const ContractPreExec> preExec = execContext.preExecuted(iter, tesraTransactions, hardBlockGasLimit);
     ByteCodeExecResult testExecResult;
-    if(!exec.processingResults(testExecResult)){
-        UpdateState(oldHashStateRoot,oldHashUTXORoot);
-        return false;
+    if (preExec) {
+        if (!preExec->fValid)
+            return false;
+        testExecResult = preExec->result;
+    } else {
+        ByteCodeExec exec(execContext, tesraTransactions, hardBlockGasLimit);
+        if(!exec.performByteCode()){
+            
+            execContext.rollback(savepoint);
+            return false;
+        }
+
+        if(!exec.processingResults(testExecResult)){
+            execContext.rollback(savepoint);
+            return false;
+        }
     }
 
 
     if(bceResult.usedGas + testExecResult.usedGas > softBlockGasLimit){
         
-        UpdateState(oldHashStateRoot,oldHashUTXORoot);
+        execContext.rollback(savepoint);
 
         return false;
     }
@@ -309,12 +374,13 @@ bool AttemptToAddContractToBlock(const CTransaction &iter, uint64_t minGasPrice,
     if (nBlockSigOpsCost > (int)MAX_BLOCK_SIGOPS_CURRENT ||
             nBlockWeight > GetArg("-blockmaxsize", DEFAULT_BLOCK_MAX_SIZE)) {
         
-        UpdateState(oldHashStateRoot,oldHashUTXORoot);
+        execContext.rollback(savepoint);
 
         return false;
     }
 
-    
+    if (preExec)
+        execContext.applyPreExecuted(*preExec);
 
     
     bceResult.usedGas += testExecResult.usedGas;
@@ -608,19 +674,59 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
 
         vector<CBigNum> vBlockSerials;
         vector<CBigNum> vTxSerials;
+        std::unique_ptr<BlockExecContext> pexecContext;
 
-        
-        while (!vecPriority.empty()) {
-
-
+        vector<CContractCandidate> vecContract;
+        ContractCandidateCompare contractComparer;
+        bool fContractSelection = chainActive.Tip()->IsContractEnabled();
 
-            
-            double dPriority = vecPriority.front().get<0>();
-            CFeeRate feeRate = vecPriority.front().get<1>();
-            const CTransaction& tx = *(vecPriority.front().get<2>());
+        
+        while (!vecPriority.empty() || !vecContract.empty()) {
+
+            double dPriority;
+            CFeeRate feeRate;
+            const CTransaction* ptx;
+            ExtractTesraTX extracted;
+            bool fExtracted = false;
+            if (!vecPriority.empty()) {
+                dPriority = vecPriority.front().get<0>();
+                feeRate = vecPriority.front().get<1>();
+                ptx = vecPriority.front().get<2>();
+
+                std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
+                vecPriority.pop_back();
+
+                // Contract transactions wait for the contract stage below
+                if (fContractSelection && ptx->HasCreateOrCall()) {
+                    uint64_t nGasLimit, nGasPrice;
+                    ExtractTesraTX extracted;
+                    if (GetContractGas(*ptx, view, pblock->vtx, extracted, nGasLimit, nGasPrice) && nGasPrice >= minGasPrice && nGasLimit <= txGasLimit) {
+                        vecContract.push_back(CContractCandidate(ptx, dPriority, feeRate, nGasLimit, nGasPrice, std::move(extracted)));
+                        std::push_heap(vecContract.begin(), vecContract.end(), contractComparer);
+                    }
+                    continue;
+                }
+            } else {
+                // Candidates only fit while their whole gas limit is below the soft limit, stop
+                // once no transaction could fit anymore
+                uint64_t nGasLeft = softBlockGasLimit > bceResult.usedGas ? softBlockGasLimit - bceResult.usedGas : 0;
+                if (nGasLeft < MINIMUM_GAS_LIMIT)
+                    break;
 
-            std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            vecPriority.pop_back();
+                const CContractCandidate& candidate = vecContract.front();
+                dPriority = candidate.dPriority;
+                feeRate = candidate.feeRate;
+                ptx = candidate.ptx;
+                bool fFits = candidate.nGasLimit <= nGasLeft;
+
+                std::pop_heap(vecContract.begin(), vecContract.end(), contractComparer);
+                extracted = std::move(vecContract.back().extracted);
+                fExtracted = true;
+                vecContract.pop_back();
+                if (!fFits)
+                    continue;
+            }
+            const CTransaction& tx = *ptx;
 
             
             unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
@@ -696,10 +802,14 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
             
             
             if (tx.HasCreateOrCall()) {
-                if(!AttemptToAddContractToBlock(tx, minGasPrice,pblocktemplate.get(),nBlockSize,nBlockSigOps,nBlockTx,view, nFees))
+                if (!pexecContext)
+                {
+                    pexecContext.reset(new BlockExecContext(*pblock, 0, hardBlockGasLimit));
+                    pexecContext->buildTemplate();
+                }
+                if(!AttemptToAddContractToBlock(tx, minGasPrice,pblocktemplate.get(),*pexecContext,nBlockSize,nBlockSigOps,nBlockTx,view, nFees,
+                                                fExtracted ? &extracted.first : NULL))
                 {
-                    std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
-                    vecPriority.pop_back();
                     continue;
                 }
 
@@ -760,7 +870,10 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
             if(chainActive.Tip()->nHeight >= Params().Contract_StartHeight()) {
 
                 uint256 hashStateRoot, hashUTXORoot;
-                GetState(hashStateRoot, hashUTXORoot);
+                if (pexecContext)
+                    pexecContext->finishTemplate(hashStateRoot, hashUTXORoot);
+                else
+                    GetState(hashStateRoot, hashUTXORoot);
 
                 LogPrintf("CreateNewBlock: Populate state and utxo before RebuildRefundTransaction:\nstateroot:%s\nutxoRoot: %s\n", hashStateRoot.GetHex().c_str(), hashUTXORoot.GetHex().c_str());
                 CScript contract = CScript() << ParseHex(hashStateRoot.GetHex().c_str()) << ParseHex(hashUTXORoot.GetHex().c_str()) << OP_VM_STATE;
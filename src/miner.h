@@ -7,14 +7,17 @@
 #define BITCOIN_MINER_H
 
 #include <stdint.h>
+#include <vector>
 #include "primitives/transaction.h"
 
+class BlockExecContext;
 class CBlock;
 class CBlockHeader;
 class CBlockIndex;
 class CReserveKey;
 class CScript;
 class CWallet;
+class TesraTransaction;
 
 struct CBlockTemplate;
 
@@ -34,7 +37,9 @@ void UpdateTime(CBlockHeader* block, const CBlockIndex* pindexPrev);
 void BitcoinMiner(CWallet* pwallet, bool fProofOfStake);
 
 void RebuildRefundTransaction(CBlock *pblock, CAmount &nFees);
-bool AttemptToAddContractToBlock(const CTransaction &iter, uint64_t minGasPrice, CBlockTemplate *pblockTemplate, uint64_t &nBlockSize, int &nBlockSigOps, uint64_t &nBlockTx, CCoinsViewCache &view, CAmount &nFees);
+// pTesraTransactions, when given, are the contract outputs of iter decoded already.
+bool AttemptToAddContractToBlock(const CTransaction &iter, uint64_t minGasPrice, CBlockTemplate *pblockTemplate, BlockExecContext &execContext, uint64_t &nBlockSize, int &nBlockSigOps, uint64_t &nBlockTx, CCoinsViewCache &view, CAmount &nFees,
+                                 const std::vector<TesraTransaction> *pTesraTransactions = NULL);
 
 
 
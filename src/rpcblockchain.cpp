@@ -9,6 +9,9 @@
 #include "checkpoints.h"
 #include "clientversion.h"
 #include "contractconfig.h"
+#include "contract_api/statedump.h"
+#include "contract/libevm/VMProfile.h"
+#include "contract/libevmcore/Instruction.h"
 
 #include "main.h"
 #include "rpcserver.h"
@@ -1475,6 +1478,31 @@ UniValue verifychain(const UniValue& params, bool fHelp)
 }
 
 
+// Optional block number of the contract state calls, -1 or "latest" for the tip.
+static int ContractStateHeight(const UniValue& params, size_t index)
+{
+    int nHeight = -1;
+    if (params.size() > index)
+    {
+        if (params[index].isNum())
+            nHeight = params[index].get_int();
+        else if (!params[index].isStr() || params[index].get_str() != "latest")
+            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+    }
+    if (nHeight < -1)
+        throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+    return nHeight;
+}
+
+static std::shared_ptr<TesraState> ContractState(int nHeight)
+{
+    std::string errinfo;
+    std::shared_ptr<TesraState> state = GetStateAt(nHeight, errinfo);
+    if (!state)
+        throw JSONRPCError(RPC_INVALID_PARAMS, errinfo);
+    return state;
+}
+
 UniValue getaccountinfo(const UniValue& params, bool fHelp)
 {
     bool IsEnabled = (chainActive.Tip()->nVersion > ZEROCOIN_VERSION);
@@ -1483,17 +1511,18 @@ UniValue getaccountinfo(const UniValue& params, bool fHelp)
 
     if (fHelp || params.size() < 1)
         throw std::runtime_error(
-                "getaccountinfo \"address\"\n"
+                "getaccountinfo \"address\" ( blockNum )\n"
                 "\nArgument:\n"
-                "1. \"address\"          (string, required) The account address\n");
-
-    LOCK(cs_main);
+                "1. \"address\"          (string, required) The account address\n"
+                "2. \"blockNum\"         (number, optional) Number of block to get state from, \"latest\" keyword supported. Latest if not passed.\n");
 
     std::string strAddr = params[0].get_str();
     if (strAddr.size() != 40 || !IsHex(strAddr))
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address");
 
-    if (!AddressInUse(strAddr))
+    std::shared_ptr<TesraState> state = ContractState(ContractStateHeight(params, 1));
+
+    if (!AddressInUse(strAddr, state.get()))
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
 
     dev::Address addrAccount(strAddr);
@@ -1501,10 +1530,10 @@ UniValue getaccountinfo(const UniValue& params, bool fHelp)
     UniValue result(UniValue::VOBJ);
 
     result.push_back(Pair("address", strAddr));
-    result.push_back(Pair("balance", GetContractBalance(addrAccount)));
-    std::vector<uint8_t> code = GetContractCode(addrAccount);
+    result.push_back(Pair("balance", GetContractBalance(addrAccount, state.get())));
+    std::vector<uint8_t> code = GetContractCode(addrAccount, state.get());
 
-    std::map<dev::h256, std::pair<dev::u256, dev::u256>> storage = GetStorageByAddress(strAddr);
+    std::map<dev::h256, std::pair<dev::u256, dev::u256>> storage = GetStorageByAddress(strAddr, state.get());
 
     UniValue storageUV(UniValue::VOBJ);
     for (auto j: storage)
@@ -1522,7 +1551,7 @@ UniValue getaccountinfo(const UniValue& params, bool fHelp)
     uint32_t nVout;
     dev::u256 value;
     uint8_t alive;
-    if (GetContractVin(addrAccount, hash, nVout, value, alive))
+    if (GetContractVin(addrAccount, hash, nVout, value, alive, state.get()))
     {
         UniValue vin(UniValue::VOBJ);
         valtype vchHash(hash.asBytes());
@@ -1550,47 +1579,13 @@ UniValue getstorage(const UniValue& params, bool fHelp)
                 "2. \"blockNum\"         (string, optional) Number of block to get state from, \"latest\" keyword supported. Latest if not passed.\n"
                 "3. \"index\"            (number, optional) Zero-based index position of the storage\n");
 
-    LOCK(cs_main);
-
     std::string strAddr = params[0].get_str();
     if (strAddr.size() != 40 || !IsHex(strAddr))
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address");
 
-    if (params.size() > 1)
-    {
-        if (params[1].isNum())
-        {
-            auto blockNum = params[1].get_int();
-            if ((blockNum < 0 && blockNum != -1) || blockNum > chainActive.Height())
-                throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
-
-            if (blockNum != -1)
-            {
-                uint256 hashStateRoot;
-                uint256 hashUTXORoot;
-                CBlock block;
-                if (!ReadBlockFromDisk(block, chainActive[blockNum]))
-                {
-                    std::ostringstream stringStream;
-                    stringStream << "ReadBlockFromDisk failed at hegiht " << chainActive[blockNum]->nHeight << " hash: " << chainActive[blockNum]->GetBlockHash().ToString();
-                    throw JSONRPCError(RPC_INVALID_PARAMS, stringStream.str());
-                } else
-                {
-                    if(block.GetVMState(hashStateRoot, hashUTXORoot) == RET_VM_STATE_ERR){
-                        throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect GetVMState");
-                    }
-                }
-                SetTemporaryState(hashStateRoot, hashUTXORoot);
-                
-                
-            }
-        } else
-        {
-            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
-        }
-    }
+    std::shared_ptr<TesraState> state = ContractState(ContractStateHeight(params, 1));
 
-    if (!AddressInUse(strAddr))
+    if (!AddressInUse(strAddr, state.get()))
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
 
     UniValue result(UniValue::VOBJ);
@@ -1600,7 +1595,7 @@ UniValue getstorage(const UniValue& params, bool fHelp)
     if (onlyIndex)
         index = params[2].get_int();
 
-    std::map<dev::h256, std::pair<dev::u256, dev::u256>> storage = GetStorageByAddress(strAddr);
+    std::map<dev::h256, std::pair<dev::u256, dev::u256>> storage = GetStorageByAddress(strAddr, state.get());
     if (onlyIndex)
     {
         if (index >= storage.size())
@@ -1633,15 +1628,14 @@ UniValue callcontract(const UniValue& params, bool fHelp)
 
     if (fHelp || params.size() < 2)
         throw std::runtime_error(
-                "callcontract \"address\" \"data\" ( address )\n"
+                "callcontract \"address\" \"data\" ( address gasLimit blockNum )\n"
                 "\nArgument:\n"
                 "1. \"address\"          (string, required) The account address\n"
                 "2. \"data\"             (string, required) The data hex string\n"
                 "3. address              (string, optional) The sender address hex string\n"
                 "4. gasLimit  (numeric or string, optional) gasLimit, default: " +
-                i64tostr(DEFAULT_GAS_LIMIT_OP_SEND) + "\n");
-
-    LOCK(cs_main);
+                i64tostr(DEFAULT_GAS_LIMIT_OP_SEND) + "\n"
+                "5. blockNum             (numeric, optional) Number of block to execute the call on the state of, \"latest\" keyword supported. Latest if not passed.\n");
 
     std::string strAddr = params[0].get_str();
     std::string data = params[1].get_str();
@@ -1653,15 +1647,25 @@ UniValue callcontract(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address");
 
 
-    CBlockIndex * pBlockIndex = chainActive.Tip();
-    if (pBlockIndex->nHeight < Params().Contract_StartHeight())
-        throw JSONRPCError(RPC_INVALID_REQUEST, "contract not enabled.");
+    int nHeight = ContractStateHeight(params, 4);
+    if (nHeight >= 0)
+    {
+        if (!AddressInUse(strAddr, ContractState(nHeight).get()))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
+    } else
+    {
+        LOCK(cs_main);
 
-    if (!AddressInUse(strAddr))
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
+        CBlockIndex * pBlockIndex = chainActive.Tip();
+        if (pBlockIndex->nHeight < Params().Contract_StartHeight())
+            throw JSONRPCError(RPC_INVALID_REQUEST, "contract not enabled.");
+
+        if (!AddressInUse(strAddr))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
+    }
 
     string sender = "";
-    if (params.size() == 3)
+    if (params.size() > 2)
     {
         CBitcoinAddress btcSenderAddress(params[2].get_str());
         if (btcSenderAddress.IsValid())
@@ -1676,7 +1680,7 @@ UniValue callcontract(const UniValue& params, bool fHelp)
         }
     }
     uint64_t gasLimit = 0;
-    if (params.size() == 4)
+    if (params.size() > 3)
     {
         
         if (params[3].isNum())
@@ -1695,7 +1699,7 @@ UniValue callcontract(const UniValue& params, bool fHelp)
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("address", strAddr));
 
-    RPCCallContract(result, strAddr, ParseHex(data), sender, gasLimit);
+    RPCCallContract(result, strAddr, ParseHex(data), sender, gasLimit, nHeight);
 
     return result;
 }
@@ -1945,15 +1949,165 @@ private:
 
 
 
+/**
+ * One page of searchlogs results. A cursor "<height>:<n>" resumes after the first n results
+ * at that height. The order of results at one height does not change while the block is in the
+ * chain, so pages neither skip nor repeat results.
+ */
+class SearchLogsPage
+{
+public:
+    UniValue logs;
+
+    SearchLogsPage(const UniValue &limit, const UniValue &cursor) : logs(UniValue::VARR)
+    {
+        if (!limit.isNull())
+            nLimit = parseUInt(limit, 0);
+        if (!cursor.isNull() && !cursor.get_str().empty())
+        {
+            std::string str = cursor.get_str();
+            size_t sep = str.find(':');
+            int64_t height, skip;
+            if (sep == std::string::npos || !ParseInt64(str.substr(0, sep), &height) ||
+                !ParseInt64(str.substr(sep + 1), &skip) || height < 0 || skip < 0)
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+            nCursorHeight = height;
+            nCursorSkip = skip;
+        }
+        fPaged = nLimit > 0 || !cursor.isNull();
+    }
+
+    int CursorHeight() const { return nCursorHeight; }
+
+    /** Adds a result, returns false once the page is full. */
+    bool Push(int height, const TransactionReceiptInfo &receipt)
+    {
+        if (height != nHeight)
+        {
+            nHeight = height;
+            nAtHeight = 0;
+        }
+        if (height == nCursorHeight && nAtHeight < nCursorSkip)
+        {
+            nAtHeight++;
+            return true;
+        }
+        if (nLimit > 0 && logs.size() >= nLimit)
+        {
+            strNext = strprintf("%d:%u", height, nAtHeight);
+            return false;
+        }
+        nAtHeight++;
+
+        UniValue tri(UniValue::VOBJ);
+        transactionReceiptInfoToJSON(receipt, tri);
+        logs.push_back(tri);
+        return true;
+    }
+
+    UniValue Result() const
+    {
+        if (!fPaged)
+            return logs;
+
+        UniValue result(UniValue::VOBJ);
+        result.push_back(Pair("logs", logs));
+        if (!strNext.empty())
+            result.push_back(Pair("next", strNext));
+        return result;
+    }
+
+private:
+    size_t nLimit = 0;
+    int nCursorHeight = -1;
+    size_t nCursorSkip = 0;
+    bool fPaged = false;
+
+    int nHeight = -1;
+    size_t nAtHeight = 0;
+    std::string strNext;
+};
+
+static bool receiptMatchesTopics(const TransactionReceiptInfo &receipt, const std::vector<boost::optional<dev::h256>> &topics)
+{
+    if (receipt.logs.empty())
+        return false;
+    if (topics.empty())
+        return true;
+
+    for (size_t i = 0; i < topics.size(); i++)
+    {
+        if (!topics[i])
+            continue;
+        for (const auto &log : receipt.logs)
+        {
+            if (i < log.topics.size() && topics[i].get() == log.topics[i])
+                return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * searchlogs through the log topic index: only logs emitted by one of the addresses with one of
+ * the topics at its position match. Reads O(results) index entries instead of every receipt in range.
+ */
+static void searchlogsindexed(const SearchLogsParams &params_, SearchLogsPage &page)
+{
+    if (!fLogTopicIndex)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Log topic index disabled, restart with -logtopicindex -reindex");
+
+    bool fTopic = false;
+    for (const auto &tc : params_.topics)
+        fTopic |= bool(tc);
+    if (params_.addresses.empty() || !fTopic)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Indexed search needs at least one address and one topic");
+
+    int high = params_.toBlock;
+
+    // Transactions with a matching log, in chain order
+    std::map<std::pair<unsigned int, unsigned int>, uint256> matches;
+    for (const dev::h160 &address : params_.addresses)
+    {
+        for (size_t i = 0; i < params_.topics.size() && i <= 0xff; i++)
+        {
+            if (!params_.topics[i])
+                continue;
+            pblocktree->ReadLogTopicIndex(address, uint8_t(i), params_.topics[i].get(), params_.fromBlock, high,
+                                          [&](const CLogTopicIndexKey &key, const uint256 &hashTx) {
+                                              matches[std::make_pair(key.height, key.txIndex)] = hashTx;
+                                              return true;
+                                          });
+        }
+    }
+
+    for (const auto &m : matches)
+    {
+        for (const auto &receipt : GetResult(m.second))
+        {
+            bool fMatch = false;
+            for (const auto &log : receipt.logs)
+            {
+                if (!params_.addresses.count(log.address))
+                    continue;
+                for (size_t i = 0; i < log.topics.size() && i < params_.topics.size() && !fMatch; i++)
+                    fMatch = params_.topics[i] && params_.topics[i].get() == log.topics[i];
+            }
+            if (fMatch && !page.Push(m.first.first, receipt))
+                return;
+        }
+    }
+}
+
 UniValue searchlogs(const UniValue& params, bool fHelp)
 {
     bool IsEnabled = (chainActive.Tip()->nVersion > ZEROCOIN_VERSION);
     if (!IsEnabled)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "not arrive to the contract height,disabled");
 
-    if (fHelp || params.size() < 2 || params.size() > 5)
+    if (fHelp || params.size() < 2 || params.size() > 8)
         throw std::runtime_error(
-                "searchlogs <fromBlock> <toBlock> (address) (topics)\n"
+                "searchlogs <fromBlock> <toBlock> (address) (topics) (minconf) (indexed) (limit) (cursor)\n"
                 "requires -logevents to be enabled"
                 "\nArgument:\n"
                 "1. \"fromBlock\"        (numeric, required) The number of the earliest block (latest may be given to mean the most recent block).\n"
@@ -1961,6 +2115,12 @@ UniValue searchlogs(const UniValue& params, bool fHelp)
                 "3. \"address\"          (string, optional) An address or a list of addresses to only get logs from particular account(s).\n"
                 "4. \"topics\"           (string, optional) An array of values from which at least one must appear in the log entries. The order is important, if you want to leave topics out use null, e.g. [\"null\", \"0x00...\"]. \n"
                 "5. \"minconf\"          (uint, optional, default=0) Minimal number of confirmations before a log is returned\n"
+                "6. \"indexed\"          (bool, optional, default=false) Use the log topic index, requires -logtopicindex. Addresses then match the contract that emitted the log and at least one address and one topic are required\n"
+                "7. \"limit\"            (uint, optional, default=0) Maximum number of results, 0 for no limit\n"
+                "8. \"cursor\"           (string, optional) The \"next\" value of the previous page, \"\" for the first page\n"
+                "\nResult:\n"
+                "An array of receipts. When limit or cursor is given, an object with the receipts in \"logs\" and,\n"
+                "if there are more results, the cursor of the next page in \"next\".\n"
                 "\nExamples:\n"
                 + HelpExampleCli("searchlogs",
                 "0 100 '{\"addresses\": [\"12ae42729af478ca92c8c66773a3e32115717be4\"]}' '{\"topics\": [\"null\",\"b436c2bf863ccd7b8f63171201efd4792066b4ce8e543dde9c3e9e9ab98e216c\"]}'")
@@ -1972,80 +2132,59 @@ UniValue searchlogs(const UniValue& params, bool fHelp)
 
     int curheight = 0;
 
-    LOCK(cs_main);
-
-    SearchLogsParams params_(params);
-
-
-
-    std::vector<std::vector<uint256>> hashesToBlock;
-    curheight = pblocktree->ReadHeightIndex(params_.fromBlock, params_.toBlock, params_.minconf,
-                                            hashesToBlock,
-                                            params_.addresses);
+    SearchLogsPage page(params.size() > 6 ? params[6] : NullUniValue, params.size() > 7 ? params[7] : NullUniValue);
 
+    // Only the block range needs the chain. The scan below reads the height index and the
+    // receipts, which have their own locks, so it runs without cs_main.
+    std::unique_ptr<SearchLogsParams> pparams;
+    {
+        LOCK(cs_main);
+        pparams.reset(new SearchLogsParams(params));
+        if (pparams->minconf > 0)
+        {
+            int high = chainActive.Height() - (int)pparams->minconf;
+            // Nothing is confirmed enough yet, the genesis block has no logs
+            if (high <= 0 || high < (int)pparams->fromBlock)
+                return page.Result();
+            pparams->toBlock = std::min<size_t>(pparams->toBlock, high);
+            pparams->minconf = 0;
+        }
+    }
+    SearchLogsParams &params_ = *pparams;
+    if (page.CursorHeight() > (int)params_.fromBlock)
+    {
+        params_.fromBlock = page.CursorHeight();
+    }
 
-    if (curheight == -1)
+    if (params.size() > 5 && params[5].get_bool())
     {
-        throw JSONRPCError(RPC_INVALID_PARAMETER, "Incorrect params");
+        searchlogsindexed(params_, page);
+        return page.Result();
     }
 
-    UniValue result(UniValue::VARR);
+    CLogBloomFilter filter(params_.addresses, params_.topics);
     auto topics = params_.topics;
+    curheight = pblocktree->ReadHeightIndex(params_.fromBlock, params_.toBlock, params_.minconf,
+                                            [&](const CHeightTxIndexKey &key, const std::vector<uint256> &hashesTx) {
+                                                for (const auto &e : hashesTx)
+                                                {
+                                                    for (const auto &receipt : GetResult(e))
+                                                    {
+                                                        if (receiptMatchesTopics(receipt, topics) &&
+                                                            !page.Push(key.height, receipt))
+                                                            return false;
+                                                    }
+                                                }
+                                                return true;
+                                            },
+                                            params_.addresses, &filter);
 
-    for (const auto &hashesTx : hashesToBlock)
+    if (curheight == -1)
     {
-        for (const auto &e : hashesTx)
-        {
-            std::vector<TransactionReceiptInfo> receipts = GetResult(e);
-
-            for (const auto &receipt : receipts)
-            {
-                if (receipt.logs.empty())
-                {
-                    continue;
-                }
-
-                if (!topics.empty())
-                {
-                    for (size_t i = 0; i < topics.size(); i++)
-                    {
-                        const auto &tc = topics[i];
-
-                        if (!tc)
-                        {
-                            continue;
-                        }
-
-                        for (const auto &log: receipt.logs)
-                        {
-                            auto filterTopicContent = tc.get();
-
-                            if (i >= log.topics.size())
-                            {
-                                continue;
-                            }
-
-                            if (filterTopicContent == log.topics[i])
-                            {
-                                goto push;
-                            }
-                        }
-                    }
-
-                    
-                    continue;
-                }
-
-                push:
-
-                UniValue tri(UniValue::VOBJ);
-                transactionReceiptInfoToJSON(receipt, tri);
-                result.push_back(tri);
-            }
-        }
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Incorrect params");
     }
 
-    return result;
+    return page.Result();
 }
 
 UniValue gettransactionreceipt(const UniValue& params, bool fHelp)
@@ -2097,47 +2236,232 @@ UniValue listcontracts(const UniValue& params, bool fHelp)
         throw std::runtime_error(
                 "listcontracts (start maxDisplay)\n"
                 "\nArgument:\n"
-                "1. start     (numeric or string, optional) The starting account index, default 1\n"
-                "2. maxDisplay       (numeric or string, optional) Max accounts to list, default 20\n");
+                "1. start     (numeric or string, optional) The starting account index, default 1,\n"
+                "             or the \"next\" value of the previous page, \"\" for the first page\n"
+                "2. maxDisplay       (numeric or string, optional) Max accounts to list, default 20\n"
+                "\nResult:\n"
+                "An object of addresses and balances. When start is a string, an object with the accounts in\n"
+                "\"contracts\" and, if there are more accounts, the start of the next page in \"next\".\n");
 
-    LOCK(cs_main);
+    int maxDisplay = 20;
+    if (params.size() > 1)
+    {
+        maxDisplay = params[1].get_int();
+        if (maxDisplay <= 0)
+            throw JSONRPCError(RPC_TYPE_ERROR, "Invalid maxDisplay");
+    }
 
+    bool fCursor = params.size() > 0 && params[0].isStr();
+    dev::h256 from;
     int start = 1;
-    if (params.size() > 0)
+    if (fCursor)
+    {
+        std::string cursor = params[0].get_str();
+        if (!cursor.empty())
+        {
+            if (cursor.size() != 64 || !IsHex(cursor))
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid start");
+            from = dev::h256(cursor);
+        }
+    } else if (params.size() > 0)
     {
         start = params[0].get_int();
         if (start <= 0)
             throw JSONRPCError(RPC_TYPE_ERROR, "Invalid start, min=1");
     }
 
-    int maxDisplay = 20;
-    if (params.size() > 1)
+    LOCK(cs_main);
+
+    // Accounts are read in trie order, only as many as the page needs
+    dev::h256 next;
+    std::vector<std::pair<dev::h160, dev::u256>> contracts = GetContractList(from, start - 1 + maxDisplay, next);
+    int contractsCount = (int)contracts.size();
+
+    if (!fCursor && contractsCount > 0 && start > contractsCount)
+        throw JSONRPCError(RPC_TYPE_ERROR, "start greater than max index " + itostr(contractsCount));
+
+    UniValue list(UniValue::VOBJ);
+    for (auto it = contracts.begin() + std::min(start - 1, contractsCount); it != contracts.end(); it++)
     {
-        maxDisplay = params[1].get_int();
-        if (maxDisplay <= 0)
-            throw JSONRPCError(RPC_TYPE_ERROR, "Invalid maxDisplay");
+        list.push_back(Pair(it->first.hex(), ValueFromAmount(CAmount(it->second))));
     }
 
+    if (!fCursor)
+        return list;
+
     UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("contracts", list));
+    if (next)
+        result.push_back(Pair("next", next.hex()));
+    return result;
+}
 
-    std::unordered_map<dev::h160, dev::u256> map = GetContractList();
-    int contractsCount = (int)map.size();
+UniValue dumpcontractstate(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 2)
+        throw std::runtime_error(
+                "dumpcontractstate \"filename\" ( blockNum )\n"
+                "\nWrites the contract state after a block to a file that -loadcontractstate imports.\n"
+                "\nArgument:\n"
+                "1. \"filename\"         (string, required) The file to write, relative to the working directory of the server\n"
+                "2. \"blockNum\"         (number, optional) Number of block to dump the state of, \"latest\" keyword supported. Latest if not passed.\n"
+                "\nResult:\n"
+                "{\n"
+                "  \"height\": n,            (numeric) the height of the block\n"
+                "  \"hash\": \"hash\",        (string) the hash of the block\n"
+                "  \"hashStateRoot\": \"hash\", (string) the state root of the block\n"
+                "  \"hashUTXORoot\": \"hash\",  (string) the UTXO root of the block\n"
+                "  \"nodes\": n              (numeric) the number of trie nodes and code blobs written\n"
+                "}\n"
+                "\nExamples:\n" +
+                HelpExampleCli("dumpcontractstate", "\"state.dump\"") + HelpExampleRpc("dumpcontractstate", "\"state.dump\", 1000"));
 
-    if (contractsCount > 0 && start > contractsCount)
-        throw JSONRPCError(RPC_TYPE_ERROR, "start greater than max index " + itostr(contractsCount));
+    std::string strPath = params[0].get_str();
+    int nHeight = ContractStateHeight(params, 1);
 
-    int itStartPos = std::min(start - 1, contractsCount);
-    int i = 0;
+    CContractStateDumpHeader header;
+    uint64_t nEntries = 0;
+    std::string errinfo;
+    if (!DumpContractState(strPath, nHeight, header, nEntries, errinfo))
+        throw JSONRPCError(RPC_MISC_ERROR, errinfo);
 
-    for (auto it = std::next(map.begin(), itStartPos); it != map.end(); it++)
-    {
-        CAmount balance = GetContractBalance(it->first);
-        result.push_back(Pair(it->first.hex(), ValueFromAmount(balance)));
-        i++;
-        if (i == maxDisplay)
-            break;
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("height", header.nHeight));
+    result.push_back(Pair("hash", header.hashBlock.GetHex()));
+    result.push_back(Pair("hashStateRoot", header.hashStateRoot.GetHex()));
+    result.push_back(Pair("hashUTXORoot", header.hashUTXORoot.GetHex()));
+    result.push_back(Pair("nodes", nEntries));
+    return result;
+}
+
+
+
+static bool CompareContractsByTime(const std::pair<dev::h160, dev::eth::VMContractStats>& a,
+                                   const std::pair<dev::h160, dev::eth::VMContractStats>& b)
+{
+    return a.second.nanos > b.second.nanos;
+}
+
+static UniValue VMProfileToJSON(const dev::eth::VMProfileData& data)
+{
+    std::vector<std::pair<uint64_t, int> > vOpcodes;
+    for (size_t i = 0; i < data.opcodes.size(); i++) {
+        if (data.opcodes[i].count)
+            vOpcodes.push_back(std::make_pair(data.opcodes[i].cycles, (int)i));
+    }
+    std::sort(vOpcodes.rbegin(), vOpcodes.rend());
+
+    UniValue opcodes(UniValue::VARR);
+    for (const std::pair<uint64_t, int>& op : vOpcodes) {
+        const dev::eth::VMOpcodeStats& stats = data.opcodes[op.second];
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("op", dev::eth::instructionInfo(dev::eth::Instruction(op.second)).name));
+        entry.push_back(Pair("count", stats.count));
+        entry.push_back(Pair("cycles", stats.cycles));
+        entry.push_back(Pair("avgcycles", (double)stats.cycles / stats.count));
+        opcodes.push_back(entry);
+    }
+
+    std::vector<std::pair<dev::h160, dev::eth::VMContractStats> > vContracts(data.contracts.begin(), data.contracts.end());
+    std::sort(vContracts.begin(), vContracts.end(), CompareContractsByTime);
+
+    UniValue contracts(UniValue::VARR);
+    uint64_t nGas = 0;
+    uint64_t nNanos = 0;
+    for (const std::pair<dev::h160, dev::eth::VMContractStats>& contract : vContracts) {
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("address", contract.first.hex()));
+        entry.push_back(Pair("calls", contract.second.calls));
+        entry.push_back(Pair("gas", contract.second.gas));
+        entry.push_back(Pair("time", contract.second.nanos / 1000));
+        entry.push_back(Pair("sload", contract.second.sloads));
+        entry.push_back(Pair("sstore", contract.second.sstores));
+        contracts.push_back(entry);
+        nGas += contract.second.gas;
+        nNanos += contract.second.nanos;
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("gas", nGas));
+    result.push_back(Pair("time", nNanos / 1000));
+    result.push_back(Pair("opcodes", opcodes));
+    result.push_back(Pair("contracts", contracts));
+    return result;
+}
+
+UniValue getvmprofile(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 2)
+        throw std::runtime_error(
+                "getvmprofile ( reset count )\n"
+                "\nReturns where the EVM spent its time in the blocks connected since the last reset, -vmprofile enables it.\n"
+                "Times of instructions and contracts exclude the frames they called.\n"
+                "\nArguments:\n"
+                "1. reset          (boolean, optional, default=false) Clear the profile after returning it\n"
+                "2. count          (numeric, optional, default=1) Number of recent blocks to return the profile of, max " + strprintf("%u", dev::eth::VMProfiler::c_maxBlocks) + "\n"
+                "\nResult:\n"
+                "{\n"
+                "  \"enabled\": true|false,   (boolean) whether -vmprofile is set\n"
+                "  \"blocks\": n,             (numeric) the number of blocks in the total\n"
+                "  \"total\": {               (object) the profile of these blocks\n"
+                "    \"gas\": n,              (numeric) gas used by contract code\n"
+                "    \"time\": n,             (numeric) microseconds spent executing contract code\n"
+                "    \"opcodes\": [           (array) instructions by time, slowest first\n"
+                "      {\n"
+                "        \"op\": \"name\",       (string) the instruction\n"
+                "        \"count\": n,        (numeric) times it was executed\n"
+                "        \"cycles\": n,       (numeric) CPU time stamp counter cycles spent in it, nanoseconds without one\n"
+                "        \"avgcycles\": n     (numeric) cycles per execution\n"
+                "      }, ...\n"
+                "    ],\n"
+                "    \"contracts\": [         (array) contracts by time, slowest first\n"
+                "      {\n"
+                "        \"address\": \"hex\",  (string) the address of the code\n"
+                "        \"calls\": n,        (numeric) frames that ran it\n"
+                "        \"gas\": n,          (numeric) gas used\n"
+                "        \"time\": n,         (numeric) microseconds spent\n"
+                "        \"sload\": n,        (numeric) SLOAD instructions\n"
+                "        \"sstore\": n        (numeric) SSTORE instructions\n"
+                "      }, ...\n"
+                "    ]\n"
+                "  },\n"
+                "  \"recent\": [              (array) the last blocks, latest first\n"
+                "    {\n"
+                "      \"height\": n,         (numeric) the height of the block\n"
+                "      \"hash\": \"hash\",     (string) the hash of the block\n"
+                "      ...                    the fields of total for this block\n"
+                "    }, ...\n"
+                "  ]\n"
+                "}\n"
+                "\nExamples:\n" +
+                HelpExampleCli("getvmprofile", "") + HelpExampleCli("getvmprofile", "true 10") + HelpExampleRpc("getvmprofile", "false, 10"));
+
+    bool fReset = params.size() > 0 && params[0].get_bool();
+    int nCount = params.size() > 1 ? params[1].get_int() : 1;
+    if (nCount < 0 || nCount > (int)dev::eth::VMProfiler::c_maxBlocks)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid count");
+
+    dev::eth::VMProfiler& profiler = dev::eth::VMProfiler::instance();
+    uint64_t nBlocks = 0;
+    dev::eth::VMProfileData total = profiler.total(nBlocks);
+    std::vector<dev::eth::VMBlockProfile> vRecent = profiler.recent(nCount);
+    if (fReset)
+        profiler.reset();
+
+    UniValue recent(UniValue::VARR);
+    for (const dev::eth::VMBlockProfile& block : vRecent) {
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("height", (uint64_t)block.height));
+        entry.push_back(Pair("hash", block.hash.hex()));
+        entry.pushKVs(VMProfileToJSON(block.data));
+        recent.push_back(entry);
     }
 
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("enabled", profiler.enabled()));
+    result.push_back(Pair("blocks", nBlocks));
+    result.push_back(Pair("total", VMProfileToJSON(total)));
+    result.push_back(Pair("recent", recent));
     return result;
 }
 
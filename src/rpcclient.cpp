@@ -114,10 +114,17 @@ static const CRPCConvertParam vRPCConvertParams[] =
         {"getstorage", 2},
         {"getstorage", 1},
         {"callcontract", 3},
+        {"callcontract", 4},
+        {"getaccountinfo", 1},
+        {"dumpcontractstate", 1},
+        {"getvmprofile", 0},
+        {"getvmprofile", 1},
         {"searchlogs", 0},
         {"searchlogs", 1},
         {"searchlogs", 2},
         {"searchlogs", 3},
+        {"searchlogs", 5},
+        {"searchlogs", 6},
 
         {"keypoolrefill", 0},
         {"getrawmempool", 0},
@@ -308,6 +308,8 @@ static const CRPCCommand vRPCCommands[] =
         {"blockchain", "getstorage", &getstorage,},
         {"blockchain", "callcontract", &callcontract, true, false,false},
         {"blockchain", "listcontracts", &listcontracts,},
+        {"blockchain", "dumpcontractstate", &dumpcontractstate, true, false, false},
+        {"blockchain", "getvmprofile", &getvmprofile, true, false, false},
         {"blockchain", "gettransactionreceipt", &gettransactionreceipt,},
         {"blockchain", "searchlogs", &searchlogs,},
 
@@ -273,6 +273,8 @@ extern UniValue getstorage(const UniValue& params, bool fHelp);
 extern UniValue callcontract(const UniValue& params, bool fHelp);
 extern UniValue searchlogs(const UniValue& params, bool fHelp);
 extern UniValue listcontracts(const UniValue& params, bool fHelp);
+extern UniValue dumpcontractstate(const UniValue& params, bool fHelp);
+extern UniValue getvmprofile(const UniValue& params, bool fHelp);
 extern UniValue gettransactionreceipt(const UniValue& params, bool fHelp);
 extern UniValue getchaintips(const UniValue& params, bool fHelp);
 
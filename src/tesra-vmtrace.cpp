@@ -0,0 +1,204 @@
+#include "clientversion.h"
+#include "util.h"
+#include "utilstrencodings.h"
+#include "contract/libevm/VMTrace.h"
+#include "contract/libevmcore/Instruction.h"
+#include <univalue.h>
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace std;
+using namespace dev::eth;
+
+static const char* KindName(uint8_t kind)
+{
+    switch (kind) {
+    case VMTraceRecord::Step:
+        return "step";
+    case VMTraceRecord::Enter:
+        return "enter";
+    case VMTraceRecord::Exit:
+        return "exit";
+    case VMTraceRecord::Transaction:
+        return "transaction";
+    case VMTraceRecord::Dropped:
+        return "dropped";
+    default:
+        return "unknown";
+    }
+}
+
+/** Trace file opened for reading slots by index, slot 0 being the first after the header. */
+class TraceFile
+{
+public:
+    TraceFile() : file(NULL), nSlots(0) {}
+    ~TraceFile()
+    {
+        if (file)
+            fclose(file);
+    }
+
+    bool Open(const string& strPath, string& strError)
+    {
+        file = fopen(strPath.c_str(), "rb");
+        if (!file) {
+            strError = "cannot open " + strPath;
+            return false;
+        }
+        VMTraceHeader header;
+        if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, VMTraceHeader::magicBytes(), sizeof(header.magic)) != 0) {
+            strError = strPath + " is not a VM trace";
+            return false;
+        }
+        if (header.version != VMTraceHeader::c_version || header.recordSize != sizeof(VMTraceRecord)) {
+            strError = strprintf("unsupported trace version %u", header.version);
+            return false;
+        }
+        fseek(file, 0, SEEK_END);
+        // A trace being written may end with a partial slot
+        nSlots = (ftell(file) - sizeof(header)) / sizeof(VMTraceRecord);
+        return true;
+    }
+
+    bool Read(uint64_t nSlot, size_t nCount, vector<VMTraceRecord>& records)
+    {
+        nCount = (size_t)min<uint64_t>(nCount, nSlots > nSlot ? nSlots - nSlot : 0);
+        records.resize(nCount);
+        if (nCount == 0)
+            return true;
+        if (fseek(file, (nSlot + 1) * sizeof(VMTraceRecord), SEEK_SET) != 0)
+            return false;
+        return fread(records.data(), sizeof(VMTraceRecord), nCount, file) == nCount;
+    }
+
+    uint64_t Size() const { return nSlots; }
+
+private:
+    FILE* file;
+    uint64_t nSlots;
+};
+
+static UniValue RecordToJSON(uint64_t nSlot, uint32_t nThread, const VMTraceRecord& r, const vector<VMTraceRecord>& data)
+{
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("slot", nSlot));
+    result.push_back(Pair("thread", (uint64_t)nThread));
+    result.push_back(Pair("kind", KindName(r.kind)));
+    switch (r.kind) {
+    case VMTraceRecord::Step:
+        result.push_back(Pair("execution", (uint64_t)r.execution));
+        result.push_back(Pair("pc", (uint64_t)r.pc));
+        result.push_back(Pair("op", instructionInfo(Instruction(r.op)).name));
+        result.push_back(Pair("gas", r.gas));
+        result.push_back(Pair("stack", (uint64_t)r.stack));
+        result.push_back(Pair("memory", (uint64_t)r.memory));
+        break;
+    case VMTraceRecord::Enter:
+        result.push_back(Pair("execution", (uint64_t)r.execution));
+        result.push_back(Pair("depth", (uint64_t)r.pc));
+        result.push_back(Pair("gas", r.gas));
+        if (data.size() >= 1)
+            result.push_back(Pair("address", HexStr((const unsigned char*)&data[0], (const unsigned char*)&data[0] + 20)));
+        break;
+    case VMTraceRecord::Exit:
+        result.push_back(Pair("execution", (uint64_t)r.execution));
+        result.push_back(Pair("gas", r.gas));
+        result.push_back(Pair("threw", r.op != 0));
+        break;
+    case VMTraceRecord::Transaction:
+        result.push_back(Pair("nvout", (uint64_t)r.pc));
+        result.push_back(Pair("gas", r.gas));
+        if (data.size() >= 2) {
+            vector<unsigned char> hash((const unsigned char*)&data[0], (const unsigned char*)&data[0] + VMTraceRecord::c_dataSize);
+            hash.insert(hash.end(), (const unsigned char*)&data[1], (const unsigned char*)&data[1] + 32 - VMTraceRecord::c_dataSize);
+            result.push_back(Pair("txid", HexStr(hash)));
+        }
+        break;
+    case VMTraceRecord::Dropped:
+        result.push_back(Pair("records", r.gas));
+        break;
+    }
+    return result;
+}
+
+static int CommandLineVMTrace(int argc, char* argv[])
+{
+    if (argc < 2 || argc > 4 || strcmp(argv[1], "-?") == 0 || strcmp(argv[1], "-help") == 0) {
+        fprintf(stdout, "%s",
+            (string("Tesra Core tesra-vmtrace utility version ") + FormatFullVersion() + "\n\n" +
+                "Usage:\n" +
+                "  tesra-vmtrace <file> [<from> [<to>]]  Print the records of a -record-log-opcodes trace in slots [from, to) as JSON\n")
+                .c_str());
+        return argc < 2 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    TraceFile trace;
+    string strError;
+    if (!trace.Open(argv[1], strError)) {
+        fprintf(stderr, "error: %s\n", strError.c_str());
+        return EXIT_FAILURE;
+    }
+    uint64_t nFrom = argc > 2 ? atoi64(argv[2]) : 0;
+    uint64_t nTo = argc > 3 ? min<uint64_t>(atoi64(argv[3]), trace.Size()) : trace.Size();
+
+    // Walk the chunk slots up to the one holding nFrom to learn which thread recorded it
+    uint64_t nChunk = 0;
+    uint32_t nThread = 0;
+    uint64_t nChunkEnd = 0;
+    vector<VMTraceRecord> records;
+    while (nChunk < trace.Size()) {
+        if (!trace.Read(nChunk, 1, records) || records.empty() || records[0].kind != VMTraceRecord::Chunk) {
+            fprintf(stderr, "error: no chunk at slot %llu\n", (unsigned long long)nChunk);
+            return EXIT_FAILURE;
+        }
+        nThread = records[0].execution;
+        nChunkEnd = nChunk + 1 + records[0].pc;
+        if (nChunkEnd > nFrom)
+            break;
+        nChunk = nChunkEnd;
+    }
+
+    static const size_t nBatch = 4096;
+    bool fFirst = true;
+    fprintf(stdout, "[");
+    for (uint64_t nSlot = max(nFrom, nChunk); nSlot < nTo;) {
+        // Read past the batch for the data slots of its last record
+        if (!trace.Read(nSlot, nBatch + 2, records) || records.empty())
+            break;
+        size_t nRead = (size_t)min<uint64_t>(min<uint64_t>(records.size(), nBatch), nTo - nSlot);
+        for (size_t i = 0; i < nRead; ++i, ++nSlot) {
+            const VMTraceRecord& r = records[i];
+            if (nSlot == nChunkEnd && r.kind == VMTraceRecord::Chunk) {
+                nThread = r.execution;
+                nChunkEnd = nSlot + 1 + r.pc;
+                continue;
+            }
+            if (r.kind == VMTraceRecord::Chunk || r.kind == VMTraceRecord::Data)
+                continue;
+            vector<VMTraceRecord> data;
+            for (size_t j = i + 1; j < records.size() && records[j].kind == VMTraceRecord::Data && data.size() < 2; ++j)
+                data.push_back(records[j]);
+            fprintf(stdout, "%s\n%s", fFirst ? "" : ",", RecordToJSON(nSlot, nThread, r, data).write().c_str());
+            fFirst = false;
+        }
+    }
+    fprintf(stdout, "\n]\n");
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[])
+{
+    SetupEnvironment();
+
+    int ret = EXIT_FAILURE;
+    try {
+        ret = CommandLineVMTrace(argc, argv);
+    } catch (std::exception& e) {
+        PrintExceptionContinue(&e, "CommandLineVMTrace()");
+    } catch (...) {
+        PrintExceptionContinue(NULL, "CommandLineVMTrace()");
+    }
+    return ret;
+}
@@ -0,0 +1,358 @@
+#include "random.h"
+#include "util.h"
+
+#include <libevm/CodeAnalysis.h>
+#include <libevm/CodeCache.h>
+#include <libevm/VMFactory.h>
+#include <libevm/VMProfile.h>
+#include <libevm/VMTrace.h>
+#include <libevm/Word256.h>
+#include <libevm/ExtVMFace.h>
+#include <libdevcore/SHA3.h>
+
+#include <fstream>
+#include <map>
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+class TestExtVM : public ExtVMFace
+{
+public:
+    TestExtVM(EnvInfo const& envInfo, bytes const& code) :
+        ExtVMFace(envInfo, Address(1), Address(2), Address(3), 0, 1, bytesConstRef(), std::make_shared<bytes const>(code), sha3(code), 0) {}
+
+    u256 store(u256 key) override { return storage[key]; }
+    void setStore(u256 key, u256 value) override { storage[key] = value; }
+    boost::optional<owning_bytes_ref> call(CallParameters&) override { return boost::none; }
+    EVMSchedule const& evmSchedule() const override { return EIP158Schedule; }
+
+    std::map<u256, u256> storage;
+};
+
+struct ExecResult
+{
+    u256 gasLeft;
+    bytes output;
+    std::map<u256, u256> storage;
+    bool failed = false;
+};
+
+ExecResult Execute(bytes const& code, u256 gas = 1000000, VMKind kind = VMKind::Interpreter)
+{
+    EnvInfo envInfo;
+    envInfo.setGasLimit(1000000);
+    TestExtVM ext(envInfo, code);
+    ExecResult result;
+    result.gasLeft = gas;
+    try
+    {
+        result.output = VMFactory::create(kind)->exec(result.gasLeft, ext, OnOpFunc()).toBytes();
+    }
+    catch (VMException const&)
+    {
+        result.failed = true;
+    }
+    result.storage = ext.storage;
+    return result;
+}
+
+u256 RandomWord()
+{
+    u256 v = 0;
+    for (int i = 0; i < 8; ++i)
+        v = (v << 32) | insecure_rand();
+    switch (insecure_rand() % 6)
+    {
+    case 0: return v >> (insecure_rand() % 256);
+    case 1: return insecure_rand() % 4;
+    case 2: return ~u256(0) - insecure_rand() % 4;
+    case 3: return u256(1) << (insecure_rand() % 256);
+    case 4: return v & ((u256(1) << (64 * (1 + insecure_rand() % 3))) - 1);
+    default: return v;
+    }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(evm_tests)
+
+BOOST_AUTO_TEST_CASE(analysis_cache_reuse)
+{
+    CodeAnalysisCache& cache = CodeAnalysisCache::instance();
+    cache.clear();
+
+    bytes code = fromHex("600a56000000000000005b61123460005500");
+    ExecResult first = Execute(code);
+    BOOST_CHECK(!first.failed);
+    BOOST_CHECK_EQUAL(cache.misses(), 1U);
+    BOOST_CHECK_EQUAL(cache.size(), 1U);
+
+    ExecResult second = Execute(code);
+    BOOST_CHECK_EQUAL(cache.hits(), 1U);
+    BOOST_CHECK(second.gasLeft == first.gasLeft);
+    BOOST_CHECK(second.storage == first.storage);
+    BOOST_CHECK(second.storage[0] == 0x1234);
+
+    bytes badJump = fromHex("6003566b5b00");
+    BOOST_CHECK(Execute(badJump).failed);
+    BOOST_CHECK(Execute(badJump).failed);
+    cache.clear();
+}
+
+BOOST_AUTO_TEST_CASE(analysis_cache_memory_bound)
+{
+    CodeAnalysisCache& cache = CodeAnalysisCache::instance();
+    cache.clear();
+    cache.setMaxMemory(3 * sizeof(CodeAnalysis));
+
+    for (unsigned i = 0; i < 10; ++i)
+        Execute(bytes{0x60, byte(i), 0x60, 0x00, 0x55, 0x00});
+    BOOST_CHECK(cache.size() < 10U);
+    BOOST_CHECK(cache.memoryUsage() <= cache.maxMemory());
+
+    cache.setMaxMemory(0);
+    BOOST_CHECK_EQUAL(cache.size(), 0U);
+    Execute(bytes{0x60, 0x01, 0x00});
+    BOOST_CHECK_EQUAL(cache.size(), 0U);
+
+    cache.setMaxMemory(CodeAnalysisCache::c_defaultMaxMemory);
+    cache.clear();
+}
+
+BOOST_AUTO_TEST_CASE(code_cache_shared_and_bounded)
+{
+    CodeCache& cache = CodeCache::instance();
+    cache.clear();
+
+    bytes code = fromHex("600a56000000000000005b61123460005500");
+    h256 codeHash = sha3(code);
+    BOOST_CHECK(!cache.get(codeHash));
+    SharedCode stored = cache.store(codeHash, std::make_shared<bytes const>(code));
+    BOOST_CHECK(cache.store(codeHash, std::make_shared<bytes const>(code)) == stored);
+    BOOST_CHECK(cache.get(codeHash) == stored);
+    size_t size = 0;
+    BOOST_CHECK(cache.size(codeHash, size));
+    BOOST_CHECK_EQUAL(size, code.size());
+
+    cache.setMaxMemory(CodeCache::c_shards * 4096);
+    for (unsigned i = 0; i < 2000; ++i)
+    {
+        bytes filler(512, byte(i));
+        filler[0] = byte(i >> 8);
+        cache.store(sha3(filler), std::make_shared<bytes const>(filler));
+    }
+    BOOST_CHECK(cache.size() < 2000U);
+    BOOST_CHECK(cache.memoryUsage() <= cache.maxMemory());
+
+    cache.setMaxMemory(0);
+    BOOST_CHECK_EQUAL(cache.size(), 0U);
+    BOOST_CHECK(!cache.get(codeHash));
+
+    cache.setMaxMemory(CodeCache::c_defaultMaxMemory);
+    cache.clear();
+}
+
+BOOST_AUTO_TEST_CASE(pooled_frames_start_clean)
+{
+    bytes writeAndReturn = fromHex("61123460005261ffff60205360206000f3");
+    bytes readBack = fromHex("60005160005560205160015500");
+    for (VMKind kind : {VMKind::Interpreter, VMKind::Threaded})
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            ExecResult written = Execute(writeAndReturn, 1000000, kind);
+            BOOST_CHECK(!written.failed);
+            BOOST_REQUIRE_EQUAL(written.output.size(), 32U);
+            BOOST_CHECK_EQUAL(written.output[30], 0x12);
+            BOOST_CHECK_EQUAL(written.output[31], 0x34);
+
+            ExecResult read = Execute(readBack, 1000000, kind);
+            BOOST_CHECK(!read.failed);
+            BOOST_CHECK(read.storage[0] == 0);
+            BOOST_CHECK(read.storage[1] == 0);
+        }
+        VMFactory::releaseFrames();
+    }
+    CodeAnalysisCache::instance().clear();
+}
+
+BOOST_AUTO_TEST_CASE(threaded_matches_interpreter)
+{
+    const char* programs[] = {
+        "60005b60010180610100116002570060005500",
+        "6001600260036004600560066007600880818283849091929350505050600055",
+        "61123461567801600055620f4240601f5261fffe51600155",
+        "6003566b5b00",
+        "60016000f1600055600160025a03600055",
+        "7fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff600160000360020a0460005500",
+        "6005600a5760005b600155fe",
+        "600035601c52600051601357005b602060006000f0",
+        "58600055600c565b5b600155",
+        "6101",
+    };
+    for (const char* program : programs)
+    {
+        bytes code = fromHex(program);
+        for (u256 gas : {u256(30), u256(100), u256(1000000)})
+        {
+            ExecResult interpreted = Execute(code, gas, VMKind::Interpreter);
+            ExecResult threaded = Execute(code, gas, VMKind::Threaded);
+            BOOST_CHECK_MESSAGE(interpreted.failed == threaded.failed, program);
+            BOOST_CHECK_MESSAGE(interpreted.gasLeft == threaded.gasLeft, program);
+            BOOST_CHECK_MESSAGE(interpreted.output == threaded.output, program);
+            BOOST_CHECK_MESSAGE(interpreted.storage == threaded.storage, program);
+        }
+    }
+    CodeAnalysisCache::instance().clear();
+}
+
+BOOST_AUTO_TEST_CASE(trace_buffer_drops_when_full)
+{
+    VMTraceBuffer buffer(1);
+    for (size_t i = 0; i <= VMTraceBuffer::c_capacity; ++i)
+        buffer.step(1, i, 0x01, 100, 0, 0);
+    std::vector<VMTraceRecord> records;
+    uint64_t dropped = 0;
+    buffer.drain(records, dropped);
+    BOOST_CHECK_EQUAL(records.size(), VMTraceBuffer::c_capacity);
+    BOOST_CHECK_EQUAL(dropped, 1U);
+    BOOST_CHECK_EQUAL(records.back().pc, VMTraceBuffer::c_capacity - 1);
+
+    // Enter pushes a record and its data slot, or nothing
+    buffer.enter(Address(1), 0, 100);
+    records.clear();
+    buffer.drain(records, dropped);
+    BOOST_REQUIRE_EQUAL(records.size(), 2U);
+    BOOST_CHECK_EQUAL(records[0].kind, VMTraceRecord::Enter);
+    BOOST_CHECK_EQUAL(records[1].kind, VMTraceRecord::Data);
+    BOOST_CHECK_EQUAL(dropped, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(trace_file_records_steps)
+{
+    boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    BOOST_REQUIRE(VMTracer::instance().start(path.string(), 0));
+    // PUSH1 1 PUSH1 2 ADD PUSH1 0 SSTORE STOP
+    ExecResult result = Execute(fromHex("600160020160005500"), 1000000, VMKind::Threaded);
+    VMTracer::instance().stop();
+    BOOST_CHECK(!result.failed);
+
+    std::ifstream file(path.string(), std::ios::binary);
+    VMTraceHeader header;
+    BOOST_REQUIRE(file.read((char*)&header, sizeof(header)));
+    BOOST_CHECK(memcmp(header.magic, VMTraceHeader::magicBytes(), sizeof(header.magic)) == 0);
+    BOOST_CHECK_EQUAL(header.recordSize, sizeof(VMTraceRecord));
+
+    std::vector<uint8_t> ops;
+    std::map<uint8_t, unsigned> kinds;
+    VMTraceRecord record;
+    while (file.read((char*)&record, sizeof(record)))
+    {
+        kinds[record.kind]++;
+        if (record.kind == VMTraceRecord::Step)
+            ops.push_back(record.op);
+    }
+    std::vector<uint8_t> expected = {0x60, 0x60, 0x01, 0x60, 0x55, 0x00};
+    BOOST_CHECK(ops == expected);
+    BOOST_CHECK_EQUAL(kinds[VMTraceRecord::Chunk], 1U);
+    BOOST_CHECK_EQUAL(kinds[VMTraceRecord::Enter], 1U);
+    BOOST_CHECK_EQUAL(kinds[VMTraceRecord::Exit], 1U);
+    file.close();
+    boost::filesystem::remove(path);
+    VMFactory::releaseFrames();
+}
+
+BOOST_AUTO_TEST_CASE(profile_counts_instructions_and_storage)
+{
+    // PUSH1 1 PUSH1 0 SSTORE PUSH1 0 SLOAD PUSH1 1 SSTORE STOP
+    bytes code = fromHex("600160005560005460015500");
+    VMProfiler::instance().setEnabled(true);
+    VMProfile profile;
+    {
+        // Frames outside of a scope are not profiled
+        Execute(code, 1000000, VMKind::Threaded);
+        VMProfileScope scope(&profile);
+        for (VMKind kind : {VMKind::Interpreter, VMKind::Threaded})
+            BOOST_CHECK(!Execute(code, 1000000, kind).failed);
+    }
+    VMProfiler::instance().setEnabled(false);
+    BOOST_CHECK(VMProfileScope::current() == nullptr);
+
+    VMProfileData data = profile.data();
+    BOOST_CHECK_EQUAL(data.opcodes[byte(Instruction::SSTORE)].count, 4U);
+    BOOST_CHECK_EQUAL(data.opcodes[byte(Instruction::SLOAD)].count, 2U);
+    BOOST_CHECK_EQUAL(data.opcodes[byte(Instruction::STOP)].count, 2U);
+    BOOST_REQUIRE_EQUAL(data.contracts.size(), 1U);
+    VMContractStats const& stats = data.contracts.begin()->second;
+    BOOST_CHECK(data.contracts.begin()->first == Address(1));
+    BOOST_CHECK_EQUAL(stats.calls, 2U);
+    BOOST_CHECK_EQUAL(stats.sloads, 2U);
+    BOOST_CHECK_EQUAL(stats.sstores, 4U);
+    BOOST_CHECK(stats.gas > 0);
+
+    VMProfiler::instance().addBlock(1, h256(1), data);
+    uint64_t blocks = 0;
+    BOOST_CHECK_EQUAL(VMProfiler::instance().total(blocks).opcodes[byte(Instruction::SLOAD)].count, 2U);
+    BOOST_CHECK_EQUAL(blocks, 1U);
+    BOOST_CHECK_EQUAL(VMProfiler::instance().recent(10).size(), 1U);
+    VMProfiler::instance().reset();
+    BOOST_CHECK(VMProfiler::instance().recent(10).empty());
+    VMFactory::releaseFrames();
+}
+
+BOOST_AUTO_TEST_CASE(word256_matches_boost)
+{
+    for (int i = 0; i < 20000; ++i)
+    {
+        u256 a = RandomWord(), b = RandomWord(), m = RandomWord();
+        Word256 wa = u2w(a), wb = u2w(b), wm = u2w(m);
+        BOOST_REQUIRE(w2u(wa) == a);
+        BOOST_REQUIRE(w2h(wa) == h256(a));
+
+        BOOST_CHECK(w2u(wa + wb) == a + b);
+        BOOST_CHECK(w2u(wa - wb) == a - b);
+        BOOST_CHECK(w2u(wa * wb) == a * b);
+        BOOST_CHECK(w2u(div(wa, wb)) == (b ? u256(a / b) : u256(0)));
+        BOOST_CHECK(w2u(mod(wa, wb)) == (b ? u256(a % b) : u256(0)));
+        BOOST_CHECK(w2u(sdiv(wa, wb)) == (b ? s2u(s256(s512(u2s(a)) / s512(u2s(b)))) : u256(0)));
+        BOOST_CHECK(w2u(smod(wa, wb)) == (b ? s2u(s256(s512(u2s(a)) % s512(u2s(b)))) : u256(0)));
+        BOOST_CHECK(w2u(addmod(wa, wb, wm)) == (m ? u256((u512(a) + u512(b)) % m) : u256(0)));
+        BOOST_CHECK(w2u(mulmod(wa, wb, wm)) == (m ? u256((u512(a) * u512(b)) % m) : u256(0)));
+        BOOST_CHECK(w2u(~wa & wb) == (~a & b));
+        BOOST_CHECK(w2u(wa | wb) == (a | b));
+        BOOST_CHECK(w2u(wa ^ wb) == (a ^ b));
+        BOOST_CHECK((wa < wb) == (a < b));
+        BOOST_CHECK((wa == wb) == (a == b));
+        BOOST_CHECK(slt(wa, wb) == (u2s(a) < u2s(b)));
+        BOOST_CHECK(sgt(wa, wb) == (u2s(a) > u2s(b)));
+        BOOST_CHECK(wa.byteLength() == 32 - h256(a).firstBitSet() / 8);
+
+        unsigned k = insecure_rand() % 40;
+        BOOST_CHECK(w2u(byteAt(k, wa)) == (k < 32 ? u256((a >> (8 * (31 - k))) & 0xff) : u256(0)));
+        u256 extended = a;
+        if (k < 31)
+        {
+            u256 mask = (u256(1) << (k * 8 + 7)) - 1;
+            extended = boost::multiprecision::bit_test(a, k * 8 + 7) ? a | ~mask : a & mask;
+        }
+        BOOST_CHECK(w2u(signExtend(k, wa)) == extended);
+
+        if (i % 50 == 0)
+        {
+            u256 expected = 1;
+            for (u256 base = a, e = b; e; e >>= 1, base *= base)
+                if (e & 1)
+                    expected *= base;
+            BOOST_CHECK(w2u(exp(wa, wb)) == expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
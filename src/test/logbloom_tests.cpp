@@ -0,0 +1,107 @@
+#include "txdb.h"
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+
+dev::eth::LogBloom BlockBloom(dev::h160 const& contract, dev::h256 const& topic)
+{
+    dev::eth::LogEntry log(contract, {topic}, dev::bytes());
+    dev::eth::LogBloom bloom = log.bloom();
+    bloom.shiftBloom<3>(dev::sha3(contract.ref()));
+    return bloom;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(logbloom_tests)
+
+BOOST_AUTO_TEST_CASE(logbloom_filter)
+{
+    dev::h160 contract(0x1000);
+    dev::h256 topic(0x42);
+    dev::eth::LogBloom bloom = BlockBloom(contract, topic);
+
+    std::vector<boost::optional<dev::h256>> topics{boost::none, topic};
+    BOOST_CHECK(CLogBloomFilter({}, {}).Matches(bloom));
+    BOOST_CHECK(!CLogBloomFilter({}, {}).Matches(dev::eth::LogBloom()));
+    BOOST_CHECK(CLogBloomFilter({contract}, topics).Matches(bloom));
+    BOOST_CHECK(CLogBloomFilter({dev::h160(0x2000), contract}, {}).Matches(bloom));
+    BOOST_CHECK(!CLogBloomFilter({dev::h160(0x2000)}, {}).Matches(bloom));
+    BOOST_CHECK(!CLogBloomFilter({contract}, {boost::optional<dev::h256>(dev::h256(0x43))}).Matches(bloom));
+}
+
+BOOST_AUTO_TEST_CASE(logbloom_height_index)
+{
+    CBlockTreeDB db(1 << 20, true);
+    dev::h160 contract(0x1000);
+    dev::h256 topic(0x42);
+
+    // One matching block in the first section, none in the second, the tip in the third
+    for (unsigned int height = 1; height < 3 * LOG_BLOOM_SECTION_SIZE; height += 31)
+    {
+        bool match = height == 32 || height == 3070;
+        BOOST_CHECK(db.WriteHeightIndex(CHeightTxIndexKey(height, contract), {uint256(height)}));
+        BOOST_CHECK(db.WriteLogBloom(height, BlockBloom(contract, match ? topic : dev::h256(height + 1000))));
+    }
+
+    std::vector<boost::optional<dev::h256>> topics{topic};
+    CLogBloomFilter filter({}, topics);
+    std::vector<std::vector<uint256>> all, filtered;
+    db.ReadHeightIndex(1, 3 * LOG_BLOOM_SECTION_SIZE, 0, all, {});
+    db.ReadHeightIndex(1, 3 * LOG_BLOOM_SECTION_SIZE, 0, filtered, {}, &filter);
+
+    BOOST_CHECK(all.size() == 99);
+    BOOST_CHECK(filtered.size() == 2);
+    BOOST_CHECK(filtered.front().front() == uint256(32));
+    BOOST_CHECK(filtered.back().front() == uint256(3070));
+
+    // Disconnecting the matching block takes it out of its section
+    BOOST_CHECK(db.EraseLogBloom(3070));
+    dev::eth::LogBloom section;
+    BOOST_CHECK(db.ReadLogBloomSection(2, section));
+    BOOST_CHECK(!filter.Matches(section));
+    BOOST_CHECK(db.WipeLogBlooms());
+    BOOST_CHECK(!db.ReadLogBloomSection(0, section));
+}
+
+BOOST_AUTO_TEST_CASE(logtopic_index)
+{
+    CBlockTreeDB db(1 << 20, true);
+    dev::h160 contract(0x1000);
+    dev::h256 transfer(0x42);
+
+    for (unsigned int height = 1; height <= 20; height++)
+    {
+        std::vector<std::pair<CLogTopicIndexKey, uint256>> entries;
+        entries.push_back(std::make_pair(CLogTopicIndexKey(contract, 0, transfer, height, 1, 0), uint256(height)));
+        entries.push_back(std::make_pair(CLogTopicIndexKey(contract, 1, dev::h256(height), height, 1, 0), uint256(height)));
+        entries.push_back(std::make_pair(CLogTopicIndexKey(dev::h160(0x2000), 0, transfer, height, 2, 0), uint256(height + 100)));
+        BOOST_CHECK(db.WriteLogTopicIndex(height, entries));
+    }
+
+    std::vector<unsigned int> heights;
+    auto collect = [&](const CLogTopicIndexKey& key, const uint256& hashTx) {
+        BOOST_CHECK(key.address == contract && hashTx == uint256(key.height));
+        heights.push_back(key.height);
+        return true;
+    };
+    BOOST_CHECK_EQUAL(db.ReadLogTopicIndex(contract, 0, transfer, 5, 9, collect), 5U);
+    BOOST_CHECK(heights == std::vector<unsigned int>({5, 6, 7, 8, 9}));
+
+    heights.clear();
+    BOOST_CHECK_EQUAL(db.ReadLogTopicIndex(contract, 1, dev::h256(7), 0, -1, collect), 1U);
+    BOOST_CHECK(heights == std::vector<unsigned int>({7}));
+
+    // Disconnecting the tip removes its entries only
+    BOOST_CHECK(db.EraseLogTopicIndex(20));
+    heights.clear();
+    BOOST_CHECK_EQUAL(db.ReadLogTopicIndex(contract, 0, transfer, 0, -1, collect), 19U);
+    BOOST_CHECK_EQUAL(heights.back(), 19U);
+
+    BOOST_CHECK(db.WipeLogTopicIndex());
+    BOOST_CHECK_EQUAL(db.ReadLogTopicIndex(contract, 0, transfer, 0, -1, collect), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
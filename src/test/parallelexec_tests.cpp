@@ -0,0 +1,367 @@
+#include "main.h"
+#include "random.h"
+#include "util.h"
+
+#include "contract_api/parallelexec.h"
+#include "test/test_contract.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+std::vector<ResultExecute> RunSequential(TesraState& state, TestChain& chain, std::vector<TesraTransaction> const& txs,
+                                         bool deferred = false)
+{
+    state.setDeferredCommit(deferred);
+    std::vector<ResultExecute> results;
+    for (TesraTransaction const& tx : txs)
+    {
+        chain.sealEngine->deleteAddresses.clear();
+        results.push_back(state.execute(chain.envInfo, *chain.sealEngine, tx));
+    }
+    state.commitBlock();
+    state.setDeferredCommit(false);
+    return results;
+}
+
+std::vector<ResultExecute> RunParallel(TesraState& state, TestChain& chain, std::vector<TesraTransaction> const& txs,
+                                       ParallelContractExecutor& executor, bool deferred = false)
+{
+    state.setDeferredCommit(deferred);
+    executor.speculate(state, chain.envInfo, chain.sealEngine->evmSchedule(chain.envInfo), txs);
+    std::vector<ResultExecute> results;
+    for (TesraTransaction const& tx : txs)
+        results.push_back(executor.execute(state, chain.envInfo, *chain.sealEngine, tx));
+    state.commitBlock();
+    state.setDeferredCommit(false);
+    return results;
+}
+
+bytes LogRLP(LogEntries const& log)
+{
+    RLPStream s(log.size());
+    for (LogEntry const& l : log)
+        l.streamRLP(s);
+    return s.out();
+}
+
+void CheckSameResults(std::vector<ResultExecute> const& a, std::vector<ResultExecute> const& b, bool sameRoots = true)
+{
+    BOOST_REQUIRE_EQUAL(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        BOOST_CHECK(a[i].execRes.excepted == b[i].execRes.excepted);
+        BOOST_CHECK(a[i].execRes.gasUsed == b[i].execRes.gasUsed);
+        BOOST_CHECK(a[i].execRes.newAddress == b[i].execRes.newAddress);
+        BOOST_CHECK(a[i].execRes.output == b[i].execRes.output);
+        if (sameRoots)
+            BOOST_CHECK(a[i].txRec.stateRoot() == b[i].txRec.stateRoot());
+        BOOST_CHECK(a[i].txRec.gasUsed() == b[i].txRec.gasUsed());
+        BOOST_CHECK(LogRLP(a[i].txRec.log()) == LogRLP(b[i].txRec.log()));
+        BOOST_CHECK(a[i].tx.GetHash() == b[i].tx.GetHash());
+    }
+}
+
+void CheckDeterministic(TestChain& chain, std::vector<TesraTransaction> const& txs, unsigned threads,
+                        uint64_t& reused, uint64_t& reexecuted, bool deferred = false)
+{
+    TesraState sequential(chain.base);
+    std::vector<ResultExecute> expected = RunSequential(sequential, chain, txs);
+
+    TesraState parallel(chain.base);
+    ParallelContractExecutor executor(threads, chain.params);
+    std::vector<ResultExecute> results = RunParallel(parallel, chain, txs, executor, deferred);
+
+    CheckSameResults(expected, results, !deferred);
+    BOOST_CHECK(sequential.rootHash() == parallel.rootHash());
+    BOOST_CHECK(sequential.rootHashUTXO() == parallel.rootHashUTXO());
+    BOOST_CHECK_EQUAL(executor.reused() + executor.reexecuted(), txs.size());
+    reused = executor.reused();
+    reexecuted = executor.reexecuted();
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(parallelexec_tests)
+
+BOOST_AUTO_TEST_CASE(parallel_low_conflict)
+{
+    TestChain chain(16);
+    std::vector<TesraTransaction> txs;
+    for (unsigned i = 0; i < 16; i++)
+        txs.push_back(chain.Call(i, chain.contracts[i], 0));
+
+    for (unsigned threads = 1; threads <= 4; threads++)
+    {
+        uint64_t reused, reexecuted;
+        CheckDeterministic(chain, txs, threads, reused, reexecuted);
+        BOOST_CHECK_EQUAL(reused, txs.size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(parallel_high_conflict)
+{
+    TestChain chain(1);
+    std::vector<TesraTransaction> txs;
+    for (unsigned i = 0; i < 16; i++)
+        txs.push_back(chain.Call(i, chain.contracts[0], 7, i % 4 == 0 ? 1000 : 0));
+
+    for (unsigned threads = 1; threads <= 4; threads++)
+    {
+        uint64_t reused, reexecuted;
+        CheckDeterministic(chain, txs, threads, reused, reexecuted);
+        BOOST_CHECK_EQUAL(reused, 1U);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(parallel_mixed_conflict)
+{
+    TestChain chain(3);
+    for (int round = 0; round < 5; round++)
+    {
+        std::vector<TesraTransaction> txs;
+        for (unsigned i = 0; i < 40; i++)
+        {
+            Address to = insecure_rand() % 10 ? chain.contracts[insecure_rand() % 3] : Address(0x9999);
+            txs.push_back(chain.Call(100 * round + i, to, insecure_rand() % 4, insecure_rand() % 5 ? 0 : 500));
+        }
+        uint64_t reused, reexecuted;
+        CheckDeterministic(chain, txs, 1 + round % 4, reused, reexecuted);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(chain_data_reads_run_in_block_order)
+{
+    TestChain chain(12);
+    // Runtime code: storage[0] = TESRAINFO(height 0, key 0, type 0, any owner)
+    Address info(0x2000);
+    chain.base.createContract(info);
+    chain.base.setNewCode(info, fromHex("60006000600060002160005500"));
+    chain.base.commit(State::CommitBehaviour::KeepEmptyAccounts);
+
+    std::vector<TesraTransaction> txs;
+    for (unsigned i = 0; i < 12; i++)
+        txs.push_back(chain.Call(i, i % 3 ? chain.contracts[i] : info, 0));
+
+    // Like ConnectBlock, the workers run while this thread holds cs_main
+    LOCK(cs_main);
+    for (unsigned threads = 1; threads <= 4; threads++)
+    {
+        uint64_t reused, reexecuted;
+        CheckDeterministic(chain, txs, threads, reused, reexecuted);
+        BOOST_CHECK_EQUAL(reexecuted, 4U);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(deferred_commit)
+{
+    TestChain chain(3);
+    for (int round = 0; round < 5; round++)
+    {
+        std::vector<TesraTransaction> txs;
+        for (unsigned i = 0; i < 40; i++)
+        {
+            Address to = insecure_rand() % 10 ? chain.contracts[insecure_rand() % 3] : Address(0x9999);
+            txs.push_back(chain.Call(100 * round + i, to, insecure_rand() % 4, insecure_rand() % 5 ? 0 : 500));
+        }
+
+        TesraState immediate(chain.base);
+        std::vector<ResultExecute> expected = RunSequential(immediate, chain, txs);
+        TesraState deferred(chain.base);
+        std::vector<ResultExecute> results = RunSequential(deferred, chain, txs, true);
+        CheckSameResults(expected, results, false);
+        BOOST_CHECK(immediate.rootHash() == deferred.rootHash());
+        BOOST_CHECK(immediate.rootHashUTXO() == deferred.rootHashUTXO());
+        for (ResultExecute const& res : results)
+            BOOST_CHECK(res.txRec.stateRoot() == chain.base.rootHash());
+
+        uint64_t reused, reexecuted;
+        CheckDeterministic(chain, txs, 1 + round % 4, reused, reexecuted, true);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(block_savepoint_rollback)
+{
+    TestChain chain(3);
+    for (int round = 0; round < 5; round++)
+    {
+        std::vector<TesraTransaction> accepted;
+        TesraState speculative(chain.base);
+        speculative.setDeferredCommit(true);
+        speculative.setKeepChanges(true);
+        for (unsigned i = 0; i < 40; i++)
+        {
+            TesraState::BlockSavepoint savepoint = speculative.blockSavepoint();
+            unsigned group = 1 + insecure_rand() % 3;
+            std::vector<TesraTransaction> candidate;
+            for (unsigned j = 0; j < group; j++)
+            {
+                Address to = insecure_rand() % 10 ? chain.contracts[insecure_rand() % 3] : Address(0x9999);
+                candidate.push_back(chain.Call(1000 * round + 10 * i + j, to, insecure_rand() % 4, insecure_rand() % 5 ? 0 : 500));
+            }
+            for (TesraTransaction const& tx : candidate)
+            {
+                chain.sealEngine->deleteAddresses.clear();
+                speculative.execute(chain.envInfo, *chain.sealEngine, tx);
+            }
+            if (insecure_rand() % 3)
+                accepted.insert(accepted.end(), candidate.begin(), candidate.end());
+            else
+                speculative.rollbackBlock(savepoint);
+        }
+        speculative.hashBlock();
+        speculative.setKeepChanges(false);
+
+        TesraState immediate(chain.base);
+        RunSequential(immediate, chain, accepted);
+        BOOST_CHECK(immediate.rootHash() == speculative.rootHash());
+        BOOST_CHECK(immediate.rootHashUTXO() == speculative.rootHashUTXO());
+        speculative.setDeferredCommit(false);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(preexec_applied_to_template)
+{
+    TestChain chain(3);
+    Address const placeholder(0xb0);
+    EnvInfo preEnv(chain.envInfo);
+    preEnv.setAuthor(placeholder);
+
+    std::vector<std::vector<TesraTransaction>> candidates;
+    std::vector<TxAccessSet> preExecs;
+    for (unsigned i = 0; i < 30; i++)
+    {
+        std::vector<TesraTransaction> candidate;
+        for (unsigned j = 0, group = 1 + insecure_rand() % 2; j < group; j++)
+            candidate.push_back(chain.Call(10 * i + j, chain.contracts[insecure_rand() % 3], insecure_rand() % 8,
+                                           insecure_rand() % 4 ? 0 : 500));
+        candidates.push_back(candidate);
+
+        TesraState view(chain.base);
+        view.setDeferredCommit(true);
+        preExecs.push_back(TxAccessSet());
+        view.setAccessSet(&preExecs.back());
+        for (TesraTransaction const& tx : candidate)
+        {
+            chain.sealEngine->deleteAddresses.clear();
+            view.execute(preEnv, *chain.sealEngine, tx);
+        }
+        view.setAccessSet(nullptr);
+        view.setDeferredCommit(false);
+        preExecs.back().readAccounts.erase(placeholder);
+        preExecs.back().writtenAccounts.erase(placeholder);
+        preExecs.back().accounts.erase(placeholder);
+        BOOST_CHECK(!preExecs.back().readBlockInfo);
+    }
+
+    TesraState templ(chain.base);
+    templ.setDeferredCommit(true);
+    templ.setKeepChanges(true);
+    TxAccessSet written;
+    std::vector<TesraTransaction> accepted;
+    unsigned reused = 0;
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        if (!preExecs[i].conflictsWith(written))
+        {
+            templ.applyAccessSet(preExecs[i]);
+            written.mergeWrites(preExecs[i]);
+            reused++;
+        }
+        else
+        {
+            for (TesraTransaction const& tx : candidates[i])
+            {
+                TxAccessSet access;
+                templ.setAccessSet(&access);
+                chain.sealEngine->deleteAddresses.clear();
+                templ.execute(chain.envInfo, *chain.sealEngine, tx);
+                templ.setAccessSet(nullptr);
+                written.mergeWrites(access);
+            }
+        }
+        accepted.insert(accepted.end(), candidates[i].begin(), candidates[i].end());
+    }
+    templ.hashBlock();
+    templ.setKeepChanges(false);
+
+    TesraState immediate(chain.base);
+    RunSequential(immediate, chain, accepted);
+    BOOST_CHECK(reused > 0);
+    BOOST_CHECK(immediate.rootHash() == templ.rootHash());
+    BOOST_CHECK(immediate.rootHashUTXO() == templ.rootHashUTXO());
+    templ.setDeferredCommit(false);
+}
+
+BOOST_AUTO_TEST_CASE(block_info_reads_recorded)
+{
+    TestChain chain(1);
+    TesraState state(chain.base);
+    Address clock(0x2000);
+    // Runtime code: storage[0] = timestamp
+    state.createContract(clock);
+    state.setNewCode(clock, fromHex("4260005500"));
+    state.commit(State::CommitBehaviour::KeepEmptyAccounts);
+
+    TxAccessSet counter;
+    state.setAccessSet(&counter);
+    chain.sealEngine->deleteAddresses.clear();
+    state.execute(chain.envInfo, *chain.sealEngine, chain.Call(1, chain.contracts[0], 1));
+    BOOST_CHECK(!counter.readBlockInfo);
+
+    TxAccessSet timestamp;
+    state.setAccessSet(&timestamp);
+    chain.sealEngine->deleteAddresses.clear();
+    state.execute(chain.envInfo, *chain.sealEngine, chain.Call(2, clock, 0));
+    state.setAccessSet(nullptr);
+    BOOST_CHECK(timestamp.readBlockInfo);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_benchmark)
+{
+    TestChain chain(64);
+    std::vector<std::pair<std::string, std::vector<TesraTransaction>>> blocks;
+    // Low conflict: 64 contracts with four calls each. High conflict: every call goes to one of two contracts.
+    blocks.push_back(std::make_pair("LOW CONFLICT", std::vector<TesraTransaction>()));
+    blocks.push_back(std::make_pair("HIGH CONFLICT", std::vector<TesraTransaction>()));
+    for (unsigned i = 0; i < 256; i++)
+    {
+        blocks[0].second.push_back(chain.Call(i, chain.contracts[i % 64], i / 64));
+        blocks[1].second.push_back(chain.Call(i, chain.contracts[i % 2], i % 4));
+    }
+
+    for (auto const& block : blocks)
+    {
+        std::vector<TesraTransaction> const& txs = block.second;
+        std::cout << "\t" << block.first << ", " << txs.size() << " txs" << std::endl;
+
+        TesraState sequential(chain.base);
+        int64_t nStart = GetTimeMicros();
+        RunSequential(sequential, chain, txs);
+        std::cout << "\t\tSEQUENTIAL: " << 0.001 * (GetTimeMicros() - nStart) << " ms" << std::endl;
+
+        TesraState deferred(chain.base);
+        nStart = GetTimeMicros();
+        RunSequential(deferred, chain, txs, true);
+        std::cout << "\t\tSEQUENTIAL DEFERRED COMMIT: " << 0.001 * (GetTimeMicros() - nStart) << " ms" << std::endl;
+        BOOST_CHECK(deferred.rootHash() == sequential.rootHash());
+
+        for (unsigned threads = 1; threads <= 4; threads *= 2)
+        {
+            TesraState parallel(chain.base);
+            ParallelContractExecutor executor(threads, chain.params);
+            nStart = GetTimeMicros();
+            RunParallel(parallel, chain, txs, executor);
+            std::cout << "\t\tPARALLEL " << threads << " THREADS: " << 0.001 * (GetTimeMicros() - nStart) << " ms, reused "
+                      << executor.reused() << ", re-executed " << executor.reexecuted() << std::endl;
+            BOOST_CHECK(parallel.rootHash() == sequential.rootHash());
+            BOOST_CHECK_EQUAL(executor.reused() + executor.reexecuted(), txs.size());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,199 @@
+#include "util.h"
+
+#include "contract_api/statedump.h"
+#include "contract_api/statepruner.h"
+#include "test/test_contract.h"
+
+#include <libdevcore/TrieDB.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+using namespace dev;
+
+namespace
+{
+
+bytes Account(h256 const& storageRoot)
+{
+    RLPStream s(4);
+    s << u256(1) << u256(1000) << storageRoot << EmptySHA3;
+    return s.out();
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(statepruner_tests)
+
+BOOST_AUTO_TEST_CASE(prune_keeps_recent_roots)
+{
+    OverlayDB stateDB = OpenDB("prune_state");
+    OverlayDB utxoDB = OpenDB("prune_utxo");
+    CCriticalSection cs;
+    StatePruner pruner(stateDB, utxoDB, cs, 2, 1);
+
+    GenericTrieDB<OverlayDB> storage(&stateDB);
+    GenericTrieDB<OverlayDB> accounts(&stateDB);
+    GenericTrieDB<OverlayDB> utxo(&utxoDB);
+    storage.init();
+    accounts.init();
+    utxo.init();
+
+    std::vector<std::pair<h256, h256>> roots;
+    for (unsigned block = 0; block < 4; block++)
+    {
+        for (unsigned i = 0; i < 50; i++)
+        {
+            storage.insert(h256(i).asBytes(), rlp(u256(block * 100 + i)));
+            utxo.insert(h256(i).asBytes(), h256(block * 100 + i).asBytes());
+        }
+        for (unsigned i = 0; i < 20; i++)
+            accounts.insert(h256(i).asBytes(), Account(i == block ? storage.root() : EmptyTrie));
+        stateDB.commit();
+        utxoDB.commit();
+        roots.push_back(std::make_pair(accounts.root(), utxo.root()));
+        pruner.keep(block, accounts.root(), utxo.root());
+    }
+
+    BOOST_CHECK(pruner.prune() > 0);
+
+    // Roots of the last two blocks and everything they reference survive
+    for (unsigned block = 2; block < 4; block++)
+    {
+        OverlayDB stateView = stateDB.share();
+        OverlayDB utxoView = utxoDB.share();
+        GenericTrieDB<OverlayDB> a(&stateView, roots[block].first, Verification::Skip);
+        GenericTrieDB<OverlayDB> u(&utxoView, roots[block].second, Verification::Skip);
+        for (unsigned i = 0; i < 50; i++)
+            BOOST_CHECK(u.at(h256(i).asBytes()) == asString(h256(block * 100 + i).asBytes()));
+
+        std::string payload = a.at(h256(block).asBytes());
+        RLP account(payload);
+        GenericTrieDB<OverlayDB> s(&stateView, account[2].toHash<h256>(), Verification::Skip);
+        for (unsigned i = 0; i < 50; i++)
+            BOOST_CHECK(s.at(h256(i).asBytes()) == asString(rlp(u256(block * 100 + i))));
+    }
+
+    // The roots of the released blocks are gone
+    BOOST_CHECK(stateDB.share().lookup(roots[0].first).empty());
+    BOOST_CHECK(utxoDB.share().lookup(roots[0].second).empty());
+    BOOST_CHECK(!stateDB.share().lookup(EmptyTrie).empty());
+}
+
+BOOST_AUTO_TEST_CASE(state_dump_roundtrip)
+{
+    OverlayDB stateDB = OpenDB("dump_state");
+    OverlayDB utxoDB = OpenDB("dump_utxo");
+    dev::eth::SecureTrieDB<h256, OverlayDB> storage(&stateDB);
+    dev::eth::SecureTrieDB<h256, OverlayDB> accounts(&stateDB);
+    dev::eth::SecureTrieDB<h256, OverlayDB> utxo(&utxoDB);
+    storage.init();
+    accounts.init();
+    utxo.init();
+    for (unsigned i = 0; i < 300; i++)
+    {
+        storage.insert(h256(i), rlp(u256(i + 1)));
+        utxo.insert(h256(i), h256(i + 2).asBytes());
+    }
+    for (unsigned i = 0; i < 100; i++)
+        accounts.insert(h256(i), Account(i % 10 ? EmptyTrie : storage.root()));
+    stateDB.commit();
+    utxoDB.commit();
+
+    CContractStateDumpHeader header;
+    header.nHeight = 10;
+    header.hashStateRoot = h256Touint(accounts.root());
+    header.hashUTXORoot = h256Touint(utxo.root());
+    boost::filesystem::path path = GetDataDir() / "state.dump";
+    uint64_t nExported = 0;
+    std::string errinfo;
+    BOOST_CHECK(ExportContractState(stateDB, utxoDB, header, path, nExported, errinfo));
+    BOOST_CHECK(nExported > 0);
+
+    CContractStateDumpHeader read;
+    BOOST_CHECK(ReadContractStateHeader(path, read, errinfo));
+    BOOST_CHECK_EQUAL(read.nHeight, 10);
+    BOOST_CHECK(read.hashStateRoot == header.hashStateRoot);
+
+    OverlayDB importState = OpenDB("import_state");
+    OverlayDB importUTXO = OpenDB("import_utxo");
+    uint64_t nImported = 0;
+    BOOST_CHECK(ImportContractState(importState, importUTXO, path, nImported, errinfo));
+    BOOST_CHECK_EQUAL(nImported, nExported);
+
+    dev::eth::SecureTrieDB<h256, OverlayDB> a(&importState, accounts.root(), Verification::Skip);
+    dev::eth::SecureTrieDB<h256, OverlayDB> u(&importUTXO, utxo.root(), Verification::Skip);
+    std::string payload = a.at(h256(20));
+    dev::eth::SecureTrieDB<h256, OverlayDB> s(&importState, RLP(payload)[2].toHash<h256>(), Verification::Skip);
+    for (unsigned i = 0; i < 300; i++)
+    {
+        BOOST_CHECK(u.at(h256(i)) == asString(h256(i + 2).asBytes()));
+        BOOST_CHECK(s.at(h256(i)) == asString(rlp(u256(i + 1))));
+    }
+
+    // A damaged chunk is rejected
+    {
+        FILE* file = fopen(path.string().c_str(), "r+b");
+        BOOST_REQUIRE(file);
+        fseek(file, 200, SEEK_SET);
+        int c = fgetc(file);
+        fseek(file, 200, SEEK_SET);
+        fputc(c ^ 0xff, file);
+        fclose(file);
+    }
+    OverlayDB damagedState = OpenDB("damaged_state");
+    OverlayDB damagedUTXO = OpenDB("damaged_utxo");
+    BOOST_CHECK(!ImportContractState(damagedState, damagedUTXO, path, nImported, errinfo));
+}
+
+BOOST_AUTO_TEST_CASE(state_dump_keeps_keys)
+{
+    TestChain chain(4);
+    TesraState state(chain.base);
+    for (unsigned i = 0; i < 12; i++)
+    {
+        chain.sealEngine->deleteAddresses.clear();
+        state.execute(chain.envInfo, *chain.sealEngine, chain.Call(i, chain.contracts[i % 4], i % 5, i % 3 ? 0 : 500));
+    }
+    state.commitBlock();
+
+    CContractStateDumpHeader header;
+    header.hashStateRoot = h256Touint(state.rootHash());
+    header.hashUTXORoot = h256Touint(state.rootHashUTXO());
+    boost::filesystem::path path = GetDataDir() / "keys.dump";
+    uint64_t nEntries = 0;
+    std::string errinfo;
+    BOOST_REQUIRE(ExportContractState(state.db(), state.dbUtxo(), header, path, nEntries, errinfo));
+
+    OverlayDB importState = OpenDB("keys_state");
+    OverlayDB importUTXO = OpenDB("keys_utxo");
+    BOOST_REQUIRE(ImportContractState(importState, importUTXO, path, nEntries, errinfo));
+
+    // listcontracts and getstorage only find accounts and slots through the keys kept next to the tries
+    dev::eth::State imported(0, importState);
+    imported.setRoot(state.rootHash());
+    h256 next;
+    std::vector<std::pair<Address, u256>> listed = imported.addresses(h256(), 100, next);
+    BOOST_CHECK_EQUAL(listed.size(), state.addresses().size());
+    for (std::pair<Address, u256> const& a : listed)
+        BOOST_CHECK(state.addressInUse(a.first) && state.balance(a.first) == a.second);
+    for (Address const& c : chain.contracts)
+    {
+        std::map<h256, std::pair<u256, u256>> slots = imported.storage(c);
+        BOOST_CHECK(!slots.empty());
+        BOOST_CHECK(slots == state.storage(c));
+    }
+
+    // A state without them cannot be exported
+    OverlayDB plainState = OpenDB("keys_plain_state");
+    OverlayDB plainUTXO = OpenDB("keys_plain_utxo");
+    GenericTrieDB<OverlayDB> plain(&plainState);
+    plain.init();
+    plain.insert(h256(1).asBytes(), Account(EmptyTrie));
+    plainState.commit();
+    header.hashStateRoot = h256Touint(plain.root());
+    header.hashUTXORoot = h256Touint(EmptyTrie);
+    BOOST_CHECK(!ExportContractState(plainState, plainUTXO, header, GetDataDir() / "plain.dump", nEntries, errinfo));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
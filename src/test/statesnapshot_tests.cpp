@@ -0,0 +1,205 @@
+#include "random.h"
+#include "util.h"
+
+#include "contract_api/tesrastate.h"
+#include "test/test_contract.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+
+struct SnapshotChain : TestChain
+{
+    unsigned nTx = 0;
+
+    SnapshotChain(unsigned nContracts) : TestChain(nContracts) {}
+
+    std::vector<TesraTransaction> Block(unsigned size)
+    {
+        std::vector<TesraTransaction> txs;
+        for (unsigned i = 0; i < size; i++, nTx++)
+        {
+            Address to = insecure_rand() % 8 ? contracts[insecure_rand() % contracts.size()] : Address(0x9000 + nTx % 4);
+            txs.push_back(Call(nTx, to, insecure_rand() % 6, insecure_rand() % 4 ? 0 : 500));
+        }
+        return txs;
+    }
+
+    // Connects txs as ConnectBlock does, a check-only connect leaves the snapshot alone and is undone.
+    void Connect(TesraState& state, std::vector<TesraTransaction> const& txs, bool deferred, bool justCheck = false)
+    {
+        h256 root = state.rootHash();
+        h256 rootUTXO = state.rootHashUTXO();
+        state.setDeferredCommit(deferred);
+        for (TesraTransaction const& tx : txs)
+        {
+            sealEngine->deleteAddresses.clear();
+            state.execute(envInfo, *sealEngine, tx);
+        }
+        state.commitBlock(!justCheck);
+        state.setDeferredCommit(false);
+        if (justCheck)
+        {
+            state.setRoot(root);
+            state.setRootUTXO(rootUTXO);
+        }
+        else if (state.snapshot())
+            state.snapshot()->flush();
+    }
+};
+
+std::shared_ptr<StateSnapshot> OpenSnapshot(std::string const& name)
+{
+    return StateSnapshot::open((GetDataDir() / name).string());
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(statesnapshot_tests)
+
+BOOST_AUTO_TEST_CASE(snapshot_follows_blocks)
+{
+    SnapshotChain chain(4);
+    TesraState plain(chain.base);
+    TesraState snap(chain.base);
+    snap.setSnapshot(OpenSnapshot("snapshot_follow"));
+
+    for (int block = 0; block < 4; block++)
+    {
+        std::vector<TesraTransaction> txs = chain.Block(30);
+        chain.Connect(plain, txs, false);
+        chain.Connect(snap, txs, true);
+
+        BOOST_CHECK(plain.rootHash() == snap.rootHash());
+        BOOST_CHECK(plain.rootHashUTXO() == snap.rootHashUTXO());
+        BOOST_CHECK(snap.snapshot()->root() == snap.rootHash());
+
+        for (Address const& c : chain.contracts)
+        {
+            BOOST_CHECK(plain.balance(c) == snap.balance(c));
+            for (unsigned k = 0; k < 6; k++)
+                BOOST_CHECK(plain.storage(c, k) == snap.storage(c, k));
+        }
+        for (unsigned i = 0; i < 4; i++)
+            BOOST_CHECK(plain.balance(Address(0x9000 + i)) == snap.balance(Address(0x9000 + i)));
+    }
+
+    std::shared_ptr<StateSnapshot> rebuilt = OpenSnapshot("snapshot_rebuilt");
+    rebuilt->rebuild(snap.db(), snap.rootHash());
+    BOOST_CHECK(rebuilt->root() == snap.snapshot()->root());
+    for (Address const& c : chain.contracts)
+    {
+        BOOST_CHECK(rebuilt->account(sha3(c)) == snap.snapshot()->account(sha3(c)));
+        for (unsigned k = 0; k < 6; k++)
+            BOOST_CHECK(rebuilt->storage(sha3(c), sha3(h256(k))) == snap.snapshot()->storage(sha3(c), sha3(h256(k))));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_ignored_off_root)
+{
+    SnapshotChain chain(2);
+    TesraState snap(chain.base);
+    snap.setSnapshot(OpenSnapshot("snapshot_stale"));
+    chain.Connect(snap, chain.Block(10), true);
+
+    TesraState plain(chain.base);
+    snap.setRoot(chain.base.rootHash());
+    snap.setRootUTXO(chain.base.rootHashUTXO());
+    BOOST_CHECK(snap.snapshot()->root() != snap.rootHash());
+    for (Address const& c : chain.contracts)
+        for (unsigned k = 0; k < 6; k++)
+            BOOST_CHECK(snap.storage(c, k) == plain.storage(c, k));
+
+    std::vector<TesraTransaction> txs = chain.Block(10);
+    chain.Connect(plain, txs, false);
+    chain.Connect(snap, txs, true);
+    BOOST_CHECK(snap.rootHash() == plain.rootHash());
+    BOOST_CHECK(snap.snapshot()->root() == snap.rootHash());
+    for (Address const& c : chain.contracts)
+        for (unsigned k = 0; k < 6; k++)
+            BOOST_CHECK(snap.storage(c, k) == plain.storage(c, k));
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_skips_check_only_blocks)
+{
+    SnapshotChain chain(4);
+    TesraState plain(chain.base);
+    TesraState snap(chain.base);
+    snap.setSnapshot(OpenSnapshot("snapshot_check"));
+
+    std::vector<TesraTransaction> txs = chain.Block(20);
+    chain.Connect(plain, txs, false);
+    chain.Connect(snap, txs, true);
+    h256 root = snap.rootHash();
+
+    // A template checked with TestBlockValidity, then the block actually mined on the same parent
+    txs = chain.Block(20);
+    chain.Connect(snap, txs, true, true);
+    BOOST_CHECK(snap.rootHash() == root);
+    BOOST_CHECK(snap.snapshot()->root() == root);
+
+    chain.Connect(plain, txs, false);
+    chain.Connect(snap, txs, true);
+    BOOST_CHECK(snap.rootHash() == plain.rootHash());
+    BOOST_CHECK(snap.snapshot()->root() == snap.rootHash());
+    for (Address const& c : chain.contracts)
+        for (unsigned k = 0; k < 6; k++)
+            BOOST_CHECK(snap.storage(c, k) == plain.storage(c, k));
+
+    // The second block followed the first one instead of rebuilding, so it can be undone
+    BOOST_CHECK(snap.snapshot()->revert(root));
+    BOOST_CHECK(snap.snapshot()->root() == root);
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_reverts_disconnected_blocks)
+{
+    SnapshotChain chain(4);
+    TesraState snap(chain.base);
+    snap.setSnapshot(OpenSnapshot("snapshot_revert"));
+    chain.Connect(snap, chain.Block(20), true);
+    h256 root = snap.rootHash();
+    h256 rootUTXO = snap.rootHashUTXO();
+
+    std::shared_ptr<StateSnapshot> expected = OpenSnapshot("snapshot_revert_expected");
+    expected->rebuild(snap.db(), root);
+
+    for (int block = 0; block < 3; block++)
+        chain.Connect(snap, chain.Block(20), true);
+    BOOST_CHECK(snap.snapshot()->root() == snap.rootHash());
+
+    // A block that fails after its commit leaves the snapshot where it was
+    h256 tip = snap.rootHash();
+    snap.setDeferredCommit(true);
+    for (TesraTransaction const& tx : chain.Block(20))
+    {
+        chain.sealEngine->deleteAddresses.clear();
+        snap.execute(chain.envInfo, *chain.sealEngine, tx);
+    }
+    snap.commitBlock();
+    snap.setDeferredCommit(false);
+    BOOST_CHECK(snap.snapshot()->root() == snap.rootHash());
+    snap.snapshot()->discard();
+    BOOST_CHECK(snap.snapshot()->root() == tip);
+
+    snap.setRoot(root);
+    snap.setRootUTXO(rootUTXO);
+    BOOST_CHECK(!snap.snapshot()->revert(chain.base.rootHash()));
+    BOOST_CHECK(snap.snapshot()->root() == tip);
+    BOOST_CHECK(snap.snapshot()->revert(root));
+    BOOST_CHECK(snap.snapshot()->root() == root);
+
+    for (Address const& c : chain.contracts)
+    {
+        BOOST_CHECK(snap.snapshot()->account(sha3(c)) == expected->account(sha3(c)));
+        for (unsigned k = 0; k < 6; k++)
+            BOOST_CHECK(snap.snapshot()->storage(sha3(c), sha3(h256(k))) == expected->storage(sha3(c), sha3(h256(k))));
+    }
+    for (unsigned i = 0; i < 4; i++)
+        BOOST_CHECK(snap.snapshot()->account(sha3(Address(0x9000 + i))) == expected->account(sha3(Address(0x9000 + i))));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,136 @@
+#include "random.h"
+#include "util.h"
+
+#include "contract_api/storageresults.h"
+#include "contract_api/contractbase.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+
+std::vector<TransactionReceiptInfo> MakeResult(uint256 const& hashTx, unsigned nLogs)
+{
+    TransactionReceiptInfo info{GetRandHash(), 10, hashTx, 1, dev::Address(0x5000), dev::Address(0x1000),
+                                21000, 21000, dev::Address(), dev::eth::LogEntries(), 0};
+    for (unsigned i = 0; i < nLogs; i++)
+    {
+        // Repetitive data so the receipt compresses
+        info.logs.push_back(dev::eth::LogEntry(dev::Address(0x1000), {dev::h256(i)}, dev::bytes(200, 0x42)));
+    }
+    return std::vector<TransactionReceiptInfo>{info};
+}
+
+bool SameResult(std::vector<TransactionReceiptInfo> const& a, std::vector<TransactionReceiptInfo> const& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].blockHash != b[i].blockHash || a[i].transactionHash != b[i].transactionHash ||
+            a[i].from != b[i].from || a[i].to != b[i].to || a[i].gasUsed != b[i].gasUsed ||
+            a[i].logs.size() != b[i].logs.size())
+            return false;
+        for (size_t j = 0; j < a[i].logs.size(); j++)
+        {
+            if (a[i].logs[j].address != b[i].logs[j].address || a[i].logs[j].topics != b[i].logs[j].topics ||
+                a[i].logs[j].data != b[i].logs[j].data)
+                return false;
+        }
+    }
+    return true;
+}
+
+std::string StoreDir(std::string const& name)
+{
+    boost::filesystem::path dir = GetDataDir() / name;
+    boost::filesystem::create_directories(dir);
+    return dir.string();
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(storageresults_tests)
+
+BOOST_AUTO_TEST_CASE(results_roundtrip)
+{
+    for (bool compress : {false, true})
+    {
+        std::string dir = StoreDir(compress ? "results_lz4" : "results_raw");
+        std::vector<CTransaction> txs;
+        std::vector<std::vector<TransactionReceiptInfo>> results;
+        {
+            StorageResults store(dir, StorageResults::DEFAULT_CACHE_MEMORY, compress);
+            for (unsigned i = 0; i < 8; i++)
+            {
+                CMutableTransaction tx;
+                tx.nLockTime = i;
+                txs.push_back(CTransaction(tx));
+                results.push_back(MakeResult(txs.back().GetHash(), i));
+                store.addResult(uintToh256(txs.back().GetHash()), results.back());
+            }
+            BOOST_CHECK(SameResult(store.getResult(uintToh256(txs[3].GetHash())), results[3]));
+            store.commitResults();
+            store.deleteResults(std::vector<CTransaction>{txs[0]});
+            BOOST_CHECK(store.getResult(uintToh256(txs[0].GetHash())).empty());
+        }
+
+        // Read back from disk
+        StorageResults store(dir, StorageResults::DEFAULT_CACHE_MEMORY, !compress);
+        BOOST_CHECK(store.getResult(uintToh256(txs[0].GetHash())).empty());
+        for (unsigned i = 1; i < txs.size(); i++)
+            BOOST_CHECK(SameResult(store.getResult(uintToh256(txs[i].GetHash())), results[i]));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(results_cache_bounded)
+{
+    size_t limit = 8 * 1024;
+    StorageResults store(StoreDir("results_cache"), limit);
+    std::vector<uint256> hashes;
+    for (unsigned i = 0; i < 64; i++)
+    {
+        hashes.push_back(GetRandHash());
+        std::vector<TransactionReceiptInfo> result = MakeResult(hashes.back(), 2);
+        store.addResult(uintToh256(hashes.back()), result);
+    }
+    store.commitResults();
+    BOOST_CHECK(store.cacheMemoryUsage() <= limit);
+
+    for (uint256 const& hash : hashes)
+        BOOST_CHECK(store.getResult(uintToh256(hash)).size() == 1);
+    BOOST_CHECK(store.cacheMemoryUsage() <= limit);
+}
+
+BOOST_AUTO_TEST_CASE(results_migrate_hex_keys)
+{
+    std::string dir = StoreDir("results_legacy");
+    uint256 hashTx = GetRandHash();
+    std::vector<TransactionReceiptInfo> result = MakeResult(hashTx, 3);
+    {
+        // Write the receipt the way the previous format did: hex key, plain RLP value
+        StorageResults store(dir, StorageResults::DEFAULT_CACHE_MEMORY, false);
+        store.addResult(uintToh256(hashTx), result);
+        store.commitResults();
+    }
+    {
+        leveldb::DB* db;
+        leveldb::Options options;
+        BOOST_CHECK(leveldb::DB::Open(options, dir + "/resultsDB", &db).ok());
+        dev::h256 key = uintToh256(hashTx);
+        std::string value;
+        BOOST_CHECK(db->Get(leveldb::ReadOptions(), leveldb::Slice((const char*)key.data(), dev::h256::size), &value).ok());
+        leveldb::WriteBatch batch;
+        batch.Delete(leveldb::Slice((const char*)key.data(), dev::h256::size));
+        batch.Delete("version");
+        batch.Put(key.hex(), value.substr(1));
+        BOOST_CHECK(db->Write(leveldb::WriteOptions(), &batch).ok());
+        delete db;
+    }
+
+    StorageResults store(dir);
+    BOOST_CHECK(SameResult(store.getResult(uintToh256(hashTx)), result));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,70 @@
+#ifndef TESRA_TEST_TEST_CONTRACT_H
+#define TESRA_TEST_TEST_CONTRACT_H
+
+#include "util.h"
+#include "contract_api/tesrastate.h"
+
+#include <libethashseal/GenesisInfo.h>
+#include <libethereum/ChainParams.h>
+#include <libdevcore/OverlayDB.h>
+#include <libdevcore/SHA3.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+// Runtime code: storage[calldata[0]] += 1
+static const char* const COUNTER_CODE = "600035805460010190550000";
+
+/** Contract state with counter contracts at 0x1000.. and a sealing setup to execute calls to them. */
+struct TestChain
+{
+    dev::eth::ChainParams params;
+    std::unique_ptr<dev::eth::SealEngineFace> sealEngine;
+    dev::eth::EnvInfo envInfo;
+    TesraState base;
+    std::vector<dev::Address> contracts;
+
+    TestChain(unsigned nContracts) : params(dev::eth::genesisInfo(dev::eth::Network::HomesteadTest)), sealEngine(params.createSealEngine())
+    {
+        envInfo.setNumber(1);
+        envInfo.setGasLimit(40000000);
+        envInfo.setAuthor(dev::Address(0xa0));
+        sealEngine->pinEVMSchedule(&sealEngine->evmSchedule(envInfo));
+
+        base.noteAccountStartNonce(0);
+        base.setRoot(dev::sha3(dev::rlp("")));
+        base.setRootUTXO(dev::sha3(dev::rlp("")));
+        for (unsigned i = 0; i < nContracts; i++)
+        {
+            dev::Address addr(0x1000 + i);
+            base.createContract(addr);
+            base.setNewCode(addr, dev::fromHex(COUNTER_CODE));
+            contracts.push_back(addr);
+        }
+        base.commit(dev::eth::State::CommitBehaviour::KeepEmptyAccounts);
+    }
+
+    TesraTransaction Call(unsigned n, dev::Address const& to, dev::u256 key, dev::u256 value = 0) const
+    {
+        TesraTransaction tx(value, 1, 100000, to, dev::h256(key).asBytes(), 0);
+        tx.forceSender(dev::Address(0x5000 + n));
+        tx.setHashWith(dev::sha3(dev::h256(n).asBytes()));
+        tx.setNVout(n % 3);
+        tx.setVersion(VersionVM::GetEVMDefault());
+        return tx;
+    }
+};
+
+/** Opens (creating it if needed) a LevelDB named name in the test data directory. */
+inline dev::OverlayDB OpenDB(std::string const& name)
+{
+    boost::filesystem::path path = GetDataDir() / name;
+    boost::filesystem::create_directories(path);
+    ldb::Options o;
+    o.create_if_missing = true;
+    ldb::DB* db = nullptr;
+    BOOST_REQUIRE(ldb::DB::Open(o, path.string(), &db).ok());
+    return dev::OverlayDB(db);
+}
+
+#endif // TESRA_TEST_TEST_CONTRACT_H
@@ -0,0 +1,65 @@
+#include "util.h"
+#include "test/test_contract.h"
+
+#include <libdevcore/OverlayDB.h>
+#include <libdevcore/TrieDB.h>
+#include <libdevcore/TrieNodeCache.h>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace dev;
+
+BOOST_AUTO_TEST_SUITE(trienodecache_tests)
+
+BOOST_AUTO_TEST_CASE(trie_node_cache_reads)
+{
+    TrieNodeCache cache;
+    OverlayDB db = OpenDB("trienodecache_reads");
+    db.setNodeCache(&cache);
+
+    GenericTrieDB<OverlayDB> trie(&db);
+    trie.init();
+    for (unsigned i = 0; i < 200; i++)
+        trie.insert(h256(i).asBytes(), h256(i * 7 + 1).asBytes());
+    h256 root = trie.root();
+    db.commit();
+    BOOST_CHECK_EQUAL(cache.size(), 0U);
+
+    OverlayDB view = db.share();
+    BOOST_CHECK(view.nodeCache() == &cache);
+    GenericTrieDB<OverlayDB> read(&view, root, Verification::Skip);
+    for (unsigned i = 0; i < 200; i++)
+        BOOST_CHECK(read.at(h256(i).asBytes()) == asString(h256(i * 7 + 1).asBytes()));
+    BOOST_CHECK(cache.size() > 0U);
+    BOOST_CHECK(cache.hits() > 0U);
+    uint64_t misses = cache.misses();
+
+    for (unsigned i = 0; i < 200; i++)
+        BOOST_CHECK(read.at(h256(i).asBytes()) == asString(h256(i * 7 + 1).asBytes()));
+    BOOST_CHECK_EQUAL(cache.misses(), misses);
+}
+
+BOOST_AUTO_TEST_CASE(trie_node_cache_memory_bound)
+{
+    TrieNodeCache cache;
+    cache.setMaxMemory(4096);
+    for (unsigned i = 0; i < 100; i++)
+        cache.store(h256(i), std::string(100, char(i)));
+    BOOST_CHECK(cache.size() < 100U);
+    BOOST_CHECK(cache.memoryUsage() <= cache.maxMemory());
+
+    std::string node;
+    BOOST_CHECK(cache.get(h256(99), node));
+    BOOST_CHECK(node == std::string(100, char(99)));
+    BOOST_CHECK(!cache.get(h256(0), node));
+
+    cache.erase(h256(99));
+    BOOST_CHECK(!cache.get(h256(99), node));
+
+    cache.setMaxMemory(0);
+    BOOST_CHECK_EQUAL(cache.size(), 0U);
+    cache.store(h256(1), "node");
+    BOOST_CHECK_EQUAL(cache.size(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -10,6 +10,7 @@
 #include "pow.h"
 #include "uint256.h"
 #include "accumulators.h"
+#include "contract/libdevcore/SHA3.h"
 
 #include <stdint.h>
 
@@ -17,6 +18,12 @@
 
 
 static const char DB_HEIGHTINDEX = 'h';
+static const char DB_LOGBLOOM = 'L';
+static const char DB_LOGBLOOMSECTION = 'S';
+static const char DB_LOGTOPICINDEX = 'T';
+static const char DB_LOGTOPICUNDO = 'U';
+
+static const char *const LOG_BLOOM_HEIGHT = "logbloomheight";
 
 
 using namespace std;
@@ -221,9 +228,52 @@ bool CBlockTreeDB::WriteHeightIndex(const CHeightTxIndexKey &heightIndex, const
 
 
 
+CLogBloomFilter::CLogBloomFilter(std::set<dev::h160> const &_addresses, std::vector<boost::optional<dev::h256>> const &_topics)
+{
+    for (const dev::h160 &address : _addresses)
+        addresses.push_back(dev::eth::LogBloom().shiftBloom<3>(dev::sha3(address.ref())));
+    for (const boost::optional<dev::h256> &topic : _topics)
+    {
+        if (topic)
+            topics.push_back(dev::eth::LogBloom().shiftBloom<3>(dev::sha3(topic.get().ref())));
+    }
+}
+
+bool CLogBloomFilter::Matches(const dev::eth::LogBloom &bloom) const
+{
+    // Receipts without logs never match, they add nothing to the bloom
+    if (!bloom)
+        return false;
+
+    auto any = [&](const std::vector<dev::eth::LogBloom> &parts) {
+        if (parts.empty())
+            return true;
+        for (const dev::eth::LogBloom &part : parts)
+        {
+            if (bloom.contains(part))
+                return true;
+        }
+        return false;
+    };
+    return any(addresses) && any(topics);
+}
+
 int CBlockTreeDB::ReadHeightIndex(int low, int high, int minconf,
                                   std::vector<std::vector<uint256>> &blocksOfHashes,
-                                  std::set<dev::h160> const &addresses) {
+                                  std::set<dev::h160> const &addresses,
+                                  const CLogBloomFilter *filter) {
+    return ReadHeightIndex(low, high, minconf,
+                           [&](const CHeightTxIndexKey &, const std::vector<uint256> &hashesTx) {
+                               blocksOfHashes.push_back(hashesTx);
+                               return true;
+                           },
+                           addresses, filter);
+}
+
+int CBlockTreeDB::ReadHeightIndex(int low, int high, int minconf,
+                                  std::function<bool(const CHeightTxIndexKey &, const std::vector<uint256> &)> const &fn,
+                                  std::set<dev::h160> const &addresses,
+                                  const CLogBloomFilter *filter) {
 
     if ((high < low && high > -1) || (high == 0 && low == 0) || (high < -1 || low < 0)) {
         return -1;
@@ -241,6 +291,22 @@ int CBlockTreeDB::ReadHeightIndex(int low, int high, int minconf,
 
     int curheight = 0;
 
+    // Blocks connected before the blooms were introduced are always read
+    int bloomHeight = 0;
+    if (filter && !ReadInt(LOG_BLOOM_HEIGHT, bloomHeight)) {
+        filter = NULL;
+    }
+    int section = -1;
+    int bloomChecked = -1;
+    bool sectionMatch = true;
+    bool blockMatch = true;
+
+    auto seekHeight = [&](unsigned int height) {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << make_pair(DB_HEIGHTINDEX, CHeightTxIndexIteratorKey(height));
+        pcursor->Seek(leveldb::Slice(&ssKey[0], ssKey.size()));
+    };
+
     for (size_t count = 0; pcursor->Valid(); pcursor->Next()) {
 
         std::pair<char, CHeightTxIndexKey> key;
@@ -265,6 +331,28 @@ int CBlockTreeDB::ReadHeightIndex(int low, int high, int minconf,
 
         curheight = nextHeight;
 
+        if (filter && nextHeight >= bloomHeight) {
+            dev::eth::LogBloom bloom;
+            if (int(nextHeight / LOG_BLOOM_SECTION_SIZE) != section) {
+                section = nextHeight / LOG_BLOOM_SECTION_SIZE;
+                sectionMatch = !ReadLogBloomSection(section, bloom) || filter->Matches(bloom);
+            }
+            if (!sectionMatch) {
+                seekHeight((section + 1) * LOG_BLOOM_SECTION_SIZE);
+                if (!pcursor->Valid())
+                    break;
+                pcursor->Prev();
+                continue;
+            }
+            if (nextHeight != bloomChecked) {
+                bloomChecked = nextHeight;
+                blockMatch = !ReadLogBloom(nextHeight, bloom) || filter->Matches(bloom);
+            }
+            if (!blockMatch) {
+                continue;
+            }
+        }
+
         auto address = key.second.address;
         if (!addresses.empty() && addresses.find(address) == addresses.end()) {
             continue;
@@ -278,7 +366,9 @@ int CBlockTreeDB::ReadHeightIndex(int low, int high, int minconf,
 
         count += hashesTx.size();
 
-        blocksOfHashes.push_back(hashesTx);
+        if (!fn(key.second, hashesTx)) {
+            break;
+        }
     }
 
     return curheight;
@@ -342,6 +432,180 @@ bool CBlockTreeDB::WipeHeightIndex() {
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::WriteLogBloom(const unsigned int &height, const dev::eth::LogBloom &bloom) {
+    CLevelDBBatch batch;
+    unsigned int section = height / LOG_BLOOM_SECTION_SIZE;
+    dev::eth::LogBloom sectionBloom;
+    ReadLogBloomSection(section, sectionBloom);
+    sectionBloom |= bloom;
+
+    batch.Write(std::make_pair(DB_LOGBLOOM, CHeightTxIndexIteratorKey(height)), bloom.asBytes());
+    batch.Write(std::make_pair(DB_LOGBLOOMSECTION, CHeightTxIndexIteratorKey(section)), sectionBloom.asBytes());
+
+    int bloomHeight;
+    if (!ReadInt(LOG_BLOOM_HEIGHT, bloomHeight)) {
+        batch.Write(std::make_pair('I', std::string(LOG_BLOOM_HEIGHT)), int(height));
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadLogBloom(const unsigned int &height, dev::eth::LogBloom &bloom) {
+    std::vector<unsigned char> data;
+    if (!Read(std::make_pair(DB_LOGBLOOM, CHeightTxIndexIteratorKey(height)), data) || data.size() != dev::eth::LogBloom::size)
+        return false;
+    bloom = dev::eth::LogBloom(data);
+    return true;
+}
+
+bool CBlockTreeDB::ReadLogBloomSection(const unsigned int &section, dev::eth::LogBloom &bloom) {
+    std::vector<unsigned char> data;
+    if (!Read(std::make_pair(DB_LOGBLOOMSECTION, CHeightTxIndexIteratorKey(section)), data) || data.size() != dev::eth::LogBloom::size)
+        return false;
+    bloom = dev::eth::LogBloom(data);
+    return true;
+}
+
+bool CBlockTreeDB::EraseLogBloom(const unsigned int &height) {
+    CLevelDBBatch batch;
+    unsigned int section = height / LOG_BLOOM_SECTION_SIZE;
+    batch.Erase(std::make_pair(DB_LOGBLOOM, CHeightTxIndexIteratorKey(height)));
+
+    // Blocks are disconnected from the tip, so the rest of the section is below height
+    dev::eth::LogBloom sectionBloom;
+    bool fFound = false;
+    for (unsigned int h = section * LOG_BLOOM_SECTION_SIZE; h < height; h++) {
+        dev::eth::LogBloom bloom;
+        if (ReadLogBloom(h, bloom)) {
+            sectionBloom |= bloom;
+            fFound = true;
+        }
+    }
+    if (fFound)
+        batch.Write(std::make_pair(DB_LOGBLOOMSECTION, CHeightTxIndexIteratorKey(section)), sectionBloom.asBytes());
+    else
+        batch.Erase(std::make_pair(DB_LOGBLOOMSECTION, CHeightTxIndexIteratorKey(section)));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::WipeLogBlooms() {
+
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+    CLevelDBBatch batch;
+
+    for (char prefix : {DB_LOGBLOOM, DB_LOGBLOOMSECTION}) {
+        CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+        ssKeySet << prefix;
+        pcursor->Seek(leveldb::Slice(&ssKeySet[0], ssKeySet.size()));
+
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            std::pair<char, CHeightTxIndexIteratorKey> key;
+            if (GetKey(pcursor.get(), key) && key.first == prefix) {
+                batch.Erase(key);
+                pcursor->Next();
+            } else {
+                break;
+            }
+        }
+    }
+    batch.Erase(std::make_pair('I', std::string(LOG_BLOOM_HEIGHT)));
+
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::WriteLogTopicIndex(const unsigned int &height, const std::vector<std::pair<CLogTopicIndexKey, uint256>> &entries) {
+    CLevelDBBatch batch;
+    std::vector<CLogTopicIndexKey> keys;
+    keys.reserve(entries.size());
+    for (const auto &e : entries) {
+        batch.Write(std::make_pair(DB_LOGTOPICINDEX, e.first), e.second);
+        keys.push_back(e.first);
+    }
+    batch.Write(std::make_pair(DB_LOGTOPICUNDO, CHeightTxIndexIteratorKey(height)), keys);
+    return WriteBatch(batch);
+}
+
+size_t CBlockTreeDB::ReadLogTopicIndex(const dev::h160 &address, uint8_t position, const dev::h256 &topic, int low, int high,
+                                       std::function<bool(const CLogTopicIndexKey &, const uint256 &)> const &fn) {
+
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair(DB_LOGTOPICINDEX, CLogTopicIndexKey(address, position, topic, std::max(low, 0)));
+    pcursor->Seek(leveldb::Slice(&ssKeySet[0], ssKeySet.size()));
+
+    size_t count = 0;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CLogTopicIndexKey> key;
+        if (!GetKey(pcursor.get(), key) || key.first != DB_LOGTOPICINDEX || key.second.address != address ||
+            key.second.position != position || key.second.topic != topic) {
+            break;
+        }
+        if (high > -1 && int(key.second.height) > high) {
+            break;
+        }
+
+        uint256 hashTx;
+        if (!GetValue(pcursor.get(), hashTx)) {
+            break;
+        }
+        count++;
+        if (!fn(key.second, hashTx)) {
+            break;
+        }
+    }
+    return count;
+}
+
+bool CBlockTreeDB::EraseLogTopicIndex(const unsigned int &height) {
+    std::vector<CLogTopicIndexKey> keys;
+    if (!Read(std::make_pair(DB_LOGTOPICUNDO, CHeightTxIndexIteratorKey(height)), keys))
+        return true;
+
+    CLevelDBBatch batch;
+    for (const CLogTopicIndexKey &key : keys)
+        batch.Erase(std::make_pair(DB_LOGTOPICINDEX, key));
+    batch.Erase(std::make_pair(DB_LOGTOPICUNDO, CHeightTxIndexIteratorKey(height)));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::WipeLogTopicIndex() {
+
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+    CLevelDBBatch batch;
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << DB_LOGTOPICINDEX;
+    pcursor->Seek(leveldb::Slice(&ssKeySet[0], ssKeySet.size()));
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CLogTopicIndexKey> key;
+        if (GetKey(pcursor.get(), key) && key.first == DB_LOGTOPICINDEX) {
+            batch.Erase(key);
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    ssKeySet.clear();
+    ssKeySet << DB_LOGTOPICUNDO;
+    pcursor->Seek(leveldb::Slice(&ssKeySet[0], ssKeySet.size()));
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CHeightTxIndexIteratorKey> key;
+        if (GetKey(pcursor.get(), key) && key.first == DB_LOGTOPICUNDO) {
+            batch.Erase(key);
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    return WriteBatch(batch);
+}
+
 
 
 
@@ -12,10 +12,15 @@
 #include "primitives/zerocoin.h"
 
 #include <map>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include <functional>
+
+#include <boost/optional.hpp>
+
 class CCoins;
 class uint256;
 
@@ -43,6 +48,23 @@ public:
 };
 
 
+/** Number of blocks whose log blooms are also merged into one section bloom. */
+static const unsigned int LOG_BLOOM_SECTION_SIZE = 1024;
+
+/**
+ * Tests the log bloom of a block against a searchlogs query. A block can only hold a match
+ * when one of the addresses and one of the topics is in its bloom, an empty set matches anything.
+ */
+struct CLogBloomFilter
+{
+    std::vector<dev::eth::LogBloom> addresses;
+    std::vector<dev::eth::LogBloom> topics;
+
+    CLogBloomFilter(std::set<dev::h160> const &_addresses, std::vector<boost::optional<dev::h256>> const &_topics);
+
+    bool Matches(const dev::eth::LogBloom &bloom) const;
+};
+
 class CBlockTreeDB : public CLevelDBWrapper
 {
 public:
@@ -112,15 +134,44 @@ public:
      * @param minconf stop iterating of the block height does not have enough confirmations (ignored if <= 0)
      * @param blocksOfHashes transaction hashes in blocks iterated are collected into this vector.
      * @param addresses filter out a block unless it matches one of the addresses in this set.
+     * @param filter skip sections and blocks whose log bloom does not match (ignored if null).
      *
      * @return the height of the latest block iterated. 0 if no block is iterated.
      */
     int ReadHeightIndex(int low, int high, int minconf,
                         std::vector<std::vector<uint256>> &blocksOfHashes,
-                        std::set<dev::h160> const &addresses);
+                        std::set<dev::h160> const &addresses,
+                        const CLogBloomFilter *filter = NULL);
+    /** Same, but passes each block and address to fn as it is read and stops when fn returns false. */
+    int ReadHeightIndex(int low, int high, int minconf,
+                        std::function<bool(const CHeightTxIndexKey &, const std::vector<uint256> &)> const &fn,
+                        std::set<dev::h160> const &addresses,
+                        const CLogBloomFilter *filter = NULL);
     bool EraseHeightIndex(const unsigned int &height);
     bool WipeHeightIndex();
 
+    /** Stores the log bloom of a block and merges it into the bloom of its section. */
+    bool WriteLogBloom(const unsigned int &height, const dev::eth::LogBloom &bloom);
+    bool ReadLogBloom(const unsigned int &height, dev::eth::LogBloom &bloom);
+    bool ReadLogBloomSection(const unsigned int &section, dev::eth::LogBloom &bloom);
+    /** Removes the bloom of a block and rebuilds its section from the blocks below it. */
+    bool EraseLogBloom(const unsigned int &height);
+    bool WipeLogBlooms();
+
+    /** Stores the log topic index entries of a block together with the list used to erase them. */
+    bool WriteLogTopicIndex(const unsigned int &height, const std::vector<std::pair<CLogTopicIndexKey, uint256>> &entries);
+
+    /**
+     * Streams the entries of one (contract, topic position, topic) between two heights in chain
+     * order, until fn returns false.
+     *
+     * @return the number of entries passed to fn.
+     */
+    size_t ReadLogTopicIndex(const dev::h160 &address, uint8_t position, const dev::h256 &topic, int low, int high,
+                             std::function<bool(const CLogTopicIndexKey &, const uint256 &)> const &fn);
+    bool EraseLogTopicIndex(const unsigned int &height);
+    bool WipeLogTopicIndex();
+
     
 
 };